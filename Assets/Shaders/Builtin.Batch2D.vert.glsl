@@ -0,0 +1,21 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in uint inTexture;
+
+layout(push_constant) uniform Batch2DConstants {
+    mat4 Projection;
+} batch;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outUV;
+layout(location = 2) flat out uint outTexture;
+
+void main() {
+    gl_Position = batch.Projection * vec4(inPosition, 0.0, 1.0);
+    outColor = inColor;
+    outUV = inUV;
+    outTexture = inTexture;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec4 inColor;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) flat in uint inTexture;
+
+layout(set = 0, binding = 1) uniform sampler2D g_Textures[];
+
+layout(location = 0) out vec4 outColor;
+
+// Matches Batch2D::NoTexture.
+const uint NoTexture = 0xffffffffu;
+
+void main() {
+    // Sprites of one draw may all use different textures.
+    outColor = inColor;
+    if (inTexture != NoTexture) {
+        outColor *= texture(g_Textures[nonuniformEXT(inTexture)], inUV);
+    }
+}
\ No newline at end of file
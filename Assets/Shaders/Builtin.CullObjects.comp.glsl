@@ -0,0 +1,92 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Constant ids match ObjectCullTraits.
+layout(local_size_x = 64, local_size_x_id = 0) in;
+layout(constant_id = 1) const bool Statistics = true;
+
+struct ObjectData {
+    mat4 Transform;
+    vec4 Bounds;
+};
+
+struct DrawRecord {
+    uint IndexCount;
+    uint InstanceCount;
+    uint FirstIndex;
+    int VertexOffset;
+    uint FirstInstance;
+    uint ObjectIndex;
+    uint Padding0;
+    uint Padding1;
+};
+
+layout(set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData Items[];
+} g_Objects[];
+
+layout(set = 0, binding = 0) buffer DrawBuffer {
+    DrawRecord Items[];
+} g_Draws[];
+
+layout(set = 0, binding = 0) buffer UintBuffer {
+    uint Items[];
+} g_Uints[];
+
+layout(set = 0, binding = 0) buffer CounterBuffer {
+    uint DrawCount;
+    uint ClusterDrawCount;
+    uint ObjectsIn;
+    uint ObjectsVisible;
+    uint TrianglesIn;
+    uint TrianglesAfterFrustum;
+    uint TrianglesVisible;
+    uint ClustersVisible;
+} g_Counters[];
+
+layout(push_constant) uniform CullConstants {
+    vec4 Planes[6];
+    uint ObjectBuffer;
+    uint InputDraws;
+    uint OutputDraws;
+    uint Visibility;
+    uint Counters;
+    uint ObjectCount;
+} cull;
+
+void main() {
+    uint object = gl_GlobalInvocationID.x;
+    if (object >= cull.ObjectCount) {
+        return;
+    }
+
+    DrawRecord draw = g_Draws[cull.InputDraws].Items[object];
+    if (draw.IndexCount == 0) {
+        g_Uints[cull.Visibility].Items[object] = 0;
+        return;
+    }
+
+    uint triangles = draw.IndexCount / 3;
+    if (Statistics) {
+        atomicAdd(g_Counters[cull.Counters].ObjectsIn, 1);
+        atomicAdd(g_Counters[cull.Counters].TrianglesIn, triangles);
+    }
+
+    vec4 bounds = g_Objects[cull.ObjectBuffer].Items[draw.ObjectIndex].Bounds;
+    bool visible = true;
+    for (int i = 0; i < 6; i++) {
+        visible = visible && dot(cull.Planes[i].xyz, bounds.xyz) + cull.Planes[i].w >= -bounds.w;
+    }
+
+    g_Uints[cull.Visibility].Items[object] = visible ? 1 : 0;
+    if (!visible) {
+        return;
+    }
+
+    if (Statistics) {
+        atomicAdd(g_Counters[cull.Counters].ObjectsVisible, 1);
+        atomicAdd(g_Counters[cull.Counters].TrianglesAfterFrustum, triangles);
+    }
+    uint slot = atomicAdd(g_Counters[cull.Counters].DrawCount, 1);
+    g_Draws[cull.OutputDraws].Items[slot] = draw;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// One workgroup per cluster, one invocation per triangle.
+layout(local_size_x = 64) in;
+// Constant ids match TriangleCullTraits.
+layout(constant_id = 0) const bool Statistics = true;
+
+struct ObjectData {
+    mat4 Transform;
+    vec4 Bounds;
+};
+
+struct Cluster {
+    uint ObjectIndex;
+    uint FirstIndex;
+    uint TriangleCount;
+    int VertexOffset;
+};
+
+struct DrawRecord {
+    uint IndexCount;
+    uint InstanceCount;
+    uint FirstIndex;
+    int VertexOffset;
+    uint FirstInstance;
+    uint ObjectIndex;
+    uint Padding0;
+    uint Padding1;
+};
+
+layout(set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData Items[];
+} g_Objects[];
+
+layout(set = 0, binding = 0) readonly buffer ClusterBuffer {
+    Cluster Items[];
+} g_Clusters[];
+
+layout(set = 0, binding = 0) writeonly buffer DrawBuffer {
+    DrawRecord Items[];
+} g_Draws[];
+
+layout(set = 0, binding = 0) readonly buffer VertexBuffer {
+    vec2 Items[];
+} g_Vertices[];
+
+layout(set = 0, binding = 0) buffer UintBuffer {
+    uint Items[];
+} g_Uints[];
+
+layout(set = 0, binding = 0) buffer CounterBuffer {
+    uint DrawCount;
+    uint ClusterDrawCount;
+    uint ObjectsIn;
+    uint ObjectsVisible;
+    uint TrianglesIn;
+    uint TrianglesAfterFrustum;
+    uint TrianglesVisible;
+    uint ClustersVisible;
+} g_Counters[];
+
+layout(push_constant) uniform CullConstants {
+    mat4 ViewProjection;
+    vec2 Viewport;
+    uint ObjectBuffer;
+    uint Visibility;
+    uint Clusters;
+    uint ClusterDraws;
+    uint Vertices;
+    uint Indices;
+    uint CulledIndices;
+    uint Counters;
+    uint ClusterCount;
+} cull;
+
+shared uint s_visible;
+
+bool KeepTriangle(vec4 c0, vec4 c1, vec4 c2) {
+    // Triangles crossing the near plane are left to the clipper.
+    if (c0.w <= 0.0 || c1.w <= 0.0 || c2.w <= 0.0) {
+        return true;
+    }
+
+    vec2 p0 = (c0.xy / c0.w * 0.5 + 0.5) * cull.Viewport;
+    vec2 p1 = (c1.xy / c1.w * 0.5 + 0.5) * cull.Viewport;
+    vec2 p2 = (c2.xy / c2.w * 0.5 + 0.5) * cull.Viewport;
+
+    float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+    if (area == 0.0) {
+        return false;
+    }
+
+    // Samples sit on pixel centers, if rounding collapses either axis of the bounds
+    // the triangle falls between two rows or columns of samples.
+    vec2 lo = min(p0, min(p1, p2));
+    vec2 hi = max(p0, max(p1, p2));
+    return !any(equal(round(lo), round(hi)));
+}
+
+void main() {
+    uint clusterIndex = gl_WorkGroupID.x;
+    if (clusterIndex >= cull.ClusterCount) {
+        return;
+    }
+
+    Cluster cluster = g_Clusters[cull.Clusters].Items[clusterIndex];
+    if (g_Uints[cull.Visibility].Items[cluster.ObjectIndex] == 0) {
+        return;
+    }
+
+    if (gl_LocalInvocationIndex == 0) {
+        s_visible = 0;
+    }
+    barrier();
+
+    uint triangle = gl_LocalInvocationIndex;
+    bool keep = false;
+    uint indices[3];
+    if (triangle < cluster.TriangleCount) {
+        uint base = cluster.FirstIndex + triangle * 3;
+        mat4 transform = cull.ViewProjection * g_Objects[cull.ObjectBuffer].Items[cluster.ObjectIndex].Transform;
+        vec4 clip[3];
+        for (int i = 0; i < 3; i++) {
+            indices[i] = g_Uints[cull.Indices].Items[base + i];
+            vec2 position = g_Vertices[cull.Vertices].Items[cluster.VertexOffset + int(indices[i])];
+            clip[i] = transform * vec4(position, 0.0, 1.0);
+        }
+        keep = KeepTriangle(clip[0], clip[1], clip[2]);
+    }
+
+    uint slot = 0;
+    if (keep) {
+        slot = atomicAdd(s_visible, 1);
+        // Survivors are packed at the front of the cluster's own index range.
+        uint target = cluster.FirstIndex + slot * 3;
+        for (int i = 0; i < 3; i++) {
+            g_Uints[cull.CulledIndices].Items[target + i] = indices[i];
+        }
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0 && s_visible > 0) {
+        if (Statistics) {
+            atomicAdd(g_Counters[cull.Counters].TrianglesVisible, s_visible);
+            atomicAdd(g_Counters[cull.Counters].ClustersVisible, 1);
+        }
+        uint drawSlot = atomicAdd(g_Counters[cull.Counters].ClusterDrawCount, 1);
+        g_Draws[cull.ClusterDraws].Items[drawSlot] = DrawRecord(s_visible * 3, 1, cluster.FirstIndex, cluster.VertexOffset,
+                                                                cluster.ObjectIndex, cluster.ObjectIndex, 0, 0);
+    }
+}
\ No newline at end of file
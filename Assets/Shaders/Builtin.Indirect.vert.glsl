@@ -0,0 +1,28 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 position;
+
+layout(set = 0, binding = 0) uniform FrameData {
+    mat4 ViewProjection;
+    vec4 Time;
+} frame;
+
+struct ObjectData {
+    mat4 Transform;
+    vec4 Bounds;
+};
+
+layout(set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData Items[];
+} g_Objects[];
+
+layout(push_constant) uniform DrawConstants {
+    uint ObjectBuffer;
+    uint MaterialIndex;
+} draw;
+
+void main() {
+    ObjectData object = g_Objects[draw.ObjectBuffer].Items[gl_InstanceIndex];
+    gl_Position = frame.ViewProjection * object.Transform * vec4(position, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#version 460
+#extension GL_EXT_mesh_shader : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// One workgroup per visible meshlet, one invocation per vertex.
+layout(local_size_x = 64) in;
+layout(triangles, max_vertices = 64, max_primitives = 124) out;
+
+layout(set = 0, binding = 0) uniform FrameData {
+    mat4 ViewProjection;
+    vec4 Time;
+} frame;
+
+struct ObjectData {
+    mat4 Transform;
+    vec4 Bounds;
+};
+
+struct Meshlet {
+    vec4 Sphere;
+    vec4 ConeApex;
+    vec4 ConeAxis;
+    uint VertexOffset;
+    uint TriangleOffset;
+    uint VertexCount;
+    uint TriangleCount;
+};
+
+layout(set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData Items[];
+} g_Objects[];
+
+layout(set = 1, binding = 0) readonly buffer MeshletBuffer {
+    Meshlet Items[];
+} g_Meshlets[];
+
+layout(set = 1, binding = 0) readonly buffer UintBuffer {
+    uint Items[];
+} g_Uints[];
+
+layout(set = 1, binding = 0) readonly buffer VertexBuffer {
+    vec2 Items[];
+} g_Vertices[];
+
+layout(push_constant) uniform MeshletConstants {
+    vec4 Eye;
+    uint ObjectBuffer;
+    uint Meshlets;
+    uint MeshletVertices;
+    uint MeshletTriangles;
+    uint Vertices;
+    uint Tasks;
+    uint TaskCount;
+} draw;
+
+struct TaskPayload {
+    uint ObjectIndex;
+    int VertexOffset;
+    uint MeshletIndices[32];
+};
+
+taskPayloadSharedEXT TaskPayload payload;
+
+// Triangles are three bytes each, packed into the words of the buffer.
+uint TriangleByte(uint offset) {
+    uint word = g_Uints[draw.MeshletTriangles].Items[offset >> 2];
+    return (word >> ((offset & 3) * 8)) & 0xff;
+}
+
+void main() {
+    Meshlet meshlet = g_Meshlets[draw.Meshlets].Items[payload.MeshletIndices[gl_WorkGroupID.x]];
+    mat4 transform = frame.ViewProjection * g_Objects[draw.ObjectBuffer].Items[payload.ObjectIndex].Transform;
+
+    SetMeshOutputsEXT(meshlet.VertexCount, meshlet.TriangleCount);
+
+    uint lane = gl_LocalInvocationIndex;
+    if (lane < meshlet.VertexCount) {
+        int vertex = int(g_Uints[draw.MeshletVertices].Items[meshlet.VertexOffset + lane]) + payload.VertexOffset;
+        vec2 position = g_Vertices[draw.Vertices].Items[vertex];
+        gl_MeshVerticesEXT[lane].gl_Position = transform * vec4(position, 0.0, 1.0);
+    }
+
+    for (uint triangle = lane; triangle < meshlet.TriangleCount; triangle += 64) {
+        uint offset = meshlet.TriangleOffset + triangle * 3;
+        gl_PrimitiveTriangleIndicesEXT[triangle] = uvec3(TriangleByte(offset), TriangleByte(offset + 1), TriangleByte(offset + 2));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#version 460
+#extension GL_EXT_mesh_shader : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// One workgroup per task, one invocation per meshlet.
+layout(local_size_x = 32) in;
+
+layout(set = 0, binding = 0) uniform FrameData {
+    mat4 ViewProjection;
+    vec4 Time;
+} frame;
+
+struct ObjectData {
+    mat4 Transform;
+    vec4 Bounds;
+};
+
+struct Meshlet {
+    vec4 Sphere;
+    vec4 ConeApex;
+    vec4 ConeAxis;
+    uint VertexOffset;
+    uint TriangleOffset;
+    uint VertexCount;
+    uint TriangleCount;
+};
+
+struct MeshletTask {
+    uint ObjectIndex;
+    uint FirstMeshlet;
+    uint MeshletCount;
+    int VertexOffset;
+};
+
+layout(set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData Items[];
+} g_Objects[];
+
+layout(set = 1, binding = 0) readonly buffer MeshletBuffer {
+    Meshlet Items[];
+} g_Meshlets[];
+
+layout(set = 1, binding = 0) readonly buffer TaskBuffer {
+    MeshletTask Items[];
+} g_Tasks[];
+
+layout(push_constant) uniform MeshletConstants {
+    vec4 Eye;
+    uint ObjectBuffer;
+    uint Meshlets;
+    uint MeshletVertices;
+    uint MeshletTriangles;
+    uint Vertices;
+    uint Tasks;
+    uint TaskCount;
+} draw;
+
+struct TaskPayload {
+    uint ObjectIndex;
+    int VertexOffset;
+    uint MeshletIndices[32];
+};
+
+taskPayloadSharedEXT TaskPayload payload;
+shared uint s_visibleCount;
+
+vec4 Row(int i) {
+    mat4 m = frame.ViewProjection;
+    return vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+}
+
+bool IsVisible(Meshlet meshlet, mat4 transform) {
+    vec3 center = (transform * vec4(meshlet.Sphere.xyz, 1.0)).xyz;
+    vec3 scales = vec3(length(transform[0].xyz), length(transform[1].xyz), length(transform[2].xyz));
+    float scale = max(max(scales.x, scales.y), scales.z);
+    float radius = meshlet.Sphere.w * scale;
+
+    // Same planes as Frustum::FromViewProjection, depth is [0, 1].
+    vec4 planes[6] = vec4[6](Row(3) + Row(0), Row(3) - Row(0), Row(3) + Row(1), Row(3) - Row(1), Row(2), Row(3) - Row(2));
+    for (int i = 0; i < 6; i++) {
+        vec4 plane = planes[i] / length(planes[i].xyz);
+        if (dot(plane.xyz, center) + plane.w < -radius) {
+            return false;
+        }
+    }
+
+    // Backfacing cluster, see Meshlet::IsBackfacing. Normals go through the inverse transpose,
+    // here the cofactor matrix, which only differs by a factor the normalize removes. A non
+    // uniform scale also widens the normal cone beyond its stored cutoff, those objects skip
+    // the test rather than risk rejecting visible triangles.
+    bool uniformScale = scale <= min(min(scales.x, scales.y), scales.z) * 1.001;
+    if (meshlet.ConeAxis.w < 1.0 && uniformScale) {
+        vec3 apex = (transform * vec4(meshlet.ConeApex.xyz, 1.0)).xyz;
+        mat3 normalMatrix = mat3(cross(transform[1].xyz, transform[2].xyz),
+                                 cross(transform[2].xyz, transform[0].xyz),
+                                 cross(transform[0].xyz, transform[1].xyz));
+        vec3 axis = normalize(normalMatrix * meshlet.ConeAxis.xyz);
+        vec3 view = draw.Eye.w != 0.0 ? apex - draw.Eye.xyz / draw.Eye.w : -draw.Eye.xyz;
+        if (dot(normalize(view), axis) >= meshlet.ConeAxis.w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void main() {
+    uint taskIndex = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+    uint lane = gl_LocalInvocationIndex;
+
+    if (lane == 0) {
+        s_visibleCount = 0;
+    }
+    barrier();
+
+    if (taskIndex < draw.TaskCount) {
+        MeshletTask task = g_Tasks[draw.Tasks].Items[taskIndex];
+        if (lane == 0) {
+            payload.ObjectIndex = task.ObjectIndex;
+            payload.VertexOffset = task.VertexOffset;
+        }
+        if (lane < task.MeshletCount) {
+            uint meshletIndex = task.FirstMeshlet + lane;
+            mat4 transform = g_Objects[draw.ObjectBuffer].Items[task.ObjectIndex].Transform;
+            if (IsVisible(g_Meshlets[draw.Meshlets].Items[meshletIndex], transform)) {
+                payload.MeshletIndices[atomicAdd(s_visibleCount, 1)] = meshletIndex;
+            }
+        }
+    }
+    barrier();
+
+    EmitMeshTasksEXT(s_visibleCount, 1, 1);
+}
\ No newline at end of file
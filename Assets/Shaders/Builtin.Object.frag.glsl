@@ -1,7 +1,12 @@
 #version 450
 
+// Constant ids match ObjectShaderTraits.
+layout(constant_id = 0) const float ColorR = 1.0;
+layout(constant_id = 1) const float ColorG = 0.0;
+layout(constant_id = 2) const float ColorB = 1.0;
+
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(1.0, 0.0, 1.0, 1.0);
+    outColor = vec4(ColorR, ColorG, ColorB, 1.0);
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 
 layout(location = 0) in vec2 position;
 
+layout(set = 0, binding = 0) uniform FrameData {
+    mat4 ViewProjection;
+    vec4 Time;
+} frame;
+
 void main() {
-    gl_Position = vec4(position, 0.0, 1.0);
+    gl_Position = frame.ViewProjection * vec4(position, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform FrameData {
+    mat4 ViewProjection;
+    vec4 Time;
+} frame;
+
+struct Particle {
+    vec4 PositionLife;
+    vec4 VelocityLifetime;
+};
+
+layout(set = 1, binding = 0) readonly buffer ParticleBuffer {
+    Particle Items[];
+} g_Particles[];
+
+layout(push_constant) uniform ParticleDrawConstants {
+    uint Particles;
+} draw;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // One point per particle, fetched straight from the compacted buffer.
+    Particle particle = g_Particles[draw.Particles].Items[gl_VertexIndex];
+    gl_Position = frame.ViewProjection * vec4(particle.PositionLife.xyz, 1.0);
+    gl_PointSize = 1.0;
+
+    float age = clamp(particle.PositionLife.w / particle.VelocityLifetime.w, 0.0, 1.0);
+    outColor = vec4(mix(vec3(0.8, 0.15, 0.05), vec3(1.0, 0.85, 0.4), age), age);
+}
\ No newline at end of file
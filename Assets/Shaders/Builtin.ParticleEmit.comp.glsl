@@ -0,0 +1,77 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(local_size_x = 256) in;
+
+struct Particle {
+    vec4 PositionLife;
+    vec4 VelocityLifetime;
+};
+
+layout(set = 0, binding = 0) buffer ParticleBuffer {
+    Particle Items[];
+} g_Particles[];
+
+layout(set = 0, binding = 0) buffer CounterBuffer {
+    uint Count;
+    uint Alive;
+    uint Simulated;
+    uint DispatchX;
+    uint DispatchY;
+    uint DispatchZ;
+    uint VertexCount;
+    uint InstanceCount;
+    uint FirstVertex;
+    uint FirstInstance;
+} g_Counters[];
+
+layout(push_constant) uniform ParticleConstants {
+    vec4 Emitter;
+    uint Source;
+    uint Destination;
+    uint SourceCounters;
+    uint DestinationCounters;
+    uint Capacity;
+    uint EmitCount;
+    uint Seed;
+    float DeltaTime;
+} particles;
+
+shared uint s_base;
+
+// PCG hash, good enough to scatter particles without any state between frames.
+uint Hash(uint value) {
+    uint state = value * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float Random(inout uint seed) {
+    seed = Hash(seed);
+    return float(seed) * (1.0 / 4294967295.0);
+}
+
+void main() {
+    // New particles land behind this frame's survivors, the ones past the capacity are dropped.
+    uint groupCount = min(gl_WorkGroupSize.x, particles.EmitCount - gl_WorkGroupID.x * gl_WorkGroupSize.x);
+    if (gl_LocalInvocationIndex == 0) {
+        s_base = atomicAdd(g_Counters[particles.DestinationCounters].Count, groupCount);
+    }
+    barrier();
+
+    uint slot = s_base + gl_LocalInvocationIndex;
+    if (gl_LocalInvocationIndex >= groupCount || slot >= particles.Capacity) {
+        return;
+    }
+
+    uint seed = Hash(gl_GlobalInvocationID.x ^ Hash(particles.Seed));
+    float angle = -1.5707963 + (Random(seed) - 0.5) * 0.8;
+    float speed = mix(0.8, 1.6, Random(seed));
+    float lifetime = mix(1.0, 3.0, Random(seed));
+    vec2 jitter = (vec2(Random(seed), Random(seed)) - 0.5) * particles.Emitter.w;
+
+    Particle particle;
+    particle.PositionLife = vec4(particles.Emitter.xy + jitter, particles.Emitter.z, lifetime);
+    particle.VelocityLifetime = vec4(cos(angle) * speed, sin(angle) * speed, 0.0, lifetime);
+    g_Particles[particles.Destination].Items[slot] = particle;
+}
\ No newline at end of file
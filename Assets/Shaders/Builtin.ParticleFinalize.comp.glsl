@@ -0,0 +1,47 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(local_size_x = 1) in;
+
+layout(set = 0, binding = 0) buffer CounterBuffer {
+    uint Count;
+    uint Alive;
+    uint Simulated;
+    uint DispatchX;
+    uint DispatchY;
+    uint DispatchZ;
+    uint VertexCount;
+    uint InstanceCount;
+    uint FirstVertex;
+    uint FirstInstance;
+} g_Counters[];
+
+layout(push_constant) uniform ParticleConstants {
+    vec4 Emitter;
+    uint Source;
+    uint Destination;
+    uint SourceCounters;
+    uint DestinationCounters;
+    uint Capacity;
+    uint EmitCount;
+    uint Seed;
+    float DeltaTime;
+} particles;
+
+// Must match ParticleSystem::WorkgroupSize.
+const uint WorkgroupSize = 256;
+
+void main() {
+    uint alive = min(g_Counters[particles.DestinationCounters].Count, particles.Capacity);
+    g_Counters[particles.DestinationCounters].Alive = alive;
+    g_Counters[particles.DestinationCounters].Simulated = g_Counters[particles.SourceCounters].Alive;
+
+    // Next frame's simulate over the survivors, this frame's draw of every particle as a point.
+    g_Counters[particles.DestinationCounters].DispatchX = (alive + WorkgroupSize - 1) / WorkgroupSize;
+    g_Counters[particles.DestinationCounters].DispatchY = 1;
+    g_Counters[particles.DestinationCounters].DispatchZ = 1;
+    g_Counters[particles.DestinationCounters].VertexCount = alive;
+    g_Counters[particles.DestinationCounters].InstanceCount = 1;
+    g_Counters[particles.DestinationCounters].FirstVertex = 0;
+    g_Counters[particles.DestinationCounters].FirstInstance = 0;
+}
\ No newline at end of file
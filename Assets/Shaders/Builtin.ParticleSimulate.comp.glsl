@@ -0,0 +1,77 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(local_size_x = 256) in;
+
+struct Particle {
+    vec4 PositionLife;
+    vec4 VelocityLifetime;
+};
+
+layout(set = 0, binding = 0) buffer ParticleBuffer {
+    Particle Items[];
+} g_Particles[];
+
+layout(set = 0, binding = 0) buffer CounterBuffer {
+    uint Count;
+    uint Alive;
+    uint Simulated;
+    uint DispatchX;
+    uint DispatchY;
+    uint DispatchZ;
+    uint VertexCount;
+    uint InstanceCount;
+    uint FirstVertex;
+    uint FirstInstance;
+} g_Counters[];
+
+layout(push_constant) uniform ParticleConstants {
+    vec4 Emitter;
+    uint Source;
+    uint Destination;
+    uint SourceCounters;
+    uint DestinationCounters;
+    uint Capacity;
+    uint EmitCount;
+    uint Seed;
+    float DeltaTime;
+} particles;
+
+const vec3 Gravity = vec3(0.0, 1.5, 0.0);
+
+// Survivors are appended per workgroup, one global atomic per group instead of per particle.
+shared uint s_count;
+shared uint s_base;
+
+void main() {
+    if (gl_LocalInvocationIndex == 0) {
+        s_count = 0;
+    }
+    barrier();
+
+    uint index = gl_GlobalInvocationID.x;
+    bool alive = false;
+    Particle particle;
+    if (index < g_Counters[particles.SourceCounters].Alive) {
+        particle = g_Particles[particles.Source].Items[index];
+        particle.PositionLife.w -= particles.DeltaTime;
+        particle.VelocityLifetime.xyz += Gravity * particles.DeltaTime;
+        particle.PositionLife.xyz += particle.VelocityLifetime.xyz * particles.DeltaTime;
+        alive = particle.PositionLife.w > 0.0;
+    }
+
+    uint local = 0;
+    if (alive) {
+        local = atomicAdd(s_count, 1);
+    }
+    barrier();
+    if (gl_LocalInvocationIndex == 0 && s_count > 0) {
+        s_base = atomicAdd(g_Counters[particles.DestinationCounters].Count, s_count);
+    }
+    barrier();
+
+    // The destination starts empty and sources never exceed the capacity, every survivor fits.
+    if (alive) {
+        g_Particles[particles.Destination].Items[s_base + local] = particle;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "Batch2D.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Scenario {
+    char const *Name;
+    u32 Layers;
+    // Share of lines, the rest is split between sprites and triangles.
+    f32 Lines;
+};
+
+// The layer goes into the color so the output order can be checked afterwards.
+static void Submit(Batch2D &batch, Scenario const &scenario, u32 primitives, std::mt19937 &random)
+{
+    std::uniform_real_distribution<f32> position(0.0f, 1920.0f);
+    std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<u32> layer(0, scenario.Layers - 1);
+
+    batch.Clear();
+    for (u32 i = 0; i < primitives; i++) {
+        auto current = layer(random);
+        batch.SetLayer(static_cast<u16>(current));
+        glm::vec2 a(position(random), position(random));
+        auto kind = unit(random);
+        if (kind < scenario.Lines) {
+            batch.Line(a, a + glm::vec2(16.0f, 4.0f), current);
+        } else if (kind < scenario.Lines + (1.0f - scenario.Lines) * 0.5f) {
+            batch.Sprite(a, a + glm::vec2(8.0f), i % 64, glm::vec2(0.0f), glm::vec2(1.0f), current);
+        } else {
+            batch.Triangle(a, a + glm::vec2(8.0f, 0.0f), a + glm::vec2(0.0f, 8.0f), current);
+        }
+    }
+}
+
+static bool Validate(Batch2D const &batch, std::span<Batch2D::Draw const> draws, std::vector<Vertex2D> const &output)
+{
+    u32 covered = 0;
+    u32 previousLayer = 0;
+    for (auto const &draw: draws) {
+        if (draw.FirstVertex != covered) {
+            std::printf("draws do not cover the output back to back\n");
+            return false;
+        }
+        auto perPrimitive = draw.Primitive == Primitive2D::Lines ? 2u : 3u;
+        if (draw.VertexCount % perPrimitive != 0) {
+            std::printf("draw splits a primitive\n");
+            return false;
+        }
+        for (u32 i = draw.FirstVertex; i < draw.FirstVertex + draw.VertexCount; i++) {
+            if (output[i].Color < previousLayer) {
+                std::printf("vertex of layer %u drawn after layer %u\n", output[i].Color, previousLayer);
+                return false;
+            }
+            previousLayer = output[i].Color;
+        }
+        covered += draw.VertexCount;
+    }
+    if (covered != batch.VertexCount()) {
+        std::printf("draws cover %u of %u vertices\n", covered, batch.VertexCount());
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    constexpr u32 maxVertices = 6 * 1'000'000;
+    Batch2D batch(maxVertices);
+    std::vector<Vertex2D> output(maxVertices);
+    std::mt19937 random(7);
+
+    std::printf("%12s %10s %10s %8s %8s %12s %12s %12s\n", "scenario", "prims", "vertices", "runs", "draws", "submit us", "finish us", "Mprim/s");
+    for (auto const &scenario: {Scenario{"sprites", 1, 0.0f}, Scenario{"mixed", 1, 0.3f}, Scenario{"layers", 8, 0.3f}}) {
+        for (u32 primitives: {100'000u, 500'000u, 1'000'000u}) {
+            constexpr u32 iterations = 20;
+            f64 submitSeconds = 0.0, finishSeconds = 0.0;
+            std::span<Batch2D::Draw const> draws;
+            for (u32 i = 0; i < iterations; i++) {
+                auto begin = Clock::now();
+                Submit(batch, scenario, primitives, random);
+                auto submitted = Clock::now();
+                draws = batch.Finish(output.data());
+                auto finished = Clock::now();
+                submitSeconds += std::chrono::duration<f64>(submitted - begin).count();
+                finishSeconds += std::chrono::duration<f64>(finished - submitted).count();
+            }
+            if (batch.GetStats().Dropped > 0 || !Validate(batch, draws, output)) {
+                std::printf("%s with %u primitives failed\n", scenario.Name, primitives);
+                return 1;
+            }
+
+            // The random numbers are part of the submit time, this is a lower bound.
+            auto const &stats = batch.GetStats();
+            std::printf("%12s %10u %10u %8u %8u %12.1f %12.1f %12.2f\n",
+                        scenario.Name, stats.Primitives, stats.Vertices, stats.Commands, stats.Draws,
+                        submitSeconds / iterations * 1e6, finishSeconds / iterations * 1e6,
+                        primitives / ((submitSeconds + finishSeconds) / iterations) * 1e-6);
+        }
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static void Populate(FrustumCuller &culler, u32 count)
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<f32> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<f32> size(0.5f, 4.0f);
+
+    culler.Clear();
+    culler.Reserve(count);
+    for (u32 i = 0; i < count; i++) {
+        glm::vec3 center(position(random), position(random), position(random));
+        if (i % 2 == 0) {
+            (void) culler.AddSphere(center, size(random));
+        } else {
+            glm::vec3 extents(size(random), size(random), size(random));
+            (void) culler.AddBox(center - extents, center + extents);
+        }
+    }
+}
+
+static f64 Measure(FrustumCuller &culler, Frustum const &frustum, std::vector<u32> &visible, JobSystem *jobs, u32 iterations)
+{
+    // One warm-up pass so the output vector and the workers are already up.
+    (void) culler.Cull(frustum, visible, jobs);
+
+    auto begin = Clock::now();
+    for (u32 i = 0; i < iterations; i++) {
+        (void) culler.Cull(frustum, visible, jobs);
+    }
+    return std::chrono::duration<f64>(Clock::now() - begin).count() / iterations;
+}
+
+int main()
+{
+    JobSystem jobs;
+    auto projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+    auto view = glm::lookAt(glm::vec3(0.0f, 0.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    auto frustum = Frustum::FromViewProjection(projection * view);
+
+    std::printf("Detected kernel: %s, %u workers + caller\n", FrustumCuller::KernelName(FrustumCuller::DetectKernel()), jobs.WorkerCount());
+    std::printf("%10s %8s %8s %10s %12s %12s\n", "objects", "kernel", "threads", "visible", "us/pass", "Mobj/s");
+
+    FrustumCuller culler;
+    std::vector<u32> reference, visible;
+    for (u32 count: {10'000u, 100'000u, 1'000'000u}) {
+        Populate(culler, count);
+        auto iterations = std::max(10u, 20'000'000u / count);
+
+        culler.SetKernel(FrustumCuller::Kernel::Scalar);
+        (void) culler.Cull(frustum, reference, nullptr);
+
+        for (auto kernel: {FrustumCuller::Kernel::Scalar, FrustumCuller::Kernel::SSE, FrustumCuller::Kernel::AVX2, FrustumCuller::Kernel::AVX512}) {
+            if (!FrustumCuller::IsSupported(kernel)) {
+                continue;
+            }
+            culler.SetKernel(kernel);
+
+            for (auto *pool: {static_cast<JobSystem *>(nullptr), &jobs}) {
+                auto seconds = Measure(culler, frustum, visible, pool, iterations);
+                if (visible != reference) {
+                    std::printf("%s kernel disagrees with the scalar reference\n", FrustumCuller::KernelName(kernel));
+                    return 1;
+                }
+                std::printf("%10u %8s %8u %10zu %12.1f %12.1f\n",
+                            count, FrustumCuller::KernelName(kernel), pool ? pool->WorkerCount() + 1 : 1,
+                            visible.size(), seconds * 1e6, count / seconds * 1e-6);
+            }
+        }
+    }
+    return 0;
+}
\ No newline at end of file
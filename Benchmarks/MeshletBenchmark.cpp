@@ -0,0 +1,154 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+struct TestMesh {
+    char const *Name;
+    std::vector<glm::vec3> Positions;
+    std::vector<u32> Indices;
+};
+
+// Facing outwards under the builder's normal convention.
+static void AddTriangle(TestMesh &mesh, u32 a, u32 b, u32 c, glm::vec3 const &outside)
+{
+    auto const &p = mesh.Positions;
+    auto normal = glm::cross(p[c] - p[a], p[b] - p[a]);
+    if (glm::dot(normal, outside) < 0.0f) {
+        std::swap(b, c);
+    }
+    mesh.Indices.insert(mesh.Indices.end(), {a, b, c});
+}
+
+static TestMesh MakeSphere(u32 rings, u32 segments)
+{
+    TestMesh mesh{"sphere"};
+    for (u32 ring = 0; ring <= rings; ring++) {
+        auto theta = 3.14159265f * static_cast<f32>(ring) / static_cast<f32>(rings);
+        for (u32 segment = 0; segment <= segments; segment++) {
+            auto phi = 6.28318531f * static_cast<f32>(segment) / static_cast<f32>(segments);
+            mesh.Positions.emplace_back(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (u32 ring = 0; ring < rings; ring++) {
+        for (u32 segment = 0; segment < segments; segment++) {
+            auto a = ring * (segments + 1) + segment;
+            auto b = a + segments + 1;
+            auto center = mesh.Positions[a] + mesh.Positions[b + 1];
+            if (ring > 0) {
+                AddTriangle(mesh, a, a + 1, b + 1, center);
+            }
+            if (ring + 1 < rings) {
+                AddTriangle(mesh, a, b + 1, b, center);
+            }
+        }
+    }
+    return mesh;
+}
+
+static TestMesh MakeTerrain(u32 size)
+{
+    TestMesh mesh{"terrain"};
+    for (u32 y = 0; y <= size; y++) {
+        for (u32 x = 0; x <= size; x++) {
+            auto height = 0.05f * std::sin(static_cast<f32>(x) * 0.1f) * std::cos(static_cast<f32>(y) * 0.13f);
+            mesh.Positions.emplace_back(static_cast<f32>(x) / size, height, static_cast<f32>(y) / size);
+        }
+    }
+    for (u32 y = 0; y < size; y++) {
+        for (u32 x = 0; x < size; x++) {
+            auto a = y * (size + 1) + x;
+            auto b = a + size + 1;
+            AddTriangle(mesh, a, a + 1, b, glm::vec3(0.0f, 1.0f, 0.0f));
+            AddTriangle(mesh, a + 1, b + 1, b, glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+    }
+    return mesh;
+}
+
+// Every triangle has to come out exactly once, inside the limits, and a meshlet may only be
+// rejected by its cone if all of its triangles really face away.
+static bool Validate(TestMesh const &mesh, MeshletData const &data, MeshletLimits limits)
+{
+    std::vector<std::array<u32, 3>> expected, rebuilt;
+    for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+        expected.push_back({mesh.Indices[i], mesh.Indices[i + 1], mesh.Indices[i + 2]});
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<f32> coordinate(-3.0f, 3.0f);
+    std::array<glm::vec4, 64> eyes;
+    for (auto &eye: eyes) {
+        eye = glm::vec4(coordinate(random), coordinate(random), coordinate(random), 1.0f);
+    }
+
+    for (auto const &meshlet: data.Meshlets) {
+        if (meshlet.VertexCount > limits.MaxVertices || meshlet.TriangleCount > limits.MaxTriangles || meshlet.TriangleOffset % 4 != 0) {
+            std::printf("%s: meshlet outside the limits\n", mesh.Name);
+            return false;
+        }
+        for (u32 i = 0; i < meshlet.TriangleCount; i++) {
+            std::array<u32, 3> triangle{};
+            for (u32 corner = 0; corner < 3; corner++) {
+                auto local = data.Triangles[meshlet.TriangleOffset + i * 3 + corner];
+                if (local >= meshlet.VertexCount) {
+                    std::printf("%s: local index out of range\n", mesh.Name);
+                    return false;
+                }
+                triangle[corner] = data.Vertices[meshlet.VertexOffset + local];
+            }
+            rebuilt.push_back(triangle);
+
+            auto const &a = mesh.Positions[triangle[0]];
+            auto normal = glm::cross(mesh.Positions[triangle[2]] - a, mesh.Positions[triangle[1]] - a);
+            for (auto const &eye: eyes) {
+                if (meshlet.IsBackfacing(eye) && glm::dot(glm::vec3(eye) - a, normal) > 1e-5f) {
+                    std::printf("%s: cone culled a front facing triangle\n", mesh.Name);
+                    return false;
+                }
+            }
+        }
+    }
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(rebuilt.begin(), rebuilt.end());
+    if (expected != rebuilt) {
+        std::printf("%s: meshlets do not cover the mesh exactly once\n", mesh.Name);
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    MeshletLimits limits{};
+    std::printf("%10s %10s %10s %10s %10s %10s %12s\n", "mesh", "triangles", "meshlets", "verts/m", "tris/m", "cone cull", "Mtri/s");
+
+    for (auto const &mesh: {MakeSphere(256, 512), MakeTerrain(512)}) {
+        auto begin = Clock::now();
+        auto data = BuildMeshlets(mesh.Indices, mesh.Positions, limits);
+        auto seconds = std::chrono::duration<f64>(Clock::now() - begin).count();
+
+        if (!Validate(mesh, data, limits)) {
+            return 1;
+        }
+
+        u64 vertices = 0, triangles = 0, backfacing = 0;
+        glm::vec4 eye(0.0f, 2.5f, 2.5f, 1.0f);
+        for (auto const &meshlet: data.Meshlets) {
+            vertices += meshlet.VertexCount;
+            triangles += meshlet.TriangleCount;
+            backfacing += meshlet.IsBackfacing(eye) ? 1 : 0;
+        }
+        auto meshlets = static_cast<f64>(data.Meshlets.size());
+        std::printf("%10s %10llu %10zu %10.1f %10.1f %9.1f%% %12.2f\n",
+                    mesh.Name, static_cast<unsigned long long>(triangles), data.Meshlets.size(),
+                    vertices / meshlets, triangles / meshlets, 100.0 * backfacing / meshlets, triangles / seconds * 1e-6);
+    }
+    return 0;
+}
\ No newline at end of file
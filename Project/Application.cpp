@@ -1,7 +1,24 @@
 #include "Application.h"
 #include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <glm/gtc/matrix_transform.hpp>
 #include <vulkan/vk_enum_string_helper.h>
 
+using Clock = std::chrono::steady_clock;
+
+static f64 SecondsBetween(Clock::time_point begin, Clock::time_point end)
+{
+    return std::chrono::duration<f64>(end - begin).count();
+}
+
 void Sierpinski(
         std::vector<Model::Vertex> &vertices,
         int depth,
@@ -23,23 +40,147 @@ void Sierpinski(
     }
 }
 
+// Only the full detail fractal is generated, the coarser levels come out of Model::BuildLodChain.
+// The base triangle's edge is one unit long, the errors are in the same units.
+std::vector<Model::Lod> SierpinskiLods(int depth, f32 maxError, u32 maxLevels)
+{
+    std::vector<Model::Vertex> vertices;
+    Sierpinski(vertices, depth, {0.0f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f});
+    return Model::BuildLodChain(vertices, maxError, maxLevels);
+}
+
 void Application::Initialize()
 {
+    auto &timer = StartupTimer::Get();
+    auto initialize = timer.Measure("Initialize");
+    {
+        auto phase = timer.Measure("Frame data and descriptors");
+        m_frameData = std::make_unique<StreamingBuffer>(m_device, 4 * 1024 * 1024, Swapchain::MaxFramesInFlight);
+        CreateDescriptors();
+        m_resources = std::make_unique<ResourceManager>(m_device);
+    }
+
     auto config = PipelineConfigInfo::Default(m_Window.Width(), m_Window.Height());
     config.Layout = CreatePipelineLayout();
+    config.Specialization = Specialize(ObjectShaderTraits{});
     m_pipelineLayout = config.Layout;
-    config.RenderPass = m_swapchain.RenderPass();
-    m_pipeline = std::make_unique<Pipeline>(m_device, config);
+    // Depth images only exist once a pipeline actually tests or writes depth.
+    if (config.UsesDepth()) {
+        m_swapchain.RequireDepth();
+    }
+    if (m_device.SupportsDynamicRendering()) {
+        m_graph = std::make_unique<RenderGraph>(m_device);
+        config.ColorFormat = m_swapchain.ImageFormat();
+        config.DepthFormat = m_swapchain.HasDepth() ? m_swapchain.DepthFormat() : VK_FORMAT_UNDEFINED;
+    } else {
+        config.RenderPass = m_swapchain.RenderPass();
+    }
+
+    // The passes of the GPU-driven path are built on these two, both only allocate.
+    bool indirect = m_device.SupportsGpuDriven() && m_bindless;
+    bool meshlets = indirect && m_device.SupportsMeshShaders();
+    if (indirect) {
+        m_geometry = std::make_unique<GeometryArena>(m_device, 1 << 20, 3 << 20);
+        m_indirect = std::make_unique<IndirectRenderer>(m_device, *m_bindless, 1 << 16);
+    }
+    auto indirectConfig = config;
+    indirectConfig.VertexShader = "Assets/Shaders/Builtin.Indirect.vert.spv";
+
+    // None of these depend on each other: geometry generation, and every pipeline with its
+    // SPIR-V reads, shader modules and compile. They go wide on the job system with this thread
+    // taking part, the pipeline cache is internally synchronized. Only one of them registers
+    // bindless buffers.
+    std::vector<Model::Lod> lods;
+    std::vector<Model::MeshData> meshes;
+    std::function<void()> const tasks[] = {
+            [&] {
+                auto phase = timer.Measure("Geometry");
+                lods = SierpinskiLods(8, 0.05f, 3);
+                for (auto const &lod: lods) {
+                    if (indirect) {
+                        meshes.push_back(meshlets ? Model::Cook(lod.Vertices) : Model::Weld(lod.Vertices));
+                    }
+                }
+            },
+            [&] {
+                auto phase = timer.Measure("Object pipeline");
+                m_pipeline = std::make_unique<Pipeline>(m_device, config, m_resources.get());
+            },
+            [&] {
+                if (meshlets) {
+                    auto phase = timer.Measure("Meshlet pass");
+                    m_meshlets = std::make_unique<MeshletPass>(m_device, *m_bindless, *m_geometry, *m_indirect, m_frameSetLayout, config, 1 << 16);
+                } else if (indirect) {
+                    auto phase = timer.Measure("Indirect pipeline and culling pass");
+                    m_indirectPipeline = std::make_unique<Pipeline>(m_device, indirectConfig, m_resources.get());
+                    m_culling = std::make_unique<CullingPass>(m_device, *m_bindless, *m_geometry, *m_indirect);
+                }
+            },
+            [&] {
+                auto phase = timer.Measure("2D renderer");
+                m_renderer2D = std::make_unique<Renderer2D>(m_device, m_bindless.get(), config, 1 << 20);
+            },
+    };
+    m_jobs.ParallelFor(static_cast<u32>(std::size(tasks)), 1, [&](u32 begin, u32 end) {
+        for (u32 i = begin; i < end; i++) {
+            tasks[i]();
+        }
+    });
 
-    std::vector<Model::Vertex> vertices;//{{{0.0f, -0.5}}, {{0.5f, 0.5f}}, {{-0.5f, 0.5f}}};
-    Sierpinski(vertices, 8, {0.0f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f});
-    m_model = std::make_unique<Model>(m_device, vertices);
+    if constexpr (ShaderHotReload::Enabled) {
+        m_hotReload = std::make_unique<ShaderHotReload>();
+        m_hotReload->Watch<Pipeline>({config.VertexShader, config.FragmentShader}, m_pipeline, [this, config] {
+            return std::make_unique<Pipeline>(m_device, config, m_resources.get());
+        });
+    }
+
+    for (auto const &lod: lods) {
+        m_lodErrors.push_back(lod.Error);
+    }
+    if (indirect) {
+        auto phase = timer.Measure("Geometry upload");
+        CreateIndirectPath(indirectConfig, lods, meshes);
+    } else {
+        auto phase = timer.Measure("Geometry upload");
+        m_model = std::make_unique<Model>(m_device, *m_resources, lods);
+        // The triangle spans [-0.5, 0.5] around the origin, the scene fills in the real bounds.
+        auto object = m_culler.AddSphere(glm::vec3(0.0f), 0.0f);
+        (void) m_scene.Create(Transform{}, {}, glm::vec4(0.0f, 0.0f, 0.0f, std::sqrt(0.5f)), object);
+        INFOF("CPU culling kernel: {}", FrustumCuller::KernelName(m_culler.ActiveKernel()));
+    }
+    if (m_hotReload) {
+        m_renderer2D->WatchShaders(*m_hotReload);
+    }
+    // VULKANIZED_PARTICLES=<count> adds the particle benchmark, it works on either path.
+    if (auto const *particles = std::getenv("VULKANIZED_PARTICLES"); particles != nullptr) {
+        auto phase = timer.Measure("Particles");
+        auto capacity = static_cast<u32>(std::strtoul(particles, nullptr, 10));
+        if (!m_bindless) {
+            WARN("Particles need bindless descriptors, the particle benchmark is disabled");
+        } else if (capacity > 0) {
+            m_particles = std::make_unique<ParticleSystem>(m_device, *m_bindless, m_frameSetLayout, config, capacity);
+            if (m_hotReload) {
+                m_particles->WatchShaders(*m_hotReload);
+            }
+        }
+    }
     CreateCommandBuffers();
+    m_pipelineStatistics = std::make_unique<PipelineStatisticsQueries>(m_device, Swapchain::MaxFramesInFlight);
+    CreateFrameCapture();
+    m_swapchain.ReportDepthMemory();
+    m_memoryJson = std::getenv("VULKANIZED_MEMORY_JSON");
+    m_device.Memory().Update();
+    m_device.Memory().LogSummary();
+    if (m_hotReload) {
+        m_hotReload->Start();
+    }
 }
 
 Application::~Application()
 {
-    vkDestroyPipelineLayout(m_device.LogicalDevice(), m_pipelineLayout, nullptr);
+    // A rebuild in flight still uses the pipeline layout.
+    m_hotReload.reset();
+    vkDestroyPipelineLayout(m_device.LogicalDevice(), m_pipelineLayout, m_device.HostCallbacks());
 }
 
 void Application::Run()
@@ -54,97 +195,564 @@ void Application::Run()
     DEBUG("This is a debug message.");
 
     INFOF("This is the {} message with {} formatting.", 2, "custom");
+
+    m_renderThread = std::thread([this] { RenderLoop(); });
+
+    auto start = Clock::now();
+    auto previous = start;
+    auto reportStart = start;
+    u64 frameNumber = 0;
+    u64 renderBusyAtReport = 0;
+    u64 renderedAtReport = 0;
+    FrameOverlapMetrics metrics{};
+
     while (!m_Window.ShouldClose()) {
         m_Window.Update();
-        // Main stuff
-        DrawFrame();
+
+        auto simulateStart = Clock::now();
+        auto &packet = m_frameHandoff.WriteSlot();
+        packet.FrameNumber = frameNumber++;
+        packet.Time = SecondsBetween(start, simulateStart);
+        packet.DeltaTime = static_cast<f32>(SecondsBetween(previous, simulateStart));
+        packet.ShouldQuit = false;
+        previous = simulateStart;
+        Simulate(packet);
+        metrics.SimulateTime += SecondsBetween(simulateStart, Clock::now());
+
+        // Stay at most one packet ahead of the render thread, it is still free to draw the
+        // previous one while we simulate the next. Packets carry changes, none may be dropped.
+        m_frameHandoff.WaitUntilConsumed();
+        m_frameHandoff.Publish();
+
+        auto now = Clock::now();
+        metrics.WallTime = SecondsBetween(reportStart, now);
+        if (metrics.WallTime >= 2.0) {
+            auto renderBusy = m_renderBusyNs.load(std::memory_order_relaxed);
+            auto rendered = m_renderedFrames.load(std::memory_order_relaxed);
+            metrics.RenderTime = static_cast<f64>(renderBusy - renderBusyAtReport) * 1e-9;
+            metrics.Frames = rendered - renderedAtReport;
+            ReportOverlap(metrics);
+
+            renderBusyAtReport = renderBusy;
+            renderedAtReport = rendered;
+            reportStart = now;
+            metrics = {};
+        }
     }
 
+    auto &packet = m_frameHandoff.WriteSlot();
+    packet.ShouldQuit = true;
+    m_frameHandoff.Publish();
+    m_renderThread.join();
+
     vkDeviceWaitIdle(m_device.LogicalDevice());
 }
 
+void Application::Simulate(FramePacket &packet)
+{
+    // The render thread is drawing the previous packet from the culler and the indirect
+    // renderer, everything for this one only goes into the packet.
+    m_frameArena.Reset();
+    packet.ViewProjection = glm::rotate(glm::mat4(1.0f), static_cast<f32>(packet.Time) * 0.25f, glm::vec3(0.0f, 0.0f, 1.0f));
+    packet.Objects.clear();
+    packet.Released.clear();
+    packet.LodChanges.clear();
+
+    (void) m_scene.Update(m_jobs, SceneOutputs{.Updates = &packet.Objects});
+    for (auto const &update: packet.Objects) {
+        if (update.Object >= m_simulatedBounds.size()) {
+            m_simulatedBounds.resize(update.Object + 1, glm::vec4(0.0f, 0.0f, 0.0f, -1.0f));
+            m_simulatedScales.resize(update.Object + 1, 1.0f);
+        }
+        auto const &world = update.World;
+        m_simulatedBounds[update.Object] = update.Bounds;
+        m_simulatedScales[update.Object] = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+    }
+    for (auto object: m_scene.TakeReleasedObjects(m_frameArena)) {
+        packet.Released.push_back(object);
+        if (object < m_simulatedBounds.size()) {
+            m_simulatedBounds[object].w = -1.0f;
+        }
+    }
+
+    // Levels are picked for the view the packet is drawn with, culled objects included, so
+    // they come back into view at the right level.
+    LodView view{packet.ViewProjection, static_cast<f32>(m_swapchain.Extent().height)};
+    for (u32 object = 0; object < m_simulatedBounds.size(); object++) {
+        auto const &bounds = m_simulatedBounds[object];
+        if (bounds.w < 0.0f) {
+            continue;
+        }
+        auto previous = m_lodSelector.Current(object);
+        auto lod = m_lodSelector.Select(object, m_lodErrors, glm::vec3(bounds), m_simulatedScales[object], view);
+        if (lod != previous) {
+            packet.LodChanges.push_back(LodChange{object, lod});
+        }
+    }
+}
+
+void Application::ApplySimulation(FramePacket const &packet)
+{
+    u32 firstObject = ~0u;
+    u32 lastObject = 0;
+    for (auto const &update: packet.Objects) {
+        if (m_indirect) {
+            auto &object = m_indirect->Objects()[update.Object];
+            object.Transform = update.World;
+            object.Bounds = update.Bounds;
+            firstObject = std::min(firstObject, update.Object);
+            lastObject = std::max(lastObject, update.Object);
+        } else {
+            m_culler.SetSphere(update.Object, glm::vec3(update.Bounds), update.Bounds.w);
+        }
+    }
+    if (m_indirect && firstObject <= lastObject) {
+        m_indirect->MarkObjectsDirty(firstObject, lastObject + 1);
+    }
+
+    for (auto object: packet.Released) {
+        if (m_indirect) {
+            m_indirect->RemoveObject(object);
+        } else {
+            m_culler.SetSphere(object, glm::vec3(0.0f), std::numeric_limits<f32>::lowest());
+        }
+    }
+
+    for (auto const &change: packet.LodChanges) {
+        if (m_indirect) {
+            m_indirect->SetMesh(change.Object, m_lodMeshes[change.Lod]);
+        } else {
+            if (change.Object >= m_drawLods.size()) {
+                m_drawLods.resize(change.Object + 1, 0);
+            }
+            m_drawLods[change.Object] = change.Lod;
+        }
+    }
+    m_lodSwitches += packet.LodChanges.size();
+}
+
+void Application::RenderLoop()
+{
+    // Everything before the first frame is startup, not churn.
+    auto startup = m_device.HostAllocations().TakeChurn();
+    INFOF("Host allocations during startup: {} in {} KiB", startup.Allocations, startup.Bytes / 1024);
+
+    while (true) {
+        m_frameHandoff.WaitForPacket();
+        if (!m_frameHandoff.Consume()) {
+            continue;
+        }
+
+        auto const &packet = m_frameHandoff.ReadSlot();
+        if (packet.ShouldQuit) {
+            break;
+        }
+
+        auto begin = Clock::now();
+        DrawFrame(packet);
+        auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+        m_renderBusyNs.fetch_add(static_cast<u64>(busy), std::memory_order_relaxed);
+        auto rendered = m_renderedFrames.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (rendered == 1) {
+            StartupTimer::Get().Record("First frame", begin, Clock::now());
+            StartupTimer::Get().Report("first frame submitted");
+        }
+
+        if (rendered % 1000 == 0 && !m_indirect) {
+            auto const &stats = m_renderQueue.Stats();
+            INFOF("Render queue: {} packets, {} sort passes, {} state changes, {} saved",
+                  stats.Packets, stats.SortPasses, stats.StateChanges(), stats.StateChangesSaved());
+            INFOF("\tSaved binds: pipeline {}, vertex buffer {}, index buffer {}, material {}",
+                  stats.PipelineBindsSaved, stats.VertexBufferBindsSaved, stats.IndexBufferBindsSaved, stats.MaterialChangesSaved);
+        }
+
+        if (rendered % 1000 == 0) {
+            INFOF("LOD: {} switches over the last 1000 frames, {} triangles submitted per frame on the CPU path",
+                  std::exchange(m_lodSwitches, 0), std::exchange(m_lodTriangles, 0) / 1000);
+        }
+
+        if (rendered % 1000 == 0 && m_graph) {
+            auto const &stats = m_graph->Stats();
+            INFOF("Render graph: {} passes, {} culled, {} barriers, {} transient textures in {} bytes ({} without aliasing)",
+                  stats.Passes, stats.PassesCulled, stats.Barriers, stats.TransientTextures, stats.AliasedBytes, stats.TransientBytes);
+        }
+
+        if (rendered % 1000 == 0 && m_culling) {
+            auto stats = m_culling->TakeStats();
+            auto frames = stats.Frames > 0 ? stats.Frames : 1;
+            INFOF("Culling: {}/{} objects, {}/{} triangles after frustum, {} after small triangle culling (per frame)",
+                  stats.ObjectsVisible / frames, stats.ObjectsIn / frames,
+                  stats.TrianglesAfterFrustum / frames, stats.TrianglesIn / frames, stats.TrianglesVisible / frames);
+        }
+
+        if (rendered % 1000 == 0) {
+            auto const &stats = m_renderer2D->LastStats();
+            INFOF("2D batch: {} primitives, {} vertices, {} runs in {} draws", stats.Primitives, stats.Vertices, stats.Commands, stats.Draws);
+        }
+
+        if (rendered % 1000 == 0) {
+            // Steady state should be zero, every allocation left here is the driver working per frame.
+            auto churn = m_device.HostAllocations().TakeChurn();
+            INFOF("Host allocations: {:.2f} per frame, {} bytes per frame, {} of {} from the command arena",
+                  static_cast<f64>(churn.Allocations) / 1000.0, churn.Bytes / 1000, churn.ArenaAllocations, churn.Allocations);
+        }
+
+        if (rendered % 1000 == 0) {
+            m_device.Stats().LogAverages();
+        }
+
+        // The budget query is cheap but not free, a couple of times a second is enough to react.
+        if (rendered % 120 == 0) {
+            m_device.Memory().Update();
+        }
+
+        if (rendered % 1000 == 0) {
+            m_device.Memory().LogSummary();
+            if (m_memoryJson != nullptr) {
+                (void) m_device.Memory().WriteJson(m_memoryJson);
+            }
+        }
+
+        if (rendered % 1000 == 0 && m_particles) {
+            auto stats = m_particles->TakeStats();
+            auto frames = stats.Frames > 0 ? stats.Frames : 1;
+            auto timedFrames = static_cast<f64>(stats.TimedFrames > 0 ? stats.TimedFrames : 1);
+            INFOF("Particles: {} simulated, {} drawn per frame on the {} queue",
+                  stats.Simulated / frames, stats.Rendered / frames, m_particles->Async() ? "compute" : "graphics");
+            INFOF("\tSimulate {:.3f} ms ({:.0f} particles/ms), render {:.3f} ms ({:.0f} particles/ms)",
+                  stats.SimulateMs / timedFrames, stats.SimulatedPerMs(), stats.RenderMs / timedFrames, stats.RenderedPerMs());
+        }
+    }
+}
+
+void Application::ReportOverlap(FrameOverlapMetrics const &metrics)
+{
+    auto frames = metrics.Frames > 0 ? static_cast<f64>(metrics.Frames) : 1.0;
+    auto busiest = std::max(metrics.SimulateTime, metrics.RenderTime);
+    auto shortest = std::min(metrics.SimulateTime, metrics.RenderTime);
+    INFOF("Frame overlap: {} frames in {:.2f}s, simulate {:.3f} ms/frame, render {:.3f} ms/frame",
+          metrics.Frames, metrics.WallTime, metrics.SimulateTime * 1000.0 / frames, metrics.RenderTime * 1000.0 / frames);
+    INFOF("\tOverlapped {:.3f}s ({:.1f}% of the shorter thread, serial loop would take {:.1f}% longer)",
+          metrics.OverlapTime(),
+          shortest > 0.0 ? 100.0 * metrics.OverlapTime() / shortest : 0.0,
+          busiest > 0.0 ? 100.0 * (metrics.SimulateTime + metrics.RenderTime - busiest) / busiest : 0.0);
+    INFOF("\tFrame arena: {} KiB high water of {} KiB", m_frameArena.HighWater() / 1024, m_frameArena.Capacity() / 1024);
+}
+
+void Application::DrawOverlay(FramePacket const &packet)
+{
+    m_frameTimes[m_frameTimeHead] = packet.DeltaTime;
+    m_frameTimeHead = (m_frameTimeHead + 1) % static_cast<u32>(m_frameTimes.size());
+
+    // Frame time graph in the top left corner, 33 ms at the top, a line at 16.7 ms.
+    constexpr glm::vec2 origin{8.0f, 8.0f};
+    constexpr glm::vec2 size{256.0f, 64.0f};
+    constexpr f32 scale = 1.0f / 30.0f;
+    auto &batch = m_renderer2D->Batch();
+    batch.Quad(origin, origin + size, PackColor(glm::vec4(0.0f, 0.0f, 0.0f, 0.5f)));
+
+    batch.SetLayer(1);
+    auto target = origin.y + size.y * (1.0f - (1.0f / 60.0f) / scale);
+    batch.Line({origin.x, target}, {origin.x + size.x, target}, PackColor(glm::vec4(0.3f, 0.8f, 0.3f, 0.6f)));
+    std::array<glm::vec2, std::tuple_size_v<decltype(m_frameTimes)>> points;
+    for (u32 i = 0; i < points.size(); i++) {
+        auto time = m_frameTimes[(m_frameTimeHead + i) % m_frameTimes.size()];
+        points[i] = glm::vec2(origin.x + size.x * static_cast<f32>(i) / static_cast<f32>(points.size() - 1),
+                              origin.y + size.y * (1.0f - std::min(time / scale, 1.0f)));
+    }
+    batch.LineStrip(points, PackColor(glm::vec4(1.0f, 0.8f, 0.2f, 1.0f)));
+}
+
 VkPipelineLayout Application::CreatePipelineLayout()
 {
+    std::vector<VkDescriptorSetLayout> setLayouts{m_frameSetLayout};
+    if (m_bindless) {
+        setLayouts.push_back(m_bindless->Layout());
+    }
+
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = sizeof(DrawConstants),
+    };
+
     VkPipelineLayoutCreateInfo info{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr,
+            .setLayoutCount = static_cast<u32>(setLayouts.size()),
+            .pSetLayouts = setLayouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
     };
 
     VkPipelineLayout layout;
-    auto result = vkCreatePipelineLayout(m_device.LogicalDevice(), &info, nullptr, &layout);
+    auto result = vkCreatePipelineLayout(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &layout);
     if (result != VK_SUCCESS) {
         ERROR("Failed to create pipeline layout");
     }
     return layout;
 }
 
+void Application::CreateDescriptors()
+{
+    m_layoutCache = std::make_unique<DescriptorLayoutCache>(m_device);
+    for (u32 i = 0; i < Swapchain::MaxFramesInFlight; i++) {
+        m_frameDescriptors.emplace_back(m_device);
+    }
+
+    VkDescriptorSetLayoutBinding frameBinding{
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    if (m_device.SupportsMeshShaders()) {
+        frameBinding.stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+    m_frameSetLayout = m_layoutCache->Get(std::span<VkDescriptorSetLayoutBinding const>(&frameBinding, 1));
+
+    if (m_device.SupportsBindless()) {
+        m_bindless = std::make_unique<BindlessHeap>(m_device, *m_layoutCache);
+    }
+}
+
+void Application::CreateIndirectPath(PipelineConfigInfo const &config, std::vector<Model::Lod> const &lods, std::vector<Model::MeshData> const &meshes)
+{
+    for (u32 i = 0; i < meshes.size(); i++) {
+        auto const &mesh = meshes[i];
+        m_lodMeshes.push_back(m_geometry->Upload(mesh.Vertices, mesh.Indices));
+        INFOF("Welded {} vertices down to {} for the geometry arena", lods[i].Vertices.size(), mesh.Vertices.size());
+        if (m_meshlets && m_meshlets->AddMesh(m_lodMeshes.back(), mesh.Meshlets)) {
+            INFOF("\tSplit into {} meshlets", mesh.Meshlets.Meshlets.size());
+        }
+    }
+    auto object = m_indirect->AddObject(m_lodMeshes.front(), glm::mat4(1.0f));
+    (void) m_scene.Create(Transform{}, {}, m_lodMeshes.front().Bounds, object);
+
+    if (m_hotReload) {
+        if (m_meshlets) {
+            m_meshlets->WatchShaders(*m_hotReload);
+        } else {
+            m_hotReload->Watch<Pipeline>({config.VertexShader, config.FragmentShader}, m_indirectPipeline, [this, config] {
+                return std::make_unique<Pipeline>(m_device, config, m_resources.get());
+            });
+            m_culling->WatchShaders(*m_hotReload);
+        }
+    }
+}
+
 void Application::CreateCommandBuffers()
 {
-    m_commandBuffers.resize(m_swapchain.ImageCount());
+    m_commandBuffers.resize(Swapchain::MaxFramesInFlight);
 
     VkCommandBufferAllocateInfo allocateInfo{
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
             .commandPool = m_device.CommandPool(),
             .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = m_swapchain.ImageCount(),
+            .commandBufferCount = Swapchain::MaxFramesInFlight,
     };
 
     auto result = vkAllocateCommandBuffers(m_device.LogicalDevice(), &allocateInfo, m_commandBuffers.data());
     if (result != VK_SUCCESS) {
         ERRORF("Failed to allocate command buffers: {}", string_VkResult(result));
     }
+}
+
+void Application::CreateFrameCapture()
+{
+    m_capture = std::make_unique<FrameCapture>(m_device, m_jobs, Swapchain::MaxFramesInFlight);
+    auto const *screenshot = std::getenv("VULKANIZED_SCREENSHOT");
+    auto const *sequence = std::getenv("VULKANIZED_CAPTURE_SEQUENCE");
+    if (screenshot == nullptr && sequence == nullptr) {
+        return;
+    }
+    if (!m_swapchain.SupportsReadback()) {
+        WARN("The swapchain images cannot be copied from, frame capture is disabled");
+        return;
+    }
+
+    // VULKANIZED_SCREENSHOT=<file> captures the first frame, .raw for plain RGBA8, PNG otherwise.
+    if (screenshot != nullptr) {
+        m_capture->Screenshot(screenshot);
+    }
+    // VULKANIZED_CAPTURE_SEQUENCE=<directory> captures every frame as PNG, only the first
+    // VULKANIZED_CAPTURE_FRAMES=<count> when set.
+    if (sequence != nullptr) {
+        auto const *frames = std::getenv("VULKANIZED_CAPTURE_FRAMES");
+        m_capture->StartSequence(sequence, CaptureFormat::Png, frames != nullptr ? static_cast<u32>(std::strtoul(frames, nullptr, 10)) : 0);
+    }
+}
+
+void Application::RecordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex, VkDescriptorSet frameSet, u32 frameDataOffset, glm::mat4 const &viewProjection)
+{
+    VkCommandBufferBeginInfo info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
 
-    for (u32 i = 0; i < m_commandBuffers.size(); i++) {
-        VkCommandBufferBeginInfo info{
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    auto result = vkBeginCommandBuffer(commandBuffer, &info);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to begin command buffers: {}", string_VkResult(result));
+    }
+    m_pipelineStatistics->Begin(commandBuffer, m_swapchain.CurrentFrame());
 
-        result = vkBeginCommandBuffer(m_commandBuffers[i], &info);
-        if (result != VK_SUCCESS) {
-            ERRORF("Failed to begin command buffers: {}", string_VkResult(result));
+    if (m_indirect) {
+        m_indirect->Upload(commandBuffer, *m_frameData);
+        if (m_meshlets) {
+            m_meshlets->Prepare(commandBuffer, *m_frameData);
+        } else {
+            m_culling->Cull(commandBuffer, *m_frameData, m_swapchain.CurrentFrame(), viewProjection, m_swapchain.Extent());
         }
+    }
+    if (m_particles) {
+        m_particles->Simulate(commandBuffer);
+    }
+
+    VkClearValue clearValues[2] = {
+            VkClearValue{
+                    .color = {0.1f, 0.1f, 0.1f, 1.0f},
+            },
+            VkClearValue{
+                    .depthStencil = {1.0f, 0}}};
 
+    if (m_graph) {
+        m_graph->Begin(m_swapchain.CurrentFrame());
+        // The acquire semaphore is waited on at color attachment output, the first transition
+        // has to come after it.
+        auto backbuffer = m_graph->ImportImage(
+                "Backbuffer", m_swapchain.GetImage(imageIndex), m_swapchain.GetImageView(imageIndex),
+                TextureDesc{m_swapchain.ImageFormat(), m_swapchain.Extent()},
+                ResourceState{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE},
+                ResourceState{VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE});
+        auto &forward = m_graph->AddPass("Forward")
+                .Clear(backbuffer, ResourceUsage::ColorAttachment, clearValues[0]);
+        if (m_swapchain.HasDepth()) {
+            // Scratch import, the graph clears it and never stores it.
+            auto depth = m_graph->ImportImage(
+                    "Depth", m_swapchain.DepthImage(), m_swapchain.DepthImageView(),
+                    TextureDesc{m_swapchain.DepthFormat(), m_swapchain.Extent()}, ResourceState{}, ResourceState{});
+            forward.Clear(depth, ResourceUsage::DepthAttachment, clearValues[1]);
+        }
+        forward.Execute([&](VkCommandBuffer passCommands) { RecordScene(passCommands, frameSet, frameDataOffset, viewProjection); });
+        m_graph->Execute(commandBuffer);
+    } else {
         VkRenderPassBeginInfo renderPassBeginInfo{
                 .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
                 .renderPass = m_swapchain.RenderPass(),
-                .framebuffer = m_swapchain.GetFramebuffer(i),
+                .framebuffer = m_swapchain.GetFramebuffer(imageIndex),
                 .renderArea = VkRect2D{
                         .offset = {0, 0},
                         .extent = m_swapchain.Extent(),
-                }};
-
-        VkClearValue clearValues[2] = {
-                VkClearValue{
-                        .color = {0.1f, 0.1f, 0.1f, 1.0f},
                 },
-                VkClearValue{
-                        .depthStencil = {1.0f, 0}}};
-
-        renderPassBeginInfo.clearValueCount = 2;
-        renderPassBeginInfo.pClearValues = clearValues;
-
-        vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        m_pipeline->BindCommandBuffer(m_commandBuffers[i]);
-
-        m_model->Bind(m_commandBuffers[i]);
-        m_model->Draw(m_commandBuffers[i]);
+                .clearValueCount = 2,
+                .pClearValues = clearValues,
+        };
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        RecordScene(commandBuffer, frameSet, frameDataOffset, viewProjection);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+    // Both paths leave the backbuffer ready to present.
+    if (m_swapchain.SupportsReadback()) {
+        m_capture->Record(commandBuffer, m_renderedFrames.load(std::memory_order_relaxed), m_swapchain.GetImage(imageIndex),
+                          m_swapchain.ImageFormat(), m_swapchain.Extent(), VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
+    m_pipelineStatistics->End(commandBuffer, m_swapchain.CurrentFrame());
 
-        // vkCmdDraw(m_commandBuffers[i], 3, 1, 0, 0);
-        vkCmdEndRenderPass(m_commandBuffers[i]);
+    result = vkEndCommandBuffer(commandBuffer);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to record command buffer: {}", string_VkResult(result));
+    }
+}
 
-        result = vkEndCommandBuffer(m_commandBuffers[i]);
+void Application::RecordScene(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, u32 frameDataOffset, glm::mat4 const &viewProjection)
+{
+    // Bound once per frame, draws only change push constants from here on.
+    VkDescriptorSet sets[] = {frameSet, m_bindless ? m_bindless->Set() : VK_NULL_HANDLE};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, m_bindless ? 2 : 1, sets, 1, &frameDataOffset);
 
-        if (result != VK_SUCCESS) {
-            ERRORF("Failed to record command buffer: {}", string_VkResult(result));
+    if (m_meshlets) {
+        m_meshlets->Draw(commandBuffer, frameSet, frameDataOffset, EyeFromViewProjection(viewProjection));
+    } else if (m_indirect) {
+        m_indirectPipeline->BindCommandBuffer(commandBuffer);
+        m_culling->Draw(commandBuffer, m_pipelineLayout);
+    } else {
+        m_renderQueue.Clear();
+        (void) m_culler.Cull(Frustum::FromViewProjection(viewProjection), m_visible, &m_jobs);
+        // Resolved once, each resolve locks the resource manager and marks the frame as a use.
+        auto pipeline = m_pipeline->Handle();
+        auto vertexBuffer = m_model->VertexBuffer();
+        for (auto object: m_visible) {
+            auto lod = object < m_drawLods.size() ? m_drawLods[object] : 0;
+            auto const &range = m_model->Lods()[lod];
+            m_lodTriangles += range.VertexCount / 3;
+            // Front to back within the pipeline, so depth testing rejects what is hidden early.
+            auto clip = viewProjection * glm::vec4(m_culler.Center(object), 1.0f);
+            auto depth = clip.w > 0.0f ? clip.z / clip.w : 0.0f;
+            m_renderQueue.Submit(DrawPacket{
+                    .SortKey = SortKey::Make(0, 0, 0, 0, depth),
+                    .Pipeline = pipeline,
+                    .VertexBuffer = vertexBuffer,
+                    .Count = range.VertexCount,
+                    .FirstVertex = range.FirstVertex,
+                    .ObjectIndex = object,
+            });
         }
+        m_renderQueue.Sort();
+        m_renderQueue.Flush(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, m_device.Stats());
     }
+
+    if (m_particles) {
+        m_particles->Draw(commandBuffer, frameSet, frameDataOffset);
+    }
+
+    // Batch coordinates are pixels from the top left corner.
+    auto extent = m_swapchain.Extent();
+    m_renderer2D->Draw(commandBuffer, glm::ortho(0.0f, static_cast<f32>(extent.width), 0.0f, static_cast<f32>(extent.height)));
 }
 
-void Application::DrawFrame()
+void Application::DrawFrame(FramePacket const &packet)
 {
     u32 imageIndex = m_swapchain.AcquireNextImage();
+    // Nothing is recording yet, replaced pipelines are retired after the frames that used them.
+    if (m_hotReload && m_hotReload->Apply() > 0) {
+        INFOF("Swapped in {} hot reloaded pipelines", m_hotReload->AppliedCount());
+    }
+
+    // AcquireNextImage waited on this slot's fence, so its command buffer and streaming
+    // region are no longer in use by the GPU.
+    auto frameIndex = m_swapchain.CurrentFrame();
+    m_pipelineStatistics->Collect(frameIndex);
+    m_capture->Poll(m_renderedFrames.load(std::memory_order_relaxed));
+    m_frameData->BeginFrame(frameIndex);
+    // With a compute queue of its own the particle simulation goes out ahead of the frame.
+    std::optional<QueueWait> particleWait;
+    if (m_particles) {
+        m_particles->BeginFrame(frameIndex, packet.DeltaTime);
+        particleWait = m_particles->SubmitAsync();
+    }
+    m_renderer2D->BeginFrame(frameIndex);
+    DrawOverlay(packet);
+
+    auto frameData = m_frameData->PushUniform(FrameUniforms{
+            .ViewProjection = packet.ViewProjection,
+            .Time = glm::vec4(static_cast<f32>(packet.Time), packet.DeltaTime, 0.0f, 0.0f),
+    });
+
+    // Transient sets come from the frame's own pools, which are recycled in one go.
+    auto &descriptors = m_frameDescriptors[frameIndex];
+    descriptors.Reset();
+    auto frameSet = descriptors.Allocate(m_frameSetLayout);
+    auto writes = DescriptorWriter()
+            .WriteBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, m_frameData->Handle(), 0, sizeof(FrameUniforms))
+            .Update(m_device.LogicalDevice(), frameSet);
+    m_device.Stats().Add(RenderCounter::DescriptorWrites, writes);
+
+    // Transforms and level changes have to reach the draw records before this frame's upload.
+    ApplySimulation(packet);
 
-    m_swapchain.SubmitCommandBuffers(&m_commandBuffers[imageIndex], imageIndex);
+    auto commandBuffer = m_commandBuffers[frameIndex];
+    RecordCommandBuffer(commandBuffer, imageIndex, frameSet, static_cast<u32>(frameData.Offset), packet.ViewProjection);
+    m_swapchain.SubmitCommandBuffers(&commandBuffer, imageIndex,
+                                     particleWait ? std::span<QueueWait const>(&*particleWait, 1) : std::span<QueueWait const>());
+    m_capture->Submitted(m_swapchain.LastSubmit());
+    m_device.Stats().EndFrame();
 }
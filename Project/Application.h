@@ -6,18 +6,157 @@
 #include <vector>
 #include "Model.h"
 #include "Types.h"
+#include "TripleBuffer.h"
+#include "StreamingBuffer.h"
+#include "Descriptors.h"
+#include "Resources.h"
+#include "RenderQueue.h"
+#include "GeometryArena.h"
+#include "IndirectRenderer.h"
+#include "CullingPass.h"
+#include "MeshletPass.h"
+#include "ParticleSystem.h"
+#include "Renderer2D.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include "LinearArena.h"
+#include "LodSelector.h"
+#include "RenderGraph.h"
+#include "ShaderHotReload.h"
+#include "FrameCapture.h"
+#include "StartupTimer.h"
+#include <array>
+#include <atomic>
+#include <thread>
+#include <tuple>
+
+// A render object switching detail level, decided by the simulation.
+struct LodChange {
+    u32 Object{};
+    u32 Lod{};
+};
+
+// Everything the render thread needs to know about one simulated frame. Object state comes as
+// changes since the previous packet, the vectors keep their capacity as the slots get reused.
+struct FramePacket {
+    u64 FrameNumber{};
+    f64 Time{};
+    f32 DeltaTime{};
+    bool ShouldQuit{};
+    glm::mat4 ViewProjection{1.0f};
+    std::vector<SceneObjectUpdate> Objects{};
+    // Render objects of destroyed entities.
+    std::vector<u32> Released{};
+    std::vector<LodChange> LodChanges{};
+};
+
+// Per-frame uniform block, matches `FrameData` in Builtin.Object.vert.glsl.
+struct FrameUniforms {
+    glm::mat4 ViewProjection;
+    glm::vec4 Time;
+};
+
+// Per-draw push constants, indices into the bindless heap.
+struct DrawConstants {
+    u32 ObjectIndex;
+    u32 MaterialIndex;
+};
+
+// Specialization traits of Builtin.Object.frag, shared by every object pipeline.
+struct ObjectShaderTraits {
+    static constexpr char const *Name = "Object";
+    f32 ColorR = 1.0f;
+    f32 ColorG = 0.0f;
+    f32 ColorB = 1.0f;
+
+    constexpr auto Constants() const { return std::tuple{ColorR, ColorG, ColorB}; }
+};
+
+struct FrameOverlapMetrics {
+    u64 Frames{};
+    f64 WallTime{};
+    f64 SimulateTime{};
+    f64 RenderTime{};
+
+    // Lower bound of the time both threads were busy at once.
+    MUST_USE f64 OverlapTime() const {
+        auto overlap = SimulateTime + RenderTime - WallTime;
+        return overlap > 0.0 ? overlap : 0.0;
+    }
+};
 
 class Application {
     Window m_Window{600, 400, "Window"};
     Device m_device{m_Window};
+    // Runtime assets, the object model and pipelines, live behind its handles. Declared before
+    // them so they can unregister when they go away.
+    Ptr<ResourceManager> m_resources{};
     Ptr<Pipeline> m_pipeline{};
     Ptr<Model> m_model{};
     Swapchain m_swapchain{m_device};
+    Ptr<StreamingBuffer> m_frameData{};
+    Ptr<DescriptorLayoutCache> m_layoutCache{};
+    std::vector<DescriptorAllocator> m_frameDescriptors{};
+    Ptr<BindlessHeap> m_bindless{};
+    RenderQueue m_renderQueue{};
+    JobSystem m_jobs{};
+    // Visibility for the CPU-driven path, indices refer to the objects submitted to the render queue.
+    FrustumCuller m_culler{};
+    std::vector<u32> m_visible{};
+    // Entities carry their render object, an IndirectRenderer slot or a culler index on the CPU path.
+    // Simulation thread only, the render thread sees it through the frame packets.
+    Scene m_scene{};
+    // Every object shares the one detail chain, levels are drawn ranges of m_model on the CPU path
+    // and separate arena meshes on the GPU path. The selector and the world bounds and scales it
+    // works from belong to the simulation, a negative radius marks a released object.
+    LodSelector m_lodSelector{};
+    std::vector<glm::vec4> m_simulatedBounds{};
+    std::vector<f32> m_simulatedScales{};
+    std::vector<f32> m_lodErrors{};
+    std::vector<MeshAllocation> m_lodMeshes{};
+    // Render thread: the level each CPU path object is drawn at, and statistics.
+    std::vector<u32> m_drawLods{};
+    u64 m_lodSwitches{};
+    u64 m_lodTriangles{};
+    // GPU-driven path, only created when the device supports indirect count draws and bindless.
+    // Objects go through the meshlet pass when mesh shaders are available, the culling pass otherwise.
+    Ptr<GeometryArena> m_geometry{};
+    Ptr<IndirectRenderer> m_indirect{};
+    Ptr<Pipeline> m_indirectPipeline{};
+    Ptr<CullingPass> m_culling{};
+    Ptr<MeshletPass> m_meshlets{};
+    // Compute particle workload on top of the scene, only created when asked for.
+    Ptr<ParticleSystem> m_particles{};
+    // Immediate mode 2D on top of everything else, the frame time graph for now.
+    Ptr<Renderer2D> m_renderer2D{};
+    std::array<f32, 128> m_frameTimes{};
+    u32 m_frameTimeHead{};
+    // Transient CPU data of the frame being simulated, reset at the start of every Simulate.
+    LinearArena m_frameArena{256 * 1024};
+    // Around every frame's command buffer, feeds the GPU side of the device's render stats.
+    Ptr<PipelineStatisticsQueries> m_pipelineStatistics{};
+    // Screenshots and frame sequences out of the presented images. Declared after the job system
+    // so its encoding jobs are done before the workers stop.
+    Ptr<FrameCapture> m_capture{};
+    // Where the device memory statistics go every 1000 frames, from VULKANIZED_MEMORY_JSON.
+    char const *m_memoryJson{};
+    // Frame passes go through the graph when dynamic rendering is available, the swapchain's
+    // render pass is the fallback.
+    Ptr<RenderGraph> m_graph{};
+    // Declared after every pipeline it swaps so it stops watching before they go away.
+    Ptr<ShaderHotReload> m_hotReload{};
 
     VkPipelineLayout m_pipelineLayout{};
+    VkDescriptorSetLayout m_frameSetLayout{};
 
     std::vector<VkCommandBuffer> m_commandBuffers{};
 
+    TripleBuffer<FramePacket> m_frameHandoff{};
+    std::thread m_renderThread{};
+    std::atomic<u64> m_renderBusyNs{0};
+    std::atomic<u64> m_renderedFrames{0};
+
 public:
     ~Application();
     void Initialize();
@@ -25,6 +164,18 @@ public:
 
 private:
     VkPipelineLayout CreatePipelineLayout();
+    void CreateDescriptors();
     void CreateCommandBuffers();
-    void DrawFrame();
+    void CreateFrameCapture();
+    // Uploads the pre-built meshes, the passes themselves are created in Initialize.
+    void CreateIndirectPath(PipelineConfigInfo const &config, std::vector<Model::Lod> const &lods, std::vector<Model::MeshData> const &meshes);
+    void RecordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex, VkDescriptorSet frameSet, u32 frameDataOffset, glm::mat4 const &viewProjection);
+    void RecordScene(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, u32 frameDataOffset, glm::mat4 const &viewProjection);
+    void Simulate(FramePacket &packet);
+    // Render thread, writes the packet's object changes into the culler or the indirect renderer.
+    void ApplySimulation(FramePacket const &packet);
+    void RenderLoop();
+    void DrawFrame(FramePacket const &packet);
+    void DrawOverlay(FramePacket const &packet);
+    void ReportOverlap(FrameOverlapMetrics const &metrics);
 };
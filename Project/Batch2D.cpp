@@ -0,0 +1,127 @@
+#include "Batch2D.h"
+#include <cstring>
+
+Batch2D::Batch2D(u32 maxVertices)
+    : m_maxVertices(maxVertices), m_vertices(std::make_unique_for_overwrite<Vertex2D[]>(maxVertices))
+{
+    m_commands.reserve(1024);
+    m_keys.reserve(64);
+    m_draws.reserve(64);
+}
+
+void Batch2D::Clear()
+{
+    m_vertexCount = 0;
+    m_commands.clear();
+    m_draws.clear();
+    m_layer = 0;
+    m_stats = {};
+}
+
+Vertex2D *Batch2D::Reserve(Primitive2D primitive, u32 count)
+{
+    if (m_vertexCount + count > m_maxVertices) {
+        m_stats.Dropped++;
+        return nullptr;
+    }
+
+    auto key = static_cast<u32>(m_layer) << 1 | static_cast<u32>(primitive);
+    if (m_commands.empty() || m_commands.back().Key != key) {
+        m_commands.push_back(Command{key, m_vertexCount, 0});
+    }
+    m_commands.back().VertexCount += count;
+
+    auto *vertices = m_vertices.get() + m_vertexCount;
+    m_vertexCount += count;
+    m_stats.Primitives++;
+    return vertices;
+}
+
+void Batch2D::Triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, u32 color)
+{
+    if (auto *vertices = Reserve(Primitive2D::Triangles, 3)) {
+        vertices[0] = Vertex2D{a, glm::vec2(0.0f), color, NoTexture};
+        vertices[1] = Vertex2D{b, glm::vec2(0.0f), color, NoTexture};
+        vertices[2] = Vertex2D{c, glm::vec2(0.0f), color, NoTexture};
+    }
+}
+
+void Batch2D::Quad(glm::vec2 min, glm::vec2 max, u32 color)
+{
+    Sprite(min, max, NoTexture, glm::vec2(0.0f), glm::vec2(0.0f), color);
+}
+
+void Batch2D::Line(glm::vec2 a, glm::vec2 b, u32 color)
+{
+    if (auto *vertices = Reserve(Primitive2D::Lines, 2)) {
+        vertices[0] = Vertex2D{a, glm::vec2(0.0f), color, NoTexture};
+        vertices[1] = Vertex2D{b, glm::vec2(0.0f), color, NoTexture};
+    }
+}
+
+void Batch2D::LineStrip(std::span<glm::vec2 const> points, u32 color)
+{
+    for (size_t i = 1; i < points.size(); i++) {
+        Line(points[i - 1], points[i], color);
+    }
+}
+
+void Batch2D::Sprite(glm::vec2 min, glm::vec2 max, u32 texture, glm::vec2 uvMin, glm::vec2 uvMax, u32 color)
+{
+    // Two triangles, no index buffer: six vertices cost less than building indices per frame.
+    if (auto *vertices = Reserve(Primitive2D::Triangles, 6)) {
+        Vertex2D topLeft{min, uvMin, color, texture};
+        Vertex2D topRight{{max.x, min.y}, {uvMax.x, uvMin.y}, color, texture};
+        Vertex2D bottomRight{max, uvMax, color, texture};
+        Vertex2D bottomLeft{{min.x, max.y}, {uvMin.x, uvMax.y}, color, texture};
+        vertices[0] = topLeft;
+        vertices[1] = topRight;
+        vertices[2] = bottomRight;
+        vertices[3] = bottomRight;
+        vertices[4] = bottomLeft;
+        vertices[5] = topLeft;
+    }
+}
+
+std::span<Batch2D::Draw const> Batch2D::Finish(Vertex2D *destination)
+{
+    // A counting sort over the keys in use: there are only a few, and it keeps primitives of one
+    // type in submission order within a layer. Runs of one key go out in a single copy.
+    m_keys.clear();
+    for (auto const &command: m_commands) {
+        auto key = std::lower_bound(m_keys.begin(), m_keys.end(), command.Key, [](KeyRange const &range, u32 key) { return range.Key < key; });
+        if (key == m_keys.end() || key->Key != command.Key) {
+            key = m_keys.insert(key, KeyRange{command.Key, 0, 0});
+        }
+        key->VertexCount += command.VertexCount;
+    }
+
+    m_draws.clear();
+    u32 offset = 0;
+    for (auto &key: m_keys) {
+        key.Cursor = offset;
+        auto primitive = static_cast<Primitive2D>(key.Key & 1);
+        if (!m_draws.empty() && m_draws.back().Primitive == primitive) {
+            m_draws.back().VertexCount += key.VertexCount;
+        } else {
+            m_draws.push_back(Draw{primitive, offset, key.VertexCount});
+        }
+        offset += key.VertexCount;
+    }
+
+    // Commands stay in submission order, so each key's range fills front to back. A frame on one
+    // layer and primitive type is a single copy.
+    auto key = m_keys.begin();
+    for (auto const &command: m_commands) {
+        if (key->Key != command.Key) {
+            key = std::lower_bound(m_keys.begin(), m_keys.end(), command.Key, [](KeyRange const &range, u32 value) { return range.Key < value; });
+        }
+        std::memcpy(destination + key->Cursor, m_vertices.get() + command.FirstVertex, sizeof(Vertex2D) * command.VertexCount);
+        key->Cursor += command.VertexCount;
+    }
+
+    m_stats.Vertices = m_vertexCount;
+    m_stats.Commands = static_cast<u32>(m_commands.size());
+    m_stats.Draws = static_cast<u32>(m_draws.size());
+    return m_draws;
+}
\ No newline at end of file
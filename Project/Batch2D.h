@@ -0,0 +1,108 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Matches the vertex input of Builtin.Batch2D.vert.glsl.
+struct Vertex2D {
+    glm::vec2 Position;
+    glm::vec2 UV;
+    // RGBA8, read back as VK_FORMAT_R8G8B8A8_UNORM.
+    u32 Color;
+    // Bindless image index, Batch2D::NoTexture for flat color.
+    u32 Texture;
+};
+
+enum class Primitive2D : u32 {
+    Triangles,
+    Lines,
+};
+inline constexpr u32 Primitive2DCount = 2;
+
+MUST_USE inline u32 PackColor(glm::vec4 const &color)
+{
+    auto channel = [](f32 value, u32 shift) {
+        return static_cast<u32>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f)) << shift;
+    };
+    return channel(color.r, 0) | channel(color.g, 8) | channel(color.b, 16) | channel(color.a, 24);
+}
+
+// Collects immediate mode 2D primitives on the CPU into one preallocated vertex array. Back to
+// back submissions with the same layer and primitive type extend one command, Finish() orders
+// the commands by layer, triangles below lines within a layer, and writes them out in one pass
+// as the fewest draws that keep that order. Textures are bindless indices carried per vertex,
+// so they never split a draw. Nothing allocates per primitive.
+class Batch2D {
+public:
+    static constexpr u32 NoTexture = ~0u;
+
+    struct Draw {
+        Primitive2D Primitive;
+        u32 FirstVertex;
+        u32 VertexCount;
+    };
+
+    struct Stats {
+        u32 Primitives{};
+        u32 Vertices{};
+        u32 Commands{};
+        u32 Draws{};
+        // Primitives that did not fit into the vertex budget.
+        u32 Dropped{};
+    };
+
+private:
+    struct Command {
+        // Layer above primitive type.
+        u32 Key;
+        u32 FirstVertex;
+        u32 VertexCount;
+    };
+
+    struct KeyRange {
+        u32 Key;
+        u32 VertexCount;
+        // Where the key's next run goes in the output.
+        u32 Cursor;
+    };
+
+    u32 m_maxVertices;
+    u32 m_vertexCount{};
+    Ptr<Vertex2D[]> m_vertices;
+    std::vector<Command> m_commands;
+    std::vector<KeyRange> m_keys;
+    std::vector<Draw> m_draws;
+    u16 m_layer{};
+    Stats m_stats{};
+
+public:
+    explicit Batch2D(u32 maxVertices);
+
+    // Drops everything submitted so far and goes back to layer 0.
+    void Clear();
+    // Later layers are drawn over earlier ones, whatever order they were submitted in.
+    void SetLayer(u16 layer) { m_layer = layer; }
+    MUST_USE u16 Layer() const { return m_layer; }
+
+    void Triangle(glm::vec2 a, glm::vec2 b, glm::vec2 c, u32 color);
+    void Quad(glm::vec2 min, glm::vec2 max, u32 color);
+    void Line(glm::vec2 a, glm::vec2 b, u32 color);
+    void LineStrip(std::span<glm::vec2 const> points, u32 color);
+    void Sprite(glm::vec2 min, glm::vec2 max, u32 texture, glm::vec2 uvMin = glm::vec2(0.0f), glm::vec2 uvMax = glm::vec2(1.0f), u32 color = ~0u);
+
+    // Writes VertexCount() vertices in draw order to `destination`, which may be mapped write
+    // combined memory: it is never read and every draw's range is written front to back. The
+    // draws stay valid until the next call.
+    MUST_USE std::span<Draw const> Finish(Vertex2D *destination);
+
+    MUST_USE u32 VertexCount() const { return m_vertexCount; }
+    MUST_USE u32 MaxVertices() const { return m_maxVertices; }
+    MUST_USE Stats const &GetStats() const { return m_stats; }
+
+private:
+    MUST_USE Vertex2D *Reserve(Primitive2D primitive, u32 count);
+};
\ No newline at end of file
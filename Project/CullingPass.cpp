@@ -0,0 +1,353 @@
+#include "CullingPass.h"
+#include "FrustumCuller.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vulkan/vk_enum_string_helper.h>
+
+// Both layouts must match the push constant blocks in the culling shaders.
+struct ObjectCullConstants {
+    glm::vec4 Planes[6];
+    u32 ObjectBuffer;
+    u32 InputDraws;
+    u32 OutputDraws;
+    u32 Visibility;
+    u32 Counters;
+    u32 ObjectCount;
+};
+
+struct TriangleCullConstants {
+    glm::mat4 ViewProjection;
+    glm::vec2 Viewport;
+    u32 ObjectBuffer;
+    u32 Visibility;
+    u32 Clusters;
+    u32 ClusterDraws;
+    u32 Vertices;
+    u32 Indices;
+    u32 CulledIndices;
+    u32 Counters;
+    u32 ClusterCount;
+};
+
+static constexpr u32 PushConstantSize = 128;
+static_assert(sizeof(ObjectCullConstants) <= PushConstantSize);
+static_assert(sizeof(TriangleCullConstants) <= PushConstantSize);
+
+static constexpr char const *ObjectCullShader = "Assets/Shaders/Builtin.CullObjects.comp.spv";
+static constexpr char const *TriangleCullShader = "Assets/Shaders/Builtin.CullTriangles.comp.spv";
+
+static constexpr VkPipelineStageFlags DrawStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+
+void CullStats::Add(CullCounters const &counters)
+{
+    Frames++;
+    ObjectsIn += counters.ObjectsIn;
+    ObjectsVisible += counters.ObjectsVisible;
+    TrianglesIn += counters.TrianglesIn;
+    TrianglesAfterFrustum += counters.TrianglesAfterFrustum;
+    TrianglesVisible += counters.TrianglesVisible;
+}
+
+CullingPass::CullingPass(Device &device, BindlessHeap &bindless, GeometryArena &geometry, IndirectRenderer &renderer)
+    : m_device(device), m_bindless(bindless), m_geometry(geometry), m_renderer(renderer)
+{
+    // Every object can leave one partially filled cluster behind.
+    m_maxClusters = geometry.IndexCapacity() / 3 / ClusterSize + renderer.MaxObjects();
+
+    auto create = [&](VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &memory) {
+        auto result = m_device.CreateBuffer(size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        buffer = result.Buffer;
+        memory = result.Memory;
+    };
+    create(sizeof(GpuDrawRecord) * static_cast<VkDeviceSize>(renderer.MaxObjects()),
+           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+           m_visibleDraws, m_visibleDrawsMemory);
+    create(sizeof(u32) * static_cast<VkDeviceSize>(renderer.MaxObjects()),
+           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+           m_visibility, m_visibilityMemory);
+    create(sizeof(Cluster) * static_cast<VkDeviceSize>(m_maxClusters),
+           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+           m_clusters, m_clustersMemory);
+    create(sizeof(GpuDrawRecord) * static_cast<VkDeviceSize>(m_maxClusters),
+           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+           m_clusterDraws, m_clusterDrawsMemory);
+    create(sizeof(u32) * static_cast<VkDeviceSize>(geometry.IndexCapacity()),
+           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+           m_culledIndices, m_culledIndicesMemory);
+
+    auto alignment = m_device.Properties().limits.minStorageBufferOffsetAlignment;
+    m_counterStride = (sizeof(CullCounters) + alignment - 1) / alignment * alignment;
+    auto counters = m_device.CreateBuffer(
+            m_counterStride * Swapchain::MaxFramesInFlight,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_counters = counters.Buffer;
+    m_countersMemory = counters.Memory;
+    void *mapped{};
+    auto result = vkMapMemory(m_device.LogicalDevice(), m_countersMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to map culling counters: {}", string_VkResult(result));
+    }
+    m_countersMapped = static_cast<u8 *>(mapped);
+
+    m_visibleDrawsIndex = m_bindless.RegisterBuffer(m_visibleDraws, 0, VK_WHOLE_SIZE);
+    m_visibilityIndex = m_bindless.RegisterBuffer(m_visibility, 0, VK_WHOLE_SIZE);
+    m_clustersIndex = m_bindless.RegisterBuffer(m_clusters, 0, VK_WHOLE_SIZE);
+    m_clusterDrawsIndex = m_bindless.RegisterBuffer(m_clusterDraws, 0, VK_WHOLE_SIZE);
+    m_culledIndicesIndex = m_bindless.RegisterBuffer(m_culledIndices, 0, VK_WHOLE_SIZE);
+    m_vertexBufferIndex = m_bindless.RegisterBuffer(geometry.VertexBuffer(), 0, VK_WHOLE_SIZE);
+    m_indexBufferIndex = m_bindless.RegisterBuffer(geometry.IndexBuffer(), 0, VK_WHOLE_SIZE);
+    for (u32 i = 0; i < Swapchain::MaxFramesInFlight; i++) {
+        m_counterIndices[i] = m_bindless.RegisterBuffer(m_counters, m_counterStride * i, sizeof(CullCounters));
+    }
+
+    CreateLayout();
+    // The default variants are built up front, others on the first frame that asks for them.
+    m_pipelines = std::make_unique<PipelineRegistry>(m_device);
+    (void) m_pipelines->Compute(m_layout, ObjectCullShader, Specialize(ObjectCullTraits{}));
+    (void) m_pipelines->Compute(m_layout, TriangleCullShader, Specialize(TriangleCullTraits{}));
+
+    INFOF("Created culling pass for {} objects and {} clusters", renderer.MaxObjects(), m_maxClusters);
+}
+
+CullingPass::~CullingPass()
+{
+    for (auto index: {m_visibleDrawsIndex, m_visibilityIndex, m_clustersIndex, m_clusterDrawsIndex,
+                      m_culledIndicesIndex, m_vertexBufferIndex, m_indexBufferIndex}) {
+        m_bindless.ReleaseBuffer(index);
+    }
+    for (auto index: m_counterIndices) {
+        m_bindless.ReleaseBuffer(index);
+    }
+
+    m_pipelines.reset();
+
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), budget = &m_device.Memory(), layout = m_layout,
+                              buffers = std::array{m_visibleDraws, m_visibility, m_clusters, m_clusterDraws, m_culledIndices, m_counters},
+                              memories = std::array{m_visibleDrawsMemory, m_visibilityMemory, m_clustersMemory, m_clusterDrawsMemory, m_culledIndicesMemory, m_countersMemory}] {
+        vkDestroyPipelineLayout(device, layout, callbacks);
+        for (u32 i = 0; i < buffers.size(); i++) {
+            vkDestroyBuffer(device, buffers[i], nullptr);
+            budget->Free(device, memories[i]);
+        }
+    });
+}
+
+void CullingPass::WatchShaders(ShaderHotReload &hotReload)
+{
+    m_pipelines->WatchShaders(hotReload);
+}
+
+void CullingPass::CreateLayout()
+{
+    // The culling shaders only touch bindless buffers, so the heap is set 0 here.
+    auto setLayout = m_bindless.Layout();
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = PushConstantSize,
+    };
+
+    VkPipelineLayoutCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+
+    auto result = vkCreatePipelineLayout(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &m_layout);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create culling pipeline layout: {}", string_VkResult(result));
+    }
+}
+
+void CullingPass::ReadCounters(u32 frameIndex)
+{
+    if (!m_counterPending[frameIndex] || m_countersMapped == nullptr) {
+        return;
+    }
+
+    std::memcpy(&m_lastCounters, m_countersMapped + m_counterStride * frameIndex, sizeof(CullCounters));
+    if (!m_counterClusters[frameIndex]) {
+        m_lastCounters.TrianglesVisible = m_lastCounters.TrianglesAfterFrustum;
+    }
+    if (m_counterStatistics[frameIndex]) {
+        m_stats.Add(m_lastCounters);
+    }
+    m_counterPending[frameIndex] = false;
+}
+
+CullStats CullingPass::TakeStats()
+{
+    auto stats = m_stats;
+    m_stats = {};
+    return stats;
+}
+
+void CullingPass::RebuildClusters(VkCommandBuffer commandBuffer, StreamingBuffer &staging)
+{
+    if (m_clusterRevision == m_renderer.Revision()) {
+        return;
+    }
+
+    m_clusterData.clear();
+    auto records = m_renderer.Records();
+    for (u32 object = 0; object < records.size(); object++) {
+        auto const &command = records[object].Command;
+        auto triangles = command.indexCount / 3;
+        for (u32 first = 0; first < triangles; first += ClusterSize) {
+            m_clusterData.push_back(Cluster{
+                    .ObjectIndex = object,
+                    .FirstIndex = command.firstIndex + first * 3,
+                    .TriangleCount = std::min(ClusterSize, triangles - first),
+                    .VertexOffset = command.vertexOffset,
+            });
+        }
+    }
+
+    m_clusterCount = 0;
+    if (m_clusterData.empty()) {
+        m_clusterRevision = m_renderer.Revision();
+        return;
+    }
+    if (m_clusterData.size() > m_maxClusters) {
+        ERRORF("Culling pass has room for {} clusters, scene needs {}", m_maxClusters, m_clusterData.size());
+        return;
+    }
+
+    // Try again next frame if the staging ring is already full, draws fall back to per object.
+    auto size = sizeof(Cluster) * m_clusterData.size();
+    auto allocation = staging.AllocateStorage(size);
+    if (!allocation.IsValid()) {
+        WARNF("Not enough staging memory for {} clusters", m_clusterData.size());
+        return;
+    }
+    std::memcpy(allocation.Data, m_clusterData.data(), size);
+
+    VkBufferCopy region{
+            .srcOffset = allocation.Offset,
+            .dstOffset = 0,
+            .size = size,
+    };
+    vkCmdCopyBuffer(commandBuffer, allocation.Buffer, m_clusters, 1, &region);
+    m_device.Stats().Add(RenderCounter::UploadedBytes, size);
+
+    m_clusterCount = static_cast<u32>(m_clusterData.size());
+    m_clusterRevision = m_renderer.Revision();
+}
+
+void CullingPass::Cull(VkCommandBuffer commandBuffer, StreamingBuffer &staging, u32 frameIndex, glm::mat4 const &viewProjection, VkExtent2D viewport)
+{
+    // The caller waited on this slot's fence, so its counters are final.
+    ReadCounters(frameIndex);
+    m_frameIndex = frameIndex;
+
+    // Output buffers are shared between frames in flight, wait for earlier draws to stop reading them.
+    vkCmdPipelineBarrier(commandBuffer, DrawStages, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    RebuildClusters(commandBuffer, staging);
+    vkCmdFillBuffer(commandBuffer, m_counters, m_counterStride * frameIndex, sizeof(CullCounters), 0);
+
+    VkMemoryBarrier uploadBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    auto heap = m_bindless.Set();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_layout, 0, 1, &heap, 0, nullptr);
+
+    ObjectCullConstants objectConstants{
+            .ObjectBuffer = m_renderer.ObjectBufferIndex(),
+            .InputDraws = m_renderer.RecordBufferIndex(),
+            .OutputDraws = m_visibleDrawsIndex,
+            .Visibility = m_visibilityIndex,
+            .Counters = m_counterIndices[frameIndex],
+            .ObjectCount = m_renderer.ObjectCount(),
+    };
+    auto frustum = Frustum::FromViewProjection(viewProjection);
+    std::copy(std::begin(frustum.Planes), std::end(frustum.Planes), objectConstants.Planes);
+
+    ObjectCullTraits objectTraits{.Statistics = m_statistics};
+    m_pipelines->Compute(m_layout, ObjectCullShader, Specialize(objectTraits)).BindCommandBuffer(commandBuffer);
+    vkCmdPushConstants(commandBuffer, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(objectConstants), &objectConstants);
+    vkCmdDispatch(commandBuffer, (objectConstants.ObjectCount + objectTraits.WorkgroupSize - 1) / objectTraits.WorkgroupSize, 1, 1);
+    m_device.Stats().Add(RenderCounter::Dispatches);
+
+    m_drawClusterCount = m_triangleCulling ? m_clusterCount : 0;
+    if (m_drawClusterCount > 0) {
+        VkMemoryBarrier visibilityBarrier{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &visibilityBarrier, 0, nullptr, 0, nullptr);
+        m_device.Stats().Add(RenderCounter::Barriers);
+
+        TriangleCullConstants triangleConstants{
+                .ViewProjection = viewProjection,
+                .Viewport = glm::vec2(static_cast<f32>(viewport.width), static_cast<f32>(viewport.height)),
+                .ObjectBuffer = m_renderer.ObjectBufferIndex(),
+                .Visibility = m_visibilityIndex,
+                .Clusters = m_clustersIndex,
+                .ClusterDraws = m_clusterDrawsIndex,
+                .Vertices = m_vertexBufferIndex,
+                .Indices = m_indexBufferIndex,
+                .CulledIndices = m_culledIndicesIndex,
+                .Counters = m_counterIndices[frameIndex],
+                .ClusterCount = m_drawClusterCount,
+        };
+
+        m_pipelines->Compute(m_layout, TriangleCullShader, Specialize(TriangleCullTraits{.Statistics = m_statistics})).BindCommandBuffer(commandBuffer);
+        vkCmdPushConstants(commandBuffer, m_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(triangleConstants), &triangleConstants);
+        // One workgroup per cluster.
+        vkCmdDispatch(commandBuffer, m_drawClusterCount, 1, 1);
+        m_device.Stats().Add(RenderCounter::Dispatches);
+    }
+
+    VkMemoryBarrier cullBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, DrawStages | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    m_counterPending[frameIndex] = true;
+    m_counterClusters[frameIndex] = m_drawClusterCount > 0;
+    m_counterStatistics[frameIndex] = m_statistics;
+}
+
+void CullingPass::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout layout)
+{
+    u32 constants[] = {m_renderer.ObjectBufferIndex(), 0};
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), constants);
+
+    auto counterOffset = m_counterStride * m_frameIndex;
+    if (m_drawClusterCount > 0) {
+        // Culled clusters keep the arena's index layout, only the index buffer changes.
+        VkDeviceSize offset = 0;
+        auto vertexBuffer = m_geometry.VertexBuffer();
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, m_culledIndices, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirectCount(commandBuffer, m_clusterDraws, 0, m_counters, counterOffset + offsetof(CullCounters, ClusterDrawCount),
+                                      m_drawClusterCount, sizeof(GpuDrawRecord));
+        m_device.Stats().Add(RenderCounter::VertexBufferBinds);
+        m_device.Stats().Add(RenderCounter::IndexBufferBinds);
+    } else {
+        m_geometry.Bind(commandBuffer);
+        vkCmdDrawIndexedIndirectCount(commandBuffer, m_visibleDraws, 0, m_counters, counterOffset + offsetof(CullCounters, DrawCount),
+                                      m_renderer.ObjectCount(), sizeof(GpuDrawRecord));
+    }
+    m_device.Stats().DrawIndirect();
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#pragma once
+#include "Definitions.h"
+#include "Descriptors.h"
+#include "Device.h"
+#include "GeometryArena.h"
+#include "IndirectRenderer.h"
+#include "Pipeline.h"
+#include "PipelineRegistry.h"
+#include "ShaderHotReload.h"
+#include "Specialization.h"
+#include "StreamingBuffer.h"
+#include "Swapchain.h"
+#include "Types.h"
+#include <array>
+#include <tuple>
+#include <vulkan/vulkan.h>
+
+// Matches `Counters` in the culling shaders. The draw counts double as the count buffers
+// for vkCmdDrawIndexedIndirectCount, everything else is statistics.
+struct CullCounters {
+    u32 DrawCount;
+    u32 ClusterDrawCount;
+    u32 ObjectsIn;
+    u32 ObjectsVisible;
+    u32 TrianglesIn;
+    u32 TrianglesAfterFrustum;
+    u32 TrianglesVisible;
+    u32 ClustersVisible;
+};
+
+// Specialization traits of the culling shaders, constant ids follow the order of Constants().
+// Turning statistics off drops the counter atomics from the shaders instead of branching on them.
+struct ObjectCullTraits {
+    static constexpr char const *Name = "CullObjects";
+    u32 WorkgroupSize = 64;
+    bool Statistics = true;
+
+    constexpr auto Constants() const { return std::tuple{WorkgroupSize, Statistics}; }
+};
+
+struct TriangleCullTraits {
+    static constexpr char const *Name = "CullTriangles";
+    bool Statistics = true;
+
+    constexpr auto Constants() const { return std::tuple{Statistics}; }
+};
+
+struct CullStats {
+    u64 Frames{};
+    u64 ObjectsIn{};
+    u64 ObjectsVisible{};
+    u64 TrianglesIn{};
+    u64 TrianglesAfterFrustum{};
+    u64 TrianglesVisible{};
+
+    void Add(CullCounters const &counters);
+};
+
+// Compute culling in front of the indirect renderer. The first pass tests every object's
+// bounding sphere against the frustum and compacts the survivors into a second draw buffer.
+// The optional second pass runs one workgroup per 64-triangle cluster of the visible objects,
+// drops triangles that are degenerate or miss every sample, and writes one draw per cluster.
+class CullingPass {
+public:
+    static constexpr u32 ClusterSize = 64;
+
+    struct Cluster {
+        u32 ObjectIndex;
+        u32 FirstIndex;
+        u32 TriangleCount;
+        i32 VertexOffset;
+    };
+
+private:
+    Device &m_device;
+    BindlessHeap &m_bindless;
+    GeometryArena &m_geometry;
+    IndirectRenderer &m_renderer;
+
+    VkPipelineLayout m_layout{};
+    Ptr<PipelineRegistry> m_pipelines{};
+
+    VkBuffer m_visibleDraws{};
+    VkDeviceMemory m_visibleDrawsMemory{};
+    VkBuffer m_visibility{};
+    VkDeviceMemory m_visibilityMemory{};
+    VkBuffer m_clusters{};
+    VkDeviceMemory m_clustersMemory{};
+    VkBuffer m_clusterDraws{};
+    VkDeviceMemory m_clusterDrawsMemory{};
+    VkBuffer m_culledIndices{};
+    VkDeviceMemory m_culledIndicesMemory{};
+
+    // Host visible, one slice per frame in flight, read back once the frame's fence signalled.
+    VkBuffer m_counters{};
+    VkDeviceMemory m_countersMemory{};
+    u8 *m_countersMapped{};
+    VkDeviceSize m_counterStride{};
+
+    u32 m_visibleDrawsIndex{BindlessHeap::InvalidIndex};
+    u32 m_visibilityIndex{BindlessHeap::InvalidIndex};
+    u32 m_clustersIndex{BindlessHeap::InvalidIndex};
+    u32 m_clusterDrawsIndex{BindlessHeap::InvalidIndex};
+    u32 m_culledIndicesIndex{BindlessHeap::InvalidIndex};
+    u32 m_vertexBufferIndex{BindlessHeap::InvalidIndex};
+    u32 m_indexBufferIndex{BindlessHeap::InvalidIndex};
+    std::array<u32, Swapchain::MaxFramesInFlight> m_counterIndices{};
+
+    u32 m_maxClusters{};
+    u32 m_clusterCount{};
+    u32 m_drawClusterCount{};
+    u64 m_clusterRevision{~0ull};
+    std::vector<Cluster> m_clusterData;
+
+    u32 m_frameIndex{};
+    bool m_triangleCulling{true};
+    bool m_statistics{true};
+    // Whether the slice was written by a submitted frame, whether that frame ran the triangle pass
+    // and whether its shaders counted statistics.
+    std::array<bool, Swapchain::MaxFramesInFlight> m_counterPending{};
+    std::array<bool, Swapchain::MaxFramesInFlight> m_counterClusters{};
+    std::array<bool, Swapchain::MaxFramesInFlight> m_counterStatistics{};
+    CullCounters m_lastCounters{};
+    CullStats m_stats{};
+
+public:
+    CullingPass(Device &device, BindlessHeap &bindless, GeometryArena &geometry, IndirectRenderer &renderer);
+    ~CullingPass();
+    CullingPass(CullingPass const &other) = delete;
+    CullingPass &operator=(CullingPass const &other) = delete;
+
+    // Records both passes, must be outside a render pass and after IndirectRenderer::Upload.
+    void Cull(VkCommandBuffer commandBuffer, StreamingBuffer &staging, u32 frameIndex, glm::mat4 const &viewProjection, VkExtent2D viewport);
+    void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout layout);
+
+    void WatchShaders(ShaderHotReload &hotReload);
+
+    void SetTriangleCulling(bool enabled) { m_triangleCulling = enabled; }
+    MUST_USE bool TriangleCulling() const { return m_triangleCulling; }
+    // Switches to the shader variants without statistics, only the draw counts stay valid then.
+    void SetStatistics(bool enabled) { m_statistics = enabled; }
+    MUST_USE bool Statistics() const { return m_statistics; }
+
+    // Counters of the last frame that finished on the GPU.
+    MUST_USE CullCounters const &LastCounters() const { return m_lastCounters; }
+    MUST_USE CullStats TakeStats();
+
+private:
+    void CreateLayout();
+    void ReadCounters(u32 frameIndex);
+    void RebuildClusters(VkCommandBuffer commandBuffer, StreamingBuffer &staging);
+};
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "DeletionQueue.h"
+#include "Logger.h"
+
+DeletionQueue::~DeletionQueue()
+{
+    if (!m_entries.empty()) {
+        WARNF("Deletion queue destroyed with {} pending entries", m_entries.size());
+    }
+}
+
+void DeletionQueue::Push(std::function<void()> destroy)
+{
+    Push(CurrentFrame(), std::move(destroy));
+}
+
+void DeletionQueue::Push(u64 lastUsedFrame, std::function<void()> destroy)
+{
+    std::scoped_lock lock(m_mutex);
+    m_entries.push_back(Entry{.Frame = lastUsedFrame, .Destroy = std::move(destroy)});
+}
+
+void DeletionQueue::BeginFrame(u64 frameNumber, u64 completedFrames)
+{
+    m_currentFrame.store(frameNumber, std::memory_order_release);
+    m_completedFrames.store(completedFrames, std::memory_order_release);
+
+    std::deque<Entry> retired;
+    {
+        std::scoped_lock lock(m_mutex);
+        // Entries are pushed in roughly increasing frame order, an older entry stuck behind a
+        // newer one is only destroyed a little later than necessary.
+        while (!m_entries.empty() && m_entries.front().Frame < completedFrames) {
+            retired.push_back(std::move(m_entries.front()));
+            m_entries.pop_front();
+        }
+    }
+
+    for (auto &entry: retired) {
+        entry.Destroy();
+    }
+    m_destroyed += retired.size();
+}
+
+void DeletionQueue::Flush()
+{
+    std::deque<Entry> retired;
+    {
+        std::scoped_lock lock(m_mutex);
+        retired.swap(m_entries);
+    }
+
+    for (auto &entry: retired) {
+        entry.Destroy();
+    }
+    m_destroyed += retired.size();
+}
+
+u32 DeletionQueue::PendingCount()
+{
+    std::scoped_lock lock(m_mutex);
+    return static_cast<u32>(m_entries.size());
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Defers destruction of GPU objects until every frame that could still reference them has
+// finished on the GPU. Frame numbers are advanced by the swapchain after each fence wait.
+class DeletionQueue {
+    struct Entry {
+        u64 Frame;
+        std::function<void()> Destroy;
+    };
+
+    std::mutex m_mutex;
+    std::deque<Entry> m_entries;
+    std::atomic<u64> m_currentFrame{0};
+    std::atomic<u64> m_completedFrames{0};
+    u64 m_destroyed{0};
+
+public:
+    DeletionQueue() = default;
+    ~DeletionQueue();
+    DeletionQueue(DeletionQueue const &other) = delete;
+    DeletionQueue &operator=(DeletionQueue const &other) = delete;
+
+    // Retire after the frame currently being recorded.
+    void Push(std::function<void()> destroy);
+    // Retire after a specific frame, which may be older than the current one.
+    void Push(u64 lastUsedFrame, std::function<void()> destroy);
+
+    // Called once per frame: `completedFrames` is the number of frames known to be finished
+    // on the GPU, everything retired before it is destroyed.
+    void BeginFrame(u64 frameNumber, u64 completedFrames);
+    // Destroys everything, only valid once the device is idle.
+    void Flush();
+
+    MUST_USE u64 CurrentFrame() const { return m_currentFrame.load(std::memory_order_acquire); }
+    MUST_USE u64 CompletedFrames() const { return m_completedFrames.load(std::memory_order_acquire); }
+    MUST_USE u64 DestroyedCount() const { return m_destroyed; }
+    MUST_USE u32 PendingCount();
+};
@@ -0,0 +1,405 @@
+#include "Descriptors.h"
+#include "Logger.h"
+#include <algorithm>
+#include <vulkan/vk_enum_string_helper.h>
+
+static void HashCombine(u64 &seed, u64 value)
+{
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+bool DescriptorLayoutInfo::operator==(const DescriptorLayoutInfo &other) const
+{
+    if (Flags != other.Flags || Bindings.size() != other.Bindings.size() || BindingFlags != other.BindingFlags) {
+        return false;
+    }
+    for (u32 i = 0; i < Bindings.size(); i++) {
+        auto const &a = Bindings[i];
+        auto const &b = other.Bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+            a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags ||
+            a.pImmutableSamplers != b.pImmutableSamplers) {
+            return false;
+        }
+    }
+    return true;
+}
+
+u64 DescriptorLayoutInfo::Hash() const
+{
+    u64 hash = Bindings.size();
+    HashCombine(hash, Flags);
+    for (auto const &binding: Bindings) {
+        HashCombine(hash, binding.binding);
+        HashCombine(hash, binding.descriptorType);
+        HashCombine(hash, binding.descriptorCount);
+        HashCombine(hash, binding.stageFlags);
+    }
+    for (auto flags: BindingFlags) {
+        HashCombine(hash, flags);
+    }
+    return hash;
+}
+
+DescriptorLayoutCache::DescriptorLayoutCache(Device &device) : m_device(device)
+{
+}
+
+DescriptorLayoutCache::~DescriptorLayoutCache()
+{
+    for (auto &[info, layout]: m_layouts) {
+        vkDestroyDescriptorSetLayout(m_device.LogicalDevice(), layout, m_device.HostCallbacks());
+    }
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::Get(DescriptorLayoutInfo info)
+{
+    // Binding order must not affect the key.
+    std::vector<u32> order(info.Bindings.size());
+    for (u32 i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) { return info.Bindings[a].binding < info.Bindings[b].binding; });
+
+    DescriptorLayoutInfo sorted{.Flags = info.Flags};
+    for (auto index: order) {
+        sorted.Bindings.push_back(info.Bindings[index]);
+        if (!info.BindingFlags.empty()) {
+            sorted.BindingFlags.push_back(info.BindingFlags[index]);
+        }
+    }
+
+    std::scoped_lock lock(m_mutex);
+    if (auto it = m_layouts.find(sorted); it != m_layouts.end()) {
+        return it->second;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = static_cast<u32>(sorted.BindingFlags.size()),
+            .pBindingFlags = sorted.BindingFlags.data(),
+    };
+
+    VkDescriptorSetLayoutCreateInfo createInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = sorted.BindingFlags.empty() ? nullptr : &flagsInfo,
+            .flags = sorted.Flags,
+            .bindingCount = static_cast<u32>(sorted.Bindings.size()),
+            .pBindings = sorted.Bindings.data(),
+    };
+
+    VkDescriptorSetLayout layout{};
+    auto result = vkCreateDescriptorSetLayout(m_device.LogicalDevice(), &createInfo, m_device.HostCallbacks(), &layout);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create descriptor set layout: {}", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+    DEBUGF("Created descriptor set layout with {} bindings (hash {:016x})", sorted.Bindings.size(), sorted.Hash());
+
+    m_layouts.emplace(std::move(sorted), layout);
+    return layout;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::Get(std::span<VkDescriptorSetLayoutBinding const> bindings)
+{
+    return Get(DescriptorLayoutInfo{.Bindings = {bindings.begin(), bindings.end()}});
+}
+
+DescriptorAllocator::DescriptorAllocator(Device &device) : m_device(device)
+{
+}
+
+DescriptorAllocator::DescriptorAllocator(DescriptorAllocator &&other) noexcept
+    : m_device(other.m_device),
+      m_readyPools(std::move(other.m_readyPools)),
+      m_fullPools(std::move(other.m_fullPools)),
+      m_setsPerPool(other.m_setsPerPool),
+      m_allocatedSets(other.m_allocatedSets)
+{
+    other.m_readyPools.clear();
+    other.m_fullPools.clear();
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    for (auto pool: m_readyPools) {
+        vkDestroyDescriptorPool(m_device.LogicalDevice(), pool, m_device.HostCallbacks());
+    }
+    for (auto pool: m_fullPools) {
+        vkDestroyDescriptorPool(m_device.LogicalDevice(), pool, m_device.HostCallbacks());
+    }
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+    auto pool = GrabPool();
+
+    VkDescriptorSetAllocateInfo allocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout,
+    };
+
+    VkDescriptorSet set{};
+    auto result = vkAllocateDescriptorSets(m_device.LogicalDevice(), &allocateInfo, &set);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        m_fullPools.push_back(pool);
+        m_readyPools.pop_back();
+
+        allocateInfo.descriptorPool = GrabPool();
+        result = vkAllocateDescriptorSets(m_device.LogicalDevice(), &allocateInfo, &set);
+    }
+
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to allocate descriptor set: {}", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+    m_allocatedSets++;
+    return set;
+}
+
+void DescriptorAllocator::Reset()
+{
+    for (auto pool: m_readyPools) {
+        vkResetDescriptorPool(m_device.LogicalDevice(), pool, 0);
+    }
+    for (auto pool: m_fullPools) {
+        vkResetDescriptorPool(m_device.LogicalDevice(), pool, 0);
+        m_readyPools.push_back(pool);
+    }
+    m_fullPools.clear();
+    m_allocatedSets = 0;
+}
+
+VkDescriptorPool DescriptorAllocator::GrabPool()
+{
+    if (m_readyPools.empty()) {
+        m_readyPools.push_back(CreatePool(m_setsPerPool));
+        m_setsPerPool = std::min<u32>(m_setsPerPool * 3 / 2, 4096);
+    }
+    return m_readyPools.back();
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePool(u32 setCount)
+{
+    static constexpr PoolRatio Ratios[] = {
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+    };
+
+    VkDescriptorPoolSize sizes[std::size(Ratios)];
+    for (u32 i = 0; i < std::size(Ratios); i++) {
+        sizes[i] = VkDescriptorPoolSize{
+                .type = Ratios[i].Type,
+                .descriptorCount = static_cast<u32>(Ratios[i].Ratio * static_cast<f32>(setCount)),
+        };
+    }
+
+    VkDescriptorPoolCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = setCount,
+            .poolSizeCount = static_cast<u32>(std::size(sizes)),
+            .pPoolSizes = sizes,
+    };
+
+    VkDescriptorPool pool{};
+    auto result = vkCreateDescriptorPool(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &pool);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create descriptor pool: {}", string_VkResult(result));
+    }
+    return pool;
+}
+
+DescriptorWriter &DescriptorWriter::WriteBuffer(u32 binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, u32 arrayElement)
+{
+    auto &info = m_bufferInfos.emplace_back(VkDescriptorBufferInfo{.buffer = buffer, .offset = offset, .range = range});
+    m_writes.push_back(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstBinding = binding,
+            .dstArrayElement = arrayElement,
+            .descriptorCount = 1,
+            .descriptorType = type,
+            .pBufferInfo = &info,
+    });
+    return *this;
+}
+
+DescriptorWriter &DescriptorWriter::WriteImage(u32 binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout, u32 arrayElement)
+{
+    auto &info = m_imageInfos.emplace_back(VkDescriptorImageInfo{.sampler = sampler, .imageView = view, .imageLayout = layout});
+    m_writes.push_back(VkWriteDescriptorSet{
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstBinding = binding,
+            .dstArrayElement = arrayElement,
+            .descriptorCount = 1,
+            .descriptorType = type,
+            .pImageInfo = &info,
+    });
+    return *this;
+}
+
+u32 DescriptorWriter::Update(VkDevice device, VkDescriptorSet set)
+{
+    for (auto &write: m_writes) {
+        write.dstSet = set;
+    }
+
+    auto count = static_cast<u32>(m_writes.size());
+    vkUpdateDescriptorSets(device, count, m_writes.data(), 0, nullptr);
+    Clear();
+    return count;
+}
+
+void DescriptorWriter::Clear()
+{
+    m_bufferInfos.clear();
+    m_imageInfos.clear();
+    m_writes.clear();
+}
+
+u32 BindlessHeap::IndexList::Acquire(u64 completedFrames)
+{
+    while (!Retiring.empty() && Retiring.front().Frame < completedFrames) {
+        Free.push_back(Retiring.front().Index);
+        Retiring.pop_front();
+    }
+    if (!Free.empty()) {
+        auto index = Free.back();
+        Free.pop_back();
+        return index;
+    }
+    if (Next >= Capacity) {
+        return InvalidIndex;
+    }
+    return Next++;
+}
+
+void BindlessHeap::IndexList::Release(u32 index, u64 lastUsedFrame)
+{
+    if (index < Next) {
+        Retiring.push_back(Retired{.Index = index, .Frame = lastUsedFrame});
+    }
+}
+
+BindlessHeap::BindlessHeap(Device &device, DescriptorLayoutCache &layoutCache, u32 maxBuffers, u32 maxImages) : m_device(device)
+{
+    VkPhysicalDeviceVulkan12Properties properties12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES,
+    };
+    VkPhysicalDeviceProperties2 properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &properties12,
+    };
+    vkGetPhysicalDeviceProperties2(m_device.PhysicalDevice(), &properties);
+
+    m_buffers.Capacity = std::min(maxBuffers, properties12.maxDescriptorSetUpdateAfterBindStorageBuffers);
+    m_images.Capacity = std::min(maxImages, properties12.maxDescriptorSetUpdateAfterBindSampledImages);
+
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    m_layout = layoutCache.Get(DescriptorLayoutInfo{
+            .Bindings = {
+                    VkDescriptorSetLayoutBinding{
+                            .binding = StorageBufferBinding,
+                            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                            .descriptorCount = m_buffers.Capacity,
+                            .stageFlags = VK_SHADER_STAGE_ALL,
+                    },
+                    VkDescriptorSetLayoutBinding{
+                            .binding = SampledImageBinding,
+                            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                            .descriptorCount = m_images.Capacity,
+                            .stageFlags = VK_SHADER_STAGE_ALL,
+                    },
+            },
+            .BindingFlags = {bindingFlags, bindingFlags},
+            .Flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+    });
+
+    VkDescriptorPoolSize sizes[] = {
+            {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = m_buffers.Capacity},
+            {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = m_images.Capacity},
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets = 1,
+            .poolSizeCount = 2,
+            .pPoolSizes = sizes,
+    };
+
+    auto result = vkCreateDescriptorPool(m_device.LogicalDevice(), &poolInfo, m_device.HostCallbacks(), &m_pool);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create bindless descriptor pool: {}", string_VkResult(result));
+        return;
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = m_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &m_layout,
+    };
+
+    result = vkAllocateDescriptorSets(m_device.LogicalDevice(), &allocateInfo, &m_set);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to allocate bindless descriptor set: {}", string_VkResult(result));
+    }
+    INFOF("Created bindless heap: {} buffers, {} images", m_buffers.Capacity, m_images.Capacity);
+}
+
+BindlessHeap::~BindlessHeap()
+{
+    vkDestroyDescriptorPool(m_device.LogicalDevice(), m_pool, m_device.HostCallbacks());
+}
+
+u32 BindlessHeap::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    std::scoped_lock lock(m_mutex);
+    auto index = m_buffers.Acquire(m_device.Deletion().CompletedFrames());
+    if (index == InvalidIndex) {
+        ERROR("Bindless heap is out of buffer slots");
+        return InvalidIndex;
+    }
+
+    DescriptorWriter writer;
+    writer.WriteBuffer(StorageBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer, offset, range, index);
+    m_device.Stats().Add(RenderCounter::DescriptorWrites, writer.Update(m_device.LogicalDevice(), m_set));
+    return index;
+}
+
+u32 BindlessHeap::RegisterImage(VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+    std::scoped_lock lock(m_mutex);
+    auto index = m_images.Acquire(m_device.Deletion().CompletedFrames());
+    if (index == InvalidIndex) {
+        ERROR("Bindless heap is out of image slots");
+        return InvalidIndex;
+    }
+
+    DescriptorWriter writer;
+    writer.WriteImage(SampledImageBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, view, sampler, layout, index);
+    m_device.Stats().Add(RenderCounter::DescriptorWrites, writer.Update(m_device.LogicalDevice(), m_set));
+    return index;
+}
+
+void BindlessHeap::ReleaseBuffer(u32 index)
+{
+    // Partially bound arrays let the stale descriptor stay until the slot is reused.
+    std::scoped_lock lock(m_mutex);
+    m_buffers.Release(index, m_device.Deletion().CurrentFrame());
+}
+
+void BindlessHeap::ReleaseImage(u32 index)
+{
+    std::scoped_lock lock(m_mutex);
+    m_images.Release(index, m_device.Deletion().CurrentFrame());
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "Types.h"
+#include <deque>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct DescriptorLayoutInfo {
+    std::vector<VkDescriptorSetLayoutBinding> Bindings;
+    // Either empty or one entry per binding.
+    std::vector<VkDescriptorBindingFlags> BindingFlags;
+    VkDescriptorSetLayoutCreateFlags Flags{};
+
+    MUST_USE bool operator==(DescriptorLayoutInfo const &other) const;
+    MUST_USE u64 Hash() const;
+};
+
+// Owns every descriptor set layout in the engine. Identical binding lists share a layout.
+class DescriptorLayoutCache {
+    struct InfoHash {
+        size_t operator()(DescriptorLayoutInfo const &info) const { return static_cast<size_t>(info.Hash()); }
+    };
+
+    Device &m_device;
+    std::mutex m_mutex;
+    std::unordered_map<DescriptorLayoutInfo, VkDescriptorSetLayout, InfoHash> m_layouts;
+
+public:
+    explicit DescriptorLayoutCache(Device &device);
+    ~DescriptorLayoutCache();
+    DescriptorLayoutCache(DescriptorLayoutCache const &other) = delete;
+    DescriptorLayoutCache &operator=(DescriptorLayoutCache const &other) = delete;
+
+    MUST_USE VkDescriptorSetLayout Get(DescriptorLayoutInfo info);
+    MUST_USE VkDescriptorSetLayout Get(std::span<VkDescriptorSetLayoutBinding const> bindings);
+    MUST_USE u32 Size() const { return static_cast<u32>(m_layouts.size()); }
+};
+
+// Hands out descriptor sets from a list of pools that grows when a pool runs out.
+// Sets are never freed one by one, Reset recycles all pools at once. Keep one per frame in flight.
+class DescriptorAllocator {
+    struct PoolRatio {
+        VkDescriptorType Type;
+        f32 Ratio;
+    };
+
+    Device &m_device;
+    std::vector<VkDescriptorPool> m_readyPools;
+    std::vector<VkDescriptorPool> m_fullPools;
+    u32 m_setsPerPool{64};
+    u32 m_allocatedSets{0};
+
+public:
+    explicit DescriptorAllocator(Device &device);
+    ~DescriptorAllocator();
+    DescriptorAllocator(DescriptorAllocator &&other) noexcept;
+    DescriptorAllocator(DescriptorAllocator const &other) = delete;
+    DescriptorAllocator &operator=(DescriptorAllocator const &other) = delete;
+
+    MUST_USE VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+    void Reset();
+
+    MUST_USE u32 PoolCount() const { return static_cast<u32>(m_readyPools.size() + m_fullPools.size()); }
+    MUST_USE u32 AllocatedSets() const { return m_allocatedSets; }
+
+private:
+    MUST_USE VkDescriptorPool GrabPool();
+    MUST_USE VkDescriptorPool CreatePool(u32 setCount);
+};
+
+// Batches descriptor writes so a set is updated with a single vkUpdateDescriptorSets call.
+class DescriptorWriter {
+    // Deques keep the infos at stable addresses while writes are queued.
+    std::deque<VkDescriptorBufferInfo> m_bufferInfos;
+    std::deque<VkDescriptorImageInfo> m_imageInfos;
+    std::vector<VkWriteDescriptorSet> m_writes;
+
+public:
+    DescriptorWriter &WriteBuffer(u32 binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, u32 arrayElement = 0);
+    DescriptorWriter &WriteImage(u32 binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout, u32 arrayElement = 0);
+
+    u32 Update(VkDevice device, VkDescriptorSet set);
+    void Clear();
+};
+
+// One global set with large, partially bound arrays of buffers and textures. Resources are
+// registered once and addressed by index from shaders, so draws don't bind anything.
+class BindlessHeap {
+public:
+    static constexpr u32 StorageBufferBinding = 0;
+    static constexpr u32 SampledImageBinding = 1;
+    static constexpr u32 InvalidIndex = ~0u;
+
+    BindlessHeap(Device &device, DescriptorLayoutCache &layoutCache, u32 maxBuffers = 16384, u32 maxImages = 16384);
+    ~BindlessHeap();
+    BindlessHeap(BindlessHeap const &other) = delete;
+    BindlessHeap &operator=(BindlessHeap const &other) = delete;
+
+    MUST_USE u32 RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+    MUST_USE u32 RegisterImage(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // The slot is only reused once the frames recorded so far completed, pending work may still
+    // read the old descriptor.
+    void ReleaseBuffer(u32 index);
+    void ReleaseImage(u32 index);
+
+    MUST_USE VkDescriptorSetLayout Layout() const { return m_layout; }
+    MUST_USE VkDescriptorSet Set() const { return m_set; }
+
+private:
+    // Released slots wait out the frames that may still index them, the same rule the
+    // deletion queue applies, before a new descriptor is written over them.
+    struct IndexList {
+        struct Retired {
+            u32 Index;
+            u64 Frame;
+        };
+
+        u32 Capacity{};
+        u32 Next{};
+        std::vector<u32> Free;
+        std::deque<Retired> Retiring;
+
+        MUST_USE u32 Acquire(u64 completedFrames);
+        void Release(u32 index, u64 lastUsedFrame);
+    };
+
+    Device &m_device;
+    VkDescriptorSetLayout m_layout{};
+    VkDescriptorPool m_pool{};
+    VkDescriptorSet m_set{};
+
+    std::mutex m_mutex;
+    IndexList m_buffers;
+    IndexList m_images;
+};
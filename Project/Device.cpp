@@ -1,26 +1,54 @@
 #include "Device.h"
 #include "Logger.h"
+#include "StartupTimer.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <vulkan/vk_enum_string_helper.h>
 
 #define VALIDATION_LAYERS
 const char *g_RequiredDeviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+// Relative to the working directory, like the shader paths.
+static constexpr char const *PipelineCacheFile = "PipelineCache.bin";
 
-std::vector<const char *> GetRequiredExtensions() {
-    u32 count;
+Slice<const char *> GetRequiredExtensions(LinearArena &arena) {
+    u32 count = 0;
     auto required_extensions = glfwGetRequiredInstanceExtensions(&count);
     if (required_extensions == nullptr) {
         ERROR("Call to glfwGetRequiredInstanceExtensions failed");
     }
-    std::vector<const char *> retval(count);
-    for (i32 i = 0; i < count; i++) {
+    auto retval = arena.Allocate<const char *>(count + 1);
+    for (u32 i = 0; i < count; i++) {
         retval[i] = required_extensions[i];
     }
 
-    retval.emplace_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    retval.Last() = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
     return retval;
 }
 
+// Fills an arena slice through one of the two-call enumerate functions.
+template<typename T, typename Enumerate>
+Slice<T> EnumerateInto(LinearArena &arena, Enumerate const &enumerate) {
+    u32 count = 0;
+    enumerate(&count, nullptr);
+    auto values = arena.Allocate<T>(count);
+    enumerate(&count, values.Data());
+    return values.SubSlice(0, count);
+}
+
+bool HasDeviceExtension(VkPhysicalDevice device, char const *name) {
+    ScratchScope scratch;
+    auto extensionProperties = EnumerateInto<VkExtensionProperties>(scratch.Arena(), [&](u32 *count, VkExtensionProperties *properties) {
+        vkEnumerateDeviceExtensionProperties(device, nullptr, count, properties);
+    });
+
+    return std::any_of(extensionProperties.begin(), extensionProperties.end(), [&](VkExtensionProperties const &property) {
+        return strcmp(name, property.extensionName) == 0;
+    });
+}
+
 VkBool32 callback(
         VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
         VkDebugUtilsMessageTypeFlagsEXT messageTypes,
@@ -46,37 +74,96 @@ VkBool32 callback(
 }
 
 Device::Device(Window &window) : m_window(window) {
-    CreateInstance();
-    SetupDebugCallback();
-    CreateWindowSurface();
-    PickPhysicalDevice();
-    m_familyIndices = GetQueueFamilies(m_physicalDevice);
-    CreateLogicalDevice();
-    CreateCommandPool();
+    auto &timer = StartupTimer::Get();
+    auto phase = timer.Measure("Device");
+    // Only needs the file system, it is read while the instance and device come up.
+    m_pipelineCacheData = std::async(std::launch::async, [&timer] {
+        auto read = timer.Measure("Pipeline cache file read");
+        std::ifstream file(PipelineCacheFile, std::ios::binary);
+        return std::vector<u8>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    });
+
+    {
+        auto instance = timer.Measure("Instance");
+        CreateInstance();
+    }
+    {
+        auto messenger = timer.Measure("Debug messenger");
+        SetupDebugCallback();
+    }
+    {
+        auto surface = timer.Measure("Surface");
+        CreateWindowSurface();
+    }
+    {
+        auto physical = timer.Measure("Physical device");
+        PickPhysicalDevice();
+        m_familyIndices = GetQueueFamilies(m_physicalDevice);
+    }
+    {
+        auto logical = timer.Measure("Logical device");
+        CreateLogicalDevice();
+    }
+    {
+        auto pools = timer.Measure("Command pools");
+        CreateCommandPool();
+    }
+    {
+        auto cache = timer.Measure("Pipeline cache");
+        CreatePipelineCache();
+    }
+    CreateTimelines();
 }
 
 Device::~Device() {
-    vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
-    vkDestroyDevice(m_logicalDevice, nullptr);
+    vkDeviceWaitIdle(m_logicalDevice);
+    ReclaimUploads();
+    m_deletionQueue.Flush();
+    m_hostAllocator.LogSummary();
+    SavePipelineCache();
+
+    for (auto timeline: m_timelines) {
+        vkDestroySemaphore(m_logicalDevice, timeline, HostCallbacks());
+    }
+    vkDestroyPipelineCache(m_logicalDevice, m_pipelineCache, HostCallbacks());
+    vkDestroyCommandPool(m_logicalDevice, m_transferPool, HostCallbacks());
+    vkDestroyCommandPool(m_logicalDevice, m_uploadPool, HostCallbacks());
+    vkDestroyCommandPool(m_logicalDevice, m_commandPool, HostCallbacks());
+    vkDestroyDevice(m_logicalDevice, HostCallbacks());
 
 #ifdef VALIDATION_LAYERS
     auto DestroyDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkDestroyDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(m_vkInstance, "vkDestroyDebugUtilsMessengerEXT"));
-    DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, nullptr);
+    DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, HostCallbacks());
 #endif
 
-    vkDestroySurfaceKHR(m_vkInstance, m_surface, nullptr);
-    vkDestroyInstance(m_vkInstance, nullptr);
+    vkDestroySurfaceKHR(m_vkInstance, m_surface, HostCallbacks());
+    vkDestroyInstance(m_vkInstance, HostCallbacks());
+    if (auto leaked = m_hostAllocator.LiveBytes(); leaked > 0) {
+        WARNF("{} bytes of driver host memory are still live after destroying the instance", leaked);
+    }
 }
 
-Device::Buffer Device::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+Device::Buffer Device::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, std::span<u32 const> sharedFamilies)
 {
     Buffer buffer{};
 
+    ScratchScope scratch;
+    auto families = scratch.Allocate<u32>(static_cast<u32>(sharedFamilies.size()));
+    u32 familyCount = 0;
+    for (auto family: sharedFamilies) {
+        if (std::find(families.begin(), families.begin() + familyCount, family) == families.begin() + familyCount) {
+            families[familyCount++] = family;
+        }
+    }
+    bool concurrent = familyCount > 1;
+
     VkBufferCreateInfo info {
             .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
             .size = size,
             .usage = usage,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = concurrent ? familyCount : 0u,
+            .pQueueFamilyIndices = concurrent ? families.Data() : nullptr,
     };
 
     auto result = vkCreateBuffer(m_logicalDevice, &info, nullptr, &buffer.Buffer);
@@ -104,7 +191,7 @@ Device::Buffer Device::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
             .memoryTypeIndex = memoryTypeIndex,
     };
 
-    result = vkAllocateMemory(m_logicalDevice, &allocateInfo, nullptr, &buffer.Memory);
+    result = m_memory.Allocate(m_logicalDevice, allocateInfo, BufferCategory(usage), &buffer.Memory);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to allocate buffer memory: {}", string_VkResult(result));
     }
@@ -126,14 +213,15 @@ void Device::CreateInstance() {
             .apiVersion = VK_API_VERSION_1_3,
     };
 
-    auto extensions = GetRequiredExtensions();
+    ScratchScope scratch;
+    auto extensions = GetRequiredExtensions(scratch.Arena());
 
     VkInstanceCreateInfo InstanceCreateInfo{
             .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
             .pApplicationInfo = &ApplicationInfo,
             .enabledLayerCount = 0,
-            .enabledExtensionCount = static_cast<u32>(extensions.size()),
-            .ppEnabledExtensionNames = extensions.data(),
+            .enabledExtensionCount = extensions.Length(),
+            .ppEnabledExtensionNames = extensions.Data(),
     };
 
 #ifdef VALIDATION_LAYERS
@@ -157,7 +245,7 @@ void Device::CreateInstance() {
 #endif
 
     INFO("Creating Vulkan instance");
-    if (vkCreateInstance(&InstanceCreateInfo, nullptr, &m_vkInstance) != VK_SUCCESS) {
+    if (vkCreateInstance(&InstanceCreateInfo, HostCallbacks(), &m_vkInstance) != VK_SUCCESS) {
         FATAL("Failed to create Vulkan instance");
     }
     INFO("Vulkan instance created!");
@@ -177,33 +265,30 @@ void Device::SetupDebugCallback() {
     };
 
     auto CreateDebugUtilsMessengerEXT = reinterpret_cast<PFN_vkCreateDebugUtilsMessengerEXT>(vkGetInstanceProcAddr(m_vkInstance, "vkCreateDebugUtilsMessengerEXT"));
-    auto result = CreateDebugUtilsMessengerEXT(m_vkInstance, &debugUtilsMessengerCreateInfoExt, nullptr, &m_debugMessenger);
+    auto result = CreateDebugUtilsMessengerEXT(m_vkInstance, &debugUtilsMessengerCreateInfoExt, HostCallbacks(), &m_debugMessenger);
     if (result != VK_SUCCESS) {
         ERROR("Failed to create debug messenger");
     }
 }
 
 void Device::CreateWindowSurface() {
-    auto result = glfwCreateWindowSurface(m_vkInstance, m_window.NativeHandle(), nullptr, &m_surface);
+    auto result = glfwCreateWindowSurface(m_vkInstance, m_window.NativeHandle(), HostCallbacks(), &m_surface);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to create window surface: {}", static_cast<int>(result));
     }
 }
 
 void Device::PickPhysicalDevice() {
-    u32 count;
-    vkEnumeratePhysicalDevices(m_vkInstance, &count, nullptr);
-
-    std::vector<VkPhysicalDevice> physicalDevices;
-    physicalDevices.resize(count);
-
-    vkEnumeratePhysicalDevices(m_vkInstance, &count, physicalDevices.data());
+    ScratchScope scratch;
+    auto physicalDevices = EnumerateInto<VkPhysicalDevice>(scratch.Arena(), [&](u32 *count, VkPhysicalDevice *devices) {
+        vkEnumeratePhysicalDevices(m_vkInstance, count, devices);
+    });
 
     for (auto device: physicalDevices) {
         if (IsDeviceSuitable(device)) {
             m_physicalDevice = device;
-            VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(device, &properties);
+            vkGetPhysicalDeviceProperties(device, &m_properties);
+            auto const &properties = m_properties;
 
             INFOF("Selected GPU: {}",  properties.deviceName);
             INFOF("\tDriver version: {}.{}.{}", VK_VERSION_MAJOR(properties.driverVersion), VK_VERSION_MINOR(properties.driverVersion), VK_VERSION_PATCH(properties.driverVersion));
@@ -214,36 +299,160 @@ void Device::PickPhysicalDevice() {
 }
 
 void Device::CreateLogicalDevice() {
-    auto uniqueFamilies = m_familyIndices.GetUniqueIndex();
+    ScratchScope scratch;
+    auto uniqueFamilies = m_familyIndices.GetUniqueIndex(scratch.Arena());
+    auto queueInfos = scratch.Allocate<VkDeviceQueueCreateInfo>(uniqueFamilies.Length());
 
-    std::vector<VkDeviceQueueCreateInfo> queueInfos{};
-
-    for (auto &family: uniqueFamilies) {
-        f32 queuePriority[]{1.0f};
-        queueInfos.emplace_back(VkDeviceQueueCreateInfo{
+    static constexpr f32 queuePriority[]{1.0f};
+    for (u32 i = 0; i < uniqueFamilies.Length(); i++) {
+        queueInfos[i] = VkDeviceQueueCreateInfo{
                 .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                .queueFamilyIndex = family,
+                .queueFamilyIndex = uniqueFamilies[i],
                 .queueCount = 1,
                 .pQueuePriorities = queuePriority,
-        });
+        };
     }
 
+    // Mesh shading is optional, only ask for its features when the extension is there at all.
+    bool hasMeshShaderExtension = HasDeviceExtension(m_physicalDevice, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    VkPhysicalDeviceMeshShaderFeaturesEXT supportedMesh{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT,
+    };
+    VkPhysicalDeviceVulkan13Features supported13{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+            .pNext = hasMeshShaderExtension ? &supportedMesh : nullptr,
+    };
+    VkPhysicalDeviceVulkan12Features supported12{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    };
+    bool hasVulkan13 = m_properties.apiVersion >= VK_API_VERSION_1_3;
+    if (hasVulkan13) {
+        supported12.pNext = &supported13;
+    } else if (hasMeshShaderExtension) {
+        supported12.pNext = &supportedMesh;
+    }
+    VkPhysicalDeviceFeatures2 supported{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &supported12,
+    };
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supported);
+    SelectFeatures(supported.features, supported12, supported13, supportedMesh);
+
+    constexpr u32 requiredCount = std::size(g_RequiredDeviceExtensions);
+    char const *extensions[requiredCount + 2];
+    std::copy(std::begin(g_RequiredDeviceExtensions), std::end(g_RequiredDeviceExtensions), extensions);
+    u32 extensionCount = requiredCount;
+    void *featureTail = nullptr;
+    m_memoryBudgetSupported = HasDeviceExtension(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_memoryBudgetSupported) {
+        extensions[extensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+    if (m_meshShaderSupported) {
+        extensions[extensionCount++] = VK_EXT_MESH_SHADER_EXTENSION_NAME;
+        m_enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+        featureTail = &m_enabledMeshShaderFeatures;
+    }
+
+    m_enabledFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    m_enabledFeatures13.pNext = featureTail;
+    m_enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    m_enabledFeatures12.pNext = hasVulkan13 ? &m_enabledFeatures13 : featureTail;
+    m_enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    m_enabledFeatures.pNext = &m_enabledFeatures12;
+
     VkDeviceCreateInfo deviceCreateInfo{
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .queueCreateInfoCount = static_cast<u32>(queueInfos.size()),
-            .pQueueCreateInfos = queueInfos.data(),
-            .enabledExtensionCount = 1,
-            .ppEnabledExtensionNames = g_RequiredDeviceExtensions,
+            .pNext = &m_enabledFeatures,
+            .queueCreateInfoCount = queueInfos.Length(),
+            .pQueueCreateInfos = queueInfos.Data(),
+            .enabledExtensionCount = extensionCount,
+            .ppEnabledExtensionNames = extensions,
             .pEnabledFeatures = nullptr,
     };
 
-    auto result = vkCreateDevice(m_physicalDevice, &deviceCreateInfo, nullptr, &m_logicalDevice);
+    auto result = vkCreateDevice(m_physicalDevice, &deviceCreateInfo, HostCallbacks(), &m_logicalDevice);
     if (result != VK_SUCCESS) {
         ERROR("Failed to create logical device");
     }
+    m_memory.Initialize(m_physicalDevice, m_memoryBudgetSupported, HostCallbacks());
 
     vkGetDeviceQueue(m_logicalDevice, *m_familyIndices.GraphicsFamily, 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_logicalDevice, *m_familyIndices.PresentFamily, 0, &m_presentQueue);
+    vkGetDeviceQueue(m_logicalDevice, QueueFamily(QueueType::Compute), 0, &m_computeQueue);
+    vkGetDeviceQueue(m_logicalDevice, QueueFamily(QueueType::Transfer), 0, &m_transferQueue);
+    INFOF("Queue families: graphics {}, present {}, compute {}{}, transfer {}{}",
+          *m_familyIndices.GraphicsFamily, *m_familyIndices.PresentFamily,
+          QueueFamily(QueueType::Compute), HasDedicatedQueue(QueueType::Compute) ? "" : " (shared with graphics)",
+          QueueFamily(QueueType::Transfer), HasDedicatedQueue(QueueType::Transfer) ? "" : " (shared with graphics)");
+
+    if (m_meshShaderSupported) {
+        m_drawMeshTasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(m_logicalDevice, "vkCmdDrawMeshTasksEXT"));
+        m_meshShaderSupported = m_drawMeshTasks != nullptr;
+    }
+}
+
+void Device::SelectFeatures(VkPhysicalDeviceFeatures const &supported, VkPhysicalDeviceVulkan12Features const &supported12, VkPhysicalDeviceVulkan13Features const &supported13, VkPhysicalDeviceMeshShaderFeaturesEXT const &supportedMesh) {
+    m_bindlessSupported = supported12.descriptorIndexing &&
+                          supported12.runtimeDescriptorArray &&
+                          supported12.descriptorBindingPartiallyBound &&
+                          supported12.descriptorBindingStorageBufferUpdateAfterBind &&
+                          supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                          supported12.descriptorBindingUpdateUnusedWhilePending &&
+                          supported12.shaderStorageBufferArrayNonUniformIndexing &&
+                          supported12.shaderSampledImageArrayNonUniformIndexing;
+    if (m_bindlessSupported) {
+        m_enabledFeatures12.descriptorIndexing = true;
+        m_enabledFeatures12.runtimeDescriptorArray = true;
+        m_enabledFeatures12.descriptorBindingPartiallyBound = true;
+        m_enabledFeatures12.descriptorBindingStorageBufferUpdateAfterBind = true;
+        m_enabledFeatures12.descriptorBindingSampledImageUpdateAfterBind = true;
+        m_enabledFeatures12.descriptorBindingUpdateUnusedWhilePending = true;
+        m_enabledFeatures12.shaderStorageBufferArrayNonUniformIndexing = true;
+        m_enabledFeatures12.shaderSampledImageArrayNonUniformIndexing = true;
+    } else {
+        WARN("Descriptor indexing not supported, bindless resources are disabled");
+    }
+
+    m_gpuDrivenSupported = supported.multiDrawIndirect && supported.drawIndirectFirstInstance && supported12.drawIndirectCount;
+    if (m_gpuDrivenSupported) {
+        m_enabledFeatures.features.multiDrawIndirect = true;
+        m_enabledFeatures.features.drawIndirectFirstInstance = true;
+        m_enabledFeatures12.drawIndirectCount = true;
+    } else {
+        WARN("Indirect count draws not supported, GPU-driven rendering is disabled");
+    }
+
+    m_dynamicRenderingSupported = supported13.dynamicRendering && supported13.synchronization2;
+    if (m_dynamicRenderingSupported) {
+        m_enabledFeatures13.dynamicRendering = true;
+        m_enabledFeatures13.synchronization2 = true;
+    } else {
+        WARN("Dynamic rendering or synchronization2 not supported, the render graph is disabled");
+    }
+
+    m_timelineSupported = supported12.timelineSemaphore;
+    if (m_timelineSupported) {
+        m_enabledFeatures12.timelineSemaphore = true;
+    } else {
+        WARN("Timeline semaphores not supported, waiting on queue work idles the queue instead");
+    }
+
+    m_pipelineStatisticsSupported = supported.pipelineStatisticsQuery;
+    if (m_pipelineStatisticsSupported) {
+        m_enabledFeatures.features.pipelineStatisticsQuery = true;
+    } else {
+        WARN("Pipeline statistics queries not supported, only CPU side render stats are gathered");
+    }
+
+    m_meshShaderSupported = supportedMesh.taskShader && supportedMesh.meshShader;
+    if (m_meshShaderSupported) {
+        m_enabledMeshShaderFeatures.taskShader = true;
+        m_enabledMeshShaderFeatures.meshShader = true;
+        m_meshShaderQueriesSupported = m_pipelineStatisticsSupported && supportedMesh.meshShaderQueries;
+        m_enabledMeshShaderFeatures.meshShaderQueries = m_meshShaderQueriesSupported;
+    } else {
+        WARN("VK_EXT_mesh_shader not supported, meshlets fall back to the vertex pipeline");
+    }
 }
 
 void Device::CreateCommandPool() {
@@ -253,24 +462,372 @@ void Device::CreateCommandPool() {
             .queueFamilyIndex = *m_familyIndices.GraphicsFamily,
     };
 
-    auto result = vkCreateCommandPool(m_logicalDevice, &commandPoolCreateInfo, nullptr, &m_commandPool);
+    auto result = vkCreateCommandPool(m_logicalDevice, &commandPoolCreateInfo, HostCallbacks(), &m_commandPool);
     if (result != VK_SUCCESS) {
         ERROR("Failed to create command pool");
     }
+
+    // Separate pool so uploads from other threads never touch the render thread's pool.
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    result = vkCreateCommandPool(m_logicalDevice, &commandPoolCreateInfo, HostCallbacks(), &m_uploadPool);
+    if (result != VK_SUCCESS) {
+        ERROR("Failed to create upload command pool");
+    }
+
+    if (HasDedicatedQueue(QueueType::Transfer)) {
+        commandPoolCreateInfo.queueFamilyIndex = QueueFamily(QueueType::Transfer);
+        result = vkCreateCommandPool(m_logicalDevice, &commandPoolCreateInfo, HostCallbacks(), &m_transferPool);
+        if (result != VK_SUCCESS) {
+            ERROR("Failed to create transfer command pool");
+        }
+    }
 }
 
-bool CheckDeviceExtensionSupport(VkPhysicalDevice device) {
-    u32 count;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+void Device::CreatePipelineCache() {
+    // Data of another driver or device would be ignored anyway, it is dropped before handing
+    // it over so the log says why every pipeline gets compiled from scratch.
+    auto data = m_pipelineCacheData.get();
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() >= sizeof(header)) {
+        std::memcpy(&header, data.data(), sizeof(header));
+    }
+    bool matches = header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                   header.vendorID == m_properties.vendorID &&
+                   header.deviceID == m_properties.deviceID &&
+                   std::memcmp(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if (data.empty()) {
+        INFOF("No pipeline cache at {}, pipelines are compiled from scratch", PipelineCacheFile);
+    } else if (!matches) {
+        WARNF("Pipeline cache at {} is from another driver or device, ignoring it", PipelineCacheFile);
+        data.clear();
+    } else {
+        INFOF("Loaded {} KiB of pipeline cache from {}", data.size() / 1024, PipelineCacheFile);
+    }
+
+    VkPipelineCacheCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .initialDataSize = data.size(),
+            .pInitialData = data.empty() ? nullptr : data.data(),
+    };
+
+    // Internally synchronized, pipelines may be created from any thread with it.
+    auto result = vkCreatePipelineCache(m_logicalDevice, &info, HostCallbacks(), &m_pipelineCache);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create pipeline cache: {}", string_VkResult(result));
+    }
+}
+
+void Device::SavePipelineCache() {
+    size_t size = 0;
+    auto result = vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &size, nullptr);
+    if (result != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<u8> data(size);
+    result = vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &size, data.data());
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to read back the pipeline cache: {}", string_VkResult(result));
+        return;
+    }
+
+    std::ofstream file(PipelineCacheFile, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const *>(data.data()), static_cast<std::streamsize>(size));
+    if (!file) {
+        ERRORF("Failed to write the pipeline cache to {}", PipelineCacheFile);
+    }
+}
+
+void Device::CreateTimelines() {
+    if (!m_timelineSupported) {
+        return;
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &typeInfo,
+    };
+
+    for (auto &timeline: m_timelines) {
+        auto result = vkCreateSemaphore(m_logicalDevice, &info, HostCallbacks(), &timeline);
+        if (result != VK_SUCCESS) {
+            ERRORF("Failed to create timeline semaphore: {}", string_VkResult(result));
+        }
+    }
+}
+
+VkQueue Device::Queue(QueueType type) const {
+    switch (type) {
+        case QueueType::Compute:
+            return m_computeQueue;
+        case QueueType::Transfer:
+            return m_transferQueue;
+        default:
+            return m_graphicsQueue;
+    }
+}
+
+u32 Device::QueueFamily(QueueType type) const {
+    switch (type) {
+        case QueueType::Compute:
+            return m_familyIndices.ComputeFamily.value_or(*m_familyIndices.GraphicsFamily);
+        case QueueType::Transfer:
+            return m_familyIndices.TransferFamily.value_or(*m_familyIndices.GraphicsFamily);
+        default:
+            return *m_familyIndices.GraphicsFamily;
+    }
+}
+
+QueuePoint Device::Submit(QueueType type, QueueSubmission const &submission) {
+    auto queueIndex = static_cast<u32>(type);
+
+    // Runs every frame, the semaphore arrays live in scratch memory. Binary waits come first,
+    // then one timeline wait per QueueWait.
+    ScratchScope scratch;
+    auto binaryWaits = static_cast<u32>(submission.BinaryWaits.size());
+    auto waitCount = binaryWaits + (m_timelineSupported ? static_cast<u32>(submission.Waits.size()) : 0u);
+    auto waitSemaphores = scratch.Allocate<VkSemaphore>(waitCount);
+    auto waitStages = scratch.Allocate<VkPipelineStageFlags>(waitCount);
+    auto waitValues = scratch.Allocate<u64>(waitCount);
+    std::copy(submission.BinaryWaits.begin(), submission.BinaryWaits.end(), waitSemaphores.begin());
+    std::copy(submission.BinaryWaitStages.begin(), submission.BinaryWaitStages.end(), waitStages.begin());
+    std::fill(waitValues.begin(), waitValues.end(), 0);
+    for (u32 i = binaryWaits; i < waitCount; i++) {
+        auto const &wait = submission.Waits[i - binaryWaits];
+        waitSemaphores[i] = m_timelines[static_cast<u32>(wait.Point.Queue)];
+        waitStages[i] = wait.Stages;
+        waitValues[i] = wait.Point.Value;
+    }
 
-    std::vector<VkExtensionProperties> extensionProperties;
-    extensionProperties.resize(count);
+    auto signalCount = static_cast<u32>(submission.BinarySignals.size()) + (m_timelineSupported ? 1u : 0u);
+    auto signalSemaphores = scratch.Allocate<VkSemaphore>(signalCount);
+    auto signalValues = scratch.Allocate<u64>(signalCount);
+    std::copy(submission.BinarySignals.begin(), submission.BinarySignals.end(), signalSemaphores.begin());
+    std::fill(signalValues.begin(), signalValues.end(), 0);
+    if (m_timelineSupported) {
+        signalSemaphores.Last() = m_timelines[queueIndex];
+    }
+
+    std::scoped_lock queueLock(m_queueMutex);
+    // Without timelines the queues waited on are drained from the host instead.
+    if (!m_timelineSupported) {
+        for (auto const &wait: submission.Waits) {
+            vkQueueWaitIdle(Queue(wait.Point.Queue));
+        }
+    }
+    auto value = m_submitted[queueIndex] + 1;
+    if (m_timelineSupported) {
+        signalValues.Last() = value;
+    }
+
+    // Binary semaphores ignore their entries in the value arrays.
+    VkTimelineSemaphoreSubmitInfo timelineInfo{
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = waitValues.Length(),
+            .pWaitSemaphoreValues = waitValues.Data(),
+            .signalSemaphoreValueCount = signalValues.Length(),
+            .pSignalSemaphoreValues = signalValues.Data(),
+    };
+    VkSubmitInfo submitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = m_timelineSupported ? &timelineInfo : nullptr,
+            .waitSemaphoreCount = waitSemaphores.Length(),
+            .pWaitSemaphores = waitSemaphores.Data(),
+            .pWaitDstStageMask = waitStages.Data(),
+            .commandBufferCount = static_cast<u32>(submission.CommandBuffers.size()),
+            .pCommandBuffers = submission.CommandBuffers.data(),
+            .signalSemaphoreCount = signalSemaphores.Length(),
+            .pSignalSemaphores = signalSemaphores.Data(),
+    };
 
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensionProperties.data());
+    auto result = vkQueueSubmit(Queue(type), 1, &submitInfo, submission.Fence);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to submit to queue {}: {}", queueIndex, string_VkResult(result));
+        // The timeline never reaches the new value, waiters get the last one that will be.
+        return QueuePoint{type, m_submitted[queueIndex]};
+    }
+    m_submitted[queueIndex] = value;
+    m_stats.Add(RenderCounter::QueueSubmits);
+    return QueuePoint{type, value};
+}
+
+bool Device::IsComplete(QueuePoint point) {
+    if (!m_timelineSupported) {
+        Wait(point);
+        return true;
+    }
+    u64 value = 0;
+    vkGetSemaphoreCounterValue(m_logicalDevice, m_timelines[static_cast<u32>(point.Queue)], &value);
+    return value >= point.Value;
+}
+
+void Device::Wait(QueuePoint point) {
+    if (!m_timelineSupported) {
+        std::scoped_lock queueLock(m_queueMutex);
+        vkQueueWaitIdle(Queue(point.Queue));
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo{
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &m_timelines[static_cast<u32>(point.Queue)],
+            .pValues = &point.Value,
+    };
+    vkWaitSemaphores(m_logicalDevice, &waitInfo, UINT64_MAX);
+}
+
+VkCommandBuffer Device::BeginOneOff(VkCommandPool pool) {
+    VkCommandBufferAllocateInfo allocateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer commandBuffer;
+    auto result = vkAllocateCommandBuffers(m_logicalDevice, &allocateInfo, &commandBuffer);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to allocate one-off command buffer: {}", string_VkResult(result));
+        return VK_NULL_HANDLE;
+    }
+
+    VkCommandBufferBeginInfo beginInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    return commandBuffer;
+}
+
+void Device::ImmediateSubmit(std::function<void(VkCommandBuffer)> const &record) {
+    std::scoped_lock uploadLock(m_uploadMutex);
+
+    auto commandBuffer = BeginOneOff(m_uploadPool);
+    if (commandBuffer == VK_NULL_HANDLE) {
+        return;
+    }
+    record(commandBuffer);
+    vkEndCommandBuffer(commandBuffer);
+
+    Wait(Submit(QueueType::Graphics, QueueSubmission{.CommandBuffers = {&commandBuffer, 1}}));
+    vkFreeCommandBuffers(m_logicalDevice, m_uploadPool, 1, &commandBuffer);
+}
+
+QueuePoint Device::UploadBuffer(VkBuffer destination, VkDeviceSize offset, void const *data, VkDeviceSize size) {
+    auto staging = CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    void *mapped;
+    vkMapMemory(m_logicalDevice, staging.Memory, 0, size, 0, &mapped);
+    std::memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(m_logicalDevice, staging.Memory);
+
+    VkBufferCopy region{
+            .srcOffset = 0,
+            .dstOffset = offset,
+            .size = size,
+    };
+
+    std::scoped_lock uploadLock(m_uploadMutex);
+    ReclaimUploadsLocked();
+
+    bool dedicated = HasDedicatedQueue(QueueType::Transfer);
+    auto copyBuffer = dedicated ? BeginOneOff(m_transferPool) : VK_NULL_HANDLE;
+    auto graphicsBuffer = BeginOneOff(m_uploadPool);
+    QueuePoint ready{};
+    if (!dedicated && graphicsBuffer != VK_NULL_HANDLE) {
+        vkCmdCopyBuffer(graphicsBuffer, staging.Buffer, destination, 1, &region);
+        // Nobody waits for the copy anymore, later submissions are ordered behind it here.
+        VkMemoryBarrier copied{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
+        };
+        vkCmdPipelineBarrier(graphicsBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &copied, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(graphicsBuffer);
+        m_stats.Add(RenderCounter::Barriers);
+        ready = Submit(QueueType::Graphics, QueueSubmission{.CommandBuffers = {&graphicsBuffer, 1}});
+    } else if (dedicated && copyBuffer != VK_NULL_HANDLE && graphicsBuffer != VK_NULL_HANDLE) {
+        // The copy overlaps whatever the graphics queue is rendering, only the acquire of the
+        // written range is queued behind it.
+        BufferOwnershipTransfer transfer{
+                .Buffer = destination,
+                .Offset = offset,
+                .Size = size,
+                .SourceFamily = QueueFamily(QueueType::Transfer),
+                .DestinationFamily = QueueFamily(QueueType::Graphics),
+                .SourceStages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                .SourceAccess = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .DestinationStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                .DestinationAccess = VK_ACCESS_MEMORY_READ_BIT,
+        };
+
+        vkCmdCopyBuffer(copyBuffer, staging.Buffer, destination, 1, &region);
+        transfer.Release(copyBuffer);
+        vkEndCommandBuffer(copyBuffer);
+        transfer.Acquire(graphicsBuffer);
+        vkEndCommandBuffer(graphicsBuffer);
+        m_stats.Add(RenderCounter::Barriers, 2);
+
+        // The acquire's barrier covers every graphics submission after it, so nothing that
+        // renders needs to wait for the point itself.
+        QueueWait copied{
+                .Point = Submit(QueueType::Transfer, QueueSubmission{.CommandBuffers = {&copyBuffer, 1}}),
+                .Stages = transfer.DestinationStages,
+        };
+        ready = Submit(QueueType::Graphics, QueueSubmission{.CommandBuffers = {&graphicsBuffer, 1}, .Waits = {&copied, 1}});
+    }
+    m_stats.Add(RenderCounter::UploadedBytes, size);
+
+    m_pendingUploads.push_back(PendingUpload{
+            .Point = ready,
+            .Staging = staging.Buffer,
+            .StagingMemory = staging.Memory,
+            .Copy = copyBuffer,
+            .Graphics = graphicsBuffer,
+    });
+    // Polling a point without timelines idles the queue anyway, wait right here instead.
+    if (!m_timelineSupported) {
+        Wait(ready);
+        ReclaimUploadsLocked();
+    }
+    return ready;
+}
+
+void Device::ReclaimUploads() {
+    std::scoped_lock uploadLock(m_uploadMutex);
+    ReclaimUploadsLocked();
+}
+
+void Device::ReclaimUploadsLocked() {
+    std::erase_if(m_pendingUploads, [this](PendingUpload const &upload) {
+        if (!IsComplete(upload.Point)) {
+            return false;
+        }
+        if (upload.Copy != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(m_logicalDevice, m_transferPool, 1, &upload.Copy);
+        }
+        if (upload.Graphics != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(m_logicalDevice, m_uploadPool, 1, &upload.Graphics);
+        }
+        vkDestroyBuffer(m_logicalDevice, upload.Staging, nullptr);
+        m_memory.Free(m_logicalDevice, upload.StagingMemory);
+        return true;
+    });
+}
+
+bool CheckDeviceExtensionSupport(VkPhysicalDevice device) {
+    ScratchScope scratch;
+    auto extensionProperties = EnumerateInto<VkExtensionProperties>(scratch.Arena(), [&](u32 *count, VkExtensionProperties *properties) {
+        vkEnumerateDeviceExtensionProperties(device, nullptr, count, properties);
+    });
 
     for (auto &RequiredDeviceExtension: g_RequiredDeviceExtensions) {
         bool found = false;
-        for (auto property: extensionProperties) {
+        for (auto const &property: extensionProperties) {
             if (strcmp(RequiredDeviceExtension, property.extensionName) == 0) {
                 found = true;
             }
@@ -297,30 +854,40 @@ bool Device::IsDeviceSuitable(VkPhysicalDevice device) {
 }
 
 QueueFamilyIndices Device::GetQueueFamilies(VkPhysicalDevice device) {
-    u32 count;
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
-
-    std::vector<VkQueueFamilyProperties> familyProperties;
-    familyProperties.resize(count);
-
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &count, familyProperties.data());
+    ScratchScope scratch;
+    auto familyProperties = EnumerateInto<VkQueueFamilyProperties>(scratch.Arena(), [&](u32 *count, VkQueueFamilyProperties *properties) {
+        vkGetPhysicalDeviceQueueFamilyProperties(device, count, properties);
+    });
 
     QueueFamilyIndices indices;
-    u32 index = 0;
-    for (auto property: familyProperties) {
-        if (property.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-            indices.GraphicsFamily = index;
-        }
-
+    for (u32 index = 0; index < familyProperties.Length(); index++) {
+        auto flags = familyProperties[index].queueFlags;
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(device, index, m_surface, &presentSupport);
-        if (presentSupport) {
+
+        // A graphics family that presents as well is preferred, the swapchain images then never
+        // have to be shared between families.
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && (!indices.GraphicsFamily || (presentSupport && indices.PresentFamily != indices.GraphicsFamily))) {
+            indices.GraphicsFamily = index;
+        }
+        if (presentSupport && (!indices.PresentFamily || indices.GraphicsFamily == index)) {
             indices.PresentFamily = index;
         }
-        if (indices.IsComplete()) {
-            break;
+
+        if (flags & VK_QUEUE_GRAPHICS_BIT) {
+            continue;
+        }
+        // Async compute is any compute family without graphics. Transfer-only families are the
+        // copy engines, failing that a compute family without graphics still copies in parallel.
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !indices.ComputeFamily) {
+            indices.ComputeFamily = index;
         }
-        index++;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT) && !indices.TransferFamily) {
+            indices.TransferFamily = index;
+        }
+    }
+    if (!indices.TransferFamily) {
+        indices.TransferFamily = indices.ComputeFamily;
     }
 
     return indices;
@@ -363,7 +930,7 @@ VkFormat Device::FindSupportedFormat(const std::vector<VkFormat> &candidates, Vk
     return candidates[0];
 }
 
-Image Device::CreateImage(const VkImageCreateInfo &info, VkMemoryPropertyFlags properties) {
+Image Device::CreateImage(const VkImageCreateInfo &info, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred) {
     Image image{};
     auto result = vkCreateImage(m_logicalDevice, &info, nullptr, &image.Image);
     if (result != VK_SUCCESS) {
@@ -373,25 +940,25 @@ Image Device::CreateImage(const VkImageCreateInfo &info, VkMemoryPropertyFlags p
     VkMemoryRequirements requirements;
     vkGetImageMemoryRequirements(m_logicalDevice, image.Image, &requirements);
 
-    VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &physicalDeviceMemoryProperties);
-
-    u32 memoryTypeIndex;
-    for (u32 i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++) {
-        if ((requirements.memoryTypeBits & (1 << i)) &&
-            (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            memoryTypeIndex = i;
-            break;
-        }
+    image.MemoryProperties = properties | preferred;
+    auto memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, image.MemoryProperties);
+    if (!memoryTypeIndex) {
+        image.MemoryProperties = properties;
+        memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
     }
+    if (!memoryTypeIndex) {
+        ERROR("Failed to find a memory type for image");
+        return image;
+    }
+    image.Size = requirements.size;
 
     VkMemoryAllocateInfo allocateInfo {
             .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
             .allocationSize = requirements.size,
-            .memoryTypeIndex = memoryTypeIndex
+            .memoryTypeIndex = *memoryTypeIndex
     };
 
-    result = vkAllocateMemory(m_logicalDevice, &allocateInfo, nullptr, &image.Memory);
+    result = m_memory.Allocate(m_logicalDevice, allocateInfo, ImageCategory(info.usage), &image.Memory);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to allocate image memory: {}", string_VkResult(result));
     }
@@ -404,12 +971,25 @@ Image Device::CreateImage(const VkImageCreateInfo &info, VkMemoryPropertyFlags p
     return image;
 }
 
+std::optional<u32> Device::FindMemoryType(u32 typeBits, VkMemoryPropertyFlags properties) const {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memoryProperties);
+    for (u32 i = 0; i < memoryProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
 
-std::vector<u32> QueueFamilyIndices::GetUniqueIndex() const {
+Slice<u32 const> QueueFamilyIndices::GetUniqueIndex(LinearArena &arena) const {
     // ASSERT(IsComplete(), "");
-    if (*GraphicsFamily == *PresentFamily) {
-        return {*GraphicsFamily};
+    auto unique = arena.Allocate<u32>(4);
+    u32 count = 0;
+    for (auto family: {GraphicsFamily, PresentFamily, ComputeFamily, TransferFamily}) {
+        if (family && std::find(unique.begin(), unique.begin() + count, *family) == unique.begin() + count) {
+            unique[count++] = *family;
+        }
     }
-    ERROR("Present and Graphics indices differ, do something");
-    return {};
+    return unique.SubSlice(0, count);
 }
@@ -1,39 +1,35 @@
 #pragma once
 #include "Definitions.h"
+#include "DeletionQueue.h"
+#include "HostAllocator.h"
+#include "LinearArena.h"
 #include "Logger.h"
+#include "MemoryBudget.h"
+#include "Queues.h"
+#include "RenderStats.h"
 #include <vulkan/vulkan.h>
 #include "Window.h"
+#include <array>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <optional>
+#include <span>
 #include <vector>
 
 struct QueueFamilyIndices {
     std::optional<u32> GraphicsFamily;
     std::optional<u32> PresentFamily;
+    // Only set for families without graphics, the transfer family falls back to the compute one.
+    std::optional<u32> ComputeFamily;
+    std::optional<u32> TransferFamily;
 
     MUST_USE bool IsComplete() const {
         return GraphicsFamily.has_value() && PresentFamily.has_value();
     }
 
-    MUST_USE std::vector<u32> GetUniqueIndex() const;
-};
-
-// TODO: Fledge this out
-template<typename T>
-class Slice {
-    T *m_ptr{};
-    u32 m_length{0};
-
-public:
-    Slice() : m_ptr(nullptr), m_length(0) {}
-    Slice(T *ptr, u32 length) : m_ptr(ptr), m_length(length) {}
-    Slice(const Slice &other) : m_ptr(other.m_ptr), m_length(other.m_length) {}
-
-    T operator[](u32 i) {
-        if (i >= m_length) {
-            std::abort();
-        }
-        return m_ptr[i];
-    }
+    // Valid as long as the arena memory is.
+    MUST_USE Slice<u32 const> GetUniqueIndex(LinearArena &arena) const;
 };
 
 struct SwapchainSupportDetails {
@@ -64,41 +60,150 @@ struct SwapchainSupportDetails {
 struct Image {
     VkImage Image;
     VkDeviceMemory Memory;
+    VkDeviceSize Size;
+    VkMemoryPropertyFlags MemoryProperties;
 };
 
 class Device {
     Window &m_window;
+    // Outlives the instance, it is the last thing the driver frees through.
+    HostAllocator m_hostAllocator{};
     VkInstance m_vkInstance{};
     VkDebugUtilsMessengerEXT m_debugMessenger{};
     VkSurfaceKHR m_surface{};
     VkPhysicalDevice m_physicalDevice{};
+    VkPhysicalDeviceProperties m_properties{};
+    VkPhysicalDeviceFeatures2 m_enabledFeatures{};
+    VkPhysicalDeviceVulkan12Features m_enabledFeatures12{};
+    VkPhysicalDeviceVulkan13Features m_enabledFeatures13{};
+    VkPhysicalDeviceMeshShaderFeaturesEXT m_enabledMeshShaderFeatures{};
+    bool m_bindlessSupported{false};
+    bool m_gpuDrivenSupported{false};
+    bool m_meshShaderSupported{false};
+    bool m_meshShaderQueriesSupported{false};
+    bool m_dynamicRenderingSupported{false};
+    bool m_memoryBudgetSupported{false};
+    bool m_pipelineStatisticsSupported{false};
+    PFN_vkCmdDrawMeshTasksEXT m_drawMeshTasks{};
     VkDevice m_logicalDevice{};
     VkQueue m_graphicsQueue{}, m_presentQueue{};
+    VkQueue m_computeQueue{}, m_transferQueue{};
     VkCommandPool m_commandPool{};
+    VkCommandPool m_uploadPool{};
+    // Only when the transfer family differs from the graphics one.
+    VkCommandPool m_transferPool{};
+    // One timeline per QueueType, signalled with the submission count by every Submit().
+    bool m_timelineSupported{false};
+    std::array<VkSemaphore, QueueTypeCount> m_timelines{};
+    std::array<u64, QueueTypeCount> m_submitted{};
+    // Shared by every pipeline, rebuilding one that only had a shader tweaked reuses the rest.
+    VkPipelineCache m_pipelineCache{};
+    // Read from disk while the device is created, saved back on destruction.
+    std::future<std::vector<u8>> m_pipelineCacheData;
+    std::mutex m_uploadMutex;
+    // Uploads still running on the GPU. Their staging memory and command buffers are reclaimed
+    // once the graphics point is reached, guarded by the upload mutex.
+    struct PendingUpload {
+        QueuePoint Point;
+        VkBuffer Staging;
+        VkDeviceMemory StagingMemory;
+        VkCommandBuffer Copy;
+        VkCommandBuffer Graphics;
+    };
+    std::vector<PendingUpload> m_pendingUploads;
+    std::mutex m_queueMutex;
     QueueFamilyIndices m_familyIndices{};
     SwapchainSupportDetails m_swapchainSupport{};
+    // Before the deletion queue, whatever it still destroys frees through the budget.
+    MemoryBudget m_memory{};
+    RenderStats m_stats{};
+    DeletionQueue m_deletionQueue{};
 
 public:
     explicit Device(Window &window);
     ~Device();
 
     MUST_USE VkDevice LogicalDevice() const { return m_logicalDevice; }
+    MUST_USE VkPhysicalDevice PhysicalDevice() const { return m_physicalDevice; }
     MUST_USE VkCommandPool CommandPool() const { return m_commandPool; }
+    MUST_USE VkPipelineCache PipelineCache() const { return m_pipelineCache; }
+    // Used by the instance, the device and whatever Device, Swapchain and Pipeline create and
+    // destroy themselves. Buffers and images handed out still use nullptr, they are destroyed
+    // all over the place.
+    MUST_USE VkAllocationCallbacks const *HostCallbacks() const { return m_hostAllocator.Callbacks(); }
+    MUST_USE HostAllocator &HostAllocations() { return m_hostAllocator; }
     MUST_USE Window &GetWindow() const { return m_window; }
     MUST_USE VkSurfaceKHR Surface() const { return m_surface; }
     MUST_USE VkQueue GraphicsQueue() const { return m_graphicsQueue; }
     MUST_USE VkQueue PresentQueue() const { return m_presentQueue; }
+    MUST_USE VkQueue Queue(QueueType type) const;
+    MUST_USE u32 QueueFamily(QueueType type) const;
+    // Whether work of this type runs on a family of its own, next to the graphics queue.
+    MUST_USE bool HasDedicatedQueue(QueueType type) const { return QueueFamily(type) != QueueFamily(QueueType::Graphics); }
+    MUST_USE QueueFamilyIndices const &QueueFamilies() const { return m_familyIndices; }
+    MUST_USE VkPhysicalDeviceProperties const &Properties() const { return m_properties; }
+    MUST_USE VkPhysicalDeviceVulkan12Features const &EnabledFeatures12() const { return m_enabledFeatures12; }
+    MUST_USE VkPhysicalDeviceVulkan13Features const &EnabledFeatures13() const { return m_enabledFeatures13; }
+
+    // Descriptor indexing with update-after-bind and partially bound arrays.
+    MUST_USE bool SupportsBindless() const { return m_bindlessSupported; }
+    // Multi-draw indirect with a GPU-written draw count.
+    MUST_USE bool SupportsGpuDriven() const { return m_gpuDrivenSupported; }
+    // VK_EXT_mesh_shader with task shaders.
+    MUST_USE bool SupportsMeshShaders() const { return m_meshShaderSupported; }
+    // Dynamic rendering and synchronization2, which the render graph records with.
+    MUST_USE bool SupportsDynamicRendering() const { return m_dynamicRenderingSupported; }
+    // Without timeline semaphores cross-queue waits and QueuePoint waits idle the queues instead.
+    MUST_USE bool SupportsTimelines() const { return m_timelineSupported; }
+    // VK_QUERY_TYPE_PIPELINE_STATISTICS, for the GPU side of the render stats.
+    MUST_USE bool SupportsPipelineStatistics() const { return m_pipelineStatisticsSupported; }
+    // Task and mesh shader invocation counts in those queries.
+    MUST_USE bool SupportsMeshShaderQueries() const { return m_meshShaderQueriesSupported; }
+    // Extension entry point, only valid when SupportsMeshShaders().
+    void DrawMeshTasks(VkCommandBuffer commandBuffer, u32 x, u32 y, u32 z) const { m_drawMeshTasks(commandBuffer, x, y, z); }
+
+    // Queues are externally synchronized, every submit or present has to hold this.
+    MUST_USE std::mutex &QueueMutex() { return m_queueMutex; }
 
     MUST_USE SwapchainSupportDetails const &SwapchainSupport() const { return m_swapchainSupport; }
+    MUST_USE DeletionQueue &Deletion() { return m_deletionQueue; }
+    // Every allocation made through CreateBuffer and CreateImage, which is where their memory
+    // has to be freed as well.
+    MUST_USE MemoryBudget &Memory() { return m_memory; }
+    // What the engine records and submits per frame, every module counts into it.
+    MUST_USE RenderStats &Stats() { return m_stats; }
 
     MUST_USE VkFormat FindSupportedFormat(std::vector<VkFormat> const &canditates, VkImageTiling tiling, VkFormatFeatureFlags features);
-    MUST_USE Image CreateImage(VkImageCreateInfo const &info, VkMemoryPropertyFlags properties);
+    // `preferred` flags are added when a memory type has them, e.g. lazily allocated memory.
+    MUST_USE Image CreateImage(VkImageCreateInfo const &info, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred = 0);
+    // First memory type allowed by `typeBits` that has all of `properties`.
+    MUST_USE std::optional<u32> FindMemoryType(u32 typeBits, VkMemoryPropertyFlags properties) const;
 
     struct Buffer {
         VkBuffer Buffer;
         VkDeviceMemory Memory;
     };
-    MUST_USE Buffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+    // Buffers used by more than one of `sharedFamilies` are created concurrent, no ownership
+    // transfers needed, at whatever access cost that has on the device. The memory is accounted
+    // under BufferCategory(usage), images under ImageCategory(info.usage).
+    MUST_USE Buffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, std::span<u32 const> sharedFamilies = {});
+
+    // Submits to the queue and signals its timeline, the returned point can be waited on from
+    // any queue or the host. Takes the queue mutex itself.
+    QueuePoint Submit(QueueType type, QueueSubmission const &submission);
+    // Both drain the whole queue when there are no timelines.
+    MUST_USE bool IsComplete(QueuePoint point);
+    void Wait(QueuePoint point);
+
+    // Records and submits a one-off command buffer on the graphics queue and waits for it.
+    void ImmediateSubmit(std::function<void(VkCommandBuffer)> const &record);
+    // Copies host data into a (typically device-local) buffer through a staging buffer. With a
+    // dedicated transfer queue the copy runs there and the range is handed over to graphics.
+    // Returns without waiting: graphics work submitted afterwards sees the data, anything else
+    // waits on the returned point. Without timelines it still waits for the copy.
+    QueuePoint UploadBuffer(VkBuffer destination, VkDeviceSize offset, void const *data, VkDeviceSize size);
+    // Frees the staging memory of uploads that finished, once per frame.
+    void ReclaimUploads();
 
 private:
     void CreateInstance();
@@ -107,7 +212,13 @@ private:
 
     void PickPhysicalDevice();
     void CreateLogicalDevice();
+    void SelectFeatures(VkPhysicalDeviceFeatures const &supported, VkPhysicalDeviceVulkan12Features const &supported12, VkPhysicalDeviceVulkan13Features const &supported13, VkPhysicalDeviceMeshShaderFeaturesEXT const &supportedMesh);
     void CreateCommandPool();
+    void CreatePipelineCache();
+    void SavePipelineCache();
+    void CreateTimelines();
+    MUST_USE VkCommandBuffer BeginOneOff(VkCommandPool pool);
+    void ReclaimUploadsLocked();
     bool IsDeviceSuitable(VkPhysicalDevice device);
 
     QueueFamilyIndices GetQueueFamilies(VkPhysicalDevice device);
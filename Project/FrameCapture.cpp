@@ -0,0 +1,414 @@
+#include "FrameCapture.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <vulkan/vk_enum_string_helper.h>
+
+static std::array<u32, 256> MakeCrcTable()
+{
+    std::array<u32, 256> table{};
+    for (u32 i = 0; i < 256; i++) {
+        u32 crc = i;
+        for (u32 bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+static u32 Crc32(u32 crc, std::span<u8 const> bytes)
+{
+    static auto const table = MakeCrcTable();
+    crc = ~crc;
+    for (auto byte: bytes) {
+        crc = table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void PushBigEndian(std::vector<u8> &out, u32 value)
+{
+    out.push_back(static_cast<u8>(value >> 24));
+    out.push_back(static_cast<u8>(value >> 16));
+    out.push_back(static_cast<u8>(value >> 8));
+    out.push_back(static_cast<u8>(value));
+}
+
+static void PushChunk(std::vector<u8> &out, char const (&type)[5], std::span<u8 const> data)
+{
+    PushBigEndian(out, static_cast<u32>(data.size()));
+    auto begin = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PushBigEndian(out, Crc32(0, std::span(out).subspan(begin)));
+}
+
+// RGBA8 rows into a PNG whose zlib stream only has stored blocks. Every row gets filter type 0,
+// the only point of the filter byte here is that the format requires it.
+static std::vector<u8> EncodePng(u32 width, u32 height, std::span<u8 const> pixels)
+{
+    constexpr u32 MaxStored = 65535;
+    auto rowBytes = static_cast<size_t>(width) * 4;
+    auto rawSize = (rowBytes + 1) * height;
+
+    std::vector<u8> raw;
+    raw.reserve(rawSize);
+    for (u32 y = 0; y < height; y++) {
+        raw.push_back(0);
+        auto row = pixels.subspan(y * rowBytes, rowBytes);
+        raw.insert(raw.end(), row.begin(), row.end());
+    }
+
+    std::vector<u8> zlib;
+    zlib.reserve(rawSize + rawSize / MaxStored * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    u32 a = 1, b = 0;
+    for (size_t offset = 0; offset < raw.size(); offset += MaxStored) {
+        auto length = static_cast<u32>(std::min<size_t>(MaxStored, raw.size() - offset));
+        auto last = offset + length >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<u8>(length));
+        zlib.push_back(static_cast<u8>(length >> 8));
+        zlib.push_back(static_cast<u8>(~length));
+        zlib.push_back(static_cast<u8>(~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        // Adler-32, 5552 bytes is the most the sums take before they could overflow.
+        for (size_t i = offset; i < offset + length; i += 5552) {
+            auto end = std::min<size_t>(i + 5552, offset + length);
+            for (size_t j = i; j < end; j++) {
+                a += raw[j];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+    }
+    PushBigEndian(zlib, b << 16 | a);
+
+    std::vector<u8> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    png.reserve(zlib.size() + 64);
+    std::vector<u8> header;
+    PushBigEndian(header, width);
+    PushBigEndian(header, height);
+    // 8 bit RGBA, deflate, adaptive filtering, no interlace.
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    PushChunk(png, "IHDR", header);
+    PushChunk(png, "IDAT", zlib);
+    PushChunk(png, "IEND", {});
+    return png;
+}
+
+static bool WriteFile(std::filesystem::path const &path, std::span<u8 const> bytes)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return file.good();
+}
+
+FrameCapture::FrameCapture(Device &device, JobSystem &jobs, u32 framesInFlight)
+    : m_device(device), m_jobs(jobs), m_framesInFlight(framesInFlight)
+{
+    // The workers read every byte once, cached memory makes that a plain memcpy.
+    VkMemoryPropertyFlags coherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    auto cached = coherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    m_memoryProperties = m_device.FindMemoryType(~0u, cached) ? cached : coherent;
+}
+
+FrameCapture::~FrameCapture()
+{
+    bool inFlight = std::any_of(m_slots.begin(), m_slots.end(), [](Slot const &slot) {
+        return slot.State.load(std::memory_order_acquire) == SlotState::InFlight;
+    });
+    if (inFlight) {
+        vkDeviceWaitIdle(m_device.LogicalDevice());
+    }
+    // Whatever is in flight is written out here, the workers finish what they already have.
+    for (auto &slot: m_slots) {
+        if (slot.State.load(std::memory_order_acquire) == SlotState::InFlight) {
+            Encode(slot);
+        }
+    }
+    for (auto busy = m_encoding.load(std::memory_order_acquire); busy > 0; busy = m_encoding.load(std::memory_order_acquire)) {
+        m_encoding.wait(busy, std::memory_order_acquire);
+    }
+    for (auto &slot: m_slots) {
+        DestroyBuffer(slot);
+    }
+
+    if (m_stats.Captured > 0) {
+        INFOF("Frame capture: {} captured, {} written, {} failed, {} dropped", m_stats.Captured.load(),
+              m_stats.Written.load(), m_stats.Failed.load(), m_stats.Dropped.load());
+    }
+}
+
+void FrameCapture::Screenshot(std::filesystem::path path)
+{
+    auto format = path.extension() == ".raw" ? CaptureFormat::Raw : CaptureFormat::Png;
+    std::scoped_lock lock(m_mutex);
+    m_pending.push_back(Output{.Path = std::move(path), .Format = format});
+    m_armed.store(true, std::memory_order_release);
+}
+
+void FrameCapture::Capture(Callback callback)
+{
+    std::scoped_lock lock(m_mutex);
+    m_pending.push_back(Output{.OnCaptured = std::move(callback)});
+    m_armed.store(true, std::memory_order_release);
+}
+
+void FrameCapture::StartSequence(std::filesystem::path directory, CaptureFormat format, u32 frames)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        ERRORF("Failed to create capture directory {}: {}", directory.string(), error.message());
+        return;
+    }
+
+    std::scoped_lock lock(m_mutex);
+    INFOF("Capturing {} frames to {}", frames > 0 ? std::to_string(frames) : "all", directory.string());
+    m_sequenceDirectory = std::move(directory);
+    m_sequenceFormat = format;
+    m_sequenceRemaining = frames;
+    m_sequenceActive = true;
+    m_armed.store(true, std::memory_order_release);
+}
+
+void FrameCapture::StopSequence()
+{
+    std::scoped_lock lock(m_mutex);
+    m_sequenceActive = false;
+    m_armed.store(!m_pending.empty(), std::memory_order_release);
+}
+
+void FrameCapture::Poll(u64 frame)
+{
+    for (auto &slot: m_slots) {
+        if (slot.State.load(std::memory_order_acquire) != SlotState::InFlight) {
+            continue;
+        }
+        // The fences only say the copy is done once the slot's frame came around again, a
+        // timeline says so as soon as the GPU got there.
+        bool complete = m_device.SupportsTimelines() ? m_device.IsComplete(slot.Point) : frame >= slot.Frame + m_framesInFlight;
+        if (!complete) {
+            continue;
+        }
+        slot.State.store(SlotState::Encoding, std::memory_order_release);
+        m_encoding.fetch_add(1, std::memory_order_relaxed);
+        m_jobs.Schedule([this, &slot] {
+            Encode(slot);
+            if (m_encoding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                m_encoding.notify_all();
+            }
+        });
+    }
+}
+
+void FrameCapture::Record(VkCommandBuffer commandBuffer, u64 frame, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout)
+{
+    if (!m_armed.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    bool bgra = format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+    bool rgba = format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+    auto slot = std::find_if(m_slots.begin(), m_slots.end(), [](Slot const &candidate) {
+        return candidate.State.load(std::memory_order_acquire) == SlotState::Free;
+    });
+
+    {
+        std::scoped_lock lock(m_mutex);
+        if (!bgra && !rgba) {
+            ERRORF("Cannot capture images of format {}, dropping every capture request", string_VkFormat(format));
+            m_pending.clear();
+            m_sequenceActive = false;
+            m_armed.store(false, std::memory_order_release);
+            return;
+        }
+        if (slot == m_slots.end()) {
+            if (m_sequenceActive) {
+                m_stats.Dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+        if (!EnsureCapacity(*slot, static_cast<VkDeviceSize>(extent.width) * extent.height * 4)) {
+            return;
+        }
+
+        slot->Outputs = std::move(m_pending);
+        m_pending.clear();
+        if (m_sequenceActive) {
+            auto name = std::format("frame_{:06}{}", frame, m_sequenceFormat == CaptureFormat::Raw ? ".raw" : ".png");
+            slot->Outputs.push_back(Output{.Path = m_sequenceDirectory / name, .Format = m_sequenceFormat});
+            if (m_sequenceRemaining > 0 && --m_sequenceRemaining == 0) {
+                m_sequenceActive = false;
+            }
+        }
+        m_armed.store(m_sequenceActive, std::memory_order_release);
+    }
+
+    slot->Frame = frame;
+    slot->Width = extent.width;
+    slot->Height = extent.height;
+    slot->Bgra = bgra;
+    slot->State.store(SlotState::Recorded, std::memory_order_relaxed);
+
+    VkImageMemoryBarrier toTransfer{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout = layout,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy region{
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .imageOffset = {0, 0, 0},
+            .imageExtent = {extent.width, extent.height, 1},
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->Buffer, 1, &region);
+
+    // Back to where the frame left the image, and the copy made visible to the host.
+    VkImageMemoryBarrier toOriginal{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .dstAccessMask = 0,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .newLayout = layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    VkBufferMemoryBarrier toHost{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = slot->Buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 1, &toHost, 1, &toOriginal);
+    m_device.Stats().Add(RenderCounter::Barriers, 2);
+}
+
+void FrameCapture::Submitted(QueuePoint point)
+{
+    for (auto &slot: m_slots) {
+        if (slot.State.load(std::memory_order_relaxed) == SlotState::Recorded) {
+            slot.Point = point;
+            slot.State.store(SlotState::InFlight, std::memory_order_release);
+        }
+    }
+}
+
+FrameCapture::Difference FrameCapture::Compare(std::span<u8 const> a, std::span<u8 const> b, u8 tolerance)
+{
+    if (a.size() != b.size()) {
+        return Difference{.MaxChannel = 255, .Pixels = std::max(a.size(), b.size()) / 4};
+    }
+
+    Difference difference{};
+    for (size_t pixel = 0; pixel + 4 <= a.size(); pixel += 4) {
+        u32 largest = 0;
+        for (size_t channel = pixel; channel < pixel + 4; channel++) {
+            largest = std::max<u32>(largest, a[channel] > b[channel] ? a[channel] - b[channel] : b[channel] - a[channel]);
+        }
+        difference.MaxChannel = std::max(difference.MaxChannel, largest);
+        difference.Pixels += largest > tolerance;
+    }
+    return difference;
+}
+
+bool FrameCapture::EnsureCapacity(Slot &slot, VkDeviceSize size)
+{
+    if (slot.Size >= size) {
+        return true;
+    }
+    DestroyBuffer(slot);
+
+    auto buffer = m_device.CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, m_memoryProperties);
+    if (buffer.Memory == VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device.LogicalDevice(), buffer.Buffer, nullptr);
+        return false;
+    }
+    void *data;
+    auto result = vkMapMemory(m_device.LogicalDevice(), buffer.Memory, 0, VK_WHOLE_SIZE, 0, &data);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to map capture buffer: {}", string_VkResult(result));
+        vkDestroyBuffer(m_device.LogicalDevice(), buffer.Buffer, nullptr);
+        m_device.Memory().Free(m_device.LogicalDevice(), buffer.Memory);
+        return false;
+    }
+    slot.Buffer = buffer.Buffer;
+    slot.Memory = buffer.Memory;
+    slot.Mapped = static_cast<u8 const *>(data);
+    slot.Size = size;
+    return true;
+}
+
+void FrameCapture::DestroyBuffer(Slot &slot)
+{
+    if (slot.Buffer == VK_NULL_HANDLE) {
+        return;
+    }
+    // Freeing the memory unmaps it.
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), budget = &m_device.Memory(), buffer = slot.Buffer, memory = slot.Memory] {
+        vkDestroyBuffer(device, buffer, nullptr);
+        budget->Free(device, memory);
+    });
+    slot.Buffer = VK_NULL_HANDLE;
+    slot.Memory = VK_NULL_HANDLE;
+    slot.Mapped = nullptr;
+    slot.Size = 0;
+}
+
+void FrameCapture::Encode(Slot &slot)
+{
+    // One sequential read out of the mapped memory, after which the slot can take the next frame.
+    auto outputs = std::move(slot.Outputs);
+    auto frame = slot.Frame;
+    auto width = slot.Width;
+    auto height = slot.Height;
+    std::vector<u8> pixels(static_cast<size_t>(width) * height * 4);
+    std::memcpy(pixels.data(), slot.Mapped, pixels.size());
+    if (slot.Bgra) {
+        for (size_t i = 0; i < pixels.size(); i += 4) {
+            std::swap(pixels[i], pixels[i + 2]);
+        }
+    }
+    slot.Outputs.clear();
+    slot.State.store(SlotState::Free, std::memory_order_release);
+    m_stats.Captured.fetch_add(1, std::memory_order_relaxed);
+
+    for (auto const &output: outputs) {
+        if (output.OnCaptured) {
+            output.OnCaptured(CapturedFrame{.Frame = frame, .Width = width, .Height = height, .Pixels = pixels});
+            continue;
+        }
+        bool written = output.Format == CaptureFormat::Raw ? WriteFile(output.Path, pixels)
+                                                           : WriteFile(output.Path, EncodePng(width, height, pixels));
+        if (!written) {
+            ERRORF("Failed to write capture {}", output.Path.string());
+            m_stats.Failed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        m_stats.Written.fetch_add(1, std::memory_order_relaxed);
+    }
+}
\ No newline at end of file
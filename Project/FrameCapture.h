@@ -0,0 +1,136 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "JobSystem.h"
+#include "Types.h"
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum class CaptureFormat : u32 {
+    // Uncompressed deflate inside a valid PNG, large files but no dependency and cheap to write.
+    Png,
+    // Tightly packed RGBA8 rows, top to bottom, nothing else.
+    Raw,
+};
+
+// The pixels of one captured frame as RGBA8, whatever the format of the image was.
+struct CapturedFrame {
+    u64 Frame{};
+    u32 Width{};
+    u32 Height{};
+    // Only valid during the callback.
+    std::span<u8 const> Pixels{};
+};
+
+// Reads rendered images back without stalling the frame. Record() copies the image into one of
+// a ring of host visible buffers as part of the frame's own command buffer, Poll() notices
+// the copy finished on a later frame, through the graphics timeline or the frame fences, and
+// hands the pixels to the job system, which converts, encodes and writes them. A frame that
+// finds every slot busy is dropped from a sequence, single captures wait for the next frame.
+class FrameCapture {
+public:
+    static constexpr u32 SlotCount = 4;
+    using Callback = std::function<void(CapturedFrame const &)>;
+
+    struct Stats {
+        std::atomic<u64> Captured{};
+        std::atomic<u64> Written{};
+        std::atomic<u64> Failed{};
+        // Sequence frames skipped because every slot was still busy.
+        std::atomic<u64> Dropped{};
+    };
+
+private:
+    enum class SlotState : u32 {
+        Free,
+        Recorded,
+        InFlight,
+        Encoding,
+    };
+
+    struct Output {
+        std::filesystem::path Path;
+        CaptureFormat Format{};
+        Callback OnCaptured;
+    };
+
+    struct Slot {
+        VkBuffer Buffer{};
+        VkDeviceMemory Memory{};
+        u8 const *Mapped{};
+        VkDeviceSize Size{};
+        std::atomic<SlotState> State{SlotState::Free};
+        QueuePoint Point{};
+        u64 Frame{};
+        u32 Width{};
+        u32 Height{};
+        bool Bgra{};
+        std::vector<Output> Outputs;
+    };
+
+    Device &m_device;
+    JobSystem &m_jobs;
+    // How many frames later the frame fences guarantee a copy finished, without timelines.
+    u32 m_framesInFlight;
+    VkMemoryPropertyFlags m_memoryProperties;
+    std::array<Slot, SlotCount> m_slots{};
+    // Scheduled encoding jobs, which keep writing after they freed their slot.
+    std::atomic<u32> m_encoding{0};
+
+    // Requests come from any thread, the render thread only locks once something is armed.
+    std::mutex m_mutex;
+    std::atomic<bool> m_armed{false};
+    std::vector<Output> m_pending;
+    std::filesystem::path m_sequenceDirectory;
+    CaptureFormat m_sequenceFormat{};
+    // Frames left in the running sequence, zero runs until StopSequence.
+    u32 m_sequenceRemaining{};
+    bool m_sequenceActive{false};
+
+    Stats m_stats;
+
+public:
+    FrameCapture(Device &device, JobSystem &jobs, u32 framesInFlight);
+    // Waits for every capture in flight and writes it out.
+    ~FrameCapture();
+    FrameCapture(FrameCapture const &other) = delete;
+    FrameCapture &operator=(FrameCapture const &other) = delete;
+
+    // The next recorded frame goes to `path`, raw for a .raw extension and PNG otherwise.
+    void Screenshot(std::filesystem::path path);
+    // The next recorded frame's pixels go to `callback` on a worker thread, e.g. to compare
+    // against a golden image.
+    void Capture(Callback callback);
+    // Every frame from the next one on goes to `directory` as frame_<number>, `frames` of them
+    // or until StopSequence() when zero.
+    void StartSequence(std::filesystem::path directory, CaptureFormat format, u32 frames = 0);
+    void StopSequence();
+
+    // Render thread, once the frame's fence was waited on. `frame` counts recorded frames.
+    void Poll(u64 frame);
+    // Render thread, after the frame's passes with `image` in `layout`, where it is left again.
+    void Record(VkCommandBuffer commandBuffer, u64 frame, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout);
+    // The submit that carried the frame's Record().
+    void Submitted(QueuePoint point);
+
+    MUST_USE Stats const &GetStats() const { return m_stats; }
+
+    // Largest per channel difference and how many pixels differ by more than `tolerance`.
+    struct Difference {
+        u32 MaxChannel{};
+        u64 Pixels{};
+    };
+    MUST_USE static Difference Compare(std::span<u8 const> a, std::span<u8 const> b, u8 tolerance = 0);
+
+private:
+    MUST_USE bool EnsureCapacity(Slot &slot, VkDeviceSize size);
+    void DestroyBuffer(Slot &slot);
+    void Encode(Slot &slot);
+};
\ No newline at end of file
@@ -0,0 +1,422 @@
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC emits any intrinsic without per-function target flags.
+#define CULL_TARGET(isa)
+#else
+#define CULL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#else
+#define CULL_X86 0
+#endif
+
+using Bounds = FrustumCuller::Bounds;
+using KernelFunction = u32 (*)(Bounds const &bounds, Frustum const &frustum, u32 begin, u32 end, u32 *out);
+
+// Objects per chunk handed to a worker, a multiple of the padding.
+static constexpr u32 ChunkSize = 8192;
+
+Frustum Frustum::FromViewProjection(glm::mat4 const &m)
+{
+    // Gribb/Hartmann plane extraction. Depth is [0, 1], so the near plane is just the z row.
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    Frustum frustum{{
+            row(3) + row(0),
+            row(3) - row(0),
+            row(3) + row(1),
+            row(3) - row(1),
+            row(2),
+            row(3) - row(2),
+    }};
+    for (auto &plane: frustum.Planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+glm::vec4 EyeFromViewProjection(glm::mat4 const &m)
+{
+    // The eye projects to clip x = y = w = 0, so it spans the null space of those three rows.
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    auto x = row(0), y = row(1), w = row(3);
+    auto minor = [&](int a, int b, int c) {
+        return x[a] * (y[b] * w[c] - y[c] * w[b]) - x[b] * (y[a] * w[c] - y[c] * w[a]) + x[c] * (y[a] * w[b] - y[b] * w[a]);
+    };
+    glm::vec4 eye(minor(1, 2, 3), -minor(0, 2, 3), minor(0, 1, 3), -minor(0, 1, 2));
+
+    if (std::abs(eye.w) > 1e-6f * glm::length(glm::vec3(eye))) {
+        return glm::vec4(glm::vec3(eye) / eye.w, 1.0f);
+    }
+    // Depth grows away from the viewer, so the direction towards it has to lower clip z.
+    auto direction = glm::normalize(glm::vec3(eye));
+    if (glm::dot(row(2), glm::vec4(direction, 0.0f)) > 0.0f) {
+        direction = -direction;
+    }
+    return glm::vec4(direction, 0.0f);
+}
+
+glm::vec4 TransformSphere(glm::vec4 const &sphere, glm::mat4 const &transform)
+{
+    auto center = transform * glm::vec4(glm::vec3(sphere), 1.0f);
+    auto scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))});
+    return glm::vec4(glm::vec3(center), sphere.w * scale);
+}
+
+static u32 CullScalar(Bounds const &bounds, Frustum const &frustum, u32 begin, u32 end, u32 *out)
+{
+    u32 count = 0;
+    for (u32 i = begin; i < end; i++) {
+        bool inside = true;
+        for (auto const &plane: frustum.Planes) {
+            auto distance = plane.x * bounds.CenterX[i] + plane.y * bounds.CenterY[i] + plane.z * bounds.CenterZ[i] + plane.w;
+            auto radius = bounds.Radius[i] + std::abs(plane.x) * bounds.ExtentX[i] + std::abs(plane.y) * bounds.ExtentY[i] + std::abs(plane.z) * bounds.ExtentZ[i];
+            inside &= distance + radius >= 0.0f;
+        }
+        // Branchless compaction, the slot is simply overwritten when the object is culled.
+        out[count] = i;
+        count += inside ? 1 : 0;
+    }
+    return count;
+}
+
+#if CULL_X86
+CULL_TARGET("sse2")
+static u32 CullSSE(Bounds const &bounds, Frustum const &frustum, u32 begin, u32 end, u32 *out)
+{
+    auto const signMask = _mm_set1_ps(-0.0f);
+    auto const zero = _mm_setzero_ps();
+    __m128 planes[6][4], absolute[6][3];
+    for (u32 p = 0; p < 6; p++) {
+        for (u32 c = 0; c < 4; c++) {
+            planes[p][c] = _mm_set1_ps(frustum.Planes[p][static_cast<int>(c)]);
+        }
+        for (u32 c = 0; c < 3; c++) {
+            absolute[p][c] = _mm_andnot_ps(signMask, planes[p][c]);
+        }
+    }
+
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += 4) {
+        auto cx = _mm_loadu_ps(&bounds.CenterX[i]);
+        auto cy = _mm_loadu_ps(&bounds.CenterY[i]);
+        auto cz = _mm_loadu_ps(&bounds.CenterZ[i]);
+        auto ex = _mm_loadu_ps(&bounds.ExtentX[i]);
+        auto ey = _mm_loadu_ps(&bounds.ExtentY[i]);
+        auto ez = _mm_loadu_ps(&bounds.ExtentZ[i]);
+        auto r = _mm_loadu_ps(&bounds.Radius[i]);
+
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (u32 p = 0; p < 6; p++) {
+            auto distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, planes[p][0]), _mm_mul_ps(cy, planes[p][1])),
+                                       _mm_add_ps(_mm_mul_ps(cz, planes[p][2]), planes[p][3]));
+            auto radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, absolute[p][0]), _mm_mul_ps(ey, absolute[p][1])),
+                                     _mm_add_ps(_mm_mul_ps(ez, absolute[p][2]), r));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        auto mask = static_cast<u32>(_mm_movemask_ps(inside));
+        while (mask != 0) {
+            out[count++] = i + static_cast<u32>(std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count;
+}
+
+CULL_TARGET("avx2,fma")
+static u32 CullAVX2(Bounds const &bounds, Frustum const &frustum, u32 begin, u32 end, u32 *out)
+{
+    auto const signMask = _mm256_set1_ps(-0.0f);
+    auto const zero = _mm256_setzero_ps();
+    __m256 planes[6][4], absolute[6][3];
+    for (u32 p = 0; p < 6; p++) {
+        for (u32 c = 0; c < 4; c++) {
+            planes[p][c] = _mm256_set1_ps(frustum.Planes[p][static_cast<int>(c)]);
+        }
+        for (u32 c = 0; c < 3; c++) {
+            absolute[p][c] = _mm256_andnot_ps(signMask, planes[p][c]);
+        }
+    }
+
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += 8) {
+        auto cx = _mm256_loadu_ps(&bounds.CenterX[i]);
+        auto cy = _mm256_loadu_ps(&bounds.CenterY[i]);
+        auto cz = _mm256_loadu_ps(&bounds.CenterZ[i]);
+        auto ex = _mm256_loadu_ps(&bounds.ExtentX[i]);
+        auto ey = _mm256_loadu_ps(&bounds.ExtentY[i]);
+        auto ez = _mm256_loadu_ps(&bounds.ExtentZ[i]);
+        auto r = _mm256_loadu_ps(&bounds.Radius[i]);
+
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (u32 p = 0; p < 6; p++) {
+            auto distance = _mm256_fmadd_ps(cx, planes[p][0], _mm256_fmadd_ps(cy, planes[p][1], _mm256_fmadd_ps(cz, planes[p][2], planes[p][3])));
+            auto radius = _mm256_fmadd_ps(ex, absolute[p][0], _mm256_fmadd_ps(ey, absolute[p][1], _mm256_fmadd_ps(ez, absolute[p][2], r)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+
+        auto mask = static_cast<u32>(_mm256_movemask_ps(inside));
+        while (mask != 0) {
+            out[count++] = i + static_cast<u32>(std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count;
+}
+
+CULL_TARGET("avx512f")
+static u32 CullAVX512(Bounds const &bounds, Frustum const &frustum, u32 begin, u32 end, u32 *out)
+{
+    auto const zero = _mm512_setzero_ps();
+    auto const lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512 planes[6][4], absolute[6][3];
+    for (u32 p = 0; p < 6; p++) {
+        for (u32 c = 0; c < 4; c++) {
+            planes[p][c] = _mm512_set1_ps(frustum.Planes[p][static_cast<int>(c)]);
+        }
+        for (u32 c = 0; c < 3; c++) {
+            absolute[p][c] = _mm512_set1_ps(std::abs(frustum.Planes[p][static_cast<int>(c)]));
+        }
+    }
+
+    u32 count = 0;
+    for (u32 i = begin; i < end; i += 16) {
+        auto cx = _mm512_loadu_ps(&bounds.CenterX[i]);
+        auto cy = _mm512_loadu_ps(&bounds.CenterY[i]);
+        auto cz = _mm512_loadu_ps(&bounds.CenterZ[i]);
+        auto ex = _mm512_loadu_ps(&bounds.ExtentX[i]);
+        auto ey = _mm512_loadu_ps(&bounds.ExtentY[i]);
+        auto ez = _mm512_loadu_ps(&bounds.ExtentZ[i]);
+        auto r = _mm512_loadu_ps(&bounds.Radius[i]);
+
+        __mmask16 inside = 0xffff;
+        for (u32 p = 0; p < 6; p++) {
+            auto distance = _mm512_fmadd_ps(cx, planes[p][0], _mm512_fmadd_ps(cy, planes[p][1], _mm512_fmadd_ps(cz, planes[p][2], planes[p][3])));
+            auto radius = _mm512_fmadd_ps(ex, absolute[p][0], _mm512_fmadd_ps(ey, absolute[p][1], _mm512_fmadd_ps(ez, absolute[p][2], r)));
+            inside = _mm512_mask_cmp_ps_mask(inside, _mm512_add_ps(distance, radius), zero, _CMP_GE_OQ);
+        }
+
+        // The compress store packs the surviving lanes, no per-bit loop needed.
+        auto indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), lanes);
+        _mm512_mask_compressstoreu_epi32(out + count, inside, indices);
+        count += static_cast<u32>(std::popcount(static_cast<u32>(inside)));
+    }
+    return count;
+}
+#endif
+
+static KernelFunction SelectKernel(FrustumCuller::Kernel kernel)
+{
+    switch (kernel) {
+#if CULL_X86
+        case FrustumCuller::Kernel::SSE:
+            return CullSSE;
+        case FrustumCuller::Kernel::AVX2:
+            return CullAVX2;
+        case FrustumCuller::Kernel::AVX512:
+            return CullAVX512;
+#endif
+        default:
+            return CullScalar;
+    }
+}
+
+bool FrustumCuller::IsSupported(Kernel kernel)
+{
+#if CULL_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    auto maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    auto xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool avx2 = false, avx512f = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512f = (info[1] & (1 << 16)) != 0;
+    }
+    // The OS has to save the wider registers on context switches as well.
+    bool ymm = avx && (xcr0 & 0x6) == 0x6;
+    bool zmm = ymm && (xcr0 & 0xe0) == 0xe0;
+
+    switch (kernel) {
+        case Kernel::Scalar:
+            return true;
+        case Kernel::SSE:
+            return sse2;
+        case Kernel::AVX2:
+            return ymm && avx2 && fma;
+        case Kernel::AVX512:
+            return zmm && avx512f;
+    }
+#else
+    __builtin_cpu_init();
+    switch (kernel) {
+        case Kernel::Scalar:
+            return true;
+        case Kernel::SSE:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case Kernel::AVX512:
+            return __builtin_cpu_supports("avx512f");
+    }
+#endif
+#endif
+    return kernel == Kernel::Scalar;
+}
+
+FrustumCuller::Kernel FrustumCuller::DetectKernel()
+{
+    for (auto kernel: {Kernel::AVX512, Kernel::AVX2, Kernel::SSE}) {
+        if (IsSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return Kernel::Scalar;
+}
+
+char const *FrustumCuller::KernelName(Kernel kernel)
+{
+    switch (kernel) {
+        case Kernel::Scalar:
+            return "Scalar";
+        case Kernel::SSE:
+            return "SSE";
+        case Kernel::AVX2:
+            return "AVX2";
+        case Kernel::AVX512:
+            return "AVX-512";
+    }
+    return "Unknown";
+}
+
+FrustumCuller::FrustumCuller(Kernel kernel)
+{
+    SetKernel(kernel);
+}
+
+void FrustumCuller::Reserve(u32 count)
+{
+    auto padded = (count + Padding - 1) / Padding * Padding;
+    for (auto *array: {&m_bounds.CenterX, &m_bounds.CenterY, &m_bounds.CenterZ, &m_bounds.ExtentX, &m_bounds.ExtentY, &m_bounds.ExtentZ, &m_bounds.Radius}) {
+        array->reserve(padded);
+    }
+}
+
+void FrustumCuller::Clear()
+{
+    for (auto *array: {&m_bounds.CenterX, &m_bounds.CenterY, &m_bounds.CenterZ, &m_bounds.ExtentX, &m_bounds.ExtentY, &m_bounds.ExtentZ, &m_bounds.Radius}) {
+        array->clear();
+    }
+    m_count = 0;
+}
+
+u32 FrustumCuller::Append(glm::vec3 const &center, glm::vec3 const &extents, f32 radius)
+{
+    if (m_count == m_bounds.Radius.size()) {
+        // Padding objects have a hugely negative radius and can never be visible.
+        auto padded = m_count + Padding;
+        for (auto *array: {&m_bounds.CenterX, &m_bounds.CenterY, &m_bounds.CenterZ, &m_bounds.ExtentX, &m_bounds.ExtentY, &m_bounds.ExtentZ}) {
+            array->resize(padded, 0.0f);
+        }
+        m_bounds.Radius.resize(padded, std::numeric_limits<f32>::lowest());
+    }
+
+    auto index = m_count++;
+    Write(index, center, extents, radius);
+    return index;
+}
+
+void FrustumCuller::Write(u32 index, glm::vec3 const &center, glm::vec3 const &extents, f32 radius)
+{
+    m_bounds.CenterX[index] = center.x;
+    m_bounds.CenterY[index] = center.y;
+    m_bounds.CenterZ[index] = center.z;
+    m_bounds.ExtentX[index] = extents.x;
+    m_bounds.ExtentY[index] = extents.y;
+    m_bounds.ExtentZ[index] = extents.z;
+    m_bounds.Radius[index] = radius;
+}
+
+u32 FrustumCuller::AddSphere(glm::vec3 const &center, f32 radius)
+{
+    return Append(center, glm::vec3(0.0f), radius);
+}
+
+u32 FrustumCuller::AddBox(glm::vec3 const &min, glm::vec3 const &max)
+{
+    return Append(0.5f * (min + max), 0.5f * (max - min), 0.0f);
+}
+
+void FrustumCuller::SetSphere(u32 index, glm::vec3 const &center, f32 radius)
+{
+    if (index < m_count) {
+        Write(index, center, glm::vec3(0.0f), radius);
+    }
+}
+
+glm::vec3 FrustumCuller::Center(u32 index) const
+{
+    return {m_bounds.CenterX[index], m_bounds.CenterY[index], m_bounds.CenterZ[index]};
+}
+
+void FrustumCuller::SetBox(u32 index, glm::vec3 const &min, glm::vec3 const &max)
+{
+    if (index < m_count) {
+        Write(index, 0.5f * (min + max), 0.5f * (max - min), 0.0f);
+    }
+}
+
+u32 FrustumCuller::Cull(Frustum const &frustum, std::vector<u32> &visible, JobSystem *jobs)
+{
+    auto padded = static_cast<u32>(m_bounds.Radius.size());
+    if (m_count == 0) {
+        visible.clear();
+        return 0;
+    }
+
+    // Every chunk writes its survivors to the front of its own range, then the ranges are packed.
+    auto kernel = SelectKernel(m_kernel);
+    auto chunks = (padded + ChunkSize - 1) / ChunkSize;
+    visible.resize(padded);
+    m_chunkCounts.assign(chunks, 0);
+
+    auto run = [&](u32 begin, u32 end) {
+        m_chunkCounts[begin / ChunkSize] = kernel(m_bounds, frustum, begin, end, visible.data() + begin);
+    };
+    if (jobs != nullptr) {
+        jobs->ParallelFor(padded, ChunkSize, run);
+    } else {
+        for (u32 begin = 0; begin < padded; begin += ChunkSize) {
+            run(begin, std::min(begin + ChunkSize, padded));
+        }
+    }
+
+    u32 total = 0;
+    for (u32 chunk = 0; chunk < chunks; chunk++) {
+        auto begin = chunk * ChunkSize;
+        auto count = m_chunkCounts[chunk];
+        if (total != begin && count > 0) {
+            std::memmove(visible.data() + total, visible.data() + begin, count * sizeof(u32));
+        }
+        total += count;
+    }
+    visible.resize(total);
+    return total;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <vector>
+
+class JobSystem;
+
+struct Frustum {
+    // Normalized planes, a point is inside when dot(xyz, p) + w >= 0 for all of them.
+    glm::vec4 Planes[6];
+
+    MUST_USE static Frustum FromViewProjection(glm::mat4 const &viewProjection);
+};
+
+// Homogeneous viewer position of a view-projection, the point every view ray starts from. w is 0
+// for orthographic projections, xyz then points from the scene towards the viewer.
+MUST_USE glm::vec4 EyeFromViewProjection(glm::mat4 const &viewProjection);
+
+// Moves a bounding sphere (xyz center, w radius) by `transform`, scaling the radius by the largest axis.
+MUST_USE glm::vec4 TransformSphere(glm::vec4 const &sphere, glm::mat4 const &transform);
+
+// CPU visibility pass over bounding volumes kept in structure-of-arrays form, so the plane
+// tests run 4, 8 or 16 objects per instruction. Every object is a box with an optional
+// sphere radius added on top: spheres have zero extents, boxes have a zero radius.
+class FrustumCuller {
+public:
+    enum class Kernel {
+        Scalar,
+        SSE,
+        AVX2,
+        AVX512,
+    };
+
+    // Storage is padded to this many objects so kernels never need a remainder loop.
+    static constexpr u32 Padding = 16;
+
+    struct Bounds {
+        std::vector<f32> CenterX, CenterY, CenterZ;
+        std::vector<f32> ExtentX, ExtentY, ExtentZ;
+        std::vector<f32> Radius;
+    };
+
+private:
+    Bounds m_bounds;
+    u32 m_count{};
+    Kernel m_kernel;
+    std::vector<u32> m_chunkCounts;
+
+public:
+    explicit FrustumCuller(Kernel kernel = DetectKernel());
+
+    MUST_USE static Kernel DetectKernel();
+    MUST_USE static bool IsSupported(Kernel kernel);
+    MUST_USE static char const *KernelName(Kernel kernel);
+
+    MUST_USE u32 AddSphere(glm::vec3 const &center, f32 radius);
+    MUST_USE u32 AddBox(glm::vec3 const &min, glm::vec3 const &max);
+    void SetSphere(u32 index, glm::vec3 const &center, f32 radius);
+    void SetBox(u32 index, glm::vec3 const &min, glm::vec3 const &max);
+    MUST_USE glm::vec3 Center(u32 index) const;
+    void Reserve(u32 count);
+    void Clear();
+
+    // Writes the indices of every object touching the frustum to `visible` in ascending order
+    // and returns how many there are. Splits the work across `jobs` when given.
+    u32 Cull(Frustum const &frustum, std::vector<u32> &visible, JobSystem *jobs = nullptr);
+
+    void SetKernel(Kernel kernel) { m_kernel = IsSupported(kernel) ? kernel : Kernel::Scalar; }
+    MUST_USE Kernel ActiveKernel() const { return m_kernel; }
+    MUST_USE u32 Size() const { return m_count; }
+
+private:
+    u32 Append(glm::vec3 const &center, glm::vec3 const &extents, f32 radius);
+    void Write(u32 index, glm::vec3 const &center, glm::vec3 const &extents, f32 radius);
+};
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "GeometryArena.h"
+#include "Logger.h"
+#include <algorithm>
+#include <limits>
+
+RangeAllocator::RangeAllocator(u32 capacity) : m_capacity(capacity)
+{
+    m_free.push_back({0, capacity});
+}
+
+u32 RangeAllocator::Allocate(u32 size)
+{
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->Size < size) {
+            continue;
+        }
+
+        auto offset = it->Offset;
+        it->Offset += size;
+        it->Size -= size;
+        if (it->Size == 0) {
+            m_free.erase(it);
+        }
+        m_used += size;
+        return offset;
+    }
+    return InvalidOffset;
+}
+
+void RangeAllocator::Free(u32 offset, u32 size)
+{
+    auto it = std::lower_bound(m_free.begin(), m_free.end(), offset, [](Range const &range, u32 value) { return range.Offset < value; });
+    it = m_free.insert(it, {offset, size});
+    m_used -= size;
+
+    // Merge with the following range, then with the preceding one.
+    auto next = it + 1;
+    if (next != m_free.end() && it->Offset + it->Size == next->Offset) {
+        it->Size += next->Size;
+        m_free.erase(next);
+    }
+    if (it != m_free.begin()) {
+        auto previous = it - 1;
+        if (previous->Offset + previous->Size == it->Offset) {
+            previous->Size += it->Size;
+            m_free.erase(it);
+        }
+    }
+}
+
+GeometryArena::GeometryArena(Device &device, u32 maxVertices, u32 maxIndices)
+    : m_device(device), m_ranges(std::make_shared<Ranges>(maxVertices, maxIndices))
+{
+    auto vertexBuffer = m_device.CreateBuffer(
+            sizeof(Model::Vertex) * static_cast<VkDeviceSize>(maxVertices),
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_vertexBuffer = vertexBuffer.Buffer;
+    m_vertexMemory = vertexBuffer.Memory;
+
+    auto indexBuffer = m_device.CreateBuffer(
+            sizeof(u32) * static_cast<VkDeviceSize>(maxIndices),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_indexBuffer = indexBuffer.Buffer;
+    m_indexMemory = indexBuffer.Memory;
+
+    INFOF("Created geometry arena: {} vertices, {} indices", maxVertices, maxIndices);
+}
+
+GeometryArena::~GeometryArena()
+{
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), budget = &m_device.Memory(),
+                              vertexBuffer = m_vertexBuffer, vertexMemory = m_vertexMemory,
+                              indexBuffer = m_indexBuffer, indexMemory = m_indexMemory] {
+        vkDestroyBuffer(device, vertexBuffer, nullptr);
+        budget->Free(device, vertexMemory);
+        vkDestroyBuffer(device, indexBuffer, nullptr);
+        budget->Free(device, indexMemory);
+    });
+}
+
+MeshAllocation GeometryArena::Upload(std::span<Model::Vertex const> vertices, std::span<u32 const> indices)
+{
+    MeshAllocation mesh{
+            .VertexCount = static_cast<u32>(vertices.size()),
+            .IndexCount = static_cast<u32>(indices.size()),
+    };
+
+    {
+        std::scoped_lock lock(m_ranges->Mutex);
+        mesh.FirstVertex = m_ranges->Vertices.Allocate(mesh.VertexCount);
+        mesh.FirstIndex = m_ranges->Indices.Allocate(mesh.IndexCount);
+        if (mesh.FirstVertex == RangeAllocator::InvalidOffset || mesh.FirstIndex == RangeAllocator::InvalidOffset) {
+            ERRORF("Geometry arena is full: {} vertices and {} indices requested", mesh.VertexCount, mesh.IndexCount);
+            if (mesh.FirstVertex != RangeAllocator::InvalidOffset) {
+                m_ranges->Vertices.Free(mesh.FirstVertex, mesh.VertexCount);
+            }
+            if (mesh.FirstIndex != RangeAllocator::InvalidOffset) {
+                m_ranges->Indices.Free(mesh.FirstIndex, mesh.IndexCount);
+            }
+            return {};
+        }
+    }
+
+    glm::vec2 min{std::numeric_limits<f32>::max()}, max{std::numeric_limits<f32>::lowest()};
+    for (auto const &vertex: vertices) {
+        min = glm::min(min, vertex.Position);
+        max = glm::max(max, vertex.Position);
+    }
+    auto center = 0.5f * (min + max);
+    f32 radius = 0.0f;
+    for (auto const &vertex: vertices) {
+        radius = std::max(radius, glm::length(vertex.Position - center));
+    }
+    mesh.Bounds = glm::vec4(center, 0.0f, radius);
+
+    m_device.UploadBuffer(m_vertexBuffer, sizeof(Model::Vertex) * static_cast<VkDeviceSize>(mesh.FirstVertex), vertices.data(), vertices.size_bytes());
+    m_device.UploadBuffer(m_indexBuffer, sizeof(u32) * static_cast<VkDeviceSize>(mesh.FirstIndex), indices.data(), indices.size_bytes());
+    return mesh;
+}
+
+void GeometryArena::Free(MeshAllocation const &mesh)
+{
+    if (!mesh.IsValid()) {
+        return;
+    }
+    m_device.Deletion().Push([ranges = m_ranges, mesh] {
+        std::scoped_lock lock(ranges->Mutex);
+        ranges->Vertices.Free(mesh.FirstVertex, mesh.VertexCount);
+        ranges->Indices.Free(mesh.FirstIndex, mesh.IndexCount);
+    });
+}
+
+void GeometryArena::Bind(VkCommandBuffer commandBuffer)
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    m_device.Stats().Add(RenderCounter::VertexBufferBinds);
+    m_device.Stats().Add(RenderCounter::IndexBufferBinds);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "Model.h"
+#include "Types.h"
+#include <mutex>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// First-fit allocator over a range of elements, adjacent free ranges are merged on release.
+class RangeAllocator {
+    struct Range {
+        u32 Offset;
+        u32 Size;
+    };
+
+    std::vector<Range> m_free;
+    u32 m_capacity{};
+    u32 m_used{};
+
+public:
+    static constexpr u32 InvalidOffset = ~0u;
+
+    explicit RangeAllocator(u32 capacity);
+
+    MUST_USE u32 Allocate(u32 size);
+    void Free(u32 offset, u32 size);
+
+    MUST_USE u32 Capacity() const { return m_capacity; }
+    MUST_USE u32 Used() const { return m_used; }
+};
+
+struct MeshAllocation {
+    u32 FirstVertex{};
+    u32 VertexCount{};
+    u32 FirstIndex{};
+    u32 IndexCount{};
+    // Object-space bounding sphere, xyz center and w radius.
+    glm::vec4 Bounds{};
+
+    MUST_USE bool IsValid() const { return IndexCount > 0; }
+};
+
+// One device-local vertex buffer and one index buffer that every mesh is sub-allocated from,
+// so the GPU-driven path binds geometry once per pass.
+class GeometryArena {
+    Device &m_device;
+    VkBuffer m_vertexBuffer{};
+    VkDeviceMemory m_vertexMemory{};
+    VkBuffer m_indexBuffer{};
+    VkDeviceMemory m_indexMemory{};
+
+    // Shared with pending deletion queue entries, which may run after the arena is gone.
+    struct Ranges {
+        std::mutex Mutex;
+        RangeAllocator Vertices;
+        RangeAllocator Indices;
+
+        Ranges(u32 maxVertices, u32 maxIndices) : Vertices(maxVertices), Indices(maxIndices) {}
+    };
+    Ref<Ranges> m_ranges;
+
+public:
+    GeometryArena(Device &device, u32 maxVertices, u32 maxIndices);
+    ~GeometryArena();
+    GeometryArena(GeometryArena const &other) = delete;
+    GeometryArena &operator=(GeometryArena const &other) = delete;
+
+    // Indices are relative to the mesh, draws add FirstVertex as the vertex offset.
+    MUST_USE MeshAllocation Upload(std::span<Model::Vertex const> vertices, std::span<u32 const> indices);
+    // The ranges become reusable once the GPU is done with the current frame.
+    void Free(MeshAllocation const &mesh);
+
+    void Bind(VkCommandBuffer commandBuffer);
+
+    MUST_USE VkBuffer VertexBuffer() const { return m_vertexBuffer; }
+    MUST_USE VkBuffer IndexBuffer() const { return m_indexBuffer; }
+    MUST_USE u32 VertexCapacity() const { return m_ranges->Vertices.Capacity(); }
+    MUST_USE u32 IndexCapacity() const { return m_ranges->Indices.Capacity(); }
+    MUST_USE u32 VerticesUsed() const { return m_ranges->Vertices.Used(); }
+    MUST_USE u32 IndicesUsed() const { return m_ranges->Indices.Used(); }
+};
\ No newline at end of file
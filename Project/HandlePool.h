@@ -0,0 +1,106 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <optional>
+#include <span>
+#include <vector>
+
+// Index plus generation. A handle goes stale as soon as its slot is removed, even if the slot
+// gets reused later, so stale handles are detected instead of aliasing a new object.
+template<typename T>
+struct Handle {
+    static constexpr u32 InvalidIndex = ~0u;
+
+    u32 Index{InvalidIndex};
+    u32 Generation{0};
+
+    MUST_USE bool IsValid() const { return Index != InvalidIndex; }
+    bool operator==(Handle const &other) const = default;
+};
+
+// Values are kept densely packed for iteration, handles go through a sparse slot table.
+template<typename T>
+class HandlePool {
+    struct Slot {
+        u32 DenseIndex{};
+        u32 Generation{1};
+    };
+
+    std::vector<T> m_dense;
+    std::vector<u32> m_denseToSlot;
+    std::vector<Slot> m_slots;
+    std::vector<u32> m_freeSlots;
+
+public:
+    MUST_USE Handle<T> Insert(T value)
+    {
+        u32 slotIndex;
+        if (!m_freeSlots.empty()) {
+            slotIndex = m_freeSlots.back();
+            m_freeSlots.pop_back();
+        } else {
+            slotIndex = static_cast<u32>(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        auto &slot = m_slots[slotIndex];
+        slot.DenseIndex = static_cast<u32>(m_dense.size());
+        m_dense.push_back(std::move(value));
+        m_denseToSlot.push_back(slotIndex);
+        return {slotIndex, slot.Generation};
+    }
+
+    MUST_USE bool Contains(Handle<T> handle) const
+    {
+        return handle.Index < m_slots.size() && m_slots[handle.Index].Generation == handle.Generation;
+    }
+
+    MUST_USE T *Get(Handle<T> handle)
+    {
+        return Contains(handle) ? &m_dense[m_slots[handle.Index].DenseIndex] : nullptr;
+    }
+
+    MUST_USE T const *Get(Handle<T> handle) const
+    {
+        return Contains(handle) ? &m_dense[m_slots[handle.Index].DenseIndex] : nullptr;
+    }
+
+    std::optional<T> Remove(Handle<T> handle)
+    {
+        if (!Contains(handle)) {
+            return std::nullopt;
+        }
+
+        auto &slot = m_slots[handle.Index];
+        auto denseIndex = slot.DenseIndex;
+        T value = std::move(m_dense[denseIndex]);
+
+        // Swap the last element into the hole to keep the array dense.
+        auto last = static_cast<u32>(m_dense.size() - 1);
+        if (denseIndex != last) {
+            m_dense[denseIndex] = std::move(m_dense[last]);
+            m_denseToSlot[denseIndex] = m_denseToSlot[last];
+            m_slots[m_denseToSlot[denseIndex]].DenseIndex = denseIndex;
+        }
+        m_dense.pop_back();
+        m_denseToSlot.pop_back();
+
+        slot.Generation++;
+        m_freeSlots.push_back(handle.Index);
+        return value;
+    }
+
+    void Clear()
+    {
+        for (auto slotIndex: m_denseToSlot) {
+            m_slots[slotIndex].Generation++;
+            m_freeSlots.push_back(slotIndex);
+        }
+        m_dense.clear();
+        m_denseToSlot.clear();
+    }
+
+    MUST_USE u32 Size() const { return static_cast<u32>(m_dense.size()); }
+    MUST_USE std::span<T> Values() { return m_dense; }
+    MUST_USE std::span<T const> Values() const { return m_dense; }
+};
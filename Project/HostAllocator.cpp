@@ -0,0 +1,242 @@
+#include "HostAllocator.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Sits right in front of every block we hand out.
+struct BlockHeader {
+    u64 Size;
+    // Heap blocks: distance back to what malloc returned. Arena blocks: the arena top before.
+    u32 Offset;
+    u8 Scope;
+    bool InArena;
+};
+static_assert(sizeof(BlockHeader) == 16);
+
+// Large enough for the temporaries of pipeline creation on the drivers we run on, anything
+// bigger falls back to the heap.
+static constexpr size_t ArenaSize = 256 * 1024;
+
+struct CommandArena {
+    Ptr<std::byte[]> Storage;
+    size_t Top{};
+    u32 Live{};
+
+    MUST_USE bool Contains(void const *memory) const
+    {
+        auto const *byte = static_cast<std::byte const *>(memory);
+        return Storage && byte >= Storage.get() && byte < Storage.get() + ArenaSize;
+    }
+};
+
+// Command scope allocations never outlive the call that made them, so they are always freed on
+// the thread that allocated them and the arena needs no locking.
+static thread_local CommandArena t_Arena;
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void RaisePeak(std::atomic<u64> &peakBytes, u64 live)
+{
+    auto peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+static BlockHeader *HeaderOf(void *memory)
+{
+    return reinterpret_cast<BlockHeader *>(static_cast<std::byte *>(memory) - sizeof(BlockHeader));
+}
+
+HostAllocator::HostAllocator()
+{
+    m_callbacks = VkAllocationCallbacks{
+            .pUserData = this,
+            .pfnAllocation = [](void *user, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+                return static_cast<HostAllocator *>(user)->Allocate(size, alignment, scope);
+            },
+            .pfnReallocation = [](void *user, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+                return static_cast<HostAllocator *>(user)->Reallocate(original, size, alignment, scope);
+            },
+            .pfnFree = [](void *user, void *memory) {
+                static_cast<HostAllocator *>(user)->Free(memory);
+            },
+            .pfnInternalAllocation = [](void *user, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+                static_cast<HostAllocator *>(user)->m_scopes[scope].InternalBytes.fetch_add(size, std::memory_order_relaxed);
+            },
+            .pfnInternalFree = [](void *user, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+                static_cast<HostAllocator *>(user)->m_scopes[scope].InternalBytes.fetch_sub(size, std::memory_order_relaxed);
+            },
+    };
+}
+
+void *HostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (size == 0) {
+        return nullptr;
+    }
+    alignment = std::max(alignment, alignof(std::max_align_t));
+
+    if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+        auto &arena = t_Arena;
+        if (!arena.Storage) {
+            arena.Storage = std::make_unique_for_overwrite<std::byte[]>(ArenaSize);
+        }
+        auto offset = AlignUp(arena.Top + sizeof(BlockHeader), alignment);
+        if (offset + size <= ArenaSize) {
+            auto *memory = arena.Storage.get() + offset;
+            *HeaderOf(memory) = BlockHeader{size, static_cast<u32>(arena.Top), static_cast<u8>(scope), true};
+            arena.Top = offset + size;
+            arena.Live++;
+            m_churnArena.fetch_add(1, std::memory_order_relaxed);
+            Track(scope, size);
+            return memory;
+        }
+    }
+
+    auto *raw = static_cast<std::byte *>(std::malloc(size + alignment + sizeof(BlockHeader)));
+    if (raw == nullptr) {
+        return nullptr;
+    }
+    auto address = AlignUp(reinterpret_cast<uintptr_t>(raw) + sizeof(BlockHeader), alignment);
+    auto *memory = reinterpret_cast<std::byte *>(address);
+    *HeaderOf(memory) = BlockHeader{size, static_cast<u32>(memory - raw), static_cast<u8>(scope), false};
+    Track(scope, size);
+    return memory;
+}
+
+void *HostAllocator::Reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (original == nullptr) {
+        return Allocate(size, alignment, scope);
+    }
+    if (size == 0) {
+        Free(original);
+        return nullptr;
+    }
+
+    // The newest arena block grows or shrinks in place, which is the usual pattern of a driver
+    // building up an array during one call.
+    auto *header = HeaderOf(original);
+    auto &arena = t_Arena;
+    if (header->InArena && arena.Contains(original)) {
+        auto offset = static_cast<size_t>(static_cast<std::byte *>(original) - arena.Storage.get());
+        if (offset + header->Size == arena.Top && offset + size <= ArenaSize) {
+            Resize(static_cast<VkSystemAllocationScope>(header->Scope), header->Size, size);
+            header->Size = size;
+            arena.Top = offset + size;
+            return original;
+        }
+    }
+
+    auto *memory = Allocate(size, alignment, scope);
+    if (memory != nullptr) {
+        std::memcpy(memory, original, std::min<size_t>(size, header->Size));
+        Free(original);
+    }
+    return memory;
+}
+
+void HostAllocator::Free(void *memory)
+{
+    if (memory == nullptr) {
+        return;
+    }
+
+    auto *header = HeaderOf(memory);
+    Untrack(static_cast<VkSystemAllocationScope>(header->Scope), header->Size);
+    if (!header->InArena) {
+        std::free(static_cast<std::byte *>(memory) - header->Offset);
+        return;
+    }
+
+    auto &arena = t_Arena;
+    if (!arena.Contains(memory)) {
+        ERROR("Command scope allocation freed on another thread than it was made on");
+        return;
+    }
+    // Freed in reverse order the top just walks back, otherwise the space comes back once the
+    // call that made the allocations is done with all of them.
+    if (static_cast<std::byte *>(memory) + header->Size == arena.Storage.get() + arena.Top) {
+        arena.Top = header->Offset;
+    }
+    if (--arena.Live == 0) {
+        arena.Top = 0;
+    }
+}
+
+void HostAllocator::Track(VkSystemAllocationScope scope, size_t size)
+{
+    auto &counters = m_scopes[scope];
+    counters.Allocations.fetch_add(1, std::memory_order_relaxed);
+    auto live = counters.LiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    RaisePeak(counters.PeakBytes, live);
+    m_churnAllocations.fetch_add(1, std::memory_order_relaxed);
+    m_churnBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void HostAllocator::Resize(VkSystemAllocationScope scope, size_t oldSize, size_t newSize)
+{
+    // Still the same allocation, only the bytes it grew by count as churn.
+    auto &counters = m_scopes[scope];
+    if (newSize > oldSize) {
+        auto grown = newSize - oldSize;
+        auto live = counters.LiveBytes.fetch_add(grown, std::memory_order_relaxed) + grown;
+        RaisePeak(counters.PeakBytes, live);
+        m_churnBytes.fetch_add(grown, std::memory_order_relaxed);
+    } else {
+        counters.LiveBytes.fetch_sub(oldSize - newSize, std::memory_order_relaxed);
+    }
+}
+
+void HostAllocator::Untrack(VkSystemAllocationScope scope, size_t size)
+{
+    m_scopes[scope].LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+HostAllocator::ScopeStats HostAllocator::Scope(VkSystemAllocationScope scope) const
+{
+    auto const &counters = m_scopes[scope];
+    return ScopeStats{
+            .Allocations = counters.Allocations.load(std::memory_order_relaxed),
+            .LiveBytes = counters.LiveBytes.load(std::memory_order_relaxed),
+            .PeakBytes = counters.PeakBytes.load(std::memory_order_relaxed),
+            .InternalBytes = counters.InternalBytes.load(std::memory_order_relaxed),
+    };
+}
+
+u64 HostAllocator::LiveBytes() const
+{
+    u64 live = 0;
+    for (auto const &counters: m_scopes) {
+        live += counters.LiveBytes.load(std::memory_order_relaxed);
+    }
+    return live;
+}
+
+HostAllocator::Churn HostAllocator::TakeChurn()
+{
+    return Churn{
+            .Allocations = m_churnAllocations.exchange(0, std::memory_order_relaxed),
+            .Bytes = m_churnBytes.exchange(0, std::memory_order_relaxed),
+            .ArenaAllocations = m_churnArena.exchange(0, std::memory_order_relaxed),
+    };
+}
+
+void HostAllocator::LogSummary() const
+{
+    static constexpr char const *ScopeNames[ScopeCount] = {"command", "object", "cache", "device", "instance"};
+    for (u32 i = 0; i < ScopeCount; i++) {
+        auto stats = Scope(static_cast<VkSystemAllocationScope>(i));
+        if (stats.Allocations == 0 && stats.InternalBytes == 0) {
+            continue;
+        }
+        INFOF("Host allocations, {} scope: {} total, {} KiB live, {} KiB peak, {} KiB internal",
+              ScopeNames[i], stats.Allocations, stats.LiveBytes / 1024, stats.PeakBytes / 1024, stats.InternalBytes / 1024);
+    }
+}
\ No newline at end of file
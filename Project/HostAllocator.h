@@ -0,0 +1,66 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <array>
+#include <atomic>
+#include <vulkan/vulkan.h>
+
+// VkAllocationCallbacks that account every driver host allocation by scope. Command scope
+// allocations only live for the duration of one Vulkan call, they are bumped out of a small
+// per-thread arena instead of going through malloc. Objects must be destroyed with the same
+// callbacks they were created with, so an object created through these never mixes with nullptr.
+class HostAllocator {
+public:
+    static constexpr u32 ScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+    struct ScopeStats {
+        u64 Allocations{};
+        u64 LiveBytes{};
+        u64 PeakBytes{};
+        // Reported by the driver through the internal allocation notifications, not ours.
+        u64 InternalBytes{};
+    };
+
+    // What was allocated since the last TakeChurn(), frees do not cancel it out.
+    struct Churn {
+        u64 Allocations{};
+        u64 Bytes{};
+        u64 ArenaAllocations{};
+    };
+
+private:
+    struct Counters {
+        std::atomic<u64> Allocations{0};
+        std::atomic<u64> LiveBytes{0};
+        std::atomic<u64> PeakBytes{0};
+        std::atomic<u64> InternalBytes{0};
+    };
+
+    VkAllocationCallbacks m_callbacks{};
+    std::array<Counters, ScopeCount> m_scopes{};
+    std::atomic<u64> m_churnAllocations{0};
+    std::atomic<u64> m_churnBytes{0};
+    std::atomic<u64> m_churnArena{0};
+
+public:
+    HostAllocator();
+    HostAllocator(HostAllocator const &other) = delete;
+    HostAllocator &operator=(HostAllocator const &other) = delete;
+
+    MUST_USE VkAllocationCallbacks const *Callbacks() const { return &m_callbacks; }
+
+    MUST_USE ScopeStats Scope(VkSystemAllocationScope scope) const;
+    MUST_USE u64 LiveBytes() const;
+    MUST_USE Churn TakeChurn();
+    // One line per scope that saw any allocation.
+    void LogSummary() const;
+
+private:
+    MUST_USE void *Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    MUST_USE void *Reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void Free(void *memory);
+    void Track(VkSystemAllocationScope scope, size_t size);
+    // A block grown or shrunk in place, neither a new allocation nor a free.
+    void Resize(VkSystemAllocationScope scope, size_t oldSize, size_t newSize);
+    void Untrack(VkSystemAllocationScope scope, size_t size);
+};
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "IndirectRenderer.h"
+#include "FrustumCuller.h"
+#include "Logger.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+IndirectRenderer::IndirectRenderer(Device &device, BindlessHeap &bindless, u32 maxObjects)
+    : m_device(device), m_bindless(bindless), m_maxObjects(maxObjects)
+{
+    auto objects = m_device.CreateBuffer(
+            sizeof(GpuObject) * static_cast<VkDeviceSize>(maxObjects),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_objectBuffer = objects.Buffer;
+    m_objectMemory = objects.Memory;
+
+    auto records = m_device.CreateBuffer(
+            sizeof(GpuDrawRecord) * static_cast<VkDeviceSize>(maxObjects),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_recordBuffer = records.Buffer;
+    m_recordMemory = records.Memory;
+
+    auto count = m_device.CreateBuffer(
+            16,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_countBuffer = count.Buffer;
+    m_countMemory = count.Memory;
+
+    m_objectBufferIndex = m_bindless.RegisterBuffer(m_objectBuffer, 0, VK_WHOLE_SIZE);
+    m_recordBufferIndex = m_bindless.RegisterBuffer(m_recordBuffer, 0, VK_WHOLE_SIZE);
+
+    m_objects.reserve(maxObjects);
+    m_records.reserve(maxObjects);
+    m_meshBounds.reserve(maxObjects);
+    m_countDirty = true;
+    INFOF("Created indirect renderer for {} objects", maxObjects);
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+    m_bindless.ReleaseBuffer(m_objectBufferIndex);
+    m_bindless.ReleaseBuffer(m_recordBufferIndex);
+
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), budget = &m_device.Memory(),
+                              buffers = std::array{m_objectBuffer, m_recordBuffer, m_countBuffer},
+                              memories = std::array{m_objectMemory, m_recordMemory, m_countMemory}] {
+        for (u32 i = 0; i < buffers.size(); i++) {
+            vkDestroyBuffer(device, buffers[i], nullptr);
+            budget->Free(device, memories[i]);
+        }
+    });
+}
+
+u32 IndirectRenderer::AddObject(MeshAllocation const &mesh, glm::mat4 const &transform)
+{
+    u32 object;
+    if (!m_freeObjects.empty()) {
+        object = m_freeObjects.back();
+        m_freeObjects.pop_back();
+    } else if (m_records.size() < m_maxObjects) {
+        object = static_cast<u32>(m_records.size());
+        m_objects.emplace_back();
+        m_records.emplace_back();
+        m_meshBounds.emplace_back();
+        m_countDirty = true;
+    } else {
+        ERROR("Indirect renderer is out of object slots");
+        return InvalidObject;
+    }
+
+    m_meshBounds[object] = mesh.Bounds;
+    m_objects[object] = GpuObject{
+            .Transform = transform,
+            .Bounds = TransformSphere(mesh.Bounds, transform),
+    };
+    m_records[object] = GpuDrawRecord{
+            .Command = VkDrawIndexedIndirectCommand{
+                    .indexCount = mesh.IndexCount,
+                    .instanceCount = 1,
+                    .firstIndex = mesh.FirstIndex,
+                    .vertexOffset = static_cast<i32>(mesh.FirstVertex),
+                    // Shaders find their object through gl_InstanceIndex.
+                    .firstInstance = object,
+            },
+            .ObjectIndex = object,
+    };
+    m_dirtyObjects.Mark(object);
+    m_dirtyRecords.Mark(object);
+    m_revision++;
+    return object;
+}
+
+void IndirectRenderer::SetTransform(u32 object, glm::mat4 const &transform)
+{
+    if (object >= m_objects.size()) {
+        return;
+    }
+    m_objects[object].Transform = transform;
+    m_objects[object].Bounds = TransformSphere(m_meshBounds[object], transform);
+    m_dirtyObjects.Mark(object);
+}
+
+void IndirectRenderer::SetMesh(u32 object, MeshAllocation const &mesh)
+{
+    if (object >= m_records.size()) {
+        return;
+    }
+    auto &command = m_records[object].Command;
+    command.indexCount = mesh.IndexCount;
+    command.firstIndex = mesh.FirstIndex;
+    command.vertexOffset = static_cast<i32>(mesh.FirstVertex);
+    m_meshBounds[object] = mesh.Bounds;
+    m_objects[object].Bounds = TransformSphere(mesh.Bounds, m_objects[object].Transform);
+    m_dirtyObjects.Mark(object);
+    m_dirtyRecords.Mark(object);
+    m_revision++;
+}
+
+void IndirectRenderer::RemoveObject(u32 object)
+{
+    if (object >= m_records.size()) {
+        return;
+    }
+    m_records[object].Command.indexCount = 0;
+    m_records[object].Command.instanceCount = 0;
+    m_objects[object].Bounds = glm::vec4(0.0f);
+    m_dirtyObjects.Mark(object);
+    m_dirtyRecords.Mark(object);
+    m_freeObjects.push_back(object);
+    m_revision++;
+}
+
+bool IndirectRenderer::CopyRange(VkCommandBuffer commandBuffer, StreamingBuffer &staging, void const *source, VkBuffer destination, u32 stride, DirtyRange &range)
+{
+    if (range.Empty()) {
+        return false;
+    }
+
+    // Large updates are spread over several frames instead of overflowing the staging ring.
+    auto budget = static_cast<u32>(staging.BytesPerFrame() / 4 / stride);
+    auto count = std::min(range.End - range.Begin, std::max(budget, 1u));
+    VkDeviceSize size = static_cast<VkDeviceSize>(count) * stride;
+
+    auto allocation = staging.Allocate(size, 16);
+    if (!allocation.IsValid()) {
+        return false;
+    }
+
+    VkDeviceSize offset = static_cast<VkDeviceSize>(range.Begin) * stride;
+    std::memcpy(allocation.Data, static_cast<u8 const *>(source) + offset, static_cast<size_t>(size));
+
+    VkBufferCopy region{
+            .srcOffset = allocation.Offset,
+            .dstOffset = offset,
+            .size = size,
+    };
+    vkCmdCopyBuffer(commandBuffer, allocation.Buffer, destination, 1, &region);
+    m_device.Stats().Add(RenderCounter::UploadedBytes, size);
+
+    range.Begin += count;
+    if (range.Empty()) {
+        range = {};
+    }
+    return true;
+}
+
+void IndirectRenderer::Upload(VkCommandBuffer commandBuffer, StreamingBuffer &staging)
+{
+    if (m_dirtyObjects.Empty() && m_dirtyRecords.Empty() && !m_countDirty) {
+        return;
+    }
+
+    // Earlier frames may still be reading these buffers.
+    vkCmdPipelineBarrier(commandBuffer,
+                         m_consumerStages,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    (void) CopyRange(commandBuffer, staging, m_objects.data(), m_objectBuffer, sizeof(GpuObject), m_dirtyObjects);
+    (void) CopyRange(commandBuffer, staging, m_records.data(), m_recordBuffer, sizeof(GpuDrawRecord), m_dirtyRecords);
+
+    if (m_countDirty) {
+        auto count = static_cast<u32>(m_records.size());
+        vkCmdUpdateBuffer(commandBuffer, m_countBuffer, 0, sizeof(count), &count);
+        m_countDirty = false;
+    }
+
+    VkMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         m_consumerStages,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+}
+
+void IndirectRenderer::Draw(VkCommandBuffer commandBuffer, VkPipelineLayout layout, GeometryArena &geometry)
+{
+    if (m_records.empty()) {
+        return;
+    }
+
+    geometry.Bind(commandBuffer);
+
+    u32 constants[] = {m_objectBufferIndex, 0};
+    vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), constants);
+
+    vkCmdDrawIndexedIndirectCount(commandBuffer, m_recordBuffer, 0, m_countBuffer, 0, static_cast<u32>(m_records.size()), sizeof(GpuDrawRecord));
+    m_device.Stats().DrawIndirect();
+}
+
+void IndirectRenderer::MarkObjectsDirty(u32 begin, u32 end)
+{
+    if (begin >= end || end > m_objects.size()) {
+        return;
+    }
+    m_dirtyObjects.Mark(begin);
+    m_dirtyObjects.Mark(end - 1);
+}
\ No newline at end of file
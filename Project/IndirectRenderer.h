@@ -0,0 +1,104 @@
+#pragma once
+#include "Definitions.h"
+#include "Descriptors.h"
+#include "Device.h"
+#include "GeometryArena.h"
+#include "StreamingBuffer.h"
+#include "Types.h"
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Matches `ObjectData` in Builtin.Indirect.vert.glsl (std430).
+struct GpuObject {
+    glm::mat4 Transform;
+    // World-space bounding sphere, xyz center and w radius.
+    glm::vec4 Bounds;
+};
+
+struct GpuDrawRecord {
+    VkDrawIndexedIndirectCommand Command;
+    u32 ObjectIndex;
+    u32 Padding[2];
+};
+static_assert(sizeof(GpuDrawRecord) == 32, "GpuDrawRecord must match the indirect stride used by shaders");
+
+// GPU-driven draw path: objects and their draw records live in device-local storage buffers
+// and a whole pass is a single vkCmdDrawIndexedIndirectCount. Only objects that changed are
+// copied each frame, so CPU cost does not scale with the number of objects.
+class IndirectRenderer {
+    struct DirtyRange {
+        u32 Begin{~0u};
+        u32 End{0};
+
+        void Mark(u32 index)
+        {
+            Begin = index < Begin ? index : Begin;
+            End = index + 1 > End ? index + 1 : End;
+        }
+        MUST_USE bool Empty() const { return Begin >= End; }
+    };
+
+    Device &m_device;
+    BindlessHeap &m_bindless;
+    u32 m_maxObjects{};
+
+    VkBuffer m_objectBuffer{};
+    VkDeviceMemory m_objectMemory{};
+    VkBuffer m_recordBuffer{};
+    VkDeviceMemory m_recordMemory{};
+    VkBuffer m_countBuffer{};
+    VkDeviceMemory m_countMemory{};
+    u32 m_objectBufferIndex{BindlessHeap::InvalidIndex};
+    u32 m_recordBufferIndex{BindlessHeap::InvalidIndex};
+
+    std::vector<GpuObject> m_objects;
+    std::vector<GpuDrawRecord> m_records;
+    std::vector<glm::vec4> m_meshBounds;
+    std::vector<u32> m_freeObjects;
+    DirtyRange m_dirtyObjects;
+    DirtyRange m_dirtyRecords;
+    bool m_countDirty{false};
+    u64 m_revision{};
+    VkPipelineStageFlags m_consumerStages{VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+
+public:
+    static constexpr u32 InvalidObject = ~0u;
+
+    IndirectRenderer(Device &device, BindlessHeap &bindless, u32 maxObjects);
+    ~IndirectRenderer();
+    IndirectRenderer(IndirectRenderer const &other) = delete;
+    IndirectRenderer &operator=(IndirectRenderer const &other) = delete;
+
+    MUST_USE u32 AddObject(MeshAllocation const &mesh, glm::mat4 const &transform);
+    void SetTransform(u32 object, glm::mat4 const &transform);
+    // Swaps the geometry an object draws, e.g. for a different detail level, keeping its transform.
+    void SetMesh(u32 object, MeshAllocation const &mesh);
+    // The slot keeps an empty draw until it is reused.
+    void RemoveObject(u32 object);
+
+    // Bulk writers may fill different objects from several threads, then report what they
+    // touched with a single MarkObjectsDirty from one thread.
+    MUST_USE GpuObject *Objects() { return m_objects.data(); }
+    void MarkObjectsDirty(u32 begin, u32 end);
+
+    // Records the copies of everything that changed since the last call. Must be outside a render pass.
+    void Upload(VkCommandBuffer commandBuffer, StreamingBuffer &staging);
+    void Draw(VkCommandBuffer commandBuffer, VkPipelineLayout layout, GeometryArena &geometry);
+    // Further stages that read the object and draw buffers, so Upload synchronizes with them too.
+    void AddConsumerStages(VkPipelineStageFlags stages) { m_consumerStages |= stages; }
+
+    MUST_USE u32 ObjectCount() const { return static_cast<u32>(m_records.size()); }
+    MUST_USE std::span<GpuDrawRecord const> Records() const { return m_records; }
+    // Bumped whenever objects are added, removed or change mesh, transforms alone do not count.
+    MUST_USE u64 Revision() const { return m_revision; }
+    MUST_USE u32 MaxObjects() const { return m_maxObjects; }
+    MUST_USE VkBuffer ObjectBuffer() const { return m_objectBuffer; }
+    MUST_USE VkBuffer RecordBuffer() const { return m_recordBuffer; }
+    MUST_USE VkBuffer CountBuffer() const { return m_countBuffer; }
+    MUST_USE u32 ObjectBufferIndex() const { return m_objectBufferIndex; }
+    MUST_USE u32 RecordBufferIndex() const { return m_recordBufferIndex; }
+
+private:
+    MUST_USE bool CopyRange(VkCommandBuffer commandBuffer, StreamingBuffer &staging, void const *source, VkBuffer destination, u32 stride, DirtyRange &range);
+};
\ No newline at end of file
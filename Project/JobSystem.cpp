@@ -0,0 +1,106 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+
+JobSystem::JobSystem(u32 workerCount)
+{
+    if (workerCount == 0) {
+        auto hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+
+    m_workers.reserve(workerCount);
+    for (u32 i = 0; i < workerCount; i++) {
+        m_workers.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker: m_workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::Schedule(std::function<void()> job)
+{
+    if (m_workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::scoped_lock lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_one();
+}
+
+void JobSystem::WorkerLoop()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void JobSystem::ParallelFor(u32 count, u32 grain, std::function<void(u32 begin, u32 end)> const &body)
+{
+    grain = std::max(grain, 1u);
+    auto chunks = (count + grain - 1) / grain;
+    if (chunks == 0) {
+        return;
+    }
+    if (chunks == 1 || m_workers.empty()) {
+        body(0, count);
+        return;
+    }
+
+    // Helpers that only get to run after the loop finished must not touch the caller's stack.
+    struct Loop {
+        std::function<void(u32, u32)> Body;
+        u32 Count;
+        u32 Grain;
+        u32 Chunks;
+        std::atomic<u32> Next{0};
+        std::atomic<u32> Done{0};
+    };
+    auto loop = std::make_shared<Loop>(body, count, grain, chunks);
+
+    auto work = [](Loop &state) {
+        u32 finished = 0;
+        for (auto chunk = state.Next.fetch_add(1, std::memory_order_relaxed); chunk < state.Chunks;
+             chunk = state.Next.fetch_add(1, std::memory_order_relaxed)) {
+            auto begin = chunk * state.Grain;
+            state.Body(begin, std::min(begin + state.Grain, state.Count));
+            finished++;
+        }
+        if (finished > 0 && state.Done.fetch_add(finished, std::memory_order_acq_rel) + finished == state.Chunks) {
+            state.Done.notify_all();
+        }
+    };
+
+    auto helpers = std::min(chunks - 1, WorkerCount());
+    for (u32 i = 0; i < helpers; i++) {
+        Schedule([loop, work] { work(*loop); });
+    }
+    work(*loop);
+
+    for (auto done = loop->Done.load(std::memory_order_acquire); done < chunks; done = loop->Done.load(std::memory_order_acquire)) {
+        loop->Done.wait(done, std::memory_order_acquire);
+    }
+}
\ No newline at end of file
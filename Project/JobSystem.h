@@ -0,0 +1,36 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for data-parallel loops. The calling thread always takes part
+// in its own ParallelFor, so a pool with zero workers degrades to a plain loop.
+class JobSystem {
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping{false};
+
+public:
+    // Zero picks one worker per hardware thread, minus the caller.
+    explicit JobSystem(u32 workerCount = 0);
+    ~JobSystem();
+    JobSystem(JobSystem const &other) = delete;
+    JobSystem &operator=(JobSystem const &other) = delete;
+
+    void Schedule(std::function<void()> job);
+
+    // Splits [0, count) into chunks of `grain` and blocks until every chunk ran.
+    void ParallelFor(u32 count, u32 grain, std::function<void(u32 begin, u32 end)> const &body);
+
+    MUST_USE u32 WorkerCount() const { return static_cast<u32>(m_workers.size()); }
+
+private:
+    void WorkerLoop();
+};
\ No newline at end of file
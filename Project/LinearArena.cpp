@@ -0,0 +1,75 @@
+#include "LinearArena.h"
+#include <cstdint>
+#include <numeric>
+
+LinearArena::LinearArena(size_t blockSize) : m_blockSize(blockSize)
+{
+}
+
+void *LinearArena::Allocate(size_t size, size_t alignment)
+{
+    while (true) {
+        if (m_block < m_blocks.size()) {
+            auto &block = m_blocks[m_block];
+            auto base = reinterpret_cast<uintptr_t>(block.Memory.get());
+            auto aligned = (base + m_offset + alignment - 1) & ~(alignment - 1);
+            auto end = aligned - base + size;
+            if (end <= block.Capacity) {
+                m_used += end - m_offset;
+                m_highWater = std::max(m_highWater, m_used);
+                m_offset = end;
+                return reinterpret_cast<void *>(aligned);
+            }
+            // Leftovers of a block are skipped, the next one may already be large enough.
+            if (m_block + 1 < m_blocks.size()) {
+                m_used += block.Capacity - m_offset;
+                m_block++;
+                m_offset = 0;
+                continue;
+            }
+        }
+
+        auto capacity = std::max(m_blockSize, size + alignment);
+        if (!m_blocks.empty()) {
+            m_used += m_blocks[m_block].Capacity - m_offset;
+            m_block++;
+        }
+        m_blocks.push_back(Block{std::make_unique_for_overwrite<std::byte[]>(capacity), capacity});
+        m_offset = 0;
+    }
+}
+
+void LinearArena::Rewind(Marker marker)
+{
+    // Back at the start the blocks can be folded, scratch arenas never see a Reset() otherwise.
+    if (marker.Used == 0) {
+        Reset();
+        return;
+    }
+    m_block = marker.Block;
+    m_offset = marker.Offset;
+    m_used = marker.Used;
+}
+
+void LinearArena::Reset()
+{
+    if (m_blocks.size() > 1) {
+        auto capacity = std::max(Capacity(), m_highWater);
+        m_blocks.clear();
+        m_blocks.push_back(Block{std::make_unique_for_overwrite<std::byte[]>(capacity), capacity});
+    }
+    m_block = 0;
+    m_offset = 0;
+    m_used = 0;
+}
+
+size_t LinearArena::Capacity() const
+{
+    return std::accumulate(m_blocks.begin(), m_blocks.end(), size_t{0}, [](size_t total, Block const &block) { return total + block.Capacity; });
+}
+
+LinearArena &ThreadScratch()
+{
+    static thread_local LinearArena arena;
+    return arena;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+#include "Definitions.h"
+#include "Slice.h"
+#include "Types.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for transient CPU data: allocating is a pointer increment and everything is
+// released at once by Reset() or by rewinding to a Marker. Destructors never run, so only
+// trivially destructible types go in. Grows by adding blocks; a Reset() after growing folds them
+// into one block, so a steady workload stops touching the heap after its first frames.
+class LinearArena {
+    struct Block {
+        Ptr<std::byte[]> Memory;
+        size_t Capacity;
+    };
+
+    size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    u32 m_block{0};
+    size_t m_offset{0};
+    size_t m_used{0};
+    size_t m_highWater{0};
+
+public:
+    struct Marker {
+        u32 Block;
+        size_t Offset;
+        size_t Used;
+    };
+
+    explicit LinearArena(size_t blockSize = 64 * 1024);
+    LinearArena(LinearArena const &other) = delete;
+    LinearArena &operator=(LinearArena const &other) = delete;
+
+    MUST_USE void *Allocate(size_t size, size_t alignment);
+
+    // Default initialized, which leaves trivial types uninitialized.
+    template<typename T>
+    MUST_USE Slice<T> Allocate(u32 count)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "The arena never runs destructors");
+        auto *data = static_cast<T *>(Allocate(sizeof(T) * static_cast<size_t>(count), alignof(T)));
+        std::uninitialized_default_construct_n(data, count);
+        return Slice<T>(data, count);
+    }
+
+    template<typename T>
+    MUST_USE Slice<T> Copy(std::span<T const> values)
+    {
+        auto slice = Allocate<T>(static_cast<u32>(values.size()));
+        std::copy(values.begin(), values.end(), slice.begin());
+        return slice;
+    }
+
+    MUST_USE Marker Mark() const { return Marker{m_block, m_offset, m_used}; }
+    // Frees everything allocated since `marker`, which must come from this arena.
+    void Rewind(Marker marker);
+    void Reset();
+
+    MUST_USE size_t Used() const { return m_used; }
+    // Most ever in use at once, what a single block would need to never grow.
+    MUST_USE size_t HighWater() const { return m_highWater; }
+    MUST_USE size_t Capacity() const;
+};
+
+// Per-thread scratch arena, only ever used through a ScratchScope.
+MUST_USE LinearArena &ThreadScratch();
+
+// Marks the calling thread's scratch arena and rewinds it when the scope ends. Slices allocated
+// within must not escape it; scopes nest, an inner one only frees what it allocated itself.
+class ScratchScope {
+    LinearArena &m_arena;
+    LinearArena::Marker m_marker;
+
+public:
+    ScratchScope() : m_arena(ThreadScratch()), m_marker(m_arena.Mark()) {}
+    ~ScratchScope() { m_arena.Rewind(m_marker); }
+    ScratchScope(ScratchScope const &other) = delete;
+    ScratchScope &operator=(ScratchScope const &other) = delete;
+
+    MUST_USE LinearArena &Arena() { return m_arena; }
+
+    template<typename T>
+    MUST_USE Slice<T> Allocate(u32 count) { return m_arena.Allocate<T>(count); }
+
+    template<typename T>
+    MUST_USE Slice<T> Copy(std::span<T const> values) { return m_arena.Copy(values); }
+};
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "LodSelector.h"
+#include <algorithm>
+
+f32 LodView::PixelsPerUnit(glm::vec3 const &center) const
+{
+    auto clip = ViewProjection * glm::vec4(center, 1.0f);
+    auto w = std::max(clip.w, 1e-4f);
+    // Second row of the matrix, how fast clip-space y grows along the world axes.
+    glm::vec3 row{ViewProjection[0][1], ViewProjection[1][1], ViewProjection[2][1]};
+    return 0.5f * ViewportHeight * glm::length(row) / w;
+}
+
+u32 LodSelector::Select(u32 object, std::span<f32 const> errors, glm::vec3 const &center, f32 scale, LodView const &view)
+{
+    if (object >= m_current.size()) {
+        m_current.resize(object + 1, 0);
+    }
+    if (errors.size() <= 1) {
+        return 0;
+    }
+
+    auto pixels = view.PixelsPerUnit(center) * scale;
+    u32 current = std::min<u32>(m_current[object], static_cast<u32>(errors.size() - 1));
+
+    u32 target = 0;
+    for (auto level = static_cast<u32>(errors.size() - 1); level > 0; level--) {
+        auto limit = level > current ? m_settings.PixelThreshold * (1.0f - m_settings.Hysteresis) : m_settings.PixelThreshold;
+        if (errors[level] * pixels <= limit) {
+            target = level;
+            break;
+        }
+    }
+
+    if (target != m_current[object]) {
+        m_current[object] = static_cast<u8>(target);
+    }
+    return target;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// How large one world unit appears on screen, taken from the view-projection the frame is drawn with.
+struct LodView {
+    glm::mat4 ViewProjection;
+    f32 ViewportHeight;
+
+    // Pixels covered by one world unit at `center`, ignoring the perspective change across the object.
+    MUST_USE f32 PixelsPerUnit(glm::vec3 const &center) const;
+};
+
+// Picks a detail level per object from the screen-space size of its simplification error. An
+// object moves to a coarser level only once that level's error is well below the threshold, and
+// back to a finer one as soon as its current error goes over it, so objects sitting at a boundary
+// do not flip every frame.
+class LodSelector {
+public:
+    struct Settings {
+        // Largest error, in pixels, a level may project to.
+        f32 PixelThreshold{1.0f};
+        // Fraction of the threshold a coarser level has to stay under before switching to it.
+        f32 Hysteresis{0.25f};
+    };
+
+private:
+    Settings m_settings{};
+    std::vector<u8> m_current;
+
+public:
+    LodSelector() = default;
+    explicit LodSelector(Settings settings) : m_settings(settings) {}
+
+    // `errors` are the object-space errors of the chain, finest first, and `scale` converts them
+    // to world space. Returns the level to draw this frame.
+    MUST_USE u32 Select(u32 object, std::span<f32 const> errors, glm::vec3 const &center, f32 scale, LodView const &view);
+    MUST_USE u32 Current(u32 object) const { return object < m_current.size() ? m_current[object] : 0; }
+
+    void SetSettings(Settings settings) { m_settings = settings; }
+    MUST_USE Settings const &GetSettings() const { return m_settings; }
+};
\ No newline at end of file
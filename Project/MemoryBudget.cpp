@@ -0,0 +1,268 @@
+#include "MemoryBudget.h"
+#include "Logger.h"
+#include <algorithm>
+#include <format>
+#include <fstream>
+
+char const *MemoryCategoryName(MemoryCategory category)
+{
+    switch (category) {
+        case MemoryCategory::Geometry:
+            return "geometry";
+        case MemoryCategory::Uniforms:
+            return "uniforms";
+        case MemoryCategory::Storage:
+            return "storage";
+        case MemoryCategory::Staging:
+            return "staging";
+        case MemoryCategory::Depth:
+            return "depth";
+        case MemoryCategory::RenderTargets:
+            return "render targets";
+        case MemoryCategory::Textures:
+            return "textures";
+    }
+    return "unknown";
+}
+
+MemoryCategory BufferCategory(VkBufferUsageFlags usage)
+{
+    // Host visible copies in either direction, uploads and readbacks.
+    if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT || usage == VK_BUFFER_USAGE_TRANSFER_DST_BIT) {
+        return MemoryCategory::Staging;
+    }
+    // The streaming buffers carry uniforms next to everything else, they count as uniforms.
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        return MemoryCategory::Uniforms;
+    }
+    if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)) {
+        return MemoryCategory::Geometry;
+    }
+    return MemoryCategory::Storage;
+}
+
+MemoryCategory ImageCategory(VkImageUsageFlags usage)
+{
+    if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+        return MemoryCategory::Depth;
+    }
+    if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
+        return MemoryCategory::RenderTargets;
+    }
+    return MemoryCategory::Textures;
+}
+
+void MemoryBudget::Initialize(VkPhysicalDevice physicalDevice, bool budgetExtension, VkAllocationCallbacks const *hostCallbacks)
+{
+    m_physicalDevice = physicalDevice;
+    m_hostCallbacks = hostCallbacks;
+    m_budgetExtension = budgetExtension;
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_properties);
+
+    std::scoped_lock lock(m_mutex);
+    m_heaps.resize(m_properties.memoryHeapCount);
+    m_overBudget.assign(m_properties.memoryHeapCount, false);
+    for (u32 i = 0; i < m_properties.memoryHeapCount; i++) {
+        m_heaps[i].Flags = m_properties.memoryHeaps[i].flags;
+        m_heaps[i].Size = m_properties.memoryHeaps[i].size;
+    }
+    QueryBudget();
+    INFOF("Memory budget from {}", m_budgetExtension ? "VK_EXT_memory_budget" : "a fixed share of each heap");
+}
+
+void MemoryBudget::QueryBudget()
+{
+    if (!m_budgetExtension) {
+        // Other processes and the driver need some of the heap as well.
+        for (auto &heap: m_heaps) {
+            heap.Budget = heap.Size / 10 * 8;
+        }
+        return;
+    }
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceMemoryProperties2 properties{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budget,
+    };
+    vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &properties);
+    for (u32 i = 0; i < m_heaps.size(); i++) {
+        m_heaps[i].Budget = budget.heapBudget[i];
+        m_heaps[i].DriverUsage = budget.heapUsage[i];
+    }
+}
+
+VkResult MemoryBudget::Allocate(VkDevice device, VkMemoryAllocateInfo const &info, MemoryCategory category, VkDeviceMemory *memory)
+{
+    auto result = vkAllocateMemory(device, &info, m_hostCallbacks, memory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::scoped_lock lock(m_mutex);
+    m_entries.emplace(*memory, Entry{info.allocationSize, info.memoryTypeIndex, category});
+    auto &heap = m_heaps[m_properties.memoryTypes[info.memoryTypeIndex].heapIndex];
+    heap.Allocated += info.allocationSize;
+    heap.Peak = std::max(heap.Peak, heap.Allocated);
+    m_typeBytes[info.memoryTypeIndex] += info.allocationSize;
+    m_categoryBytes[static_cast<u32>(category)] += info.allocationSize;
+    m_categoryAllocations[static_cast<u32>(category)]++;
+    return result;
+}
+
+void MemoryBudget::Free(VkDevice device, VkDeviceMemory memory)
+{
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    vkFreeMemory(device, memory, m_hostCallbacks);
+
+    std::scoped_lock lock(m_mutex);
+    auto entry = m_entries.find(memory);
+    if (entry == m_entries.end()) {
+        WARN("Freed device memory the budget never saw allocated");
+        return;
+    }
+    auto const &[size, memoryType, category] = entry->second;
+    m_heaps[m_properties.memoryTypes[memoryType].heapIndex].Allocated -= size;
+    m_typeBytes[memoryType] -= size;
+    m_categoryBytes[static_cast<u32>(category)] -= size;
+    m_categoryAllocations[static_cast<u32>(category)]--;
+    m_entries.erase(entry);
+}
+
+u32 MemoryBudget::AddPressureCallback(PressureCallback callback)
+{
+    std::scoped_lock lock(m_mutex);
+    auto id = m_nextCallback++;
+    m_callbacks.emplace_back(id, std::move(callback));
+    return id;
+}
+
+void MemoryBudget::RemovePressureCallback(u32 id)
+{
+    std::scoped_lock lock(m_mutex);
+    std::erase_if(m_callbacks, [id](auto const &entry) { return entry.first == id; });
+}
+
+void MemoryBudget::Update()
+{
+    struct Pressure {
+        u32 Heap;
+        VkDeviceSize Excess;
+    };
+    std::vector<Pressure> pressured;
+    std::vector<PressureCallback> callbacks;
+    {
+        std::scoped_lock lock(m_mutex);
+        QueryBudget();
+        for (u32 i = 0; i < m_heaps.size(); i++) {
+            auto const &heap = m_heaps[i];
+            // The driver's number includes everything we allocate plus its own overhead.
+            auto usage = std::max(heap.DriverUsage, heap.Allocated);
+            auto warnAt = static_cast<VkDeviceSize>(static_cast<f64>(heap.Budget) * WarnFraction);
+            auto target = static_cast<VkDeviceSize>(static_cast<f64>(heap.Budget) * TargetFraction);
+            if (usage >= warnAt && heap.Budget > 0) {
+                // Reported once per crossing, it stays quiet until the heap is back at the target.
+                if (!m_overBudget[i]) {
+                    WARNF("Memory heap {} at {} of {} MiB budget", i, usage >> 20, heap.Budget >> 20);
+                    m_overBudget[i] = true;
+                }
+                pressured.push_back(Pressure{i, usage - target});
+            } else if (usage <= target) {
+                m_overBudget[i] = false;
+            }
+        }
+        if (!pressured.empty()) {
+            for (auto const &[id, callback]: m_callbacks) {
+                callbacks.push_back(callback);
+            }
+        }
+    }
+
+    for (auto const &pressure: pressured) {
+        VkDeviceSize freed = 0;
+        for (auto const &callback: callbacks) {
+            if (freed >= pressure.Excess) {
+                break;
+            }
+            freed += callback(pressure.Heap, pressure.Excess - freed);
+        }
+        if (!callbacks.empty()) {
+            INFOF("Memory heap {}: evicted {} of {} KiB over the target", pressure.Heap, freed >> 10, pressure.Excess >> 10);
+        }
+    }
+}
+
+MemoryBudget::Stats MemoryBudget::Snapshot() const
+{
+    std::scoped_lock lock(m_mutex);
+    return Stats{
+            .DriverBudget = m_budgetExtension,
+            .Allocations = static_cast<u32>(m_entries.size()),
+            .Heaps = m_heaps,
+            .TypeBytes = m_typeBytes,
+            .CategoryBytes = m_categoryBytes,
+            .CategoryAllocations = m_categoryAllocations,
+    };
+}
+
+void MemoryBudget::LogSummary() const
+{
+    auto stats = Snapshot();
+    INFOF("Device memory: {} allocations", stats.Allocations);
+    for (u32 i = 0; i < stats.Heaps.size(); i++) {
+        auto const &heap = stats.Heaps[i];
+        INFOF("\tHeap {}{}: {} MiB allocated (peak {}), {} MiB used by the process, budget {} of {} MiB",
+              i, (heap.Flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "",
+              heap.Allocated >> 20, heap.Peak >> 20, heap.DriverUsage >> 20, heap.Budget >> 20, heap.Size >> 20);
+    }
+    for (u32 i = 0; i < MemoryCategoryCount; i++) {
+        if (stats.CategoryAllocations[i] > 0) {
+            INFOF("\t{}: {} KiB in {} allocations", MemoryCategoryName(static_cast<MemoryCategory>(i)),
+                  stats.CategoryBytes[i] >> 10, stats.CategoryAllocations[i]);
+        }
+    }
+}
+
+std::string MemoryBudget::ToJson() const
+{
+    auto stats = Snapshot();
+    std::string json = std::format("{{\"driverBudget\":{},\"allocations\":{},\"heaps\":[", stats.DriverBudget, stats.Allocations);
+    for (u32 i = 0; i < stats.Heaps.size(); i++) {
+        auto const &heap = stats.Heaps[i];
+        json += std::format("{}{{\"index\":{},\"deviceLocal\":{},\"size\":{},\"budget\":{},\"driverUsage\":{},\"allocated\":{},\"peak\":{}}}",
+                            i > 0 ? "," : "", i, (heap.Flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+                            heap.Size, heap.Budget, heap.DriverUsage, heap.Allocated, heap.Peak);
+    }
+    json += "],\"memoryTypes\":[";
+    bool first = true;
+    for (u32 i = 0; i < m_properties.memoryTypeCount; i++) {
+        if (stats.TypeBytes[i] == 0) {
+            continue;
+        }
+        json += std::format("{}{{\"index\":{},\"heap\":{},\"flags\":{},\"allocated\":{}}}", first ? "" : ",",
+                            i, m_properties.memoryTypes[i].heapIndex, m_properties.memoryTypes[i].propertyFlags, stats.TypeBytes[i]);
+        first = false;
+    }
+    json += "],\"categories\":{";
+    for (u32 i = 0; i < MemoryCategoryCount; i++) {
+        json += std::format("{}\"{}\":{{\"bytes\":{},\"allocations\":{}}}", i > 0 ? "," : "",
+                            MemoryCategoryName(static_cast<MemoryCategory>(i)), stats.CategoryBytes[i], stats.CategoryAllocations[i]);
+    }
+    json += "}}";
+    return json;
+}
+
+bool MemoryBudget::WriteJson(char const *path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        ERRORF("Failed to open '{}' for the memory report", path);
+        return false;
+    }
+    file << ToJson() << '\n';
+    return static_cast<bool>(file);
+}
\ No newline at end of file
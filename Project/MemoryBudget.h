@@ -0,0 +1,113 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <array>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+enum class MemoryCategory : u32 {
+    Geometry,
+    Uniforms,
+    // Compute and indirect data, everything without a more specific use.
+    Storage,
+    Staging,
+    Depth,
+    RenderTargets,
+    Textures,
+};
+inline constexpr u32 MemoryCategoryCount = 7;
+
+MUST_USE char const *MemoryCategoryName(MemoryCategory category);
+// Derived from the usage flags, so Device::CreateBuffer and CreateImage need no extra argument.
+MUST_USE MemoryCategory BufferCategory(VkBufferUsageFlags usage);
+MUST_USE MemoryCategory ImageCategory(VkImageUsageFlags usage);
+
+// Accounts every device memory allocation the engine makes by heap, memory type and category,
+// and holds the heaps against their budget: what VK_EXT_memory_budget reports, or without it a
+// fixed share of the heap size. Allocate and Free are thread safe.
+class MemoryBudget {
+public:
+    // A heap went over the warning threshold, free about `excess` bytes of it if possible.
+    // Returns how much was actually freed. Called from Update(), outside the budget's lock.
+    using PressureCallback = std::function<VkDeviceSize(u32 heap, VkDeviceSize excess)>;
+
+    struct HeapStats {
+        VkMemoryHeapFlags Flags{};
+        VkDeviceSize Size{};
+        VkDeviceSize Budget{};
+        // Whole process as the driver sees it, only with the extension.
+        VkDeviceSize DriverUsage{};
+        // What went through Allocate().
+        VkDeviceSize Allocated{};
+        VkDeviceSize Peak{};
+    };
+
+    struct Stats {
+        bool DriverBudget{false};
+        u32 Allocations{};
+        std::vector<HeapStats> Heaps;
+        std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> TypeBytes{};
+        std::array<VkDeviceSize, MemoryCategoryCount> CategoryBytes{};
+        std::array<u32, MemoryCategoryCount> CategoryAllocations{};
+    };
+
+    // Fraction of the budget at which a heap is reported and evictions start, and the one
+    // evictions aim for.
+    static constexpr f64 WarnFraction = 0.9;
+    static constexpr f64 TargetFraction = 0.8;
+
+private:
+    struct Entry {
+        VkDeviceSize Size;
+        u32 MemoryType;
+        MemoryCategory Category;
+    };
+
+    VkPhysicalDevice m_physicalDevice{};
+    VkPhysicalDeviceMemoryProperties m_properties{};
+    bool m_budgetExtension{false};
+    // The device's host allocation tracking, allocations and frees both go through it.
+    VkAllocationCallbacks const *m_hostCallbacks{};
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<VkDeviceMemory, Entry> m_entries;
+    std::vector<HeapStats> m_heaps;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> m_typeBytes{};
+    std::array<VkDeviceSize, MemoryCategoryCount> m_categoryBytes{};
+    std::array<u32, MemoryCategoryCount> m_categoryAllocations{};
+    std::vector<bool> m_overBudget;
+
+    std::vector<std::pair<u32, PressureCallback>> m_callbacks;
+    u32 m_nextCallback{0};
+
+public:
+    MemoryBudget() = default;
+    MemoryBudget(MemoryBudget const &other) = delete;
+    MemoryBudget &operator=(MemoryBudget const &other) = delete;
+
+    void Initialize(VkPhysicalDevice physicalDevice, bool budgetExtension, VkAllocationCallbacks const *hostCallbacks);
+
+    // vkAllocateMemory plus accounting, the memory has to go back through Free().
+    MUST_USE VkResult Allocate(VkDevice device, VkMemoryAllocateInfo const &info, MemoryCategory category, VkDeviceMemory *memory);
+    // Null handles are ignored, like vkFreeMemory does.
+    void Free(VkDevice device, VkDeviceMemory memory);
+
+    MUST_USE u32 AddPressureCallback(PressureCallback callback);
+    void RemovePressureCallback(u32 id);
+
+    // Refreshes the driver's budget, warns about heaps near it and asks the callbacks to evict.
+    // Cheap, but meant to run every few frames rather than every one.
+    void Update();
+
+    MUST_USE Stats Snapshot() const;
+    void LogSummary() const;
+    MUST_USE std::string ToJson() const;
+    bool WriteJson(char const *path) const;
+
+private:
+    void QueryBudget();
+};
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static constexpr u8 NotLocal = 0xff;
+
+bool Meshlet::IsBackfacing(glm::vec4 const &eye) const
+{
+    if (ConeAxis.w >= 1.0f) {
+        return false;
+    }
+    auto view = eye.w != 0.0f ? glm::vec3(ConeApex) - glm::vec3(eye) / eye.w : -glm::vec3(eye);
+    auto length = glm::length(view);
+    return length > 0.0f && glm::dot(view / length, glm::vec3(ConeAxis)) >= ConeAxis.w;
+}
+
+static void ComputeBounds(Meshlet &meshlet, MeshletData const &data, std::span<glm::vec3 const> positions)
+{
+    auto const *vertices = data.Vertices.data() + meshlet.VertexOffset;
+    auto const *triangles = data.Triangles.data() + meshlet.TriangleOffset;
+
+    glm::vec3 min{std::numeric_limits<f32>::max()}, max{std::numeric_limits<f32>::lowest()};
+    for (u32 i = 0; i < meshlet.VertexCount; i++) {
+        min = glm::min(min, positions[vertices[i]]);
+        max = glm::max(max, positions[vertices[i]]);
+    }
+    auto center = 0.5f * (min + max);
+    f32 radius = 0.0f;
+    for (u32 i = 0; i < meshlet.VertexCount; i++) {
+        radius = std::max(radius, glm::length(positions[vertices[i]] - center));
+    }
+    meshlet.Sphere = glm::vec4(center, radius);
+
+    // Cone axis is the average facing direction, the cutoff comes from the normal furthest from it.
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.TriangleCount);
+    glm::vec3 axis{0.0f};
+    for (u32 i = 0; i < meshlet.TriangleCount; i++) {
+        auto const &a = positions[vertices[triangles[i * 3 + 0]]];
+        auto const &b = positions[vertices[triangles[i * 3 + 1]]];
+        auto const &c = positions[vertices[triangles[i * 3 + 2]]];
+        auto normal = glm::cross(c - a, b - a);
+        auto length = glm::length(normal);
+        normals.push_back(length > 0.0f ? normal / length : glm::vec3(0.0f));
+        axis += normals.back();
+    }
+
+    meshlet.ConeApex = glm::vec4(center, 0.0f);
+    meshlet.ConeAxis = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    auto axisLength = glm::length(axis);
+    if (axisLength < 1e-6f) {
+        return;
+    }
+    axis /= axisLength;
+
+    f32 minDot = 1.0f;
+    for (auto const &normal: normals) {
+        if (normal != glm::vec3(0.0f)) {
+            minDot = std::min(minDot, glm::dot(axis, normal));
+        }
+    }
+    if (minDot <= 0.0f) {
+        return;
+    }
+
+    // The apex sits far enough back along the axis to be behind every triangle's plane.
+    f32 apexDistance = 0.0f;
+    for (u32 i = 0; i < meshlet.TriangleCount; i++) {
+        if (normals[i] == glm::vec3(0.0f)) {
+            continue;
+        }
+        auto const &a = positions[vertices[triangles[i * 3]]];
+        apexDistance = std::max(apexDistance, glm::dot(center - a, normals[i]) / glm::dot(axis, normals[i]));
+    }
+    meshlet.ConeApex = glm::vec4(center - axis * apexDistance, 0.0f);
+    meshlet.ConeAxis = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
+
+MeshletData BuildMeshlets(std::span<u32 const> indices, std::span<glm::vec3 const> positions, MeshletLimits limits)
+{
+    limits.MaxVertices = std::clamp(limits.MaxVertices, 3u, 255u);
+    limits.MaxTriangles = std::max(limits.MaxTriangles, 1u);
+
+    auto vertexCount = static_cast<u32>(positions.size());
+    auto triangleCount = static_cast<u32>(indices.size() / 3);
+
+    // Triangles around each vertex, in CSR form.
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    for (auto index: indices.first(triangleCount * 3)) {
+        adjacencyOffsets[index + 1]++;
+    }
+    for (u32 i = 0; i < vertexCount; i++) {
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    }
+    std::vector<u32> adjacency(triangleCount * 3);
+    {
+        auto cursor = adjacencyOffsets;
+        for (u32 triangle = 0; triangle < triangleCount; triangle++) {
+            for (u32 corner = 0; corner < 3; corner++) {
+                adjacency[cursor[indices[triangle * 3 + corner]]++] = triangle;
+            }
+        }
+    }
+
+    MeshletData data;
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u8> local(vertexCount, NotLocal);
+    Meshlet current{};
+    glm::vec3 centroidSum{0.0f};
+
+    auto newVertices = [&](u32 triangle) {
+        u32 count = 0;
+        for (u32 corner = 0; corner < 3; corner++) {
+            auto index = indices[triangle * 3 + corner];
+            bool seen = local[index] != NotLocal;
+            for (u32 earlier = 0; earlier < corner; earlier++) {
+                seen = seen || indices[triangle * 3 + earlier] == index;
+            }
+            count += seen ? 0 : 1;
+        }
+        return count;
+    };
+
+    auto flush = [&] {
+        if (current.TriangleCount == 0) {
+            return;
+        }
+        for (u32 i = 0; i < current.VertexCount; i++) {
+            local[data.Vertices[current.VertexOffset + i]] = NotLocal;
+        }
+        // Keep every meshlet's triangles word aligned for the shaders.
+        data.Triangles.resize((data.Triangles.size() + 3) & ~size_t{3}, 0);
+        ComputeBounds(current, data, positions);
+        data.Meshlets.push_back(current);
+        current = Meshlet{
+                .VertexOffset = static_cast<u32>(data.Vertices.size()),
+                .TriangleOffset = static_cast<u32>(data.Triangles.size()),
+        };
+        centroidSum = glm::vec3(0.0f);
+    };
+
+    auto distance = [&](u32 triangle, glm::vec3 const &centroid) {
+        auto middle = (positions[indices[triangle * 3]] + positions[indices[triangle * 3 + 1]] + positions[indices[triangle * 3 + 2]]) * (1.0f / 3.0f);
+        auto offset = middle - centroid;
+        return glm::dot(offset, offset);
+    };
+
+    u32 seed = 0;
+    while (true) {
+        u32 next = ~0u;
+        if (current.TriangleCount > 0) {
+            // Cheapest unused neighbour of anything already in the meshlet, ties go to the one
+            // closest to the meshlet's centre so it grows round instead of in strips.
+            auto centroid = centroidSum / static_cast<f32>(current.VertexCount);
+            u32 bestCost = 4;
+            f32 bestDistance = std::numeric_limits<f32>::max();
+            for (u32 i = 0; i < current.VertexCount; i++) {
+                auto vertex = data.Vertices[current.VertexOffset + i];
+                for (auto offset = adjacencyOffsets[vertex]; offset < adjacencyOffsets[vertex + 1]; offset++) {
+                    auto triangle = adjacency[offset];
+                    if (emitted[triangle]) {
+                        continue;
+                    }
+                    auto cost = newVertices(triangle);
+                    if (cost > bestCost) {
+                        continue;
+                    }
+                    auto candidateDistance = distance(triangle, centroid);
+                    if (cost < bestCost || candidateDistance < bestDistance) {
+                        bestCost = cost;
+                        bestDistance = candidateDistance;
+                        next = triangle;
+                    }
+                }
+            }
+            if (next == ~0u || current.VertexCount + bestCost > limits.MaxVertices) {
+                flush();
+                continue;
+            }
+        } else {
+            while (seed < triangleCount && emitted[seed]) {
+                seed++;
+            }
+            if (seed == triangleCount) {
+                break;
+            }
+            next = seed;
+        }
+
+        for (u32 corner = 0; corner < 3; corner++) {
+            auto index = indices[next * 3 + corner];
+            if (local[index] == NotLocal) {
+                local[index] = static_cast<u8>(current.VertexCount++);
+                data.Vertices.push_back(index);
+                centroidSum += positions[index];
+            }
+            data.Triangles.push_back(local[index]);
+        }
+        emitted[next] = true;
+        if (++current.TriangleCount == limits.MaxTriangles) {
+            flush();
+        }
+    }
+    flush();
+    return data;
+}
\ No newline at end of file
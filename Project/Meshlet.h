@@ -0,0 +1,49 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// Matches `Meshlet` in the mesh shading shaders (std430). Bounds are in object space.
+struct Meshlet {
+    // xyz center, w radius.
+    glm::vec4 Sphere;
+    // Every triangle of the meshlet faces away from a viewer inside the cone behind the apex,
+    // see IsBackfacing. w is unused.
+    glm::vec4 ConeApex;
+    // xyz axis, w cutoff. A cutoff of 1 means the normals spread too far to ever cull.
+    glm::vec4 ConeAxis;
+    // First entry in MeshletData::Vertices.
+    u32 VertexOffset;
+    // First byte in MeshletData::Triangles, always a multiple of four.
+    u32 TriangleOffset;
+    u32 VertexCount;
+    u32 TriangleCount;
+
+    // `eye` is a homogeneous position, w = 0 for a viewer infinitely far along xyz.
+    MUST_USE bool IsBackfacing(glm::vec4 const &eye) const;
+};
+static_assert(sizeof(Meshlet) == 64, "Meshlet must match the std430 layout used by shaders");
+
+struct MeshletLimits {
+    // Local triangle indices are bytes, so at most 255.
+    u32 MaxVertices{64};
+    u32 MaxTriangles{124};
+};
+
+// Meshlets of one indexed mesh. Vertices maps each meshlet's local vertices back to the mesh,
+// Triangles holds three local indices per triangle.
+struct MeshletData {
+    std::vector<Meshlet> Meshlets;
+    std::vector<u32> Vertices;
+    std::vector<u8> Triangles;
+};
+
+// Greedily grows each meshlet through triangles that share its vertices, preferring the ones that
+// add the fewest new vertices, so meshlets stay spatially compact and their cones tight. Normals
+// for the cones are cross(p2 - p0, p1 - p0), the facing direction of the renderer's clockwise
+// front faces. Pure CPU code, usable offline or at load time.
+MUST_USE MeshletData BuildMeshlets(std::span<u32 const> indices, std::span<glm::vec3 const> positions, MeshletLimits limits = {});
\ No newline at end of file
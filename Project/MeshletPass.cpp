@@ -0,0 +1,244 @@
+#include "MeshletPass.h"
+#include "Logger.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vulkan/vk_enum_string_helper.h>
+
+// Must match the push constant block in the meshlet shaders.
+struct MeshletConstants {
+    glm::vec4 Eye;
+    u32 ObjectBuffer;
+    u32 Meshlets;
+    u32 MeshletVertices;
+    u32 MeshletTriangles;
+    u32 Vertices;
+    u32 Tasks;
+    u32 TaskCount;
+};
+
+static constexpr VkPipelineStageFlags MeshStages = VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+static constexpr VkShaderStageFlags MeshShaderStages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+// Guaranteed minimum of maxTaskWorkGroupCount, larger dispatches spill into y.
+static constexpr u32 MaxTaskGroupsX = 65535;
+
+MeshletPass::MeshletPass(Device &device, BindlessHeap &bindless, GeometryArena &geometry, IndirectRenderer &renderer,
+                         VkDescriptorSetLayout frameSetLayout, PipelineConfigInfo config, u32 maxMeshlets)
+    : m_device(device), m_bindless(bindless), m_geometry(geometry), m_renderer(renderer), m_maxMeshlets(maxMeshlets)
+{
+    // A meshlet vertex stands for at least one index, padding adds at most three bytes per meshlet.
+    m_maxMeshletVertices = geometry.IndexCapacity();
+    m_maxTriangleBytes = geometry.IndexCapacity() + 3 * maxMeshlets;
+    m_maxTasks = renderer.MaxObjects() * 8;
+
+    auto create = [&](VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, VkDeviceMemory &memory) {
+        auto result = m_device.CreateBuffer(size, usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        buffer = result.Buffer;
+        memory = result.Memory;
+    };
+    create(sizeof(Meshlet) * static_cast<VkDeviceSize>(m_maxMeshlets), 0, m_meshlets, m_meshletsMemory);
+    create(sizeof(u32) * static_cast<VkDeviceSize>(m_maxMeshletVertices), 0, m_meshletVertices, m_meshletVerticesMemory);
+    create(m_maxTriangleBytes, 0, m_meshletTriangles, m_meshletTrianglesMemory);
+    create(sizeof(MeshletTask) * static_cast<VkDeviceSize>(m_maxTasks), 0, m_tasks, m_tasksMemory);
+
+    m_meshletsIndex = m_bindless.RegisterBuffer(m_meshlets, 0, VK_WHOLE_SIZE);
+    m_meshletVerticesIndex = m_bindless.RegisterBuffer(m_meshletVertices, 0, VK_WHOLE_SIZE);
+    m_meshletTrianglesIndex = m_bindless.RegisterBuffer(m_meshletTriangles, 0, VK_WHOLE_SIZE);
+    m_tasksIndex = m_bindless.RegisterBuffer(m_tasks, 0, VK_WHOLE_SIZE);
+    m_vertexBufferIndex = m_bindless.RegisterBuffer(geometry.VertexBuffer(), 0, VK_WHOLE_SIZE);
+
+    // Task and mesh shaders read the renderer's objects directly.
+    m_renderer.AddConsumerStages(MeshStages);
+
+    CreateLayout(frameSetLayout);
+    config.Layout = m_layout;
+    config.TaskShader = "Assets/Shaders/Builtin.Meshlet.task.spv";
+    config.MeshShader = "Assets/Shaders/Builtin.Meshlet.mesh.spv";
+    m_config = config;
+    m_pipeline = std::make_unique<Pipeline>(m_device, m_config);
+
+    INFOF("Created meshlet pass for {} meshlets and {} tasks", m_maxMeshlets, m_maxTasks);
+}
+
+MeshletPass::~MeshletPass()
+{
+    for (auto index: {m_meshletsIndex, m_meshletVerticesIndex, m_meshletTrianglesIndex, m_tasksIndex, m_vertexBufferIndex}) {
+        m_bindless.ReleaseBuffer(index);
+    }
+
+    m_pipeline.reset();
+
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), budget = &m_device.Memory(), layout = m_layout,
+                              buffers = std::array{m_meshlets, m_meshletVertices, m_meshletTriangles, m_tasks},
+                              memories = std::array{m_meshletsMemory, m_meshletVerticesMemory, m_meshletTrianglesMemory, m_tasksMemory}] {
+        vkDestroyPipelineLayout(device, layout, callbacks);
+        for (u32 i = 0; i < buffers.size(); i++) {
+            vkDestroyBuffer(device, buffers[i], nullptr);
+            budget->Free(device, memories[i]);
+        }
+    });
+}
+
+void MeshletPass::WatchShaders(ShaderHotReload &hotReload)
+{
+    hotReload.Watch<Pipeline>({m_config.TaskShader, m_config.MeshShader, m_config.FragmentShader}, m_pipeline, [this] {
+        return std::make_unique<Pipeline>(m_device, m_config);
+    });
+}
+
+void MeshletPass::CreateLayout(VkDescriptorSetLayout frameSetLayout)
+{
+    // Same sets as the vertex path, the push constants differ so the layouts are not compatible.
+    VkDescriptorSetLayout setLayouts[] = {frameSetLayout, m_bindless.Layout()};
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = MeshShaderStages,
+            .offset = 0,
+            .size = sizeof(MeshletConstants),
+    };
+
+    VkPipelineLayoutCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 2,
+            .pSetLayouts = setLayouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+
+    auto result = vkCreatePipelineLayout(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &m_layout);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create meshlet pipeline layout: {}", string_VkResult(result));
+    }
+}
+
+bool MeshletPass::AddMesh(MeshAllocation const &mesh, MeshletData const &meshlets)
+{
+    if (meshlets.Meshlets.empty()) {
+        return false;
+    }
+    if (m_meshletCount + meshlets.Meshlets.size() > m_maxMeshlets ||
+        m_meshletVertexCount + meshlets.Vertices.size() > m_maxMeshletVertices ||
+        m_triangleBytes + meshlets.Triangles.size() > m_maxTriangleBytes) {
+        ERRORF("Meshlet pass is out of space for {} more meshlets", meshlets.Meshlets.size());
+        return false;
+    }
+
+    // Offsets become global, vertex indices stay relative to the mesh and get its base at draw time.
+    std::vector<Meshlet> placed(meshlets.Meshlets.begin(), meshlets.Meshlets.end());
+    for (auto &meshlet: placed) {
+        meshlet.VertexOffset += m_meshletVertexCount;
+        meshlet.TriangleOffset += m_triangleBytes;
+    }
+
+    m_device.UploadBuffer(m_meshlets, sizeof(Meshlet) * static_cast<VkDeviceSize>(m_meshletCount), placed.data(), sizeof(Meshlet) * placed.size());
+    m_device.UploadBuffer(m_meshletVertices, sizeof(u32) * static_cast<VkDeviceSize>(m_meshletVertexCount), meshlets.Vertices.data(), sizeof(u32) * meshlets.Vertices.size());
+    m_device.UploadBuffer(m_meshletTriangles, m_triangleBytes, meshlets.Triangles.data(), meshlets.Triangles.size());
+
+    m_ranges[mesh.FirstIndex] = MeshletRange{
+            .FirstMeshlet = m_meshletCount,
+            .MeshletCount = static_cast<u32>(placed.size()),
+    };
+    m_meshletCount += static_cast<u32>(placed.size());
+    m_meshletVertexCount += static_cast<u32>(meshlets.Vertices.size());
+    m_triangleBytes += static_cast<u32>(meshlets.Triangles.size());
+    // Objects that already use this mesh have to pick it up.
+    m_taskRevision = ~0ull;
+    return true;
+}
+
+void MeshletPass::Prepare(VkCommandBuffer commandBuffer, StreamingBuffer &staging)
+{
+    if (m_taskRevision == m_renderer.Revision()) {
+        return;
+    }
+
+    m_taskData.clear();
+    auto records = m_renderer.Records();
+    for (u32 object = 0; object < records.size(); object++) {
+        auto const &command = records[object].Command;
+        if (command.instanceCount == 0) {
+            continue;
+        }
+        auto range = m_ranges.find(command.firstIndex);
+        if (range == m_ranges.end()) {
+            continue;
+        }
+        for (u32 first = 0; first < range->second.MeshletCount; first += TaskSize) {
+            m_taskData.push_back(MeshletTask{
+                    .ObjectIndex = object,
+                    .FirstMeshlet = range->second.FirstMeshlet + first,
+                    .MeshletCount = std::min(TaskSize, range->second.MeshletCount - first),
+                    .VertexOffset = command.vertexOffset,
+            });
+        }
+    }
+
+    m_taskCount = 0;
+    if (m_taskData.empty()) {
+        m_taskRevision = m_renderer.Revision();
+        return;
+    }
+    if (m_taskData.size() > m_maxTasks) {
+        ERRORF("Meshlet pass has room for {} tasks, scene needs {}", m_maxTasks, m_taskData.size());
+        return;
+    }
+
+    // Try again next frame if the staging ring is already full.
+    auto size = sizeof(MeshletTask) * m_taskData.size();
+    auto allocation = staging.AllocateStorage(size);
+    if (!allocation.IsValid()) {
+        WARNF("Not enough staging memory for {} meshlet tasks", m_taskData.size());
+        return;
+    }
+    std::memcpy(allocation.Data, m_taskData.data(), size);
+
+    // The task list is shared between frames in flight.
+    vkCmdPipelineBarrier(commandBuffer, MeshStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    VkBufferCopy region{
+            .srcOffset = allocation.Offset,
+            .dstOffset = 0,
+            .size = size,
+    };
+    vkCmdCopyBuffer(commandBuffer, allocation.Buffer, m_tasks, 1, &region);
+    m_device.Stats().Add(RenderCounter::UploadedBytes, size);
+
+    VkMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, MeshStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    m_taskCount = static_cast<u32>(m_taskData.size());
+    m_taskRevision = m_renderer.Revision();
+}
+
+void MeshletPass::Draw(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, u32 frameDataOffset, glm::vec4 const &eye)
+{
+    if (m_taskCount == 0) {
+        return;
+    }
+
+    m_pipeline->BindCommandBuffer(commandBuffer);
+    VkDescriptorSet sets[] = {frameSet, m_bindless.Set()};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 2, sets, 1, &frameDataOffset);
+
+    MeshletConstants constants{
+            .Eye = eye,
+            .ObjectBuffer = m_renderer.ObjectBufferIndex(),
+            .Meshlets = m_meshletsIndex,
+            .MeshletVertices = m_meshletVerticesIndex,
+            .MeshletTriangles = m_meshletTrianglesIndex,
+            .Vertices = m_vertexBufferIndex,
+            .Tasks = m_tasksIndex,
+            .TaskCount = m_taskCount,
+    };
+    vkCmdPushConstants(commandBuffer, m_layout, MeshShaderStages, 0, sizeof(constants), &constants);
+
+    auto groupsX = std::min(m_taskCount, MaxTaskGroupsX);
+    m_device.DrawMeshTasks(commandBuffer, groupsX, (m_taskCount + groupsX - 1) / groupsX, 1);
+    // What the task shaders expand to is only known on the GPU.
+    m_device.Stats().DrawIndirect();
+}
\ No newline at end of file
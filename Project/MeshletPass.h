@@ -0,0 +1,99 @@
+#pragma once
+#include "Definitions.h"
+#include "Descriptors.h"
+#include "Device.h"
+#include "GeometryArena.h"
+#include "IndirectRenderer.h"
+#include "Meshlet.h"
+#include "Pipeline.h"
+#include "ShaderHotReload.h"
+#include "StreamingBuffer.h"
+#include "Types.h"
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Matches `MeshletTask` in Builtin.Meshlet.task.glsl.
+struct MeshletTask {
+    u32 ObjectIndex;
+    u32 FirstMeshlet;
+    u32 MeshletCount;
+    i32 VertexOffset;
+};
+
+// Mesh shading path over the indirect renderer's objects. Meshes register their meshlets once.
+// Each frame one task workgroup takes up to TaskSize meshlets of one object, rejects the ones
+// outside the frustum or facing away from the viewer, and launches a mesh workgroup per survivor.
+// Only created when the device supports VK_EXT_mesh_shader, the vertex path stays the fallback.
+class MeshletPass {
+public:
+    static constexpr u32 TaskSize = 32;
+
+    struct MeshletRange {
+        u32 FirstMeshlet;
+        u32 MeshletCount;
+    };
+
+private:
+    Device &m_device;
+    BindlessHeap &m_bindless;
+    GeometryArena &m_geometry;
+    IndirectRenderer &m_renderer;
+
+    VkPipelineLayout m_layout{};
+    PipelineConfigInfo m_config{};
+    Ptr<Pipeline> m_pipeline{};
+
+    VkBuffer m_meshlets{};
+    VkDeviceMemory m_meshletsMemory{};
+    VkBuffer m_meshletVertices{};
+    VkDeviceMemory m_meshletVerticesMemory{};
+    VkBuffer m_meshletTriangles{};
+    VkDeviceMemory m_meshletTrianglesMemory{};
+    VkBuffer m_tasks{};
+    VkDeviceMemory m_tasksMemory{};
+
+    u32 m_meshletsIndex{BindlessHeap::InvalidIndex};
+    u32 m_meshletVerticesIndex{BindlessHeap::InvalidIndex};
+    u32 m_meshletTrianglesIndex{BindlessHeap::InvalidIndex};
+    u32 m_tasksIndex{BindlessHeap::InvalidIndex};
+    u32 m_vertexBufferIndex{BindlessHeap::InvalidIndex};
+
+    u32 m_maxMeshlets{};
+    u32 m_maxMeshletVertices{};
+    u32 m_maxTriangleBytes{};
+    u32 m_maxTasks{};
+    u32 m_meshletCount{};
+    u32 m_meshletVertexCount{};
+    u32 m_triangleBytes{};
+
+    // Keyed by MeshAllocation::FirstIndex, which is unique per mesh in the arena.
+    std::unordered_map<u32, MeshletRange> m_ranges;
+    std::vector<MeshletTask> m_taskData;
+    u32 m_taskCount{};
+    u64 m_taskRevision{~0ull};
+
+public:
+    MeshletPass(Device &device, BindlessHeap &bindless, GeometryArena &geometry, IndirectRenderer &renderer,
+                VkDescriptorSetLayout frameSetLayout, PipelineConfigInfo config, u32 maxMeshlets);
+    ~MeshletPass();
+    MeshletPass(MeshletPass const &other) = delete;
+    MeshletPass &operator=(MeshletPass const &other) = delete;
+
+    // Objects drawing a mesh without registered meshlets are skipped.
+    bool AddMesh(MeshAllocation const &mesh, MeshletData const &meshlets);
+
+    // Rebuilds the task list when objects changed. Must be outside a render pass, after IndirectRenderer::Upload.
+    void Prepare(VkCommandBuffer commandBuffer, StreamingBuffer &staging);
+    // `eye` is the homogeneous viewer position the cone tests use, see EyeFromViewProjection.
+    void Draw(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, u32 frameDataOffset, glm::vec4 const &eye);
+
+    // Rebuilds the pipeline whenever the task, mesh or fragment shader is recompiled.
+    void WatchShaders(ShaderHotReload &hotReload);
+
+    MUST_USE u32 MeshletCount() const { return m_meshletCount; }
+    MUST_USE u32 TaskCount() const { return m_taskCount; }
+
+private:
+    void CreateLayout(VkDescriptorSetLayout frameSetLayout);
+};
\ No newline at end of file
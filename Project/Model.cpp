@@ -1,30 +1,55 @@
 #include "Model.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
 
-Model::Model(Device &device, std::vector<Vertex> const &vertices) : m_device(device)
+Model::Model(Device &device, ResourceManager &resources, std::vector<Vertex> const &vertices) : m_device(device), m_resources(resources)
 {
     CreateVertexBuffers(vertices);
+    m_lods.push_back({0, m_vertexCount, 0.0f});
+}
+
+Model::Model(Device &device, ResourceManager &resources, std::vector<Lod> const &lods) : m_device(device), m_resources(resources)
+{
+    // All levels share one buffer, a level switch is only a different draw range.
+    std::vector<Vertex> vertices;
+    for (auto const &lod: lods) {
+        m_lods.push_back({static_cast<u32>(vertices.size()), static_cast<u32>(lod.Vertices.size()), lod.Error});
+        vertices.insert(vertices.end(), lod.Vertices.begin(), lod.Vertices.end());
+    }
+    CreateVertexBuffers(vertices);
 }
 
 Model::~Model()
 {
-    vkDestroyBuffer(m_device.LogicalDevice(), m_vertexBuffer, nullptr);
-    vkFreeMemory(m_device.LogicalDevice(), m_vertexBufferMemory, nullptr);
+    m_resources.Destroy(m_vertexBuffer);
+}
+
+VkBuffer Model::VertexBuffer() const
+{
+    auto buffer = m_resources.Use(m_vertexBuffer);
+    return buffer ? buffer->Buffer : VK_NULL_HANDLE;
 }
 
 void Model::Bind(VkCommandBuffer commandBuffer)
 {
     VkBuffer buffers[] = {
-            m_vertexBuffer,
+            VertexBuffer(),
     };
 
     VkDeviceSize offsets[] = {0};
 
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    m_device.Stats().Add(RenderCounter::VertexBufferBinds);
 }
 
-void Model::Draw(VkCommandBuffer commandBuffer)
+void Model::Draw(VkCommandBuffer commandBuffer, u32 lod)
 {
-    vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+    auto const &range = m_lods[std::min(lod, static_cast<u32>(m_lods.size() - 1))];
+    vkCmdDraw(commandBuffer, range.VertexCount, 1, range.FirstVertex, 0);
+    m_device.Stats().Draw(range.VertexCount);
 }
 
 void Model::CreateVertexBuffers(const std::vector<Vertex> &vertices)
@@ -32,30 +57,121 @@ void Model::CreateVertexBuffers(const std::vector<Vertex> &vertices)
     m_vertexCount = static_cast<u32>(vertices.size());
     VkDeviceSize bufferSize = sizeof(Vertex) * m_vertexCount;
 
-    auto buffer = m_device.CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    m_vertexBuffer = buffer.Buffer;
-    m_vertexBufferMemory = buffer.Memory;
+    m_vertexBuffer = m_resources.CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    auto memory = m_resources.Use(m_vertexBuffer)->Memory;
 
     void *data;
-    vkMapMemory(m_device.LogicalDevice(), m_vertexBufferMemory, 0, bufferSize, 0, &data);
+    vkMapMemory(m_device.LogicalDevice(), memory, 0, bufferSize, 0, &data);
     std::memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(m_device.LogicalDevice(), m_vertexBufferMemory);
+    vkUnmapMemory(m_device.LogicalDevice(), memory);
+}
+
+Model::MeshData Model::Weld(std::span<Vertex const> triangles)
+{
+    MeshData mesh;
+    mesh.Indices.reserve(triangles.size());
+
+    std::unordered_map<u64, u32> lookup;
+    lookup.reserve(triangles.size());
+    for (auto const &vertex: triangles) {
+        auto key = (static_cast<u64>(std::bit_cast<u32>(vertex.Position.x)) << 32) | std::bit_cast<u32>(vertex.Position.y);
+        auto [it, inserted] = lookup.try_emplace(key, static_cast<u32>(mesh.Vertices.size()));
+        if (inserted) {
+            mesh.Vertices.push_back(vertex);
+        }
+        mesh.Indices.push_back(it->second);
+    }
+    return mesh;
+}
+
+Model::MeshData Model::Cook(std::span<Vertex const> triangles)
+{
+    auto mesh = Weld(triangles);
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh.Vertices.size());
+    for (auto const &vertex: mesh.Vertices) {
+        positions.emplace_back(vertex.Position, 0.0f);
+    }
+    mesh.Meshlets = BuildMeshlets(mesh.Indices, positions);
+    return mesh;
+}
+
+std::vector<Model::Lod> Model::BuildLodChain(std::span<Vertex const> triangles, f32 maxError, u32 maxLevels)
+{
+    std::vector<Lod> lods;
+    lods.push_back({std::vector<Vertex>(triangles.begin(), triangles.end()), 0.0f});
+    if (triangles.empty()) {
+        return lods;
+    }
+
+    glm::vec2 min{std::numeric_limits<f32>::max()}, max{std::numeric_limits<f32>::lowest()};
+    for (auto const &vertex: triangles) {
+        min = glm::min(min, vertex.Position);
+        max = glm::max(max, vertex.Position);
+    }
+    auto extent = std::max(max.x - min.x, max.y - min.y);
+
+    struct Cluster {
+        glm::vec2 Sum{0.0f};
+        u32 Count{};
+    };
+    std::unordered_map<u64, Cluster> clusters;
+    std::vector<u64> keys(triangles.size());
+
+    for (auto cell = extent / 256.0f; lods.size() <= maxLevels; cell *= 2.0f) {
+        auto error = cell * std::sqrt(2.0f);
+        if (error > maxError || cell >= extent) {
+            break;
+        }
+
+        clusters.clear();
+        for (size_t i = 0; i < triangles.size(); i++) {
+            auto coordinates = glm::floor((triangles[i].Position - min) / cell);
+            keys[i] = (static_cast<u64>(coordinates.x) << 32) | static_cast<u64>(coordinates.y);
+            auto &cluster = clusters[keys[i]];
+            cluster.Sum += triangles[i].Position;
+            cluster.Count++;
+        }
+
+        // Triangles that lost an edge to the clustering disappear.
+        std::vector<Vertex> simplified;
+        for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+            if (keys[i] == keys[i + 1] || keys[i + 1] == keys[i + 2] || keys[i] == keys[i + 2]) {
+                continue;
+            }
+            for (size_t corner = 0; corner < 3; corner++) {
+                auto const &cluster = clusters[keys[i + corner]];
+                simplified.push_back({cluster.Sum / static_cast<f32>(cluster.Count)});
+            }
+        }
+
+        if (simplified.empty()) {
+            break;
+        }
+        if (simplified.size() * 10 >= lods.back().Vertices.size() * 9) {
+            continue;
+        }
+        lods.push_back({std::move(simplified), error});
+    }
+    return lods;
 }
 
-std::vector<VkVertexInputBindingDescription> Model::Vertex::BindingDescription()
+Slice<VkVertexInputBindingDescription const> Model::Vertex::BindingDescription()
 {
-    return {{
+    static constexpr VkVertexInputBindingDescription bindings[] = {{
             .binding = 0,
             .stride = sizeof(Vertex),
             .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
     }};
+    return bindings;
 }
-std::vector<VkVertexInputAttributeDescription> Model::Vertex::AttributeDescription()
+Slice<VkVertexInputAttributeDescription const> Model::Vertex::AttributeDescription()
 {
-    return {{
+    static constexpr VkVertexInputAttributeDescription attributes[] = {{
             .location = 0,
             .binding = 0,
             .format = VK_FORMAT_R32G32_SFLOAT,
             .offset = 0,
     }};
+    return attributes;
 }
@@ -1,32 +1,78 @@
 #pragma once
 #include "Device.h"
+#include "Meshlet.h"
+#include "Resources.h"
+#include "Slice.h"
 #include "Types.h"
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
+#include <span>
 #include <vector>
 
 class Model {
+public:
+    // A range of the shared vertex buffer. Error is the largest distance, in object space, any
+    // point of the level strays from the full detail mesh.
+    struct LodRange {
+        u32 FirstVertex;
+        u32 VertexCount;
+        f32 Error;
+    };
+
+private:
     Device &m_device;
-    VkBuffer m_vertexBuffer;
-    VkDeviceMemory m_vertexBufferMemory;
+    // The vertex buffer goes away after the last frame that drew it, models can be unloaded
+    // while frames are in flight.
+    ResourceManager &m_resources;
+    BufferHandle m_vertexBuffer{};
     u32 m_vertexCount;
+    std::vector<LodRange> m_lods;
 
 public:
     struct Vertex {
         glm::vec2 Position;
 
-        static std::vector<VkVertexInputBindingDescription> BindingDescription();
-        static std::vector<VkVertexInputAttributeDescription> AttributeDescription();
+        // Static storage, nothing is built per call.
+        static Slice<VkVertexInputBindingDescription const> BindingDescription();
+        static Slice<VkVertexInputAttributeDescription const> AttributeDescription();
+    };
+
+    struct MeshData {
+        std::vector<Vertex> Vertices;
+        std::vector<u32> Indices;
+        // Only filled in by Cook.
+        MeshletData Meshlets;
+    };
+
+    // One detail level as a triangle list, finest first in a chain.
+    struct Lod {
+        std::vector<Vertex> Vertices;
+        f32 Error;
     };
 
-    Model(Device &device, std::vector<Vertex> const& vertices);
+    // Merges bit-identical vertices of a triangle list into an indexed mesh.
+    MUST_USE static MeshData Weld(std::span<Vertex const> triangles);
+    // Welds and splits the result into meshlets for the mesh shading path.
+    MUST_USE static MeshData Cook(std::span<Vertex const> triangles);
+    // Simplifies by clustering vertices on a grid that doubles every level. Each level is built
+    // from the original mesh, so a vertex moves at most one cell diagonal and that bound is the
+    // level's error. Stops at `maxError`, and skips levels that would barely shrink the mesh.
+    MUST_USE static std::vector<Lod> BuildLodChain(std::span<Vertex const> triangles, f32 maxError, u32 maxLevels = 6);
+
+    Model(Device &device, ResourceManager &resources, std::vector<Vertex> const& vertices);
+    Model(Device &device, ResourceManager &resources, std::vector<Lod> const& lods);
     ~Model();
     Model(Model const &other) = delete;
     Model &operator=(Model const &other) = delete;
 
     void Bind(VkCommandBuffer commandBuffer);
-    void Draw(VkCommandBuffer commandBuffer);
+    void Draw(VkCommandBuffer commandBuffer, u32 lod = 0);
+
+    // Marks the frame being recorded as a use of the buffer.
+    MUST_USE VkBuffer VertexBuffer() const;
+    MUST_USE u32 VertexCount() const { return m_vertexCount; }
+    MUST_USE std::span<LodRange const> Lods() const { return m_lods; }
 
 private:
     void CreateVertexBuffers(std::vector<Vertex> const& vertices);
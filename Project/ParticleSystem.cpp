@@ -0,0 +1,443 @@
+#include "ParticleSystem.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <vector>
+#include <vulkan/vk_enum_string_helper.h>
+
+// Both layouts must match the push constant blocks in the particle shaders.
+struct ParticleConstants {
+    glm::vec4 Emitter;
+    u32 Source;
+    u32 Destination;
+    u32 SourceCounters;
+    u32 DestinationCounters;
+    u32 Capacity;
+    u32 EmitCount;
+    u32 Seed;
+    f32 DeltaTime;
+};
+
+struct ParticleDrawConstants {
+    u32 Particles;
+};
+
+static constexpr char const *SimulateShader = "Assets/Shaders/Builtin.ParticleSimulate.comp.spv";
+static constexpr char const *EmitShader = "Assets/Shaders/Builtin.ParticleEmit.comp.spv";
+static constexpr char const *FinalizeShader = "Assets/Shaders/Builtin.ParticleFinalize.comp.spv";
+
+static constexpr VkPipelineStageFlags DrawStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+
+ParticleSystem::ParticleSystem(Device &device, BindlessHeap &bindless, VkDescriptorSetLayout frameSetLayout, PipelineConfigInfo config, u32 capacity)
+    : m_device(device), m_bindless(bindless), m_capacity(capacity)
+{
+    // Simulate and emit go one dimensional, a full buffer has to fit into one dispatch.
+    auto maxCapacity = static_cast<u64>(m_device.Properties().limits.maxComputeWorkGroupCount[0]) * WorkgroupSize;
+    if (m_capacity > maxCapacity) {
+        WARNF("{} particles need more workgroups than a dispatch allows, clamping to {}", m_capacity, maxCapacity);
+        m_capacity = static_cast<u32>(maxCapacity);
+    }
+
+    // The compute queue only reads what the draws read too, concurrent buffers let the next
+    // simulate overlap the current draw without handing the buffers back and forth.
+    m_async = m_device.HasDedicatedQueue(QueueType::Compute);
+    std::array families{m_device.QueueFamily(QueueType::Graphics), m_device.QueueFamily(QueueType::Compute)};
+    auto shared = m_async ? std::span<u32 const>(families) : std::span<u32 const>();
+
+    for (u32 i = 0; i < m_particles.size(); i++) {
+        auto particles = m_device.CreateBuffer(sizeof(GpuParticle) * static_cast<VkDeviceSize>(m_capacity),
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shared);
+        m_particles[i] = particles.Buffer;
+        m_particlesMemory[i] = particles.Memory;
+        m_particleIndices[i] = m_bindless.RegisterBuffer(m_particles[i], 0, VK_WHOLE_SIZE);
+    }
+
+    auto alignment = m_device.Properties().limits.minStorageBufferOffsetAlignment;
+    m_counterStride = (sizeof(ParticleCounters) + alignment - 1) / alignment * alignment;
+    auto counters = m_device.CreateBuffer(
+            m_counterStride * m_counterIndices.size(),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, shared);
+    m_counters = counters.Buffer;
+    m_countersMemory = counters.Memory;
+    void *mapped{};
+    auto result = vkMapMemory(m_device.LogicalDevice(), m_countersMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to map particle counters: {}", string_VkResult(result));
+    } else {
+        // Starts out empty, the first simulate dispatches no workgroups.
+        m_countersMapped = static_cast<u8 *>(mapped);
+        std::memset(m_countersMapped, 0, m_counterStride * m_counterIndices.size());
+    }
+    for (u32 i = 0; i < m_counterIndices.size(); i++) {
+        m_counterIndices[i] = m_bindless.RegisterBuffer(m_counters, m_counterStride * i, sizeof(ParticleCounters));
+    }
+
+    CreateLayouts(frameSetLayout);
+    m_pipelines = std::make_unique<PipelineRegistry>(m_device);
+    for (auto shader: {SimulateShader, EmitShader, FinalizeShader}) {
+        (void) m_pipelines->Compute(m_computeLayout, shader);
+    }
+
+    config.Layout = m_drawLayout;
+    config.VertexShader = "Assets/Shaders/Builtin.Particle.vert.spv";
+    config.FragmentShader = "Assets/Shaders/Builtin.Particle.frag.spv";
+    config.VertexInput = false;
+    config.InputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    config.Specialization = {};
+    m_config = config;
+    m_pipeline = std::make_unique<Pipeline>(m_device, m_config);
+
+    CreateQueries();
+    if (m_async) {
+        CreateComputeCommands();
+    }
+
+    INFOF("Created particle system for {} particles ({} MiB), simulating on the {} queue",
+          m_capacity, 2 * sizeof(GpuParticle) * static_cast<u64>(m_capacity) >> 20, m_async ? "compute" : "graphics");
+}
+
+ParticleSystem::~ParticleSystem()
+{
+    for (auto index: m_particleIndices) {
+        m_bindless.ReleaseBuffer(index);
+    }
+    for (auto index: m_counterIndices) {
+        m_bindless.ReleaseBuffer(index);
+    }
+
+    m_pipelines.reset();
+    m_pipeline.reset();
+
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), budget = &m_device.Memory(), computeLayout = m_computeLayout, drawLayout = m_drawLayout,
+                              queries = m_queries, pool = m_computePool,
+                              buffers = std::array{m_particles[0], m_particles[1], m_counters},
+                              memories = std::array{m_particlesMemory[0], m_particlesMemory[1], m_countersMemory}] {
+        vkDestroyPipelineLayout(device, computeLayout, callbacks);
+        vkDestroyPipelineLayout(device, drawLayout, callbacks);
+        vkDestroyQueryPool(device, queries, callbacks);
+        vkDestroyCommandPool(device, pool, callbacks);
+        for (u32 i = 0; i < buffers.size(); i++) {
+            vkDestroyBuffer(device, buffers[i], nullptr);
+            budget->Free(device, memories[i]);
+        }
+    });
+}
+
+void ParticleSystem::WatchShaders(ShaderHotReload &hotReload)
+{
+    m_pipelines->WatchShaders(hotReload);
+    hotReload.Watch<Pipeline>({m_config.VertexShader, m_config.FragmentShader}, m_pipeline, [this] {
+        return std::make_unique<Pipeline>(m_device, m_config);
+    });
+}
+
+void ParticleSystem::CreateLayouts(VkDescriptorSetLayout frameSetLayout)
+{
+    // Compute only touches bindless buffers, the draw also needs the frame's view projection.
+    auto heapLayout = m_bindless.Layout();
+    VkPushConstantRange computeRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(ParticleConstants),
+    };
+    VkPipelineLayoutCreateInfo computeInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &heapLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &computeRange,
+    };
+    auto result = vkCreatePipelineLayout(m_device.LogicalDevice(), &computeInfo, m_device.HostCallbacks(), &m_computeLayout);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create particle compute layout: {}", string_VkResult(result));
+    }
+
+    VkDescriptorSetLayout setLayouts[] = {frameSetLayout, heapLayout};
+    VkPushConstantRange drawRange{
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(ParticleDrawConstants),
+    };
+    VkPipelineLayoutCreateInfo drawInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 2,
+            .pSetLayouts = setLayouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &drawRange,
+    };
+    result = vkCreatePipelineLayout(m_device.LogicalDevice(), &drawInfo, m_device.HostCallbacks(), &m_drawLayout);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create particle draw layout: {}", string_VkResult(result));
+    }
+}
+
+void ParticleSystem::CreateQueries()
+{
+    u32 count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device.PhysicalDevice(), &count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device.PhysicalDevice(), &count, families.data());
+
+    auto validBits = families[m_device.QueueFamily(QueueType::Graphics)].timestampValidBits;
+    if (m_async) {
+        validBits = std::min(validBits, families[m_device.QueueFamily(QueueType::Compute)].timestampValidBits);
+    }
+    auto period = m_device.Properties().limits.timestampPeriod;
+    if (validBits == 0 || period <= 0.0f) {
+        WARN("Particle queues have no timestamps, only particle counts are reported");
+        return;
+    }
+    m_timestampPeriod = period;
+    m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = QueriesPerFrame * Swapchain::MaxFramesInFlight,
+    };
+    auto result = vkCreateQueryPool(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &m_queries);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create particle timestamp queries: {}", string_VkResult(result));
+        m_queries = VK_NULL_HANDLE;
+    }
+}
+
+void ParticleSystem::CreateComputeCommands()
+{
+    VkCommandPoolCreateInfo poolInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = m_device.QueueFamily(QueueType::Compute),
+    };
+    auto result = vkCreateCommandPool(m_device.LogicalDevice(), &poolInfo, m_device.HostCallbacks(), &m_computePool);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create particle command pool: {}", string_VkResult(result));
+        m_async = false;
+        return;
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = m_computePool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = Swapchain::MaxFramesInFlight,
+    };
+    result = vkAllocateCommandBuffers(m_device.LogicalDevice(), &allocateInfo, m_computeCommands.data());
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to allocate particle command buffers: {}", string_VkResult(result));
+        m_async = false;
+    }
+}
+
+void ParticleSystem::ReadResults(u32 frameIndex)
+{
+    if (!m_pending[frameIndex] || m_countersMapped == nullptr) {
+        return;
+    }
+    m_pending[frameIndex] = false;
+
+    std::memcpy(&m_lastCounters, m_countersMapped + m_counterStride * frameIndex, sizeof(ParticleCounters));
+    auto rendered = m_drawn[frameIndex] ? m_lastCounters.Alive : 0u;
+    m_stats.Frames++;
+    m_stats.Simulated += m_lastCounters.Simulated;
+    m_stats.Rendered += rendered;
+    if (m_queries == VK_NULL_HANDLE || !m_drawn[frameIndex]) {
+        return;
+    }
+
+    std::array<u64, QueriesPerFrame> timestamps{};
+    auto result = vkGetQueryPoolResults(m_device.LogicalDevice(), m_queries, frameIndex * QueriesPerFrame, QueriesPerFrame,
+                                        sizeof(timestamps), timestamps.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    auto milliseconds = [&](u64 begin, u64 end) {
+        return static_cast<f64>((end - begin) & m_timestampMask) * m_timestampPeriod * 1e-6;
+    };
+    m_stats.TimedFrames++;
+    m_stats.TimedSimulated += m_lastCounters.Simulated;
+    m_stats.TimedRendered += rendered;
+    m_stats.SimulateMs += milliseconds(timestamps[0], timestamps[1]);
+    m_stats.RenderMs += milliseconds(timestamps[2], timestamps[3]);
+}
+
+ParticleStats ParticleSystem::TakeStats()
+{
+    auto stats = m_stats;
+    m_stats = {};
+    return stats;
+}
+
+void ParticleSystem::BeginFrame(u32 frameIndex, f32 deltaTime)
+{
+    ReadResults(frameIndex);
+    m_frameIndex = frameIndex;
+    m_deltaTime = deltaTime;
+    m_simulated = false;
+    m_drawn[frameIndex] = false;
+}
+
+std::optional<QueueWait> ParticleSystem::SubmitAsync()
+{
+    if (!m_async || m_simulated) {
+        return std::nullopt;
+    }
+
+    // The slot's fence covered the graphics submission that waited on this buffer's last use.
+    auto commandBuffer = m_computeCommands[m_frameIndex];
+    VkCommandBufferBeginInfo info{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    auto result = vkBeginCommandBuffer(commandBuffer, &info);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to begin particle command buffer: {}", string_VkResult(result));
+        return std::nullopt;
+    }
+    Record(commandBuffer);
+    result = vkEndCommandBuffer(commandBuffer);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to record particle command buffer: {}", string_VkResult(result));
+    }
+
+    auto point = m_device.Submit(QueueType::Compute, QueueSubmission{.CommandBuffers = {&commandBuffer, 1}});
+    return QueueWait{point, DrawStages};
+}
+
+void ParticleSystem::Simulate(VkCommandBuffer commandBuffer)
+{
+    if (m_simulated) {
+        return;
+    }
+    Record(commandBuffer);
+}
+
+void ParticleSystem::Record(VkCommandBuffer commandBuffer)
+{
+    auto destination = m_frameIndex;
+    auto source = 1 - destination;
+    auto firstQuery = m_frameIndex * QueriesPerFrame;
+
+    // Orders against the previous frame's finalize and, on the graphics queue, the draws that
+    // last read the destination half.
+    VkMemoryBarrier previousBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | (m_async ? 0u : DrawStages),
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &previousBarrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    if (m_queries != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, m_queries, firstQuery, QueriesPerFrame);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queries, firstQuery);
+    }
+
+    vkCmdFillBuffer(commandBuffer, m_counters, m_counterStride * destination + offsetof(ParticleCounters, Count), sizeof(u32), 0);
+    VkMemoryBarrier resetBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    // Roughly what leaves `capacity` alive at the mean lifetime, the overshoot is dropped on append.
+    auto emitCount = static_cast<u32>(std::min(static_cast<f64>(m_capacity),
+                                               std::ceil(m_capacity * static_cast<f64>(m_deltaTime) / m_meanLifetime)));
+    ParticleConstants constants{
+            .Emitter = m_emitter,
+            .Source = m_particleIndices[source],
+            .Destination = m_particleIndices[destination],
+            .SourceCounters = m_counterIndices[source],
+            .DestinationCounters = m_counterIndices[destination],
+            .Capacity = m_capacity,
+            .EmitCount = emitCount,
+            .Seed = m_seed++,
+            .DeltaTime = m_deltaTime,
+    };
+
+    auto heap = m_bindless.Set();
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computeLayout, 0, 1, &heap, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+    VkMemoryBarrier appendBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+
+    // Survivors go first, the previous frame's finalize sized this dispatch.
+    m_pipelines->Compute(m_computeLayout, SimulateShader).BindCommandBuffer(commandBuffer);
+    vkCmdDispatchIndirect(commandBuffer, m_counters, m_counterStride * source + offsetof(ParticleCounters, Dispatch));
+    m_device.Stats().Add(RenderCounter::Dispatches);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &appendBarrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    if (emitCount > 0) {
+        m_pipelines->Compute(m_computeLayout, EmitShader).BindCommandBuffer(commandBuffer);
+        vkCmdDispatch(commandBuffer, (emitCount + WorkgroupSize - 1) / WorkgroupSize, 1, 1);
+        m_device.Stats().Add(RenderCounter::Dispatches);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &appendBarrier, 0, nullptr, 0, nullptr);
+        m_device.Stats().Add(RenderCounter::Barriers);
+    }
+
+    m_pipelines->Compute(m_computeLayout, FinalizeShader).BindCommandBuffer(commandBuffer);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    m_device.Stats().Add(RenderCounter::Dispatches);
+
+    if (m_queries != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queries, firstQuery + 1);
+    }
+
+    // A separate queue gets the draw side through the semaphore wait.
+    VkMemoryBarrier finalizeBarrier{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT | (m_async ? 0u : DrawStages),
+                         0, 1, &finalizeBarrier, 0, nullptr, 0, nullptr);
+    m_device.Stats().Add(RenderCounter::Barriers);
+
+    m_simulated = true;
+    m_pending[m_frameIndex] = true;
+}
+
+void ParticleSystem::Draw(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, u32 frameDataOffset)
+{
+    if (!m_simulated) {
+        return;
+    }
+
+    m_pipeline->BindCommandBuffer(commandBuffer);
+    VkDescriptorSet sets[] = {frameSet, m_bindless.Set()};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_drawLayout, 0, 2, sets, 1, &frameDataOffset);
+
+    ParticleDrawConstants constants{
+            .Particles = m_particleIndices[m_frameIndex],
+    };
+    vkCmdPushConstants(commandBuffer, m_drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+    // Timed from whatever the pass recorded before, close enough with particles dominating.
+    auto firstQuery = m_frameIndex * QueriesPerFrame;
+    if (m_queries != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queries, firstQuery + 2);
+    }
+    vkCmdDrawIndirect(commandBuffer, m_counters, m_counterStride * m_frameIndex + offsetof(ParticleCounters, Draw), 1, sizeof(VkDrawIndirectCommand));
+    m_device.Stats().DrawIndirect();
+    if (m_queries != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queries, firstQuery + 3);
+    }
+    m_drawn[m_frameIndex] = true;
+}
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+#include "Definitions.h"
+#include "Descriptors.h"
+#include "Device.h"
+#include "Pipeline.h"
+#include "PipelineRegistry.h"
+#include "Queues.h"
+#include "ShaderHotReload.h"
+#include "Swapchain.h"
+#include "Types.h"
+#include <array>
+#include <optional>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+// Matches `Particle` in the particle shaders.
+struct GpuParticle {
+    glm::vec4 PositionLife;
+    glm::vec4 VelocityLifetime;
+};
+
+// Matches `Counters` in the particle shaders, one per particle buffer. The finalize pass turns
+// the append count into the indirect arguments of the next simulate dispatch and of the draw.
+struct ParticleCounters {
+    u32 Count;
+    u32 Alive;
+    u32 Simulated;
+    VkDispatchIndirectCommand Dispatch;
+    VkDrawIndirectCommand Draw;
+};
+
+struct ParticleStats {
+    u64 Frames{};
+    u64 Simulated{};
+    u64 Rendered{};
+    // Only frames with valid timestamps count towards these.
+    u64 TimedFrames{};
+    u64 TimedSimulated{};
+    u64 TimedRendered{};
+    f64 SimulateMs{};
+    f64 RenderMs{};
+
+    MUST_USE f64 SimulatedPerMs() const { return SimulateMs > 0.0 ? static_cast<f64>(TimedSimulated) / SimulateMs : 0.0; }
+    MUST_USE f64 RenderedPerMs() const { return RenderMs > 0.0 ? static_cast<f64>(TimedRendered) / RenderMs : 0.0; }
+};
+
+// Compute driven particles as a throughput workload. Each frame simulates the previous frame's
+// buffer into the other one, appending survivors with atomics so the output stays compact, emits
+// new particles behind them and writes the indirect arguments for the next frame's simulate
+// dispatch and this frame's point draw. Nothing is read back except statistics.
+class ParticleSystem {
+public:
+    static constexpr u32 WorkgroupSize = 256;
+    // Both halves of the double buffer are tied to frame slots, the slot's fence covers the
+    // draw that last read the buffer being overwritten.
+    static_assert(Swapchain::MaxFramesInFlight == 2, "Particle buffers are double buffered per frame slot");
+
+private:
+    // One query pair for simulate, one for the draw, per frame slot.
+    static constexpr u32 QueriesPerFrame = 4;
+
+    Device &m_device;
+    BindlessHeap &m_bindless;
+    u32 m_capacity;
+    glm::vec4 m_emitter{0.0f, 0.8f, 0.0f, 0.05f};
+    f32 m_meanLifetime{2.0f};
+
+    VkPipelineLayout m_computeLayout{};
+    VkPipelineLayout m_drawLayout{};
+    Ptr<PipelineRegistry> m_pipelines{};
+    PipelineConfigInfo m_config{};
+    Ptr<Pipeline> m_pipeline{};
+
+    std::array<VkBuffer, 2> m_particles{};
+    std::array<VkDeviceMemory, 2> m_particlesMemory{};
+    std::array<u32, 2> m_particleIndices{BindlessHeap::InvalidIndex, BindlessHeap::InvalidIndex};
+    // Host visible, read back once the frame slot's fence signalled.
+    VkBuffer m_counters{};
+    VkDeviceMemory m_countersMemory{};
+    u8 *m_countersMapped{};
+    VkDeviceSize m_counterStride{};
+    std::array<u32, 2> m_counterIndices{BindlessHeap::InvalidIndex, BindlessHeap::InvalidIndex};
+
+    // Only with a dedicated compute queue.
+    bool m_async{false};
+    VkCommandPool m_computePool{};
+    std::array<VkCommandBuffer, Swapchain::MaxFramesInFlight> m_computeCommands{};
+
+    VkQueryPool m_queries{};
+    f64 m_timestampPeriod{};
+    u64 m_timestampMask{};
+
+    u32 m_frameIndex{};
+    f32 m_deltaTime{};
+    u32 m_seed{};
+    bool m_simulated{false};
+    std::array<bool, Swapchain::MaxFramesInFlight> m_pending{};
+    std::array<bool, Swapchain::MaxFramesInFlight> m_drawn{};
+    ParticleCounters m_lastCounters{};
+    ParticleStats m_stats{};
+
+public:
+    // `config` is the scene's pipeline config, the particle pipeline keeps its targets.
+    ParticleSystem(Device &device, BindlessHeap &bindless, VkDescriptorSetLayout frameSetLayout, PipelineConfigInfo config, u32 capacity);
+    ~ParticleSystem();
+    ParticleSystem(ParticleSystem const &other) = delete;
+    ParticleSystem &operator=(ParticleSystem const &other) = delete;
+
+    // Collects the slot's results, must come after the slot's fence.
+    void BeginFrame(u32 frameIndex, f32 deltaTime);
+    // With a dedicated compute queue the simulation is submitted there right away, the returned
+    // wait belongs on the frame's graphics submission.
+    MUST_USE std::optional<QueueWait> SubmitAsync();
+    // Otherwise it is recorded into the frame's command buffer, outside of any render pass.
+    // Does nothing after SubmitAsync().
+    void Simulate(VkCommandBuffer commandBuffer);
+    void Draw(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, u32 frameDataOffset);
+
+    void WatchShaders(ShaderHotReload &hotReload);
+
+    MUST_USE u32 Capacity() const { return m_capacity; }
+    MUST_USE bool Async() const { return m_async; }
+    MUST_USE ParticleCounters const &LastCounters() const { return m_lastCounters; }
+    MUST_USE ParticleStats TakeStats();
+
+private:
+    void CreateLayouts(VkDescriptorSetLayout frameSetLayout);
+    void CreateQueries();
+    void CreateComputeCommands();
+    void ReadResults(u32 frameIndex);
+    void Record(VkCommandBuffer commandBuffer);
+};
\ No newline at end of file
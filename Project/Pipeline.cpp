@@ -1,7 +1,7 @@
 #include "Pipeline.h"
 #include "Logger.h"
 #include "Model.h"
-#include <fstream>
+#include <array>
 #include <vulkan/vk_enum_string_helper.h>
 
 PipelineConfigInfo PipelineConfigInfo::Default(u32 width, u32 height)
@@ -45,8 +45,8 @@ PipelineConfigInfo PipelineConfigInfo::Default(u32 width, u32 height)
             },
             .DepthStencilInfo = VkPipelineDepthStencilStateCreateInfo{
                     .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-                    .depthTestEnable = true,
-                    .depthWriteEnable = true,
+                    .depthTestEnable = false,
+                    .depthWriteEnable = false,
                     .depthCompareOp = VK_COMPARE_OP_LESS,
                     .depthBoundsTestEnable = false,
                     .stencilTestEnable = false,
@@ -58,6 +58,13 @@ PipelineConfigInfo PipelineConfigInfo::Default(u32 width, u32 height)
             .Layout = VK_NULL_HANDLE,
             .RenderPass = VK_NULL_HANDLE,
             .SubPass = 0,
+            .ColorFormat = VK_FORMAT_UNDEFINED,
+            .DepthFormat = VK_FORMAT_UNDEFINED,
+            .VertexShader = "Assets/Shaders/Builtin.Object.vert.spv",
+            .FragmentShader = "Assets/Shaders/Builtin.Object.frag.spv",
+            .VertexInput = true,
+            .TaskShader = nullptr,
+            .MeshShader = nullptr,
     };
 
     pipelineConfigInfo.Viewport = VkViewport{
@@ -78,39 +85,49 @@ PipelineConfigInfo PipelineConfigInfo::Default(u32 width, u32 height)
 }
 
 
-Pipeline::Pipeline(Device &device, PipelineConfigInfo config) : m_device(device)
+Pipeline::Pipeline(Device &device, PipelineConfigInfo config, ResourceManager *resources) : m_device(device), m_resources(resources)
 {
-    auto vertCode = LoadShaderByteCode("Assets/Shaders/Builtin.Object.vert.spv");
-    auto fragCode = LoadShaderByteCode("Assets/Shaders/Builtin.Object.frag.spv");
-
-    m_vertexModule = CreateShaderModule(vertCode);
-    m_fragmentModule = CreateShaderModule(fragCode);
-
-    VkPipelineShaderStageCreateInfo vertStageInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = m_vertexModule,
-            .pName = "main",
-    };
-
-    VkPipelineShaderStageCreateInfo fragStageInfo{
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = m_fragmentModule,
-            .pName = "main",
+    // Default() points this at its own local copy, configs are copied around and rebuilt later.
+    config.ColorBlendInfo.pAttachments = &config.ColorBlendAttachmentInfo;
+    bool meshShading = config.MeshShader != nullptr;
+    SpecializationInfo specialization(config.Specialization);
+    // Task, mesh and fragment at most.
+    std::array<VkPipelineShaderStageCreateInfo, 3> stages{};
+    u32 stageCount = 0;
+    auto addStage = [&](VkShaderStageFlagBits stage, char const *path, VkShaderModule &module) {
+        module = CreateShaderModule(LoadShaderByteCode(path));
+        stages[stageCount++] = VkPipelineShaderStageCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = stage,
+                .module = module,
+                .pName = "main",
+                .pSpecializationInfo = specialization.Get(),
+        };
     };
 
-    VkPipelineShaderStageCreateInfo stages[] = {vertStageInfo, fragStageInfo};
+    if (meshShading) {
+        if (config.TaskShader != nullptr) {
+            addStage(VK_SHADER_STAGE_TASK_BIT_EXT, config.TaskShader, m_taskModule);
+        }
+        addStage(VK_SHADER_STAGE_MESH_BIT_EXT, config.MeshShader, m_meshModule);
+    } else {
+        addStage(VK_SHADER_STAGE_VERTEX_BIT, config.VertexShader, m_vertexModule);
+    }
+    addStage(VK_SHADER_STAGE_FRAGMENT_BIT, config.FragmentShader, m_fragmentModule);
 
     auto bindingDescriptions = Model::Vertex::BindingDescription();
     auto attributeDescriptions = Model::Vertex::AttributeDescription();
+    if (!config.VertexBindings.empty()) {
+        bindingDescriptions = config.VertexBindings;
+        attributeDescriptions = config.VertexAttributes;
+    }
 
     VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .vertexBindingDescriptionCount = static_cast<u32>(bindingDescriptions.size()),
-            .pVertexBindingDescriptions = bindingDescriptions.data(),
-            .vertexAttributeDescriptionCount = static_cast<u32>(attributeDescriptions.size()),
-            .pVertexAttributeDescriptions = attributeDescriptions.data(),
+            .vertexBindingDescriptionCount = config.VertexInput ? bindingDescriptions.Length() : 0u,
+            .pVertexBindingDescriptions = bindingDescriptions.Data(),
+            .vertexAttributeDescriptionCount = config.VertexInput ? attributeDescriptions.Length() : 0u,
+            .pVertexAttributeDescriptions = attributeDescriptions.Data(),
     };
 
     VkPipelineViewportStateCreateInfo viewportStateCreateInfo{
@@ -121,12 +138,21 @@ Pipeline::Pipeline(Device &device, PipelineConfigInfo config) : m_device(device)
             .pScissors = &config.Scissor,
     };
 
+    VkPipelineRenderingCreateInfo renderingCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+            .colorAttachmentCount = config.ColorFormat != VK_FORMAT_UNDEFINED ? 1u : 0u,
+            .pColorAttachmentFormats = &config.ColorFormat,
+            .depthAttachmentFormat = config.DepthFormat,
+    };
+
     VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            .stageCount = 2,
-            .pStages = stages,
-            .pVertexInputState = &vertexInputStateCreateInfo,
-            .pInputAssemblyState = &config.InputAssemblyInfo,
+            .pNext = config.RenderPass == VK_NULL_HANDLE ? &renderingCreateInfo : nullptr,
+            .stageCount = stageCount,
+            .pStages = stages.data(),
+            // Mesh pipelines generate their primitives themselves.
+            .pVertexInputState = meshShading ? nullptr : &vertexInputStateCreateInfo,
+            .pInputAssemblyState = meshShading ? nullptr : &config.InputAssemblyInfo,
             .pViewportState = &viewportStateCreateInfo,
             .pRasterizationState = &config.RasterizationInfo,
             .pMultisampleState = &config.MultisampleInfo,
@@ -143,50 +169,51 @@ Pipeline::Pipeline(Device &device, PipelineConfigInfo config) : m_device(device)
     };
 
     INFO("Creating graphics pipeline");
-    auto result = vkCreateGraphicsPipelines(m_device.LogicalDevice(), nullptr, 1, &graphicsPipelineCreateInfo, nullptr, &m_pipelineHandle);
+    auto result = vkCreateGraphicsPipelines(m_device.LogicalDevice(), m_device.PipelineCache(), 1, &graphicsPipelineCreateInfo, m_device.HostCallbacks(), &m_pipelineHandle);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to create graphics pipeline: {}", string_VkResult(result));
         return;
     }
     INFO("Successfully created graphics pipeline");
+    if (m_resources != nullptr) {
+        m_handle = m_resources->AddPipeline(m_pipelineHandle, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    }
 }
 
 Pipeline::~Pipeline()
 {
-    vkDestroyShaderModule(m_device.LogicalDevice(), m_vertexModule, nullptr);
-    vkDestroyShaderModule(m_device.LogicalDevice(), m_fragmentModule, nullptr);
-    vkDestroyPipeline(m_device.LogicalDevice(), m_pipelineHandle, nullptr);
+    auto pipeline = m_pipelineHandle;
+    if (m_handle.IsValid()) {
+        // The manager owns it now and knows the last frame that used it.
+        m_resources->Destroy(m_handle);
+        pipeline = VK_NULL_HANDLE;
+    }
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), pipeline,
+                              modules = std::array{m_vertexModule, m_fragmentModule, m_taskModule, m_meshModule}] {
+        for (auto module: modules) {
+            vkDestroyShaderModule(device, module, callbacks);
+        }
+        vkDestroyPipeline(device, pipeline, callbacks);
+    });
 }
 
-std::vector<char> Pipeline::LoadShaderByteCode(const char *filePath)
+ShaderCode Pipeline::LoadShaderByteCode(const char *filePath)
 {
-    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        ERRORF("Failed to open file '{}'", filePath);
-        return {};
-    }
-    INFOF("Loading shader bytecode from '{}'", filePath);
-
-    auto size = file.tellg();
-    INFOF("\tBytecode size is {} bytes", static_cast<i32>(file.tellg()));
-    std::vector<char> byteCode(size);
-    file.seekg(0, std::ifstream::beg);
-
-    file.read(byteCode.data(), static_cast<std::streamsize>(byteCode.size()));
-    return byteCode;
+    // Embedded shaders cost nothing here, files are mapped and read straight from the page cache.
+    return ShaderCode::Load(filePath);
 }
 
-VkShaderModule Pipeline::CreateShaderModule(const std::vector<char> &byteCode)
+VkShaderModule Pipeline::CreateShaderModule(ShaderCode const &byteCode)
 {
     INFO("Creating shader module");
     VkShaderModuleCreateInfo info{
             .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-            .codeSize = static_cast<u32>(byteCode.size()),
-            .pCode = reinterpret_cast<const u32 *>(byteCode.data()),
+            .codeSize = byteCode.Size(),
+            .pCode = byteCode.Words(),
     };
 
     VkShaderModule module;
-    auto result = vkCreateShaderModule(m_device.LogicalDevice(), &info, nullptr, &module);
+    auto result = vkCreateShaderModule(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &module);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to create shader module: {}", string_VkResult(result));
     }
@@ -194,7 +221,69 @@ VkShaderModule Pipeline::CreateShaderModule(const std::vector<char> &byteCode)
     return module;
 }
 
+VkPipeline Pipeline::Handle() const
+{
+    if (!m_handle.IsValid()) {
+        return m_pipelineHandle;
+    }
+    auto pipeline = m_resources->Use(m_handle);
+    return pipeline ? pipeline->Pipeline : VK_NULL_HANDLE;
+}
+
 void Pipeline::BindCommandBuffer(VkCommandBuffer commandBuffer)
 {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineHandle);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Handle());
+    m_device.Stats().Add(RenderCounter::PipelineBinds);
 }
+
+
+ComputePipeline::ComputePipeline(Device &device, VkPipelineLayout layout, const char *shaderPath, SpecializationConstants const &specialization)
+    : m_device(device)
+{
+    auto byteCode = Pipeline::LoadShaderByteCode(shaderPath);
+    VkShaderModuleCreateInfo moduleInfo{
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = byteCode.Size(),
+            .pCode = byteCode.Words(),
+    };
+
+    auto result = vkCreateShaderModule(m_device.LogicalDevice(), &moduleInfo, m_device.HostCallbacks(), &m_module);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create shader module: {}", string_VkResult(result));
+        return;
+    }
+
+    SpecializationInfo specializationInfo(specialization);
+    VkComputePipelineCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = VkPipelineShaderStageCreateInfo{
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = m_module,
+                    .pName = "main",
+                    .pSpecializationInfo = specializationInfo.Get(),
+            },
+            .layout = layout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = -1,
+    };
+
+    result = vkCreateComputePipelines(m_device.LogicalDevice(), m_device.PipelineCache(), 1, &info, m_device.HostCallbacks(), &m_pipelineHandle);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create compute pipeline '{}': {}", shaderPath, string_VkResult(result));
+    }
+}
+
+ComputePipeline::~ComputePipeline()
+{
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), pipeline = m_pipelineHandle, module = m_module] {
+        vkDestroyShaderModule(device, module, callbacks);
+        vkDestroyPipeline(device, pipeline, callbacks);
+    });
+}
+
+void ComputePipeline::BindCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineHandle);
+    m_device.Stats().Add(RenderCounter::PipelineBinds);
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include "Device.h"
+#include "Resources.h"
+#include "ShaderCode.h"
+#include "Specialization.h"
+#include <span>
 #include <vector>
 
 struct PipelineConfigInfo {
@@ -15,21 +19,62 @@ struct PipelineConfigInfo {
     VkPipelineLayout Layout;
     VkRenderPass RenderPass;
     u32 SubPass;
+    // Used for dynamic rendering when there is no render pass.
+    VkFormat ColorFormat;
+    VkFormat DepthFormat;
+    char const *VertexShader;
+    char const *FragmentShader;
+    // Off for vertex shaders that fetch everything from storage buffers, no bindings are declared then.
+    bool VertexInput;
+    // Model::Vertex when empty. Must point at storage that outlives every copy of the config.
+    std::span<VkVertexInputBindingDescription const> VertexBindings;
+    std::span<VkVertexInputAttributeDescription const> VertexAttributes;
+    // Setting a mesh shader builds a VK_EXT_mesh_shader pipeline instead, the vertex shader and
+    // the vertex input state are ignored then. The task shader is optional.
+    char const *TaskShader;
+    char const *MeshShader;
+    // Shared by every stage, each only picks up the constant ids it declares.
+    SpecializationConstants Specialization;
 
     static PipelineConfigInfo Default(u32 width, u32 height);
+
+    MUST_USE bool UsesDepth() const {
+        return DepthStencilInfo.depthTestEnable || DepthStencilInfo.depthWriteEnable || DepthStencilInfo.stencilTestEnable;
+    }
 };
 
 class Pipeline {
     VkPipeline m_pipelineHandle{};
     Device& m_device;
-    VkShaderModule m_vertexModule, m_fragmentModule;
+    VkShaderModule m_vertexModule{}, m_fragmentModule{};
+    VkShaderModule m_taskModule{}, m_meshModule{};
+    ResourceManager* m_resources{};
+    PipelineHandle m_handle{};
 public:
-    explicit Pipeline(Device& device, PipelineConfigInfo info);
+    // With a resource manager the pipeline lives behind one of its handles: every Handle() marks
+    // the frame being recorded as a use, and the pipeline is retired after the last of them.
+    explicit Pipeline(Device& device, PipelineConfigInfo info, ResourceManager* resources = nullptr);
     ~Pipeline();
 
     void BindCommandBuffer(VkCommandBuffer commandBuffer);
+    MUST_USE VkPipeline Handle() const;
+
+    static ShaderCode LoadShaderByteCode(const char* filePath);
 
 private:
-    VkShaderModule CreateShaderModule(std::vector<char> const& byteCode);
-    static std::vector<char> LoadShaderByteCode(const char* filePath);
+    VkShaderModule CreateShaderModule(ShaderCode const& byteCode);
+};
+
+class ComputePipeline {
+    VkPipeline m_pipelineHandle{};
+    Device& m_device;
+    VkShaderModule m_module{};
+public:
+    ComputePipeline(Device& device, VkPipelineLayout layout, const char* shaderPath, SpecializationConstants const& specialization = {});
+    ~ComputePipeline();
+    ComputePipeline(ComputePipeline const& other) = delete;
+    ComputePipeline& operator=(ComputePipeline const& other) = delete;
+
+    void BindCommandBuffer(VkCommandBuffer commandBuffer);
+    MUST_USE VkPipeline Handle() const { return m_pipelineHandle; }
 };
@@ -0,0 +1,52 @@
+#include "PipelineRegistry.h"
+#include "Logger.h"
+#include <bit>
+
+ComputePipeline &PipelineRegistry::Compute(VkPipelineLayout layout, char const *shader, SpecializationConstants const &specialization)
+{
+    auto key = VariantKey(layout, shader, specialization);
+    auto it = m_compute.find(key);
+    if (it != m_compute.end()) {
+        return *it->second.Pipeline;
+    }
+
+    INFOF("Building variant {:016x} of '{}' with {} specialization constants", key, shader, specialization.Count);
+    auto &variant = m_compute.emplace(key, ComputeVariant{
+            .Layout = layout,
+            .Shader = shader,
+            .Specialization = specialization,
+            .Pipeline = std::make_unique<ComputePipeline>(m_device, layout, shader, specialization),
+    }).first->second;
+    if (m_hotReload != nullptr) {
+        Watch(variant);
+    }
+    return *variant.Pipeline;
+}
+
+void PipelineRegistry::WatchShaders(ShaderHotReload &hotReload)
+{
+    m_hotReload = &hotReload;
+    for (auto &[key, variant]: m_compute) {
+        Watch(variant);
+    }
+}
+
+void PipelineRegistry::Watch(ComputeVariant &variant)
+{
+    m_hotReload->Watch<ComputePipeline>({variant.Shader.c_str()}, variant.Pipeline, [this, &variant] {
+        return std::make_unique<ComputePipeline>(m_device, variant.Layout, variant.Shader.c_str(), variant.Specialization);
+    });
+}
+
+u64 PipelineRegistry::VariantKey(VkPipelineLayout layout, char const *shader, SpecializationConstants const &specialization)
+{
+    // FNV-1a over the shader path, then mixed with the layout and the traits' own key.
+    u64 key = 0xcbf29ce484222325ull;
+    for (; *shader != '\0'; shader++) {
+        key = (key ^ static_cast<u8>(*shader)) * 0x100000001b3ull;
+    }
+    for (auto value: {std::bit_cast<u64>(layout), specialization.Key}) {
+        key ^= value + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+    }
+    return key;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "Pipeline.h"
+#include "ShaderHotReload.h"
+#include "Specialization.h"
+#include "Types.h"
+#include <string>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+// Compute pipelines built on first use per shader, layout and specialization variant. Passes
+// look their variant up every time they record, so flipping a trait costs one pipeline build
+// the first time and a hash lookup afterwards.
+class PipelineRegistry {
+    struct ComputeVariant {
+        VkPipelineLayout Layout;
+        std::string Shader;
+        SpecializationConstants Specialization;
+        Ptr<ComputePipeline> Pipeline;
+    };
+
+    Device &m_device;
+    // Nodes never move, hot reload keeps pointing at the pipeline slots.
+    std::unordered_map<u64, ComputeVariant> m_compute;
+    ShaderHotReload *m_hotReload{};
+
+public:
+    explicit PipelineRegistry(Device &device) : m_device(device) {}
+    PipelineRegistry(PipelineRegistry const &other) = delete;
+    PipelineRegistry &operator=(PipelineRegistry const &other) = delete;
+
+    ComputePipeline &Compute(VkPipelineLayout layout, char const *shader, SpecializationConstants const &specialization = {});
+
+    // Every variant, including the ones built later, is rebuilt when its shader changes.
+    void WatchShaders(ShaderHotReload &hotReload);
+
+    MUST_USE u32 VariantCount() const { return static_cast<u32>(m_compute.size()); }
+
+    MUST_USE static u64 VariantKey(VkPipelineLayout layout, char const *shader, SpecializationConstants const &specialization);
+
+private:
+    void Watch(ComputeVariant &variant);
+};
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "Queues.h"
+
+void BufferOwnershipTransfer::Release(VkCommandBuffer commandBuffer) const
+{
+    if (SourceFamily == DestinationFamily) {
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = SourceAccess,
+            .dstAccessMask = 0,
+            .srcQueueFamilyIndex = SourceFamily,
+            .dstQueueFamilyIndex = DestinationFamily,
+            .buffer = Buffer,
+            .offset = Offset,
+            .size = Size,
+    };
+    vkCmdPipelineBarrier(commandBuffer, SourceStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void BufferOwnershipTransfer::Acquire(VkCommandBuffer commandBuffer) const
+{
+    if (SourceFamily == DestinationFamily) {
+        return;
+    }
+
+    VkBufferMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = DestinationAccess,
+            .srcQueueFamilyIndex = SourceFamily,
+            .dstQueueFamilyIndex = DestinationFamily,
+            .buffer = Buffer,
+            .offset = Offset,
+            .size = Size,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, DestinationStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void ImageOwnershipTransfer::Release(VkCommandBuffer commandBuffer) const
+{
+    if (SourceFamily == DestinationFamily) {
+        return;
+    }
+
+    VkImageMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = SourceAccess,
+            .dstAccessMask = 0,
+            .oldLayout = OldLayout,
+            .newLayout = NewLayout,
+            .srcQueueFamilyIndex = SourceFamily,
+            .dstQueueFamilyIndex = DestinationFamily,
+            .image = Image,
+            .subresourceRange = Range,
+    };
+    vkCmdPipelineBarrier(commandBuffer, SourceStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void ImageOwnershipTransfer::Acquire(VkCommandBuffer commandBuffer) const
+{
+    // Within one family only the layout changes. Its source stages match the semaphore wait
+    // so the transition is ordered after it, as with a swapchain image.
+    auto sameFamily = SourceFamily == DestinationFamily;
+    if (sameFamily && OldLayout == NewLayout) {
+        return;
+    }
+
+    VkImageMemoryBarrier barrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = DestinationAccess,
+            .oldLayout = OldLayout,
+            .newLayout = NewLayout,
+            .srcQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : SourceFamily,
+            .dstQueueFamilyIndex = sameFamily ? VK_QUEUE_FAMILY_IGNORED : DestinationFamily,
+            .image = Image,
+            .subresourceRange = Range,
+    };
+    vkCmdPipelineBarrier(commandBuffer, sameFamily ? DestinationStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, DestinationStages,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
\ No newline at end of file
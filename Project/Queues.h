@@ -0,0 +1,72 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <span>
+#include <vulkan/vulkan.h>
+
+// Queues work is submitted to. Compute and transfer get their own family when the device has
+// one without graphics, otherwise they share the graphics queue but keep their own timeline.
+enum class QueueType : u32 {
+    Graphics,
+    Compute,
+    Transfer,
+};
+inline constexpr u32 QueueTypeCount = 3;
+
+// A value on a queue's timeline semaphore, reached once everything submitted up to it finished.
+struct QueuePoint {
+    QueueType Queue{QueueType::Graphics};
+    u64 Value{0};
+};
+
+struct QueueWait {
+    QueuePoint Point;
+    // Stages of the waiting submission that must not start before the point is reached.
+    VkPipelineStageFlags Stages;
+};
+
+struct QueueSubmission {
+    std::span<VkCommandBuffer const> CommandBuffers{};
+    std::span<QueueWait const> Waits{};
+    // Binary semaphores, the swapchain's acquire and present only know those.
+    std::span<VkSemaphore const> BinaryWaits{};
+    std::span<VkPipelineStageFlags const> BinaryWaitStages{};
+    std::span<VkSemaphore const> BinarySignals{};
+    VkFence Fence{};
+};
+
+// Hands an exclusive buffer range from one queue family to another. Release() is recorded on
+// the source queue, Acquire() on the destination queue in a submission that waits for the
+// release's. Within one family both record nothing, the semaphore wait is all it takes.
+struct BufferOwnershipTransfer {
+    VkBuffer Buffer;
+    VkDeviceSize Offset;
+    VkDeviceSize Size;
+    u32 SourceFamily;
+    u32 DestinationFamily;
+    VkPipelineStageFlags SourceStages;
+    VkAccessFlags SourceAccess;
+    VkPipelineStageFlags DestinationStages;
+    VkAccessFlags DestinationAccess;
+
+    void Release(VkCommandBuffer commandBuffer) const;
+    void Acquire(VkCommandBuffer commandBuffer) const;
+};
+
+// Same for an image, the layout transition happens as part of the transfer and both halves
+// have to name the same layouts. Within one family Acquire() still records the transition.
+struct ImageOwnershipTransfer {
+    VkImage Image;
+    VkImageSubresourceRange Range;
+    VkImageLayout OldLayout;
+    VkImageLayout NewLayout;
+    u32 SourceFamily;
+    u32 DestinationFamily;
+    VkPipelineStageFlags SourceStages;
+    VkAccessFlags SourceAccess;
+    VkPipelineStageFlags DestinationStages;
+    VkAccessFlags DestinationAccess;
+
+    void Release(VkCommandBuffer commandBuffer) const;
+    void Acquire(VkCommandBuffer commandBuffer) const;
+};
\ No newline at end of file
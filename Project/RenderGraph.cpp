@@ -0,0 +1,738 @@
+#include "RenderGraph.h"
+#include "LinearArena.h"
+#include "Logger.h"
+#include <algorithm>
+#include <numeric>
+#include <vulkan/vk_enum_string_helper.h>
+
+namespace {
+
+struct UsageInfo {
+    VkPipelineStageFlags2 Stages;
+    VkAccessFlags2 Access;
+    VkImageLayout Layout;
+    VkImageUsageFlags ImageUsage;
+    bool Attachment;
+};
+
+constexpr VkAccessFlags2 WriteAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                                           VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                           VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                                           VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+constexpr VkPipelineStageFlags2 FragmentTestStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+UsageInfo Describe(ResourceUsage usage)
+{
+    switch (usage) {
+        case ResourceUsage::ColorAttachment:
+            return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true};
+        case ResourceUsage::DepthAttachment:
+            return {FragmentTestStages,
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true};
+        case ResourceUsage::DepthRead:
+            return {FragmentTestStages, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true};
+        case ResourceUsage::SampledFragment:
+            return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false};
+        case ResourceUsage::SampledCompute:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false};
+        case ResourceUsage::StorageRead:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false};
+        case ResourceUsage::StorageWrite:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false};
+        case ResourceUsage::TransferSource:
+            return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false};
+        case ResourceUsage::TransferDestination:
+            return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false};
+        case ResourceUsage::IndirectRead:
+            return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, 0, false};
+        case ResourceUsage::VertexRead:
+            return {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT,
+                    VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, 0, false};
+        case ResourceUsage::UniformRead:
+            return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, false};
+    }
+    return {};
+}
+
+VkImageAspectFlags AspectFromFormat(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+VkImageCreateInfo TransientImageInfo(VkFormat format, VkExtent2D extent, VkImageUsageFlags usage)
+{
+    return VkImageCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = {extent.width, extent.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+}
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool LifetimesOverlap(u32 firstA, u32 lastA, u32 firstB, u32 lastB)
+{
+    return firstA <= lastB && firstB <= lastA;
+}
+
+}
+
+RenderGraphPass &RenderGraphPass::Read(RenderResource resource, ResourceUsage usage)
+{
+    m_uses.push_back(Use{resource, usage, false, false, {}});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::Write(RenderResource resource, ResourceUsage usage)
+{
+    m_uses.push_back(Use{resource, usage, true, false, {}});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::Clear(RenderResource resource, ResourceUsage usage, VkClearValue value)
+{
+    if (!Describe(usage).Attachment) {
+        WARNF("Pass '{}' clears through a non-attachment usage, treating it as a plain write", m_name);
+        return Write(resource, usage);
+    }
+    m_uses.push_back(Use{resource, usage, true, true, value});
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::SideEffects()
+{
+    m_sideEffects = true;
+    return *this;
+}
+
+RenderGraphPass &RenderGraphPass::Execute(std::function<void(VkCommandBuffer)> execute)
+{
+    m_execute = std::move(execute);
+    return *this;
+}
+
+bool RenderGraph::Placement::operator==(Placement const &other) const
+{
+    return Format == other.Format && Extent.width == other.Extent.width && Extent.height == other.Extent.height &&
+           Usage == other.Usage && MemoryType == other.MemoryType && Offset == other.Offset && Size == other.Size;
+}
+
+RenderGraph::RenderGraph(Device &device) : m_device(device)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    for (auto &set: m_transientSets) {
+        DestroyTransients(set);
+    }
+}
+
+void RenderGraph::Begin(u32 frameSlot)
+{
+    m_frameSlot = frameSlot % Swapchain::MaxFramesInFlight;
+    m_resources.clear();
+    m_passes.clear();
+}
+
+RenderResource RenderGraph::ImportImage(char const *name, VkImage image, VkImageView view, TextureDesc const &desc,
+                                        ResourceState initial, ResourceState final)
+{
+    m_resources.push_back(Resource{
+            .Name = name,
+            .Imported = true,
+            .IsImage = true,
+            .Desc = desc,
+            .Usage = desc.ExtraUsage,
+            .Aspect = AspectFromFormat(desc.Format),
+            .Image = image,
+            .View = view,
+            .Buffer = VK_NULL_HANDLE,
+            .Initial = initial,
+            .Final = final,
+    });
+    return RenderResource{static_cast<u32>(m_resources.size() - 1)};
+}
+
+RenderResource RenderGraph::ImportBuffer(char const *name, VkBuffer buffer, ResourceState initial, ResourceState final)
+{
+    m_resources.push_back(Resource{
+            .Name = name,
+            .Imported = true,
+            .IsImage = false,
+            .Desc = {},
+            .Usage = 0,
+            .Aspect = 0,
+            .Image = VK_NULL_HANDLE,
+            .View = VK_NULL_HANDLE,
+            .Buffer = buffer,
+            .Initial = initial,
+            .Final = final,
+    });
+    return RenderResource{static_cast<u32>(m_resources.size() - 1)};
+}
+
+RenderResource RenderGraph::CreateTexture(char const *name, TextureDesc const &desc)
+{
+    m_resources.push_back(Resource{
+            .Name = name,
+            .Imported = false,
+            .IsImage = true,
+            .Desc = desc,
+            .Usage = desc.ExtraUsage,
+            .Aspect = AspectFromFormat(desc.Format),
+            .Image = VK_NULL_HANDLE,
+            .View = VK_NULL_HANDLE,
+            .Buffer = VK_NULL_HANDLE,
+            .Initial = {},
+            .Final = {},
+    });
+    return RenderResource{static_cast<u32>(m_resources.size() - 1)};
+}
+
+RenderGraphPass &RenderGraph::AddPass(char const *name)
+{
+    return m_passes.emplace_back(name);
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+{
+    m_stats = {};
+    Cull();
+    ComputeLifetimes();
+    AllocateTransients();
+    Record(commandBuffer);
+}
+
+void RenderGraph::Cull()
+{
+    // Walk back from the imported resources, which are what the frame hands to the outside. A pass
+    // survives when something after it still needs a resource it writes. Clears end the chain,
+    // whatever was written before them is never seen.
+    m_kept.assign(m_passes.size(), false);
+    m_needed.assign(m_resources.size(), false);
+    for (u32 i = 0; i < m_resources.size(); i++) {
+        m_needed[i] = m_resources[i].Exported();
+    }
+
+    for (u32 i = static_cast<u32>(m_passes.size()); i-- > 0;) {
+        auto const &pass = m_passes[i];
+        bool keep = pass.m_sideEffects;
+        for (auto const &use: pass.m_uses) {
+            keep = keep || (use.Write && m_needed[use.Resource.Index]);
+        }
+        if (!keep) {
+            m_stats.PassesCulled++;
+            continue;
+        }
+
+        m_kept[i] = true;
+        m_stats.Passes++;
+        for (auto const &use: pass.m_uses) {
+            if (use.Clear) {
+                m_needed[use.Resource.Index] = false;
+            }
+        }
+        for (auto const &use: pass.m_uses) {
+            if (!use.Clear) {
+                m_needed[use.Resource.Index] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+    for (auto &resource: m_resources) {
+        resource.FirstPass = RenderResource::Invalid;
+        resource.LastPass = RenderResource::Invalid;
+    }
+
+    for (u32 i = 0; i < m_passes.size(); i++) {
+        if (!m_kept[i]) {
+            continue;
+        }
+        for (auto const &use: m_passes[i].m_uses) {
+            auto &resource = m_resources[use.Resource.Index];
+            if (resource.FirstPass == RenderResource::Invalid) {
+                resource.FirstPass = i;
+            }
+            resource.LastPass = i;
+            resource.Usage |= Describe(use.Usage).ImageUsage;
+        }
+    }
+}
+
+void RenderGraph::AllocateTransients()
+{
+    m_transients.clear();
+    m_placements.clear();
+    // Runs every frame, the working arrays come from scratch memory.
+    ScratchScope scratch;
+    auto alignments = scratch.Allocate<VkDeviceSize>(static_cast<u32>(m_resources.size()));
+    for (u32 i = 0; i < m_resources.size(); i++) {
+        auto &resource = m_resources[i];
+        if (resource.Imported || resource.FirstPass == RenderResource::Invalid) {
+            continue;
+        }
+
+        // Attachments that live inside a single pass are never loaded or stored, lazily allocated
+        // memory lets tile based GPUs skip backing them entirely.
+        constexpr VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        bool onChip = resource.FirstPass == resource.LastPass && (resource.Usage & ~attachmentUsage) == 0;
+        if (onChip) {
+            resource.Usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+
+        auto info = TransientImageInfo(resource.Desc.Format, resource.Desc.Extent, resource.Usage);
+        VkDeviceImageMemoryRequirements query{
+                .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+                .pCreateInfo = &info,
+        };
+        VkMemoryRequirements2 requirements{
+                .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        };
+        vkGetDeviceImageMemoryRequirements(m_device.LogicalDevice(), &query, &requirements);
+
+        auto memoryType = onChip ? m_device.FindMemoryType(requirements.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) : std::nullopt;
+        if (!memoryType) {
+            memoryType = m_device.FindMemoryType(requirements.memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        if (!memoryType) {
+            ERRORF("No device local memory type for transient '{}'", resource.Name);
+            continue;
+        }
+
+        alignments[static_cast<u32>(m_transients.size())] = requirements.memoryRequirements.alignment;
+        m_transients.push_back(i);
+        m_placements.push_back(Placement{
+                .Format = resource.Desc.Format,
+                .Extent = resource.Desc.Extent,
+                .Usage = resource.Usage,
+                .MemoryType = *memoryType,
+                .Offset = 0,
+                .Size = requirements.memoryRequirements.size,
+        });
+        m_stats.TransientBytes += requirements.memoryRequirements.size;
+    }
+    m_stats.TransientTextures = static_cast<u32>(m_transients.size());
+
+    // Largest first, each one goes into the lowest gap left by the placed textures that are alive
+    // at the same time. Textures that never overlap in time may share memory.
+    auto transientCount = static_cast<u32>(m_transients.size());
+    auto order = scratch.Allocate<u32>(transientCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) { return m_placements[a].Size > m_placements[b].Size; });
+
+    auto placed = scratch.Allocate<u32>(transientCount);
+    auto conflicts = scratch.Allocate<u32>(transientCount);
+    u32 placedCount = 0;
+    for (auto index: order) {
+        auto &placement = m_placements[index];
+        auto const &resource = m_resources[m_transients[index]];
+        u32 conflictCount = 0;
+        for (auto other: placed.SubSlice(0, placedCount)) {
+            auto const &otherResource = m_resources[m_transients[other]];
+            if (m_placements[other].MemoryType == placement.MemoryType &&
+                LifetimesOverlap(resource.FirstPass, resource.LastPass, otherResource.FirstPass, otherResource.LastPass)) {
+                conflicts[conflictCount++] = other;
+            }
+        }
+        auto overlapping = conflicts.SubSlice(0, conflictCount);
+        std::sort(overlapping.begin(), overlapping.end(), [&](u32 a, u32 b) { return m_placements[a].Offset < m_placements[b].Offset; });
+
+        VkDeviceSize offset = 0;
+        for (auto other: overlapping) {
+            if (AlignUp(offset, alignments[index]) + placement.Size <= m_placements[other].Offset) {
+                break;
+            }
+            offset = std::max(offset, m_placements[other].Offset + m_placements[other].Size);
+        }
+        placement.Offset = AlignUp(offset, alignments[index]);
+        placed[placedCount++] = index;
+    }
+
+    // One allocation per memory type, sized to the furthest placement in it.
+    struct TypeAllocation {
+        u32 MemoryType;
+        VkDeviceSize Size;
+    };
+    auto typeAllocations = scratch.Allocate<TypeAllocation>(transientCount);
+    u32 allocationCount = 0;
+    for (auto const &placement: m_placements) {
+        auto end = typeAllocations.begin() + allocationCount;
+        auto it = std::find_if(typeAllocations.begin(), end, [&](TypeAllocation const &entry) { return entry.MemoryType == placement.MemoryType; });
+        if (it == end) {
+            typeAllocations[allocationCount++] = TypeAllocation{placement.MemoryType, placement.Offset + placement.Size};
+        } else {
+            it->Size = std::max(it->Size, placement.Offset + placement.Size);
+        }
+    }
+    auto allocations = typeAllocations.SubSlice(0, allocationCount);
+    for (auto const &allocation: allocations) {
+        m_stats.AliasedBytes += allocation.Size;
+    }
+
+    auto &set = m_transientSets[m_frameSlot];
+    if (set.Placements != m_placements) {
+        DestroyTransients(set);
+        set.Placements = m_placements;
+
+        for (auto const &allocation: allocations) {
+            VkMemoryAllocateInfo allocateInfo{
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                    .allocationSize = allocation.Size,
+                    .memoryTypeIndex = allocation.MemoryType,
+            };
+            VkDeviceMemory memory{};
+            auto result = m_device.Memory().Allocate(m_device.LogicalDevice(), allocateInfo, MemoryCategory::RenderTargets, &memory);
+            if (result != VK_SUCCESS) {
+                ERRORF("Failed to allocate transient memory: {}", string_VkResult(result));
+            }
+            set.Memory.push_back(memory);
+        }
+
+        for (u32 i = 0; i < m_placements.size(); i++) {
+            auto const &placement = m_placements[i];
+            auto const &resource = m_resources[m_transients[i]];
+            auto info = TransientImageInfo(placement.Format, placement.Extent, placement.Usage);
+            VkImage image{};
+            auto result = vkCreateImage(m_device.LogicalDevice(), &info, nullptr, &image);
+            if (result != VK_SUCCESS) {
+                ERRORF("Failed to create transient '{}': {}", resource.Name, string_VkResult(result));
+            }
+
+            auto allocation = std::find_if(allocations.begin(), allocations.end(), [&](TypeAllocation const &entry) { return entry.MemoryType == placement.MemoryType; });
+            vkBindImageMemory(m_device.LogicalDevice(), image, set.Memory[allocation - allocations.begin()], placement.Offset);
+
+            VkImageViewCreateInfo viewInfo{
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                    .image = image,
+                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                    .format = placement.Format,
+                    .subresourceRange = {resource.Aspect, 0, 1, 0, 1},
+            };
+            VkImageView view{};
+            result = vkCreateImageView(m_device.LogicalDevice(), &viewInfo, nullptr, &view);
+            if (result != VK_SUCCESS) {
+                ERRORF("Failed to create transient view '{}': {}", resource.Name, string_VkResult(result));
+            }
+            set.Images.push_back(image);
+            set.Views.push_back(view);
+        }
+        INFOF("Render graph: {} transient textures in {} bytes, {} without aliasing",
+              m_placements.size(), m_stats.AliasedBytes, m_stats.TransientBytes);
+    }
+
+    for (u32 i = 0; i < m_transients.size(); i++) {
+        m_resources[m_transients[i]].Image = set.Images[i];
+        m_resources[m_transients[i]].View = set.Views[i];
+    }
+}
+
+void RenderGraph::DestroyTransients(TransientSet &set)
+{
+    if (set.Images.empty() && set.Memory.empty()) {
+        return;
+    }
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), budget = &m_device.Memory(), images = std::move(set.Images),
+                              views = std::move(set.Views), memory = std::move(set.Memory)] {
+        for (auto view: views) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        for (auto image: images) {
+            vkDestroyImage(device, image, nullptr);
+        }
+        for (auto allocation: memory) {
+            budget->Free(device, allocation);
+        }
+    });
+    set.Images.clear();
+    set.Views.clear();
+    set.Memory.clear();
+    set.Placements.clear();
+}
+
+void RenderGraph::GatherAccesses(RenderGraphPass const &pass)
+{
+    m_accesses.clear();
+    for (auto const &use: pass.m_uses) {
+        auto info = Describe(use.Usage);
+        auto it = std::find_if(m_accesses.begin(), m_accesses.end(), [&](PassAccess const &access) { return access.Resource == use.Resource.Index; });
+        if (it == m_accesses.end()) {
+            m_accesses.push_back(PassAccess{
+                    .Resource = use.Resource.Index,
+                    .Usage = use.Usage,
+                    .Stages = info.Stages,
+                    .Access = info.Access,
+                    .Layout = info.Layout,
+                    .Write = use.Write,
+                    .Clear = use.Clear,
+                    .Undefined = false,
+                    .ClearValue = use.ClearValue,
+            });
+            continue;
+        }
+
+        if (m_resources[use.Resource.Index].IsImage && it->Layout != info.Layout) {
+            WARNF("Pass '{}' uses '{}' in two layouts, keeping the first", pass.m_name, m_resources[use.Resource.Index].Name);
+        }
+        it->Stages |= info.Stages;
+        it->Access |= info.Access;
+        it->Write = it->Write || use.Write;
+        if (use.Clear) {
+            it->Usage = use.Usage;
+            it->Clear = true;
+            it->ClearValue = use.ClearValue;
+        }
+    }
+}
+
+void RenderGraph::Transition(u32 index, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write)
+{
+    auto const &resource = m_resources[index];
+    auto &state = m_states[index];
+    bool layoutChange = resource.IsImage && layout != state.Layout;
+
+    VkPipelineStageFlags2 srcStages;
+    VkAccessFlags2 srcAccess;
+    if (write || layoutChange) {
+        // Writes wait for the last write and every read since, nothing to wait for on first use.
+        srcStages = state.WriteStages | state.ReadStages;
+        srcAccess = state.WriteAccess;
+        if (!layoutChange && srcStages == VK_PIPELINE_STAGE_2_NONE) {
+            state = {layout, stages, access & WriteAccessMask, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE};
+            return;
+        }
+    } else {
+        // Reads only wait for the last write, and only once per stage and access.
+        bool covered = (stages & ~state.ReadStages) == 0 && (access & ~state.ReadAccess) == 0;
+        if (state.WriteStages == VK_PIPELINE_STAGE_2_NONE || covered) {
+            state.ReadStages |= stages;
+            state.ReadAccess |= access;
+            return;
+        }
+        srcStages = state.WriteStages;
+        srcAccess = state.WriteAccess;
+    }
+
+    if (resource.IsImage) {
+        m_imageBarriers.push_back(VkImageMemoryBarrier2{
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .srcStageMask = srcStages,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = stages,
+                .dstAccessMask = access,
+                .oldLayout = state.Layout,
+                .newLayout = layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = resource.Image,
+                .subresourceRange = {resource.Aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS},
+        });
+    } else {
+        m_bufferBarriers.push_back(VkBufferMemoryBarrier2{
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                .srcStageMask = srcStages,
+                .srcAccessMask = srcAccess,
+                .dstStageMask = stages,
+                .dstAccessMask = access,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = resource.Buffer,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+        });
+    }
+
+    if (write) {
+        state = {layout, stages, access & WriteAccessMask, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE};
+    } else if (layoutChange) {
+        // The transition counts as a write that this read has already waited for.
+        state = {layout, stages, VK_ACCESS_2_NONE, stages, access};
+    } else {
+        state.ReadStages |= stages;
+        state.ReadAccess |= access;
+    }
+}
+
+void RenderGraph::FlushBarriers(VkCommandBuffer commandBuffer)
+{
+    if (m_imageBarriers.empty() && m_bufferBarriers.empty()) {
+        return;
+    }
+    VkDependencyInfo dependency{
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .bufferMemoryBarrierCount = static_cast<u32>(m_bufferBarriers.size()),
+            .pBufferMemoryBarriers = m_bufferBarriers.data(),
+            .imageMemoryBarrierCount = static_cast<u32>(m_imageBarriers.size()),
+            .pImageMemoryBarriers = m_imageBarriers.data(),
+    };
+    vkCmdPipelineBarrier2(commandBuffer, &dependency);
+    m_device.Stats().Add(RenderCounter::Barriers);
+    m_stats.Barriers += static_cast<u32>(m_imageBarriers.size() + m_bufferBarriers.size());
+    m_imageBarriers.clear();
+    m_bufferBarriers.clear();
+}
+
+bool RenderGraph::BeginRendering(VkCommandBuffer commandBuffer, u32 passIndex)
+{
+    std::array<VkRenderingAttachmentInfo, 8> colors{};
+    u32 colorCount = 0;
+    VkRenderingAttachmentInfo depth{};
+    bool hasDepth = false;
+    VkExtent2D extent{};
+
+    for (auto const &access: m_accesses) {
+        if (!Describe(access.Usage).Attachment) {
+            continue;
+        }
+        auto const &resource = m_resources[access.Resource];
+        bool readOnly = access.Usage == ResourceUsage::DepthRead;
+        // Transients nobody reads afterwards never leave tile memory.
+        bool keep = resource.Exported() || resource.LastPass > passIndex;
+        VkRenderingAttachmentInfo info{
+                .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                .imageView = resource.View,
+                .imageLayout = access.Layout,
+                .loadOp = access.Clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : access.Undefined ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD,
+                .storeOp = readOnly ? VK_ATTACHMENT_STORE_OP_NONE : keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .clearValue = access.ClearValue,
+        };
+        if (extent.width == 0) {
+            extent = resource.Desc.Extent;
+        }
+
+        if (access.Usage == ResourceUsage::ColorAttachment) {
+            if (colorCount == colors.size()) {
+                WARNF("Pass '{}' has more than {} color attachments", m_passes[passIndex].m_name, colors.size());
+                continue;
+            }
+            colors[colorCount++] = info;
+        } else {
+            depth = info;
+            hasDepth = true;
+        }
+    }
+
+    if (colorCount == 0 && !hasDepth) {
+        return false;
+    }
+
+    VkRenderingInfo renderingInfo{
+            .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+            .renderArea = {{0, 0}, extent},
+            .layerCount = 1,
+            .colorAttachmentCount = colorCount,
+            .pColorAttachments = colors.data(),
+            .pDepthAttachment = hasDepth ? &depth : nullptr,
+    };
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    return true;
+}
+
+void RenderGraph::Record(VkCommandBuffer commandBuffer)
+{
+    m_states.resize(m_resources.size());
+    for (u32 i = 0; i < m_resources.size(); i++) {
+        auto const &initial = m_resources[i].Initial;
+        m_states[i] = State{initial.Layout, initial.Stages, initial.Access, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE};
+    }
+
+    for (u32 passIndex = 0; passIndex < m_passes.size(); passIndex++) {
+        if (!m_kept[passIndex]) {
+            continue;
+        }
+        auto const &pass = m_passes[passIndex];
+
+        // A transient starts out in memory that an earlier, finished transient may have used, its
+        // first use waits for everything that happened to the overlapping bytes.
+        for (u32 i = 0; i < m_transients.size(); i++) {
+            auto const &resource = m_resources[m_transients[i]];
+            if (resource.FirstPass != passIndex) {
+                continue;
+            }
+            auto const &placement = m_placements[i];
+            auto &state = m_states[m_transients[i]];
+            for (u32 j = 0; j < m_transients.size(); j++) {
+                auto const &other = m_placements[j];
+                auto const &otherResource = m_resources[m_transients[j]];
+                bool sharesMemory = other.MemoryType == placement.MemoryType &&
+                                    other.Offset < placement.Offset + placement.Size &&
+                                    placement.Offset < other.Offset + other.Size;
+                if (j != i && sharesMemory && otherResource.LastPass < passIndex) {
+                    auto const &previous = m_states[m_transients[j]];
+                    state.WriteStages |= previous.WriteStages | previous.ReadStages;
+                    state.WriteAccess |= previous.WriteAccess;
+                }
+            }
+        }
+
+        GatherAccesses(pass);
+        for (auto &access: m_accesses) {
+            access.Undefined = m_resources[access.Resource].IsImage && m_states[access.Resource].Layout == VK_IMAGE_LAYOUT_UNDEFINED;
+            Transition(access.Resource, access.Stages, access.Access, access.Layout, access.Write);
+        }
+        FlushBarriers(commandBuffer);
+
+        bool rendering = BeginRendering(commandBuffer, passIndex);
+        if (pass.m_execute) {
+            pass.m_execute(commandBuffer);
+        }
+        if (rendering) {
+            vkCmdEndRendering(commandBuffer);
+        }
+    }
+
+    // Imported resources leave in the state the outside expects, presentation for the swapchain.
+    for (u32 i = 0; i < m_resources.size(); i++) {
+        auto const &resource = m_resources[i];
+        auto const &final = resource.Final;
+        if (!resource.Imported || resource.FirstPass == RenderResource::Invalid) {
+            continue;
+        }
+        bool layoutChange = resource.IsImage && final.Layout != VK_IMAGE_LAYOUT_UNDEFINED && final.Layout != m_states[i].Layout;
+        if (layoutChange || final.Stages != VK_PIPELINE_STAGE_2_NONE) {
+            Transition(i, final.Stages, final.Access, layoutChange ? final.Layout : m_states[i].Layout, true);
+        }
+    }
+    FlushBarriers(commandBuffer);
+}
\ No newline at end of file
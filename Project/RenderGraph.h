@@ -0,0 +1,206 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "Swapchain.h"
+#include "Types.h"
+#include <array>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// How a pass touches a resource. Each usage maps to fixed stages, access and image layout,
+// barriers are derived from consecutive usages of the same resource.
+enum class ResourceUsage : u8 {
+    ColorAttachment,
+    DepthAttachment,
+    DepthRead,
+    SampledFragment,
+    SampledCompute,
+    StorageRead,
+    StorageWrite,
+    TransferSource,
+    TransferDestination,
+    IndirectRead,
+    VertexRead,
+    UniformRead,
+};
+
+struct RenderResource {
+    static constexpr u32 Invalid = ~0u;
+    u32 Index{Invalid};
+
+    MUST_USE bool IsValid() const { return Index != Invalid; }
+};
+
+struct TextureDesc {
+    VkFormat Format;
+    VkExtent2D Extent;
+    // Usage flags are derived from how passes use the texture, these are added on top.
+    VkImageUsageFlags ExtraUsage{0};
+};
+
+// State of an imported resource where the graph picks it up and where it has to leave it. An
+// image whose final layout is undefined is scratch, the graph drops its contents at the end.
+struct ResourceState {
+    VkImageLayout Layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags2 Stages{VK_PIPELINE_STAGE_2_NONE};
+    VkAccessFlags2 Access{VK_ACCESS_2_NONE};
+};
+
+struct RenderGraphStats {
+    u32 Passes{};
+    u32 PassesCulled{};
+    u32 Barriers{};
+    u32 TransientTextures{};
+    // Transient memory as separate allocations versus what aliasing actually allocated.
+    VkDeviceSize TransientBytes{};
+    VkDeviceSize AliasedBytes{};
+};
+
+class RenderGraph;
+
+class RenderGraphPass {
+    friend class RenderGraph;
+
+    struct Use {
+        RenderResource Resource;
+        ResourceUsage Usage;
+        bool Write;
+        bool Clear;
+        VkClearValue ClearValue;
+    };
+
+    char const *m_name;
+    std::vector<Use> m_uses{};
+    std::function<void(VkCommandBuffer)> m_execute{};
+    bool m_sideEffects{false};
+
+public:
+    explicit RenderGraphPass(char const *name) : m_name(name) {}
+
+    RenderGraphPass &Read(RenderResource resource, ResourceUsage usage);
+    // Writes keep what was there before, attachments are loaded.
+    RenderGraphPass &Write(RenderResource resource, ResourceUsage usage);
+    // Attachment write that overwrites the whole image, earlier writers can be culled.
+    RenderGraphPass &Clear(RenderResource resource, ResourceUsage usage, VkClearValue value);
+    // Never culled, even if nothing reads what it writes.
+    RenderGraphPass &SideEffects();
+    RenderGraphPass &Execute(std::function<void(VkCommandBuffer)> execute);
+};
+
+// Frame graph rebuilt every frame. Passes declare what they read and write and run in the order
+// they were added. Executing the graph drops passes that contribute nothing to an imported
+// resource, places transient textures whose lifetimes do not overlap in the same memory, and
+// records each pass behind the synchronization2 barriers and layout transitions it needs.
+// Passes with attachments are wrapped in dynamic rendering.
+class RenderGraph {
+    struct Resource {
+        char const *Name;
+        bool Imported;
+        bool IsImage;
+        TextureDesc Desc;
+        VkImageUsageFlags Usage;
+        VkImageAspectFlags Aspect;
+        VkImage Image;
+        VkImageView View;
+        VkBuffer Buffer;
+        ResourceState Initial;
+        ResourceState Final;
+        u32 FirstPass;
+        u32 LastPass;
+
+        MUST_USE bool Exported() const { return Imported && (!IsImage || Final.Layout != VK_IMAGE_LAYOUT_UNDEFINED); }
+    };
+
+    // All uses of one resource within a pass folded together.
+    struct PassAccess {
+        u32 Resource;
+        ResourceUsage Usage;
+        VkPipelineStageFlags2 Stages;
+        VkAccessFlags2 Access;
+        VkImageLayout Layout;
+        bool Write;
+        bool Clear;
+        // Nothing worth loading, the resource was undefined before this pass.
+        bool Undefined;
+        VkClearValue ClearValue;
+    };
+
+    // Tracked while recording, reads since the last write are remembered so the next write
+    // waits for all of them.
+    struct State {
+        VkImageLayout Layout;
+        VkPipelineStageFlags2 WriteStages;
+        VkAccessFlags2 WriteAccess;
+        VkPipelineStageFlags2 ReadStages;
+        VkAccessFlags2 ReadAccess;
+    };
+
+    struct Placement {
+        VkFormat Format;
+        VkExtent2D Extent;
+        VkImageUsageFlags Usage;
+        u32 MemoryType;
+        VkDeviceSize Offset;
+        VkDeviceSize Size;
+
+        MUST_USE bool operator==(Placement const &other) const;
+    };
+
+    // Transients of one frame in flight, rebuilt only when the placement changes.
+    struct TransientSet {
+        std::vector<Placement> Placements;
+        std::vector<VkImage> Images;
+        std::vector<VkImageView> Views;
+        std::vector<VkDeviceMemory> Memory;
+    };
+
+    Device &m_device;
+    std::vector<Resource> m_resources{};
+    std::vector<RenderGraphPass> m_passes{};
+    std::vector<bool> m_kept{};
+    std::vector<State> m_states{};
+    std::vector<Placement> m_placements{};
+    std::vector<u32> m_transients{};
+    std::vector<bool> m_needed{};
+    std::vector<PassAccess> m_accesses{};
+    std::vector<VkImageMemoryBarrier2> m_imageBarriers{};
+    std::vector<VkBufferMemoryBarrier2> m_bufferBarriers{};
+    std::array<TransientSet, Swapchain::MaxFramesInFlight> m_transientSets{};
+    u32 m_frameSlot{0};
+    RenderGraphStats m_stats{};
+
+public:
+    explicit RenderGraph(Device &device);
+    ~RenderGraph();
+    RenderGraph(RenderGraph const &other) = delete;
+    RenderGraph &operator=(RenderGraph const &other) = delete;
+
+    // Starts a new graph, `frameSlot` picks the transient set that is no longer in use on the GPU.
+    void Begin(u32 frameSlot);
+
+    MUST_USE RenderResource ImportImage(char const *name, VkImage image, VkImageView view, TextureDesc const &desc,
+                                        ResourceState initial, ResourceState final);
+    MUST_USE RenderResource ImportBuffer(char const *name, VkBuffer buffer, ResourceState initial, ResourceState final);
+    MUST_USE RenderResource CreateTexture(char const *name, TextureDesc const &desc);
+
+    RenderGraphPass &AddPass(char const *name);
+
+    void Execute(VkCommandBuffer commandBuffer);
+
+    MUST_USE RenderGraphStats const &Stats() const { return m_stats; }
+    // Valid during a pass callback, transients only exist once the graph executes.
+    MUST_USE VkImageView View(RenderResource resource) const { return m_resources[resource.Index].View; }
+    MUST_USE VkImage ImageHandle(RenderResource resource) const { return m_resources[resource.Index].Image; }
+
+private:
+    void Cull();
+    void ComputeLifetimes();
+    void AllocateTransients();
+    void Record(VkCommandBuffer commandBuffer);
+    void GatherAccesses(RenderGraphPass const &pass);
+    void Transition(u32 resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout, bool write);
+    void FlushBarriers(VkCommandBuffer commandBuffer);
+    bool BeginRendering(VkCommandBuffer commandBuffer, u32 passIndex);
+    void DestroyTransients(TransientSet &set);
+};
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "RenderQueue.h"
+
+void RenderQueue::Clear()
+{
+    m_packets.clear();
+    m_keys.clear();
+    m_order.clear();
+    m_stats = {};
+}
+
+void RenderQueue::Submit(DrawPacket const &packet)
+{
+    m_keys.push_back(packet.SortKey);
+    m_order.push_back(static_cast<u32>(m_packets.size()));
+    m_packets.push_back(packet);
+}
+
+void RenderQueue::Sort()
+{
+    auto count = m_keys.size();
+    m_keysScratch.resize(count);
+    m_orderScratch.resize(count);
+    m_stats.SortPasses = 0;
+
+    // LSD radix sort on bytes, stable, so depth order survives the higher passes.
+    for (u32 shift = 0; shift < 64; shift += 8) {
+        u32 histogram[256]{};
+        for (auto key: m_keys) {
+            histogram[(key >> shift) & 0xff]++;
+        }
+
+        // All keys share this byte, the pass would not move anything.
+        if (count == 0 || histogram[(m_keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for (auto &bucket: histogram) {
+            auto size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            auto destination = histogram[(m_keys[i] >> shift) & 0xff]++;
+            m_keysScratch[destination] = m_keys[i];
+            m_orderScratch[destination] = m_order[i];
+        }
+        m_keys.swap(m_keysScratch);
+        m_order.swap(m_orderScratch);
+        m_stats.SortPasses++;
+    }
+}
+
+void RenderQueue::Flush(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags pushConstantStages, RenderStats &stats)
+{
+    VkPipeline boundPipeline{};
+    VkBuffer boundVertexBuffer{};
+    VkDeviceSize boundVertexOffset{};
+    VkBuffer boundIndexBuffer{};
+    VkDeviceSize boundIndexOffset{};
+    u32 boundMaterial = ~0u;
+    u64 instances = 0;
+    u64 vertices = 0;
+
+    m_stats.Packets = static_cast<u32>(m_packets.size());
+    for (auto index: m_order) {
+        auto const &packet = m_packets[index];
+
+        if (packet.Pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.Pipeline);
+            boundPipeline = packet.Pipeline;
+            m_stats.PipelineBinds++;
+        } else {
+            m_stats.PipelineBindsSaved++;
+        }
+
+        if (packet.VertexBuffer != boundVertexBuffer || packet.VertexBufferOffset != boundVertexOffset) {
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &packet.VertexBuffer, &packet.VertexBufferOffset);
+            boundVertexBuffer = packet.VertexBuffer;
+            boundVertexOffset = packet.VertexBufferOffset;
+            m_stats.VertexBufferBinds++;
+        } else {
+            m_stats.VertexBufferBindsSaved++;
+        }
+
+        if (packet.IndexBuffer != VK_NULL_HANDLE) {
+            if (packet.IndexBuffer != boundIndexBuffer || packet.IndexBufferOffset != boundIndexOffset) {
+                vkCmdBindIndexBuffer(commandBuffer, packet.IndexBuffer, packet.IndexBufferOffset, VK_INDEX_TYPE_UINT32);
+                boundIndexBuffer = packet.IndexBuffer;
+                boundIndexOffset = packet.IndexBufferOffset;
+                m_stats.IndexBufferBinds++;
+            } else {
+                m_stats.IndexBufferBindsSaved++;
+            }
+        }
+
+        if (packet.MaterialIndex != boundMaterial) {
+            boundMaterial = packet.MaterialIndex;
+            m_stats.MaterialChanges++;
+        } else {
+            m_stats.MaterialChangesSaved++;
+        }
+
+        // The object index changes every draw anyway, so the push is not tracked as state.
+        u32 constants[] = {packet.ObjectIndex, packet.MaterialIndex};
+        vkCmdPushConstants(commandBuffer, layout, pushConstantStages, 0, sizeof(constants), constants);
+
+        if (packet.IndexBuffer != VK_NULL_HANDLE) {
+            vkCmdDrawIndexed(commandBuffer, packet.Count, packet.InstanceCount, packet.FirstIndex, packet.VertexOffset, packet.FirstInstance);
+        } else {
+            vkCmdDraw(commandBuffer, packet.Count, packet.InstanceCount, packet.FirstVertex, packet.FirstInstance);
+        }
+        instances += packet.InstanceCount;
+        vertices += static_cast<u64>(packet.Count) * packet.InstanceCount;
+    }
+
+    stats.Add(RenderCounter::DrawCalls, m_packets.size());
+    stats.Add(RenderCounter::Instances, instances);
+    stats.Add(RenderCounter::Vertices, vertices);
+    stats.Add(RenderCounter::Triangles, vertices / 3);
+    stats.Add(RenderCounter::PipelineBinds, m_stats.PipelineBinds);
+    stats.Add(RenderCounter::VertexBufferBinds, m_stats.VertexBufferBinds);
+    stats.Add(RenderCounter::IndexBufferBinds, m_stats.IndexBufferBinds);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "Definitions.h"
+#include "RenderStats.h"
+#include "Types.h"
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// 64-bit draw sort key, most significant field first:
+//   pass (4) | pipeline (12) | material (12) | vertex buffer (12) | depth (24)
+// Sorting by it groups draws sharing state next to each other, depth breaks ties front to back.
+struct SortKey {
+    static constexpr u32 PassBits = 4;
+    static constexpr u32 PipelineBits = 12;
+    static constexpr u32 MaterialBits = 12;
+    static constexpr u32 VertexBufferBits = 12;
+    static constexpr u32 DepthBits = 24;
+
+    static constexpr u32 DepthShift = 0;
+    static constexpr u32 VertexBufferShift = DepthShift + DepthBits;
+    static constexpr u32 MaterialShift = VertexBufferShift + VertexBufferBits;
+    static constexpr u32 PipelineShift = MaterialShift + MaterialBits;
+    static constexpr u32 PassShift = PipelineShift + PipelineBits;
+
+    // `depth` is expected in [0, 1].
+    MUST_USE static constexpr u64 Make(u32 pass, u32 pipeline, u32 material, u32 vertexBuffer, f32 depth)
+    {
+        auto clamped = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+        auto quantizedDepth = static_cast<u64>(clamped * static_cast<f32>((1u << DepthBits) - 1));
+        return (static_cast<u64>(pass & Mask(PassBits)) << PassShift) |
+               (static_cast<u64>(pipeline & Mask(PipelineBits)) << PipelineShift) |
+               (static_cast<u64>(material & Mask(MaterialBits)) << MaterialShift) |
+               (static_cast<u64>(vertexBuffer & Mask(VertexBufferBits)) << VertexBufferShift) |
+               (quantizedDepth << DepthShift);
+    }
+
+    MUST_USE static constexpr u32 Mask(u32 bits) { return (1u << bits) - 1; }
+};
+
+struct DrawPacket {
+    u64 SortKey{};
+    VkPipeline Pipeline{};
+    VkBuffer VertexBuffer{};
+    VkDeviceSize VertexBufferOffset{};
+    // Leave null for non-indexed draws.
+    VkBuffer IndexBuffer{};
+    VkDeviceSize IndexBufferOffset{};
+    u32 Count{};
+    u32 InstanceCount{1};
+    u32 FirstVertex{};
+    u32 FirstIndex{};
+    i32 VertexOffset{};
+    u32 FirstInstance{};
+    u32 ObjectIndex{};
+    u32 MaterialIndex{};
+};
+
+struct RenderQueueStats {
+    u32 Packets{};
+    u32 SortPasses{};
+    u32 PipelineBinds{};
+    u32 VertexBufferBinds{};
+    u32 IndexBufferBinds{};
+    u32 MaterialChanges{};
+    u32 PipelineBindsSaved{};
+    u32 VertexBufferBindsSaved{};
+    u32 IndexBufferBindsSaved{};
+    u32 MaterialChangesSaved{};
+
+    MUST_USE u32 StateChanges() const { return PipelineBinds + VertexBufferBinds + IndexBufferBinds + MaterialChanges; }
+    MUST_USE u32 StateChangesSaved() const
+    {
+        return PipelineBindsSaved + VertexBufferBindsSaved + IndexBufferBindsSaved + MaterialChangesSaved;
+    }
+};
+
+// Collects draw packets for a frame, radix sorts them by key and records them while skipping
+// every bind that would not change state.
+class RenderQueue {
+    std::vector<DrawPacket> m_packets;
+    std::vector<u64> m_keys, m_keysScratch;
+    std::vector<u32> m_order, m_orderScratch;
+    RenderQueueStats m_stats{};
+
+public:
+    void Clear();
+    void Submit(DrawPacket const &packet);
+    void Sort();
+
+    // Pushes {ObjectIndex, MaterialIndex} as push constants at offset 0 of `layout`. Everything
+    // recorded is counted into `stats` once at the end, packets are triangle lists.
+    void Flush(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags pushConstantStages, RenderStats &stats);
+
+    MUST_USE RenderQueueStats const &Stats() const { return m_stats; }
+    MUST_USE u32 Size() const { return static_cast<u32>(m_packets.size()); }
+};
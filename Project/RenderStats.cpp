@@ -0,0 +1,263 @@
+#include "RenderStats.h"
+#include "Device.h"
+#include "Logger.h"
+#include <algorithm>
+#include <bit>
+#include <vulkan/vk_enum_string_helper.h>
+
+// Indexed by PipelineStatistic, ascending like the query writes its results.
+static constexpr VkQueryPipelineStatisticFlagBits StatisticFlags[PipelineStatisticCount] = {
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT,
+        VK_QUERY_PIPELINE_STATISTIC_TASK_SHADER_INVOCATIONS_BIT_EXT,
+        VK_QUERY_PIPELINE_STATISTIC_MESH_SHADER_INVOCATIONS_BIT_EXT,
+};
+
+static constexpr VkQueryPipelineStatisticFlags VertexStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT;
+
+static constexpr VkQueryPipelineStatisticFlags CommonStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+static constexpr VkQueryPipelineStatisticFlags MeshStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_TASK_SHADER_INVOCATIONS_BIT_EXT |
+        VK_QUERY_PIPELINE_STATISTIC_MESH_SHADER_INVOCATIONS_BIT_EXT;
+
+char const *RenderCounterName(RenderCounter counter)
+{
+    switch (counter) {
+        case RenderCounter::DrawCalls:
+            return "draw calls";
+        case RenderCounter::IndirectDraws:
+            return "indirect draws";
+        case RenderCounter::Instances:
+            return "instances";
+        case RenderCounter::Vertices:
+            return "vertices";
+        case RenderCounter::Triangles:
+            return "triangles";
+        case RenderCounter::Dispatches:
+            return "dispatches";
+        case RenderCounter::PipelineBinds:
+            return "pipeline binds";
+        case RenderCounter::VertexBufferBinds:
+            return "vertex buffer binds";
+        case RenderCounter::IndexBufferBinds:
+            return "index buffer binds";
+        case RenderCounter::Barriers:
+            return "barriers";
+        case RenderCounter::QueueSubmits:
+            return "queue submits";
+        case RenderCounter::DescriptorWrites:
+            return "descriptor writes";
+        case RenderCounter::UploadedBytes:
+            return "uploaded bytes";
+        case RenderCounter::MappedBytes:
+            return "mapped bytes";
+    }
+    return "unknown";
+}
+
+char const *PipelineStatisticName(PipelineStatistic statistic)
+{
+    switch (statistic) {
+        case PipelineStatistic::InputAssemblyVertices:
+            return "input assembly vertices";
+        case PipelineStatistic::InputAssemblyPrimitives:
+            return "input assembly primitives";
+        case PipelineStatistic::VertexShaderInvocations:
+            return "vertex shader invocations";
+        case PipelineStatistic::ClippingInvocations:
+            return "clipping invocations";
+        case PipelineStatistic::ClippingPrimitives:
+            return "clipping primitives";
+        case PipelineStatistic::FragmentShaderInvocations:
+            return "fragment shader invocations";
+        case PipelineStatistic::ComputeShaderInvocations:
+            return "compute shader invocations";
+        case PipelineStatistic::TaskShaderInvocations:
+            return "task shader invocations";
+        case PipelineStatistic::MeshShaderInvocations:
+            return "mesh shader invocations";
+    }
+    return "unknown";
+}
+
+void RenderStats::Draw(u64 vertices, u64 instances, bool triangles)
+{
+    Add(RenderCounter::DrawCalls);
+    Add(RenderCounter::Instances, instances);
+    Add(RenderCounter::Vertices, vertices * instances);
+    if (triangles) {
+        Add(RenderCounter::Triangles, vertices / 3 * instances);
+    }
+}
+
+void RenderStats::DrawIndirect(u64 draws)
+{
+    Add(RenderCounter::DrawCalls, draws);
+    Add(RenderCounter::IndirectDraws, draws);
+}
+
+void RenderStats::EndFrame()
+{
+    // The oldest frame drops out of the sums as the new one goes in, no pass over the window.
+    auto &slot = m_history[m_head];
+    for (u32 i = 0; i < RenderCounterCount; i++) {
+        m_last[i] = m_current[i].exchange(0, std::memory_order_relaxed);
+        m_sums[i] += m_last[i] - slot[i];
+        slot[i] = m_last[i];
+    }
+    m_head = (m_head + 1) % Window;
+    m_frames = std::min(m_frames + 1, Window);
+}
+
+void RenderStats::AddPipelineStatistics(PipelineCounters const &values, u32 gathered)
+{
+    m_pipelineGathered = gathered;
+    auto &slot = m_pipelineHistory[m_pipelineHead];
+    for (u32 i = 0; i < PipelineStatisticCount; i++) {
+        m_pipelineSums[i] += values[i] - slot[i];
+        slot[i] = values[i];
+    }
+    m_pipelineHead = (m_pipelineHead + 1) % Window;
+    m_pipelineFrames = std::min(m_pipelineFrames + 1, Window);
+}
+
+RenderStats::Averages RenderStats::Average() const
+{
+    Averages averages{.Frames = m_frames, .PipelineFrames = m_pipelineFrames, .PipelineGathered = m_pipelineGathered};
+    for (u32 i = 0; m_frames > 0 && i < RenderCounterCount; i++) {
+        averages.Counters[i] = static_cast<f64>(m_sums[i]) / m_frames;
+    }
+    for (u32 i = 0; m_pipelineFrames > 0 && i < PipelineStatisticCount; i++) {
+        averages.Pipeline[i] = static_cast<f64>(m_pipelineSums[i]) / m_pipelineFrames;
+    }
+    return averages;
+}
+
+void RenderStats::LogAverages() const
+{
+    auto averages = Average();
+    auto counter = [&](RenderCounter counter) { return averages.Counters[static_cast<u32>(counter)]; };
+    auto statistic = [&](PipelineStatistic statistic) { return averages.Pipeline[static_cast<u32>(statistic)]; };
+
+    INFOF("Render stats over {} frames, per frame:", averages.Frames);
+    INFOF("\t{:.1f} draws ({:.1f} indirect), {:.1f} instances, {:.0f} vertices, {:.0f} triangles, {:.1f} dispatches",
+          counter(RenderCounter::DrawCalls), counter(RenderCounter::IndirectDraws), counter(RenderCounter::Instances),
+          counter(RenderCounter::Vertices), counter(RenderCounter::Triangles), counter(RenderCounter::Dispatches));
+    INFOF("\tBinds: {:.1f} pipeline, {:.1f} vertex buffer, {:.1f} index buffer; {:.1f} barriers, {:.1f} submits, {:.1f} descriptor writes",
+          counter(RenderCounter::PipelineBinds), counter(RenderCounter::VertexBufferBinds), counter(RenderCounter::IndexBufferBinds),
+          counter(RenderCounter::Barriers), counter(RenderCounter::QueueSubmits), counter(RenderCounter::DescriptorWrites));
+    INFOF("\t{:.1f} KiB uploaded, {:.1f} KiB written to mapped memory",
+          counter(RenderCounter::UploadedBytes) / 1024.0, counter(RenderCounter::MappedBytes) / 1024.0);
+    if (averages.PipelineFrames > 0) {
+        if (averages.Gathered(PipelineStatistic::InputAssemblyVertices)) {
+            INFOF("\tGPU: {:.0f} vertices and {:.0f} primitives assembled, {:.0f} vertex invocations",
+                  statistic(PipelineStatistic::InputAssemblyVertices), statistic(PipelineStatistic::InputAssemblyPrimitives),
+                  statistic(PipelineStatistic::VertexShaderInvocations));
+        }
+        if (averages.Gathered(PipelineStatistic::TaskShaderInvocations)) {
+            INFOF("\tGPU: {:.0f} task invocations, {:.0f} mesh invocations",
+                  statistic(PipelineStatistic::TaskShaderInvocations), statistic(PipelineStatistic::MeshShaderInvocations));
+        }
+        INFOF("\tGPU: {:.0f} of {:.0f} primitives past clipping, {:.0f} fragment invocations, {:.0f} compute invocations",
+              statistic(PipelineStatistic::ClippingPrimitives), statistic(PipelineStatistic::ClippingInvocations),
+              statistic(PipelineStatistic::FragmentShaderInvocations), statistic(PipelineStatistic::ComputeShaderInvocations));
+    }
+}
+
+PipelineStatisticsQueries::PipelineStatisticsQueries(Device &device, u32 frames)
+    : m_device(device), m_recorded(frames, false)
+{
+    if (!m_device.SupportsPipelineStatistics()) {
+        return;
+    }
+    m_statistics = CommonStatistics;
+    if (!m_device.SupportsMeshShaders()) {
+        m_statistics |= VertexStatistics;
+    } else if (m_device.SupportsMeshShaderQueries()) {
+        m_statistics |= MeshStatistics;
+    }
+    for (u32 i = 0; i < PipelineStatisticCount; i++) {
+        if (m_statistics & StatisticFlags[i]) {
+            m_gathered |= 1u << i;
+        }
+    }
+
+    VkQueryPoolCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = frames,
+            .pipelineStatistics = m_statistics,
+    };
+    auto result = vkCreateQueryPool(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &m_pool);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create pipeline statistics queries: {}", string_VkResult(result));
+        m_pool = VK_NULL_HANDLE;
+    }
+}
+
+PipelineStatisticsQueries::~PipelineStatisticsQueries()
+{
+    if (m_pool == VK_NULL_HANDLE) {
+        return;
+    }
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), pool = m_pool] {
+        vkDestroyQueryPool(device, pool, callbacks);
+    });
+}
+
+void PipelineStatisticsQueries::Begin(VkCommandBuffer commandBuffer, u32 frameIndex)
+{
+    if (m_pool == VK_NULL_HANDLE) {
+        return;
+    }
+    vkCmdResetQueryPool(commandBuffer, m_pool, frameIndex, 1);
+    vkCmdBeginQuery(commandBuffer, m_pool, frameIndex, 0);
+}
+
+void PipelineStatisticsQueries::End(VkCommandBuffer commandBuffer, u32 frameIndex)
+{
+    if (m_pool == VK_NULL_HANDLE) {
+        return;
+    }
+    vkCmdEndQuery(commandBuffer, m_pool, frameIndex);
+    m_recorded[frameIndex] = true;
+}
+
+void PipelineStatisticsQueries::Collect(u32 frameIndex)
+{
+    if (m_pool == VK_NULL_HANDLE || !m_recorded[frameIndex]) {
+        return;
+    }
+    m_recorded[frameIndex] = false;
+
+    // The fence was waited on, so the results are there. A frame that was never submitted
+    // comes back as not ready and is skipped.
+    // Only the gathered statistics are written, packed in the order of their bits.
+    RenderStats::PipelineCounters packed{};
+    auto size = std::popcount(m_gathered) * sizeof(u64);
+    auto result = vkGetQueryPoolResults(m_device.LogicalDevice(), m_pool, frameIndex, 1, size, packed.data(), size, VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    RenderStats::PipelineCounters values{};
+    u32 next = 0;
+    for (u32 i = 0; i < PipelineStatisticCount; i++) {
+        if ((m_gathered >> i) & 1) {
+            values[i] = packed[next++];
+        }
+    }
+    m_device.Stats().AddPipelineStatistics(values, m_gathered);
+}
\ No newline at end of file
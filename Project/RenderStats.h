@@ -0,0 +1,139 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+// What the engine hands to the driver in a frame. Draw counts are the commands recorded, the
+// vertex and triangle counts only cover draws whose sizes the CPU knows. Indirect draws get
+// their real numbers from the pipeline statistics.
+enum class RenderCounter : u32 {
+    DrawCalls,
+    // Subset of DrawCalls, sourced from a GPU buffer: indirect, indirect count and mesh tasks.
+    IndirectDraws,
+    Instances,
+    Vertices,
+    Triangles,
+    Dispatches,
+    PipelineBinds,
+    VertexBufferBinds,
+    IndexBufferBinds,
+    // Pipeline barrier commands, not the individual barriers in them.
+    Barriers,
+    QueueSubmits,
+    DescriptorWrites,
+    // Copied by transfer commands into device local memory.
+    UploadedBytes,
+    // Written by the CPU into persistently mapped streaming memory.
+    MappedBytes,
+};
+inline constexpr u32 RenderCounterCount = 14;
+
+// The VK_QUERY_TYPE_PIPELINE_STATISTICS values that can be gathered, in the order of their flag bits.
+enum class PipelineStatistic : u32 {
+    InputAssemblyVertices,
+    InputAssemblyPrimitives,
+    VertexShaderInvocations,
+    ClippingInvocations,
+    ClippingPrimitives,
+    FragmentShaderInvocations,
+    ComputeShaderInvocations,
+    TaskShaderInvocations,
+    MeshShaderInvocations,
+};
+inline constexpr u32 PipelineStatisticCount = 9;
+
+MUST_USE char const *RenderCounterName(RenderCounter counter);
+MUST_USE char const *PipelineStatisticName(PipelineStatistic statistic);
+
+// Per frame counters of everything submitted, with averages over the last Window frames.
+// Add() is thread safe, EndFrame() and the averages belong to the render thread. Loops that
+// record many commands count locally and add once, every Add() is an atomic.
+class RenderStats {
+public:
+    static constexpr u32 Window = 120;
+
+    using Counters = std::array<u64, RenderCounterCount>;
+    using PipelineCounters = std::array<u64, PipelineStatisticCount>;
+
+    struct Averages {
+        // How many frames went into the averages, up to Window.
+        u32 Frames{};
+        std::array<f64, RenderCounterCount> Counters{};
+        // Zero frames when pipeline statistics are not supported.
+        u32 PipelineFrames{};
+        std::array<f64, PipelineStatisticCount> Pipeline{};
+        // One bit per PipelineStatistic the queries actually gather, the rest stay zero.
+        u32 PipelineGathered{};
+
+        MUST_USE bool Gathered(PipelineStatistic statistic) const { return (PipelineGathered >> static_cast<u32>(statistic)) & 1; }
+    };
+
+private:
+    std::array<std::atomic<u64>, RenderCounterCount> m_current{};
+    Counters m_last{};
+    std::array<Counters, Window> m_history{};
+    Counters m_sums{};
+    u32 m_head{};
+    u32 m_frames{};
+
+    std::array<PipelineCounters, Window> m_pipelineHistory{};
+    PipelineCounters m_pipelineSums{};
+    u32 m_pipelineHead{};
+    u32 m_pipelineFrames{};
+    u32 m_pipelineGathered{};
+
+public:
+    RenderStats() = default;
+    RenderStats(RenderStats const &other) = delete;
+    RenderStats &operator=(RenderStats const &other) = delete;
+
+    void Add(RenderCounter counter, u64 amount = 1)
+    {
+        m_current[static_cast<u32>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+    // One direct draw, `triangles` for triangle list topologies.
+    void Draw(u64 vertices, u64 instances = 1, bool triangles = true);
+    void DrawIndirect(u64 draws = 1);
+
+    // Closes the frame, everything added from here on counts towards the next one.
+    void EndFrame();
+    // Results of one frame's query, whenever they arrive. `gathered` has one bit per
+    // PipelineStatistic the query counted.
+    void AddPipelineStatistics(PipelineCounters const &values, u32 gathered);
+
+    MUST_USE Counters const &LastFrame() const { return m_last; }
+    MUST_USE Averages Average() const;
+    // The averages, one line per group of counters.
+    void LogAverages() const;
+};
+
+// One pipeline statistics query around each frame's command buffer, read back once the slot's
+// fence has been waited on and handed to the device's RenderStats. Does nothing when the
+// device has no pipelineStatisticsQuery. Mesh shader draws are invalid inside a query counting
+// input assembly or vertex shader invocations, devices with mesh shaders gather the task and
+// mesh invocations instead.
+class PipelineStatisticsQueries {
+    Device &m_device;
+    VkQueryPool m_pool{};
+    VkQueryPipelineStatisticFlags m_statistics{};
+    u32 m_gathered{};
+    // Slots whose query was recorded and not collected yet.
+    std::vector<bool> m_recorded;
+
+public:
+    PipelineStatisticsQueries(Device &device, u32 frames);
+    ~PipelineStatisticsQueries();
+    PipelineStatisticsQueries(PipelineStatisticsQueries const &other) = delete;
+    PipelineStatisticsQueries &operator=(PipelineStatisticsQueries const &other) = delete;
+
+    // Outside of any render pass, at the start and the end of the frame's command buffer.
+    void Begin(VkCommandBuffer commandBuffer, u32 frameIndex);
+    void End(VkCommandBuffer commandBuffer, u32 frameIndex);
+    // After the slot's fence, before it records again.
+    void Collect(u32 frameIndex);
+};
\ No newline at end of file
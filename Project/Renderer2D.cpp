@@ -0,0 +1,130 @@
+#include "Renderer2D.h"
+#include "Logger.h"
+#include "Swapchain.h"
+#include <cstddef>
+#include <vulkan/vk_enum_string_helper.h>
+
+static constexpr VkVertexInputBindingDescription VertexBinding{
+        .binding = 0,
+        .stride = sizeof(Vertex2D),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+};
+
+static constexpr VkVertexInputAttributeDescription VertexAttributes[] = {
+        {.location = 0, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(Vertex2D, Position)},
+        {.location = 1, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(Vertex2D, UV)},
+        {.location = 2, .binding = 0, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(Vertex2D, Color)},
+        {.location = 3, .binding = 0, .format = VK_FORMAT_R32_UINT, .offset = offsetof(Vertex2D, Texture)},
+};
+
+static constexpr VkPrimitiveTopology Topologies[Primitive2DCount] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+};
+
+Renderer2D::Renderer2D(Device &device, BindlessHeap *bindless, PipelineConfigInfo const &config, u32 maxVertices)
+    : m_device(device), m_bindless(bindless), m_batch(maxVertices)
+{
+    m_vertices = std::make_unique<StreamingBuffer>(m_device, sizeof(Vertex2D) * static_cast<VkDeviceSize>(maxVertices), Swapchain::MaxFramesInFlight);
+    CreateLayout();
+
+    for (u32 i = 0; i < Primitive2DCount; i++) {
+        auto &primitiveConfig = m_configs[i];
+        primitiveConfig = config;
+        primitiveConfig.Layout = m_layout;
+        primitiveConfig.VertexShader = "Assets/Shaders/Builtin.Batch2D.vert.spv";
+        primitiveConfig.FragmentShader = m_bindless ? "Assets/Shaders/Builtin.Batch2DTextured.frag.spv" : "Assets/Shaders/Builtin.Batch2D.frag.spv";
+        primitiveConfig.VertexInput = true;
+        primitiveConfig.VertexBindings = {&VertexBinding, 1};
+        primitiveConfig.VertexAttributes = VertexAttributes;
+        primitiveConfig.InputAssemblyInfo.topology = Topologies[i];
+        // Winding is whatever the caller passed in.
+        primitiveConfig.RasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+        primitiveConfig.Specialization = {};
+        m_pipelines[i] = std::make_unique<Pipeline>(m_device, primitiveConfig);
+    }
+
+    INFOF("Created 2D renderer for {} vertices per frame{}", maxVertices, m_bindless ? "" : ", without textures");
+}
+
+Renderer2D::~Renderer2D()
+{
+    for (auto &pipeline: m_pipelines) {
+        pipeline.reset();
+    }
+    m_device.Deletion().Push([device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), layout = m_layout] {
+        vkDestroyPipelineLayout(device, layout, callbacks);
+    });
+}
+
+void Renderer2D::WatchShaders(ShaderHotReload &hotReload)
+{
+    for (u32 i = 0; i < Primitive2DCount; i++) {
+        hotReload.Watch<Pipeline>({m_configs[i].VertexShader, m_configs[i].FragmentShader}, m_pipelines[i], [this, i] {
+            return std::make_unique<Pipeline>(m_device, m_configs[i]);
+        });
+    }
+}
+
+void Renderer2D::CreateLayout()
+{
+    auto heapLayout = m_bindless ? m_bindless->Layout() : VK_NULL_HANDLE;
+    VkPushConstantRange pushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(glm::mat4),
+    };
+
+    VkPipelineLayoutCreateInfo info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = m_bindless ? 1u : 0u,
+            .pSetLayouts = &heapLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+    };
+
+    auto result = vkCreatePipelineLayout(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &m_layout);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create 2D pipeline layout: {}", string_VkResult(result));
+    }
+}
+
+void Renderer2D::BeginFrame(u32 frameIndex)
+{
+    m_vertices->BeginFrame(frameIndex);
+    m_batch.Clear();
+}
+
+void Renderer2D::Draw(VkCommandBuffer commandBuffer, glm::mat4 const &projection)
+{
+    if (m_batch.GetStats().Dropped > 0 && !m_reportedOverflow) {
+        WARNF("2D batch is full at {} vertices, dropped {} primitives", m_batch.MaxVertices(), m_batch.GetStats().Dropped);
+        m_reportedOverflow = true;
+    }
+    m_lastStats = m_batch.GetStats();
+    if (m_batch.VertexCount() == 0) {
+        return;
+    }
+
+    // The whole frame's geometry is one allocation, every draw is a range of it.
+    auto allocation = m_vertices->AllocateVertices(sizeof(Vertex2D) * static_cast<VkDeviceSize>(m_batch.VertexCount()));
+    if (!allocation.IsValid()) {
+        return;
+    }
+    auto draws = m_batch.Finish(allocation.As<Vertex2D>());
+    m_lastStats = m_batch.GetStats();
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &allocation.Buffer, &allocation.Offset);
+    m_device.Stats().Add(RenderCounter::VertexBufferBinds);
+    if (m_bindless) {
+        auto heap = m_bindless->Set();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_layout, 0, 1, &heap, 0, nullptr);
+    }
+    vkCmdPushConstants(commandBuffer, m_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(projection), &projection);
+
+    for (auto const &draw: draws) {
+        m_pipelines[static_cast<u32>(draw.Primitive)]->BindCommandBuffer(commandBuffer);
+        vkCmdDraw(commandBuffer, draw.VertexCount, 1, draw.FirstVertex, 0);
+        m_device.Stats().Draw(draw.VertexCount, 1, draw.Primitive == Primitive2D::Triangles);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include "Batch2D.h"
+#include "Definitions.h"
+#include "Descriptors.h"
+#include "Device.h"
+#include "Pipeline.h"
+#include "ShaderHotReload.h"
+#include "StreamingBuffer.h"
+#include "Types.h"
+#include <array>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+// Draws a Batch2D straight out of its own streaming buffer, one pipeline per primitive type.
+// Sprites sample through the bindless heap, without one everything is flat colored.
+class Renderer2D {
+    Device &m_device;
+    BindlessHeap *m_bindless;
+    Batch2D m_batch;
+    Ptr<StreamingBuffer> m_vertices{};
+
+    VkPipelineLayout m_layout{};
+    std::array<PipelineConfigInfo, Primitive2DCount> m_configs{};
+    std::array<Ptr<Pipeline>, Primitive2DCount> m_pipelines{};
+    Batch2D::Stats m_lastStats{};
+    bool m_reportedOverflow{false};
+
+public:
+    // `config` is the scene's pipeline config, the 2D pipelines keep its targets.
+    Renderer2D(Device &device, BindlessHeap *bindless, PipelineConfigInfo const &config, u32 maxVertices);
+    ~Renderer2D();
+    Renderer2D(Renderer2D const &other) = delete;
+    Renderer2D &operator=(Renderer2D const &other) = delete;
+
+    // Must come after the slot's fence, starts the frame's batch from scratch.
+    void BeginFrame(u32 frameIndex);
+    // Everything submitted here until Draw() ends up in this frame.
+    MUST_USE Batch2D &Batch() { return m_batch; }
+    // Streams and draws the frame's batch, inside the pass it belongs to. `projection` maps
+    // batch coordinates to clip space.
+    void Draw(VkCommandBuffer commandBuffer, glm::mat4 const &projection);
+
+    void WatchShaders(ShaderHotReload &hotReload);
+
+    // Of the last Draw().
+    MUST_USE Batch2D::Stats const &LastStats() const { return m_lastStats; }
+
+private:
+    void CreateLayout();
+};
\ No newline at end of file
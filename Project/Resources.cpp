@@ -0,0 +1,166 @@
+#include "Resources.h"
+#include "Logger.h"
+#include <vulkan/vk_enum_string_helper.h>
+
+ResourceManager::ResourceManager(Device &device) : m_device(device)
+{
+}
+
+ResourceManager::~ResourceManager()
+{
+    std::scoped_lock lock(m_mutex);
+    for (auto const &buffer: m_buffers.Values()) {
+        Retire(buffer);
+    }
+    for (auto const &image: m_images.Values()) {
+        Retire(image);
+    }
+    for (auto const &pipeline: m_pipelines.Values()) {
+        Retire(pipeline);
+    }
+}
+
+BufferHandle ResourceManager::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+{
+    auto buffer = m_device.CreateBuffer(size, usage, properties);
+
+    std::scoped_lock lock(m_mutex);
+    return m_buffers.Insert(BufferResource{
+            .Buffer = buffer.Buffer,
+            .Memory = buffer.Memory,
+            .Size = size,
+            .LastUsedFrame = m_device.Deletion().CurrentFrame(),
+    });
+}
+
+ImageHandle ResourceManager::CreateImage(VkImageCreateInfo const &info, VkMemoryPropertyFlags properties, VkImageAspectFlags aspect)
+{
+    auto image = m_device.CreateImage(info, properties);
+
+    VkImageViewCreateInfo viewInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = image.Image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = info.format,
+            .subresourceRange = VkImageSubresourceRange{
+                    .aspectMask = aspect,
+                    .baseMipLevel = 0,
+                    .levelCount = info.mipLevels,
+                    .baseArrayLayer = 0,
+                    .layerCount = info.arrayLayers,
+            },
+    };
+
+    VkImageView view{};
+    auto result = vkCreateImageView(m_device.LogicalDevice(), &viewInfo, nullptr, &view);
+    if (result != VK_SUCCESS) {
+        ERRORF("Failed to create image view: {}", string_VkResult(result));
+    }
+
+    std::scoped_lock lock(m_mutex);
+    return m_images.Insert(ImageResource{
+            .Image = image.Image,
+            .Memory = image.Memory,
+            .View = view,
+            .Format = info.format,
+            .Extent = info.extent,
+            .LastUsedFrame = m_device.Deletion().CurrentFrame(),
+    });
+}
+
+PipelineHandle ResourceManager::AddPipeline(VkPipeline pipeline, VkPipelineBindPoint bindPoint)
+{
+    std::scoped_lock lock(m_mutex);
+    return m_pipelines.Insert(PipelineResource{
+            .Pipeline = pipeline,
+            .BindPoint = bindPoint,
+            .LastUsedFrame = m_device.Deletion().CurrentFrame(),
+    });
+}
+
+std::optional<BufferResource> ResourceManager::Use(BufferHandle handle)
+{
+    std::scoped_lock lock(m_mutex);
+    auto buffer = m_buffers.Get(handle);
+    if (buffer == nullptr) {
+        return std::nullopt;
+    }
+    buffer->LastUsedFrame = m_device.Deletion().CurrentFrame();
+    return *buffer;
+}
+
+std::optional<ImageResource> ResourceManager::Use(ImageHandle handle)
+{
+    std::scoped_lock lock(m_mutex);
+    auto image = m_images.Get(handle);
+    if (image == nullptr) {
+        return std::nullopt;
+    }
+    image->LastUsedFrame = m_device.Deletion().CurrentFrame();
+    return *image;
+}
+
+std::optional<PipelineResource> ResourceManager::Use(PipelineHandle handle)
+{
+    std::scoped_lock lock(m_mutex);
+    auto pipeline = m_pipelines.Get(handle);
+    if (pipeline == nullptr) {
+        return std::nullopt;
+    }
+    pipeline->LastUsedFrame = m_device.Deletion().CurrentFrame();
+    return *pipeline;
+}
+
+void ResourceManager::Destroy(BufferHandle handle)
+{
+    std::scoped_lock lock(m_mutex);
+    if (auto buffer = m_buffers.Remove(handle)) {
+        Retire(*buffer);
+    } else {
+        WARN("Tried to destroy a stale buffer handle");
+    }
+}
+
+void ResourceManager::Destroy(ImageHandle handle)
+{
+    std::scoped_lock lock(m_mutex);
+    if (auto image = m_images.Remove(handle)) {
+        Retire(*image);
+    } else {
+        WARN("Tried to destroy a stale image handle");
+    }
+}
+
+void ResourceManager::Destroy(PipelineHandle handle)
+{
+    std::scoped_lock lock(m_mutex);
+    if (auto pipeline = m_pipelines.Remove(handle)) {
+        Retire(*pipeline);
+    } else {
+        WARN("Tried to destroy a stale pipeline handle");
+    }
+}
+
+void ResourceManager::Retire(BufferResource const &buffer)
+{
+    m_device.Deletion().Push(buffer.LastUsedFrame, [device = m_device.LogicalDevice(), budget = &m_device.Memory(), buffer] {
+        vkDestroyBuffer(device, buffer.Buffer, nullptr);
+        budget->Free(device, buffer.Memory);
+    });
+}
+
+void ResourceManager::Retire(ImageResource const &image)
+{
+    m_device.Deletion().Push(image.LastUsedFrame, [device = m_device.LogicalDevice(), budget = &m_device.Memory(), image] {
+        vkDestroyImageView(device, image.View, nullptr);
+        vkDestroyImage(device, image.Image, nullptr);
+        budget->Free(device, image.Memory);
+    });
+}
+
+void ResourceManager::Retire(PipelineResource const &pipeline)
+{
+    m_device.Deletion().Push(pipeline.LastUsedFrame, [device = m_device.LogicalDevice(), callbacks = m_device.HostCallbacks(), pipeline] {
+        vkDestroyPipeline(device, pipeline.Pipeline, callbacks);
+    });
+}
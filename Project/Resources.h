@@ -0,0 +1,74 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "HandlePool.h"
+#include "Types.h"
+#include <mutex>
+#include <optional>
+#include <vulkan/vulkan.h>
+
+struct BufferResource {
+    VkBuffer Buffer{};
+    VkDeviceMemory Memory{};
+    VkDeviceSize Size{};
+    u64 LastUsedFrame{};
+};
+
+struct ImageResource {
+    VkImage Image{};
+    VkDeviceMemory Memory{};
+    VkImageView View{};
+    VkFormat Format{};
+    VkExtent3D Extent{};
+    u64 LastUsedFrame{};
+};
+
+struct PipelineResource {
+    VkPipeline Pipeline{};
+    VkPipelineBindPoint BindPoint{};
+    u64 LastUsedFrame{};
+};
+
+using BufferHandle = Handle<BufferResource>;
+using ImageHandle = Handle<ImageResource>;
+using PipelineHandle = Handle<PipelineResource>;
+
+// Owns runtime-streamed GPU objects behind generational handles. Destroying a handle only
+// unregisters it, the Vulkan objects are retired through the device's deletion queue once the
+// GPU is past the last frame that used them, so unloading never needs a device idle.
+class ResourceManager {
+    Device &m_device;
+    std::mutex m_mutex;
+    HandlePool<BufferResource> m_buffers;
+    HandlePool<ImageResource> m_images;
+    HandlePool<PipelineResource> m_pipelines;
+
+public:
+    explicit ResourceManager(Device &device);
+    ~ResourceManager();
+    ResourceManager(ResourceManager const &other) = delete;
+    ResourceManager &operator=(ResourceManager const &other) = delete;
+
+    MUST_USE BufferHandle CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+    MUST_USE ImageHandle CreateImage(VkImageCreateInfo const &info, VkMemoryPropertyFlags properties, VkImageAspectFlags aspect);
+    // Takes ownership of an already created pipeline.
+    MUST_USE PipelineHandle AddPipeline(VkPipeline pipeline, VkPipelineBindPoint bindPoint);
+
+    // Resolves a handle for use in the frame being recorded. Returns nothing for stale handles.
+    MUST_USE std::optional<BufferResource> Use(BufferHandle handle);
+    MUST_USE std::optional<ImageResource> Use(ImageHandle handle);
+    MUST_USE std::optional<PipelineResource> Use(PipelineHandle handle);
+
+    void Destroy(BufferHandle handle);
+    void Destroy(ImageHandle handle);
+    void Destroy(PipelineHandle handle);
+
+    MUST_USE u32 BufferCount() const { return m_buffers.Size(); }
+    MUST_USE u32 ImageCount() const { return m_images.Size(); }
+    MUST_USE u32 PipelineCount() const { return m_pipelines.Size(); }
+
+private:
+    void Retire(BufferResource const &buffer);
+    void Retire(ImageResource const &image);
+    void Retire(PipelineResource const &pipeline);
+};
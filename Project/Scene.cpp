@@ -0,0 +1,322 @@
+#include "Scene.h"
+#include "FrustumCuller.h"
+#include "IndirectRenderer.h"
+#include "JobSystem.h"
+#include "Logger.h"
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+static constexpr u8 DirtyFlag = 1 << 0;
+static constexpr u8 DestroyedFlag = 1 << 1;
+static constexpr u32 NoSlot = ~0u;
+
+// Entities per job, small enough to spread a single wide level over every worker.
+static constexpr u32 UpdateGrain = 4096;
+
+static glm::mat4 ComposeTransform(Transform const &transform)
+{
+    auto rotation = glm::mat3_cast(transform.Rotation);
+    glm::mat4 result;
+    result[0] = glm::vec4(rotation[0] * transform.Scale.x, 0.0f);
+    result[1] = glm::vec4(rotation[1] * transform.Scale.y, 0.0f);
+    result[2] = glm::vec4(rotation[2] * transform.Scale.z, 0.0f);
+    result[3] = glm::vec4(transform.Position, 1.0f);
+    return result;
+}
+
+void Scene::Reserve(u32 count)
+{
+    m_local.reserve(count);
+    m_world.reserve(count);
+    m_localBounds.reserve(count);
+    m_worldBounds.reserve(count);
+    m_parent.reserve(count);
+    m_depth.reserve(count);
+    m_renderObject.reserve(count);
+    m_flags.reserve(count);
+    m_moved.reserve(count);
+    m_denseToSlot.reserve(count);
+    m_slots.reserve(count);
+}
+
+u32 Scene::DenseIndex(Entity entity) const
+{
+    if (!entity.IsValid() || entity.Index >= m_slots.size()) {
+        return NoParent;
+    }
+    auto const &slot = m_slots[entity.Index];
+    return slot.Generation == entity.Generation ? slot.DenseIndex : NoParent;
+}
+
+bool Scene::Contains(Entity entity) const
+{
+    return DenseIndex(entity) != NoParent;
+}
+
+Entity Scene::Create(Transform const &transform, Entity parent, glm::vec4 const &localBounds, u32 renderObject)
+{
+    u32 parentIndex = NoParent;
+    u32 depth = 0;
+    if (parent.IsValid()) {
+        parentIndex = DenseIndex(parent);
+        if (parentIndex == NoParent) {
+            WARN("Tried to create an entity under a stale parent");
+            return {};
+        }
+        depth = m_depth[parentIndex] + 1;
+    }
+
+    u32 slotIndex;
+    if (!m_freeSlots.empty()) {
+        slotIndex = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        slotIndex = static_cast<u32>(m_slots.size());
+        m_slots.emplace_back();
+    }
+
+    auto dense = Size();
+    m_slots[slotIndex].DenseIndex = dense;
+    m_local.push_back(transform);
+    m_world.emplace_back(1.0f);
+    m_localBounds.push_back(localBounds);
+    m_worldBounds.push_back(localBounds);
+    m_parent.push_back(parentIndex);
+    m_depth.push_back(depth);
+    m_renderObject.push_back(renderObject);
+    m_flags.push_back(DirtyFlag);
+    m_moved.push_back(0);
+    m_denseToSlot.push_back(slotIndex);
+
+    // Appending keeps the depth order as long as the new entity is on the deepest level or one below.
+    if (!m_needsSort) {
+        if (depth + 1 == m_levelEnd.size()) {
+            m_levelEnd.back() = dense + 1;
+        } else if (depth == m_levelEnd.size()) {
+            m_levelEnd.push_back(dense + 1);
+        } else {
+            m_needsSort = true;
+        }
+    }
+
+    return Entity{slotIndex, m_slots[slotIndex].Generation};
+}
+
+void Scene::Destroy(Entity entity)
+{
+    auto index = DenseIndex(entity);
+    if (index == NoParent) {
+        return;
+    }
+
+    auto &slot = m_slots[entity.Index];
+    slot.Generation++;
+    m_freeSlots.push_back(entity.Index);
+    m_denseToSlot[index] = NoSlot;
+    m_flags[index] |= DestroyedFlag;
+    m_needsSort = true;
+}
+
+void Scene::SetTransform(Entity entity, Transform const &transform)
+{
+    auto index = DenseIndex(entity);
+    if (index != NoParent) {
+        m_local[index] = transform;
+        m_flags[index] |= DirtyFlag;
+    }
+}
+
+Transform const *Scene::LocalTransform(Entity entity) const
+{
+    auto index = DenseIndex(entity);
+    return index != NoParent ? &m_local[index] : nullptr;
+}
+
+glm::mat4 const *Scene::WorldMatrix(Entity entity) const
+{
+    auto index = DenseIndex(entity);
+    return index != NoParent ? &m_world[index] : nullptr;
+}
+
+void Scene::SetRenderObject(Entity entity, u32 renderObject)
+{
+    auto index = DenseIndex(entity);
+    if (index != NoParent) {
+        m_renderObject[index] = renderObject;
+        m_flags[index] |= DirtyFlag;
+    }
+}
+
+Slice<u32 const> Scene::TakeReleasedObjects(LinearArena &arena)
+{
+    // The list keeps its capacity, releasing objects every frame does not allocate.
+    auto released = arena.Copy<u32>(m_releasedObjects);
+    m_releasedObjects.clear();
+    return released;
+}
+
+void Scene::Sort()
+{
+    auto count = Size();
+
+    // Counting sort by depth, stable so siblings keep their creation order.
+    u32 maxDepth = 0;
+    for (auto depth: m_depth) {
+        maxDepth = std::max(maxDepth, depth);
+    }
+    ScratchScope scratch;
+    auto levelStart = scratch.Allocate<u32>(maxDepth + 2);
+    std::fill(levelStart.begin(), levelStart.end(), 0);
+    for (auto depth: m_depth) {
+        levelStart[depth + 1]++;
+    }
+    for (u32 level = 1; level < levelStart.Length(); level++) {
+        levelStart[level] += levelStart[level - 1];
+    }
+    auto order = scratch.Allocate<u32>(count);
+    for (u32 i = 0; i < count; i++) {
+        order[levelStart[m_depth[i]]++] = i;
+    }
+
+    // Parents are visited first now, so destruction reaches whole subtrees in one pass.
+    auto remap = scratch.Allocate<u32>(count);
+    std::fill(remap.begin(), remap.end(), NoParent);
+    u32 survivors = 0;
+    for (auto old: order) {
+        auto parent = m_parent[old];
+        if (parent != NoParent && (m_flags[parent] & DestroyedFlag) != 0) {
+            m_flags[old] |= DestroyedFlag;
+        }
+        if ((m_flags[old] & DestroyedFlag) != 0) {
+            if (m_denseToSlot[old] != NoSlot) {
+                auto slot = m_denseToSlot[old];
+                m_slots[slot].Generation++;
+                m_freeSlots.push_back(slot);
+            }
+            if (m_renderObject[old] != NoRenderObject) {
+                m_releasedObjects.push_back(m_renderObject[old]);
+            }
+            continue;
+        }
+        remap[old] = survivors++;
+    }
+
+    auto permute = [&]<typename T>(std::vector<T> &values) {
+        std::vector<T> sorted(survivors);
+        for (u32 old = 0; old < count; old++) {
+            if (remap[old] != NoParent) {
+                sorted[remap[old]] = std::move(values[old]);
+            }
+        }
+        values.swap(sorted);
+    };
+    permute(m_local);
+    permute(m_world);
+    permute(m_localBounds);
+    permute(m_worldBounds);
+    permute(m_parent);
+    permute(m_depth);
+    permute(m_renderObject);
+    permute(m_flags);
+    permute(m_moved);
+    permute(m_denseToSlot);
+
+    m_levelEnd.clear();
+    for (u32 i = 0; i < survivors; i++) {
+        if (m_parent[i] != NoParent) {
+            m_parent[i] = remap[m_parent[i]];
+        }
+        m_slots[m_denseToSlot[i]].DenseIndex = i;
+
+        if (m_depth[i] + 1 > m_levelEnd.size()) {
+            m_levelEnd.resize(m_depth[i] + 1, i);
+        }
+        m_levelEnd[m_depth[i]] = i + 1;
+    }
+    m_needsSort = false;
+}
+
+void Scene::UpdateRange(u32 begin, u32 end, SceneOutputs const &outputs, u32 &updated, u32 &firstObject, u32 &lastObject)
+{
+    auto *objects = outputs.Renderer != nullptr ? outputs.Renderer->Objects() : nullptr;
+
+    for (u32 i = begin; i < end; i++) {
+        auto parent = m_parent[i];
+        bool parentMoved = parent != NoParent && m_moved[parent] != 0;
+        if ((m_flags[i] & DirtyFlag) == 0 && !parentMoved) {
+            m_moved[i] = 0;
+            continue;
+        }
+
+        auto local = ComposeTransform(m_local[i]);
+        m_world[i] = parent == NoParent ? local : m_world[parent] * local;
+        m_worldBounds[i] = TransformSphere(m_localBounds[i], m_world[i]);
+        m_flags[i] &= ~DirtyFlag;
+        m_moved[i] = 1;
+        updated++;
+
+        auto object = m_renderObject[i];
+        if (object == NoRenderObject) {
+            continue;
+        }
+        if (objects != nullptr) {
+            objects[object].Transform = m_world[i];
+            objects[object].Bounds = m_worldBounds[i];
+            firstObject = std::min(firstObject, object);
+            lastObject = std::max(lastObject, object);
+        }
+        if (outputs.Culler != nullptr) {
+            outputs.Culler->SetSphere(object, glm::vec3(m_worldBounds[i]), m_worldBounds[i].w);
+        }
+    }
+}
+
+SceneUpdateStats Scene::Update(JobSystem &jobs, SceneOutputs const &outputs)
+{
+    SceneUpdateStats stats{};
+    if (m_needsSort) {
+        Sort();
+        stats.Sorted = true;
+    }
+
+    std::mutex mutex;
+    u32 updated = 0;
+    u32 firstObject = ~0u;
+    u32 lastObject = 0;
+
+    // Levels run one after another, a child only reads its parent's results once that level is done.
+    u32 levelBegin = 0;
+    for (auto levelEnd: m_levelEnd) {
+        jobs.ParallelFor(levelEnd - levelBegin, UpdateGrain, [&](u32 begin, u32 end) {
+            u32 chunkUpdated = 0;
+            u32 chunkFirst = ~0u;
+            u32 chunkLast = 0;
+            UpdateRange(levelBegin + begin, levelBegin + end, outputs, chunkUpdated, chunkFirst, chunkLast);
+            if (chunkUpdated > 0) {
+                std::scoped_lock lock(mutex);
+                updated += chunkUpdated;
+                firstObject = std::min(firstObject, chunkFirst);
+                lastObject = std::max(lastObject, chunkLast);
+            }
+        });
+        levelBegin = levelEnd;
+    }
+
+    if (outputs.Renderer != nullptr && firstObject <= lastObject) {
+        outputs.Renderer->MarkObjectsDirty(firstObject, lastObject + 1);
+    }
+    // One pass over the moved flags, the jobs above would have to lock for every append.
+    if (outputs.Updates != nullptr && updated > 0) {
+        for (u32 i = 0; i < Size(); i++) {
+            if (m_moved[i] != 0 && m_renderObject[i] != NoRenderObject) {
+                outputs.Updates->push_back(SceneObjectUpdate{m_renderObject[i], m_world[i], m_worldBounds[i]});
+            }
+        }
+    }
+
+    stats.Entities = Size();
+    stats.Updated = updated;
+    stats.Levels = static_cast<u32>(m_levelEnd.size());
+    return stats;
+}
\ No newline at end of file
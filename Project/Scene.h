@@ -0,0 +1,108 @@
+#pragma once
+#include "Definitions.h"
+#include "HandlePool.h"
+#include "LinearArena.h"
+#include "Types.h"
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+class FrustumCuller;
+class IndirectRenderer;
+class JobSystem;
+
+struct Transform {
+    glm::vec3 Position{0.0f};
+    glm::quat Rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 Scale{1.0f};
+};
+
+// One render object that moved, its world matrix and world bounding sphere.
+struct SceneObjectUpdate {
+    u32 Object{};
+    glm::mat4 World{1.0f};
+    glm::vec4 Bounds{0.0f};
+};
+
+// Where Scene::Update writes the world transforms and bounds of entities that moved. Each
+// entity's render object is used as the slot in whichever target is set.
+struct SceneOutputs {
+    IndirectRenderer *Renderer{};
+    FrustumCuller *Culler{};
+    // Appended to instead of written in place, for targets owned by another thread.
+    std::vector<SceneObjectUpdate> *Updates{};
+};
+
+struct SceneUpdateStats {
+    u32 Entities{};
+    u32 Updated{};
+    u32 Levels{};
+    bool Sorted{};
+};
+
+class Scene;
+using Entity = Handle<Scene>;
+
+// Entities are stored as parallel component arrays sorted by hierarchy depth, so parents always
+// come before their children. An update walks the arrays linearly one depth level at a time and
+// splits every level across the job system, only touching entities that are dirty or whose
+// parent moved this update.
+class Scene {
+public:
+    static constexpr u32 NoParent = ~0u;
+    static constexpr u32 NoRenderObject = ~0u;
+
+private:
+    struct Slot {
+        u32 DenseIndex{};
+        u32 Generation{1};
+    };
+
+    // Components, indexed by dense index.
+    std::vector<Transform> m_local;
+    std::vector<glm::mat4> m_world;
+    std::vector<glm::vec4> m_localBounds;
+    std::vector<glm::vec4> m_worldBounds;
+    std::vector<u32> m_parent;
+    std::vector<u32> m_depth;
+    std::vector<u32> m_renderObject;
+    std::vector<u8> m_flags;
+    std::vector<u8> m_moved;
+    std::vector<u32> m_denseToSlot;
+
+    std::vector<Slot> m_slots;
+    std::vector<u32> m_freeSlots;
+
+    // m_levelEnd[d] is one past the last entity at depth d.
+    std::vector<u32> m_levelEnd;
+    bool m_needsSort{false};
+    std::vector<u32> m_releasedObjects;
+
+public:
+    // Parents have to exist before their children. `localBounds` is a bounding sphere in the
+    // entity's own space, xyz center and w radius.
+    MUST_USE Entity Create(Transform const &transform, Entity parent = {}, glm::vec4 const &localBounds = glm::vec4(0.0f), u32 renderObject = NoRenderObject);
+    // The entity's handle goes stale right away, its descendants follow on the next Update.
+    void Destroy(Entity entity);
+
+    MUST_USE bool Contains(Entity entity) const;
+    void SetTransform(Entity entity, Transform const &transform);
+    MUST_USE Transform const *LocalTransform(Entity entity) const;
+    MUST_USE glm::mat4 const *WorldMatrix(Entity entity) const;
+    void SetRenderObject(Entity entity, u32 renderObject);
+
+    SceneUpdateStats Update(JobSystem &jobs, SceneOutputs const &outputs);
+    // Render objects of entities removed by the last updates, the caller owns releasing them.
+    // Copied into `arena`, typically the frame's.
+    MUST_USE Slice<u32 const> TakeReleasedObjects(LinearArena &arena);
+
+    void Reserve(u32 count);
+    MUST_USE u32 Size() const { return static_cast<u32>(m_local.size()); }
+
+private:
+    MUST_USE u32 DenseIndex(Entity entity) const;
+    void Sort();
+    void UpdateRange(u32 begin, u32 end, SceneOutputs const &outputs, u32 &updated, u32 &firstObject, u32 &lastObject);
+};
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "ShaderCode.h"
+#include "Logger.h"
+#include <cstring>
+#include <utility>
+
+#ifdef VULKANIZED_EMBED_SHADERS
+#include "EmbeddedShaders.h"
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ShaderCode::~ShaderCode()
+{
+    Release();
+}
+
+ShaderCode::ShaderCode(ShaderCode &&other) noexcept
+    : m_words(std::exchange(other.m_words, nullptr)),
+      m_size(std::exchange(other.m_size, 0)),
+      m_mapping(std::exchange(other.m_mapping, nullptr)),
+      m_mappingSize(std::exchange(other.m_mappingSize, 0))
+{
+}
+
+ShaderCode &ShaderCode::operator=(ShaderCode &&other) noexcept
+{
+    if (this != &other) {
+        Release();
+        m_words = std::exchange(other.m_words, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+        m_mappingSize = std::exchange(other.m_mappingSize, 0);
+    }
+    return *this;
+}
+
+void ShaderCode::Release()
+{
+    if (m_mapping != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_mapping);
+#else
+        munmap(m_mapping, m_mappingSize);
+#endif
+    }
+    m_words = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+    m_mappingSize = 0;
+}
+
+ShaderCode ShaderCode::Load(char const *path)
+{
+    ShaderCode code;
+#ifdef VULKANIZED_EMBED_SHADERS
+    for (auto const &shader: g_EmbeddedShaders) {
+        if (std::strcmp(shader.Path, path) == 0) {
+            code.m_words = shader.Words;
+            code.m_size = shader.Size;
+            return code;
+        }
+    }
+    WARNF("Shader '{}' is not embedded, mapping it from disk", path);
+#endif
+
+    size_t size = 0;
+    void *mapping = nullptr;
+#ifdef _WIN32
+    auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        ERRORF("Failed to open file '{}'", path);
+        return code;
+    }
+    LARGE_INTEGER fileSize{};
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        size = static_cast<size_t>(fileSize.QuadPart);
+        // The view keeps the mapping alive, neither handle is needed once it exists.
+        auto mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle != nullptr) {
+            mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mappingHandle);
+        }
+    }
+    CloseHandle(file);
+#else
+    auto file = open(path, O_RDONLY);
+    if (file < 0) {
+        ERRORF("Failed to open file '{}'", path);
+        return code;
+    }
+    struct stat info{};
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        size = static_cast<size_t>(info.st_size);
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+        }
+    }
+    close(file);
+#endif
+
+    if (mapping == nullptr) {
+        ERRORF("Failed to map shader '{}'", path);
+        return code;
+    }
+    if (size % sizeof(u32) != 0) {
+        WARNF("Shader '{}' is {} bytes, not a whole number of SPIR-V words", path, size);
+    }
+    INFOF("Mapped shader bytecode from '{}' ({} bytes)", path, size);
+
+    code.m_words = static_cast<u32 const *>(mapping);
+    code.m_size = size;
+    code.m_mapping = mapping;
+    code.m_mappingSize = size;
+    return code;
+}
\ No newline at end of file
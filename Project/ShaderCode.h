@@ -0,0 +1,40 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <cstddef>
+
+// One entry of the table generated by cmake/EmbedShaders.cmake, `Path` is what the code would
+// load from disk otherwise.
+struct EmbeddedShader {
+    char const *Path;
+    u32 const *Words;
+    size_t Size;
+};
+
+// Read-only SPIR-V. Shaders embedded into the executable are used in place, anything else is
+// memory mapped, neither way copies the bytecode.
+class ShaderCode {
+    u32 const *m_words{};
+    size_t m_size{};
+    void *m_mapping{};
+    size_t m_mappingSize{};
+
+public:
+    ShaderCode() = default;
+    ~ShaderCode();
+    ShaderCode(ShaderCode &&other) noexcept;
+    ShaderCode &operator=(ShaderCode &&other) noexcept;
+    ShaderCode(ShaderCode const &other) = delete;
+    ShaderCode &operator=(ShaderCode const &other) = delete;
+
+    static ShaderCode Load(char const *path);
+
+    MUST_USE bool IsValid() const { return m_words != nullptr; }
+    MUST_USE bool IsEmbedded() const { return IsValid() && m_mapping == nullptr; }
+    MUST_USE u32 const *Words() const { return m_words; }
+    // In bytes, as vkCreateShaderModule wants it.
+    MUST_USE size_t Size() const { return m_size; }
+
+private:
+    void Release();
+};
\ No newline at end of file
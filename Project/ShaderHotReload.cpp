@@ -0,0 +1,254 @@
+#include "ShaderHotReload.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifndef VULKANIZED_SHADER_SOURCE_DIR
+#define VULKANIZED_SHADER_SOURCE_DIR "Assets/Shaders"
+#endif
+#ifndef VULKANIZED_GLSLC
+#define VULKANIZED_GLSLC "glslc"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Same stage and target environment rules as the CMake shader build.
+bool ShaderStage(std::string const &file, char const *&stage, char const *&environment)
+{
+    static constexpr std::pair<char const *, char const *> stages[] = {
+            {".vert.glsl", "vert"}, {".frag.glsl", "frag"}, {".comp.glsl", "comp"},
+            {".task.glsl", "task"}, {".mesh.glsl", "mesh"},
+    };
+    for (auto [suffix, name]: stages) {
+        if (file.ends_with(suffix)) {
+            stage = name;
+            environment = file.ends_with(".task.glsl") || file.ends_with(".mesh.glsl") ? "vulkan1.3" : "vulkan1.0";
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+    Stop();
+}
+
+void ShaderHotReload::Start()
+{
+    if (m_running.exchange(true)) {
+        return;
+    }
+    m_thread = std::thread([this] { Run(); });
+    INFOF("Watching '{}' for shader changes", VULKANIZED_SHADER_SOURCE_DIR);
+}
+
+void ShaderHotReload::Stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    m_thread.join();
+}
+
+u32 ShaderHotReload::Apply()
+{
+    std::vector<std::function<void()>> ready;
+    {
+        std::scoped_lock lock(m_mutex);
+        ready.swap(m_ready);
+    }
+    for (auto &swap: ready) {
+        swap();
+    }
+    m_applied += static_cast<u32>(ready.size());
+    return static_cast<u32>(ready.size());
+}
+
+void ShaderHotReload::Run()
+{
+    using Clock = std::chrono::steady_clock;
+    // Editors tend to write a file in several steps, changes are collected until things settle.
+    constexpr auto settleTime = std::chrono::milliseconds(100);
+    std::vector<std::string> changed;
+    auto lastChange = Clock::now();
+    auto markChanged = [&](std::string path) {
+        if (path.ends_with(".glsl") && std::find(changed.begin(), changed.end(), path) == changed.end()) {
+            changed.push_back(std::move(path));
+        }
+        lastChange = Clock::now();
+    };
+
+#ifdef __linux__
+    auto notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notify < 0) {
+        ERROR("Failed to initialize inotify, shader hot reload is disabled");
+        return;
+    }
+    std::unordered_map<int, std::string> directories;
+    for (auto const &directory: {fs::path(VULKANIZED_SHADER_SOURCE_DIR), fs::path(VULKANIZED_SHADER_SOURCE_DIR) / "Include"}) {
+        auto watch = inotify_add_watch(notify, directory.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch >= 0) {
+            directories.emplace(watch, directory.string());
+        }
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (m_running.load(std::memory_order_relaxed)) {
+        pollfd descriptor{notify, POLLIN, 0};
+        if (poll(&descriptor, 1, 50) > 0) {
+            ssize_t length;
+            while ((length = read(notify, buffer, sizeof(buffer))) > 0) {
+                for (ssize_t offset = 0; offset < length;) {
+                    auto const *event = reinterpret_cast<inotify_event const *>(buffer + offset);
+                    if (event->len > 0 && directories.contains(event->wd)) {
+                        markChanged((fs::path(directories[event->wd]) / event->name).string());
+                    }
+                    offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                }
+            }
+        }
+        if (!changed.empty() && Clock::now() - lastChange >= settleTime) {
+            Reload(changed);
+            changed.clear();
+        }
+    }
+    close(notify);
+#else
+    // No change notifications here, modification times are polled instead.
+    std::unordered_map<std::string, fs::file_time_type> timestamps;
+    auto scan = [&](bool report) {
+        std::error_code error;
+        for (auto const &file: fs::recursive_directory_iterator(VULKANIZED_SHADER_SOURCE_DIR, error)) {
+            auto path = file.path().string();
+            auto time = file.last_write_time(error);
+            auto [it, inserted] = timestamps.try_emplace(path, time);
+            if (!inserted && it->second != time) {
+                it->second = time;
+                if (report) {
+                    markChanged(path);
+                }
+            }
+        }
+    };
+    scan(false);
+    while (m_running.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        scan(true);
+        if (!changed.empty() && Clock::now() - lastChange >= settleTime) {
+            Reload(changed);
+            changed.clear();
+        }
+    }
+#endif
+}
+
+void ShaderHotReload::Reload(std::vector<std::string> const &changedSources)
+{
+    // A changed include may be used by any shader, everything gets rebuilt then.
+    std::vector<std::string> sources;
+    for (auto const &source: changedSources) {
+        if (fs::path(source).parent_path().filename() != "Include") {
+            sources.push_back(source);
+            continue;
+        }
+        sources.clear();
+        std::error_code error;
+        for (auto const &file: fs::directory_iterator(VULKANIZED_SHADER_SOURCE_DIR, error)) {
+            sources.push_back(file.path().string());
+        }
+        break;
+    }
+
+    std::vector<std::string> compiled;
+    for (auto const &source: sources) {
+        std::string output;
+        if (Compile(source, output)) {
+            compiled.push_back(std::move(output));
+        }
+    }
+    if (compiled.empty()) {
+        return;
+    }
+
+    std::vector<std::function<std::function<void()>()>> rebuilds;
+    {
+        std::scoped_lock lock(m_mutex);
+        for (auto const &entry: m_entries) {
+            auto affected = std::any_of(entry.Shaders.begin(), entry.Shaders.end(), [&](std::string const &shader) {
+                return std::find(compiled.begin(), compiled.end(), shader) != compiled.end();
+            });
+            if (affected) {
+                rebuilds.push_back(entry.Rebuild);
+            }
+        }
+    }
+
+    // Pipelines are created here, on the watcher thread, through the device's pipeline cache.
+    u32 rebuilt = 0;
+    for (auto const &rebuild: rebuilds) {
+        auto swap = rebuild();
+        if (!swap) {
+            WARN("Rebuilding a pipeline failed, keeping the old one");
+            continue;
+        }
+        std::scoped_lock lock(m_mutex);
+        m_ready.push_back(std::move(swap));
+        rebuilt++;
+    }
+    INFOF("Hot reload: {} shaders recompiled, {} pipelines rebuilt", compiled.size(), rebuilt);
+}
+
+bool ShaderHotReload::Compile(std::string const &source, std::string &output)
+{
+    char const *stage;
+    char const *environment;
+    auto name = fs::path(source).filename().string();
+    if (!ShaderStage(name, stage, environment)) {
+        return false;
+    }
+
+    // The loader reads from the working directory, same as the build output.
+    output = std::format("Assets/Shaders/{}.spv", name.substr(0, name.size() - std::string_view(".glsl").size()));
+    auto temporary = output + ".tmp";
+    auto command = std::format("\"{}\" --target-env={} -fshader-stage={} -I \"{}/Include\" \"{}\" -o \"{}\"",
+                               VULKANIZED_GLSLC, environment, stage, VULKANIZED_SHADER_SOURCE_DIR, source, temporary);
+    if (std::system(command.c_str()) != 0) {
+        ERRORF("Failed to compile '{}', keeping the previous bytecode", source);
+        return false;
+    }
+
+#ifdef VULKANIZED_SPIRV_OPT
+    auto optimized = output + ".opt.tmp";
+    command = std::format("\"{}\" --target-env={} -O \"{}\" -o \"{}\"", VULKANIZED_SPIRV_OPT, environment, temporary, optimized);
+    if (std::system(command.c_str()) == 0) {
+        std::error_code error;
+        fs::rename(optimized, temporary, error);
+    } else {
+        WARNF("spirv-opt failed on '{}', using the unoptimized module", source);
+    }
+#endif
+
+    // Replaced in one step, a pipeline being built right now never maps a half written file.
+    std::error_code error;
+    fs::rename(temporary, output, error);
+    if (error) {
+        ERRORF("Failed to replace '{}': {}", output, error.message());
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Watches the shader sources (inotify on Linux, timestamps elsewhere), recompiles what changed on
+// its own thread and rebuilds the pipelines that use it there as well. Finished pipelines wait
+// until the render thread calls Apply() between frames, the replaced ones are retired through
+// the deletion queue by their destructors. Nothing here ever blocks a frame on a compiler.
+class ShaderHotReload {
+public:
+#ifdef VULKANIZED_SHADER_HOT_RELOAD
+    static constexpr bool Enabled = true;
+#else
+    static constexpr bool Enabled = false;
+#endif
+
+private:
+    struct Entry {
+        std::vector<std::string> Shaders;
+        // Runs on the watcher thread, returns the swap to do on the render thread or nothing
+        // when the new pipeline failed to build.
+        std::function<std::function<void()>()> Rebuild;
+    };
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_entries{};
+    std::vector<std::function<void()>> m_ready{};
+    std::thread m_thread{};
+    std::atomic<bool> m_running{false};
+    u32 m_applied{0};
+
+public:
+    ShaderHotReload() = default;
+    ~ShaderHotReload();
+    ShaderHotReload(ShaderHotReload const &other) = delete;
+    ShaderHotReload &operator=(ShaderHotReload const &other) = delete;
+
+    void Start();
+    void Stop();
+
+    // `slot` is replaced by whatever `build` returns once any of the compiled `shaders` changes.
+    // The slot has to outlive the watcher.
+    template<typename T>
+    void Watch(std::initializer_list<char const *> shaders, Ptr<T> &slot, std::function<Ptr<T>()> build)
+    {
+        Entry entry{{shaders.begin(), shaders.end()}, [&slot, build = std::move(build)]() -> std::function<void()> {
+            auto built = std::make_shared<Ptr<T>>(build());
+            if (!*built || (*built)->Handle() == VK_NULL_HANDLE) {
+                return {};
+            }
+            return [&slot, built] { slot = std::move(*built); };
+        }};
+        std::scoped_lock lock(m_mutex);
+        m_entries.push_back(std::move(entry));
+    }
+
+    // Swaps in everything rebuilt since the last call. Render thread only, outside of recording.
+    u32 Apply();
+    MUST_USE u32 AppliedCount() const { return m_applied; }
+
+private:
+    void Run();
+    void Reload(std::vector<std::string> const &changedSources);
+    bool Compile(std::string const &source, std::string &output);
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <cstdlib>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+
+// Non-owning view of contiguous elements, typically arena memory or a fixed array. Slice<T const>
+// is the read-only view and every Slice<T> converts to it; constness of the slice itself is
+// shallow, like a pointer. Anything contiguous converts to a slice and a slice converts to a
+// std::span, so functions taking either accept both. Out of range access aborts.
+template<typename T>
+class Slice {
+    T *m_data{};
+    u32 m_length{0};
+
+public:
+    using element_type = T;
+    using value_type = std::remove_cv_t<T>;
+    using iterator = T *;
+
+    constexpr Slice() = default;
+    constexpr Slice(T *data, u32 length) : m_data(data), m_length(length) {}
+
+    template<typename U>
+        requires std::is_convertible_v<U (*)[], T (*)[]>
+    constexpr Slice(Slice<U> other) : m_data(other.Data()), m_length(other.Length()) {}
+
+    // Only lvalues, a slice of a temporary container would dangle.
+    template<typename R>
+        requires (!std::is_same_v<std::remove_cvref_t<R>, Slice>) && std::ranges::contiguous_range<R> && std::ranges::sized_range<R> &&
+                 std::is_convertible_v<std::remove_reference_t<std::ranges::range_reference_t<R>> (*)[], T (*)[]>
+    constexpr Slice(R &range) : m_data(std::ranges::data(range)), m_length(static_cast<u32>(std::ranges::size(range))) {}
+
+    MUST_USE constexpr T *Data() const { return m_data; }
+    MUST_USE constexpr u32 Length() const { return m_length; }
+    MUST_USE constexpr u64 SizeBytes() const { return sizeof(T) * static_cast<u64>(m_length); }
+    MUST_USE constexpr bool IsEmpty() const { return m_length == 0; }
+
+    MUST_USE constexpr T &operator[](u32 i) const
+    {
+        if (i >= m_length) {
+            std::abort();
+        }
+        return m_data[i];
+    }
+
+    MUST_USE constexpr T &First() const { return (*this)[0]; }
+    MUST_USE constexpr T &Last() const { return (*this)[m_length - 1]; }
+
+    // `length` elements from `offset` on, the view has to contain all of them.
+    MUST_USE constexpr Slice SubSlice(u32 offset, u32 length) const
+    {
+        if (offset > m_length || length > m_length - offset) {
+            std::abort();
+        }
+        return Slice(m_data + offset, length);
+    }
+    MUST_USE constexpr Slice SubSlice(u32 offset) const { return SubSlice(offset, offset <= m_length ? m_length - offset : 0); }
+
+    MUST_USE constexpr T *begin() const { return m_data; }
+    MUST_USE constexpr T *end() const { return m_data + m_length; }
+    // Lower case for the standard range machinery, e.g. constructing a std::span.
+    MUST_USE constexpr T *data() const { return m_data; }
+    MUST_USE constexpr size_t size() const { return m_length; }
+};
+
+template<typename R>
+Slice(R &range) -> Slice<std::remove_reference_t<std::ranges::range_reference_t<R>>>;
+
+// The slice never owns what it points at, views of an rvalue slice stay valid.
+template<typename T>
+inline constexpr bool std::ranges::enable_borrowed_range<Slice<T>> = true;
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <array>
+#include <bit>
+#include <concepts>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vulkan/vulkan.h>
+
+// Specialization constants flattened to 32-bit words, constant_id N is word N. Plain data, so
+// pipeline configs holding it stay cheap to copy.
+struct SpecializationConstants {
+    static constexpr u32 MaxConstants = 16;
+
+    std::array<u32, MaxConstants> Words{};
+    u32 Count{};
+    // Tells variants apart in the pipeline registry: the traits' name plus every value.
+    u64 Key{};
+
+    MUST_USE bool Empty() const { return Count == 0; }
+};
+
+// Traits are plain structs of bools, 32-bit integers and floats. `Constants()` lists them in
+// constant_id order, the GLSL side declares the same ids with matching defaults:
+//
+//     struct CullTraits {
+//         static constexpr char const *Name = "Cull";
+//         u32 WorkgroupSize = 64;
+//         bool Statistics = true;
+//         constexpr auto Constants() const { return std::tuple{WorkgroupSize, Statistics}; }
+//     };
+template<typename T>
+concept PipelineTraits = requires(T const &traits) {
+    { T::Name } -> std::convertible_to<char const *>;
+    traits.Constants();
+};
+
+namespace SpecializationDetail {
+
+template<typename T>
+constexpr u32 Word(T value)
+{
+    if constexpr (std::is_same_v<T, bool>) {
+        return value ? VK_TRUE : VK_FALSE;
+    } else {
+        static_assert(std::is_arithmetic_v<T> && sizeof(T) == sizeof(u32), "Specialization constants are 32-bit");
+        return std::bit_cast<u32>(value);
+    }
+}
+
+// FNV-1a, evaluated at compile time for constexpr traits.
+constexpr u64 Hash(u64 hash, u32 word)
+{
+    for (u32 i = 0; i < sizeof(u32); i++) {
+        hash = (hash ^ ((word >> (i * 8)) & 0xffu)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}
+
+template<PipelineTraits T>
+constexpr SpecializationConstants Specialize(T const &traits)
+{
+    using Tuple = decltype(traits.Constants());
+    static_assert(std::tuple_size_v<Tuple> <= SpecializationConstants::MaxConstants, "Too many specialization constants");
+
+    SpecializationConstants result{};
+    std::apply([&](auto... values) {
+        ((result.Words[result.Count++] = SpecializationDetail::Word(values)), ...);
+    }, traits.Constants());
+
+    u64 key = 0xcbf29ce484222325ull;
+    for (auto name = static_cast<char const *>(T::Name); *name != '\0'; name++) {
+        key = SpecializationDetail::Hash(key, static_cast<u8>(*name));
+    }
+    for (u32 i = 0; i < result.Count; i++) {
+        key = SpecializationDetail::Hash(key, result.Words[i]);
+    }
+    result.Key = key;
+    return result;
+}
+
+// Map entries for SpecializationConstants, kept alive next to the create info pointing at them.
+class SpecializationInfo {
+    std::array<VkSpecializationMapEntry, SpecializationConstants::MaxConstants> m_entries{};
+    VkSpecializationInfo m_info{};
+
+public:
+    explicit SpecializationInfo(SpecializationConstants const &constants)
+    {
+        for (u32 i = 0; i < constants.Count; i++) {
+            m_entries[i] = VkSpecializationMapEntry{
+                    .constantID = i,
+                    .offset = i * static_cast<u32>(sizeof(u32)),
+                    .size = sizeof(u32),
+            };
+        }
+        m_info = VkSpecializationInfo{
+                .mapEntryCount = constants.Count,
+                .pMapEntries = m_entries.data(),
+                .dataSize = constants.Count * sizeof(u32),
+                .pData = constants.Words.data(),
+        };
+    }
+    SpecializationInfo(SpecializationInfo const &other) = delete;
+    SpecializationInfo &operator=(SpecializationInfo const &other) = delete;
+
+    // Null without constants, stages then use the defaults compiled into the shader.
+    MUST_USE VkSpecializationInfo const *Get() const { return m_info.mapEntryCount > 0 ? &m_info : nullptr; }
+};
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "StartupTimer.h"
+#include "Logger.h"
+#include <algorithm>
+
+static StartupTimer g_StartupTimer;
+
+StartupTimer::StartupTimer() : m_start(Clock::now())
+{
+    m_phases.reserve(64);
+    m_threads.push_back(std::this_thread::get_id());
+}
+
+StartupTimer &StartupTimer::Get()
+{
+    return g_StartupTimer;
+}
+
+void StartupTimer::Record(char const *name, Clock::time_point begin, Clock::time_point end)
+{
+    std::scoped_lock lock(m_mutex);
+    if (m_reported) {
+        return;
+    }
+
+    // Threads are numbered in the order they first report, the thread that started the
+    // process is 0.
+    auto id = std::this_thread::get_id();
+    auto thread = std::find(m_threads.begin(), m_threads.end(), id);
+    if (thread == m_threads.end()) {
+        thread = m_threads.insert(m_threads.end(), id);
+    }
+    m_phases.push_back(Entry{
+            .Name = name,
+            .Begin = std::chrono::duration<f64>(begin - m_start).count(),
+            .End = std::chrono::duration<f64>(end - m_start).count(),
+            .Thread = static_cast<u32>(thread - m_threads.begin()),
+    });
+}
+
+void StartupTimer::Report(char const *milestone)
+{
+    auto now = SecondsSinceStart();
+    std::scoped_lock lock(m_mutex);
+    if (m_reported) {
+        return;
+    }
+    m_reported = true;
+
+    std::sort(m_phases.begin(), m_phases.end(), [](Entry const &a, Entry const &b) { return a.Begin < b.Begin; });
+    // Sum of every phase against the wall clock they covered, above 1 means phases overlapped.
+    f64 measured = 0.0;
+    for (auto const &phase: m_phases) {
+        measured += phase.End - phase.Begin;
+    }
+
+    INFOF("Startup: {} after {:.1f} ms, {:.1f} ms of measured phases on {} threads",
+          milestone, now * 1000.0, measured * 1000.0, m_threads.size());
+    for (auto const &phase: m_phases) {
+        INFOF("\t{:8.1f} ms {:8.2f} ms  [{}] {}", phase.Begin * 1000.0, (phase.End - phase.Begin) * 1000.0, phase.Thread, phase.Name);
+    }
+    m_phases.clear();
+}
+
+f64 StartupTimer::SecondsSinceStart() const
+{
+    return std::chrono::duration<f64>(Clock::now() - m_start).count();
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Wall clock breakdown of everything between process start and the first presented frame.
+// Phases may be measured from any thread and overlap, the report lists them by start time
+// with the thread they ran on, so what ran serially and what overlapped is visible at once.
+class StartupTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Records its phase when it goes out of scope.
+    class Phase {
+        StartupTimer *m_timer;
+        char const *m_name;
+        Clock::time_point m_begin;
+
+    public:
+        Phase(StartupTimer &timer, char const *name) : m_timer(&timer), m_name(name), m_begin(Clock::now()) {}
+        ~Phase() { m_timer->Record(m_name, m_begin, Clock::now()); }
+        Phase(Phase const &other) = delete;
+        Phase &operator=(Phase const &other) = delete;
+    };
+
+private:
+    struct Entry {
+        char const *Name;
+        f64 Begin;
+        f64 End;
+        u32 Thread;
+    };
+
+    Clock::time_point m_start;
+    std::mutex m_mutex;
+    std::vector<Entry> m_phases;
+    std::vector<std::thread::id> m_threads;
+    bool m_reported{false};
+
+public:
+    StartupTimer();
+    StartupTimer(StartupTimer const &other) = delete;
+    StartupTimer &operator=(StartupTimer const &other) = delete;
+
+    // Created during static initialization, its start is as close to process start as it gets.
+    static StartupTimer &Get();
+
+    // `name` must outlive the timer, string literals only.
+    MUST_USE Phase Measure(char const *name) { return Phase(*this, name); }
+    void Record(char const *name, Clock::time_point begin, Clock::time_point end);
+
+    // Logs every phase recorded so far and the time from start to `milestone`. Only the first
+    // call reports, later ones return right away.
+    void Report(char const *milestone);
+
+    MUST_USE f64 SecondsSinceStart() const;
+};
\ No newline at end of file
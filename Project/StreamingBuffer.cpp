@@ -0,0 +1,100 @@
+#include "StreamingBuffer.h"
+#include "Logger.h"
+#include <algorithm>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+StreamingBuffer::StreamingBuffer(Device &device, VkDeviceSize bytesPerFrame, u32 frameCount) : m_device(device), m_frameCount(frameCount)
+{
+    auto const &limits = m_device.Properties().limits;
+    m_uniformAlignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+    m_storageAlignment = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 16);
+
+    // Every frame region has to start on an alignment that satisfies all sub-allocations.
+    m_bytesPerFrame = AlignUp(bytesPerFrame, std::max(m_uniformAlignment, m_storageAlignment));
+
+    auto buffer = m_device.CreateBuffer(
+            m_bytesPerFrame * m_frameCount,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_buffer = buffer.Buffer;
+    m_memory = buffer.Memory;
+
+    void *data;
+    auto result = vkMapMemory(m_device.LogicalDevice(), m_memory, 0, VK_WHOLE_SIZE, 0, &data);
+    if (result != VK_SUCCESS) {
+        ERROR("Failed to map streaming buffer");
+        return;
+    }
+    m_mapped = static_cast<u8 *>(data);
+    INFOF("Created streaming buffer: {} frames x {} KiB", m_frameCount, m_bytesPerFrame / 1024);
+}
+
+StreamingBuffer::~StreamingBuffer()
+{
+    if (m_mapped != nullptr) {
+        vkUnmapMemory(m_device.LogicalDevice(), m_memory);
+    }
+    vkDestroyBuffer(m_device.LogicalDevice(), m_buffer, nullptr);
+    m_device.Memory().Free(m_device.LogicalDevice(), m_memory);
+}
+
+void StreamingBuffer::BeginFrame(u32 frameIndex)
+{
+    m_highWaterMark = std::max(m_highWaterMark, m_head.load(std::memory_order_relaxed));
+    m_frameIndex = frameIndex % m_frameCount;
+    m_head.store(0, std::memory_order_relaxed);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (m_mapped == nullptr) {
+        return {};
+    }
+
+    auto head = m_head.load(std::memory_order_relaxed);
+    VkDeviceSize offset;
+    do {
+        offset = AlignUp(head, alignment);
+        if (offset + size > m_bytesPerFrame) {
+            if (!m_reportedOverflow.exchange(true)) {
+                ERRORF("Streaming buffer overflow: requested {} bytes with {} of {} bytes used", size, head, m_bytesPerFrame);
+            }
+            return {};
+        }
+    } while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    m_device.Stats().Add(RenderCounter::MappedBytes, size);
+    auto absoluteOffset = static_cast<VkDeviceSize>(m_frameIndex) * m_bytesPerFrame + offset;
+    return Allocation{
+            .Buffer = m_buffer,
+            .Offset = absoluteOffset,
+            .Size = size,
+            .Data = m_mapped + absoluteOffset,
+    };
+}
+
+StreamingBuffer::Allocation StreamingBuffer::AllocateUniform(VkDeviceSize size)
+{
+    return Allocate(size, m_uniformAlignment);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::AllocateStorage(VkDeviceSize size)
+{
+    return Allocate(size, m_storageAlignment);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::AllocateVertices(VkDeviceSize size)
+{
+    return Allocate(size, 16);
+}
+
+StreamingBuffer::Allocation StreamingBuffer::AllocateIndirect(u32 drawCount)
+{
+    return Allocate(sizeof(VkDrawIndexedIndirectCommand) * drawCount, 4);
+}
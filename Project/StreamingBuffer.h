@@ -0,0 +1,72 @@
+#pragma once
+#include "Definitions.h"
+#include "Device.h"
+#include "Types.h"
+#include <atomic>
+#include <vulkan/vulkan.h>
+
+// One persistently mapped buffer split into a region per frame in flight. Every frame the
+// region is reset and handed out with a bump pointer, so per-frame data (uniforms, streamed
+// vertices, indirect arguments) never allocates or maps anything.
+//
+// BeginFrame must only be called once the fence of that frame slot has been waited on,
+// Swapchain::AcquireNextImage does exactly that.
+class StreamingBuffer {
+public:
+    struct Allocation {
+        VkBuffer Buffer{};
+        VkDeviceSize Offset{};
+        VkDeviceSize Size{};
+        void *Data{};
+
+        MUST_USE bool IsValid() const { return Data != nullptr; }
+
+        template<typename T>
+        MUST_USE T *As() const { return static_cast<T *>(Data); }
+    };
+
+    StreamingBuffer(Device &device, VkDeviceSize bytesPerFrame, u32 frameCount);
+    ~StreamingBuffer();
+    StreamingBuffer(StreamingBuffer const &other) = delete;
+    StreamingBuffer &operator=(StreamingBuffer const &other) = delete;
+
+    void BeginFrame(u32 frameIndex);
+
+    // Safe to call from several threads at once during a frame.
+    MUST_USE Allocation Allocate(VkDeviceSize size, VkDeviceSize alignment);
+    MUST_USE Allocation AllocateUniform(VkDeviceSize size);
+    MUST_USE Allocation AllocateStorage(VkDeviceSize size);
+    MUST_USE Allocation AllocateVertices(VkDeviceSize size);
+    MUST_USE Allocation AllocateIndirect(u32 drawCount);
+
+    template<typename T>
+    MUST_USE Allocation PushUniform(T const &value)
+    {
+        auto allocation = AllocateUniform(sizeof(T));
+        if (allocation.IsValid()) {
+            *allocation.As<T>() = value;
+        }
+        return allocation;
+    }
+
+    MUST_USE VkBuffer Handle() const { return m_buffer; }
+    MUST_USE VkDeviceSize BytesPerFrame() const { return m_bytesPerFrame; }
+    MUST_USE VkDeviceSize UsedThisFrame() const { return m_head.load(std::memory_order_relaxed); }
+    MUST_USE VkDeviceSize HighWaterMark() const { return m_highWaterMark; }
+
+private:
+    Device &m_device;
+    VkBuffer m_buffer{};
+    VkDeviceMemory m_memory{};
+    u8 *m_mapped{};
+
+    VkDeviceSize m_bytesPerFrame{};
+    u32 m_frameCount{};
+    u32 m_frameIndex{};
+    std::atomic<VkDeviceSize> m_head{0};
+    VkDeviceSize m_highWaterMark{};
+    std::atomic<bool> m_reportedOverflow{false};
+
+    VkDeviceSize m_uniformAlignment{};
+    VkDeviceSize m_storageAlignment{};
+};
@@ -1,40 +1,38 @@
 #include "Swapchain.h"
+#include "StartupTimer.h"
 #include <GLFW/glfw3.h>
 #include <algorithm>
 #include <vulkan/vk_enum_string_helper.h>
 
 Swapchain::Swapchain(Device &device) : m_device(device) {
+    auto phase = StartupTimer::Get().Measure("Swapchain");
     CreateSwapchain();
     CreateImageViews();
     CreateRenderPass();
-    CreateDepthResources();
     CreateFramebuffers();
     CreateSyncObjects();
 }
 
 Swapchain::~Swapchain() {
     for (auto view : m_swapchainImageViews) {
-        vkDestroyImageView(m_device.LogicalDevice(), view, nullptr);
+        vkDestroyImageView(m_device.LogicalDevice(), view, m_device.HostCallbacks());
     }
 
-    vkDestroySwapchainKHR(m_device.LogicalDevice(), m_swapchain, nullptr);
+    vkDestroySwapchainKHR(m_device.LogicalDevice(), m_swapchain, m_device.HostCallbacks());
 
     for (u32 i = 0; i < m_depthImages.size(); i++) {
-        vkDestroyImageView(m_device.LogicalDevice(), m_depthImageViews[i], nullptr);
+        vkDestroyImageView(m_device.LogicalDevice(), m_depthImageViews[i], m_device.HostCallbacks());
         vkDestroyImage(m_device.LogicalDevice(), m_depthImages[i], nullptr);
-        vkFreeMemory(m_device.LogicalDevice(), m_depthImageMemories[i], nullptr);
+        m_device.Memory().Free(m_device.LogicalDevice(), m_depthImageMemories[i]);
     }
 
-    for (auto framebuffer: m_swapchainFrameBuffers) {
-        vkDestroyFramebuffer(m_device.LogicalDevice(), framebuffer, nullptr);
-    }
-
-    vkDestroyRenderPass(m_device.LogicalDevice(), m_renderPass, nullptr);
+    DestroyFramebuffers();
+    vkDestroyRenderPass(m_device.LogicalDevice(), m_renderPass, m_device.HostCallbacks());
 
     for (u32 i = 0; i < MaxFramesInFlight; i++) {
-        vkDestroySemaphore(m_device.LogicalDevice(), m_imageAvailableSemaphores[i], nullptr);
-        vkDestroySemaphore(m_device.LogicalDevice(), m_renderFinishedSemaphores[i], nullptr);
-        vkDestroyFence(m_device.LogicalDevice(), m_inFlightFences[i], nullptr);
+        vkDestroySemaphore(m_device.LogicalDevice(), m_imageAvailableSemaphores[i], m_device.HostCallbacks());
+        vkDestroySemaphore(m_device.LogicalDevice(), m_renderFinishedSemaphores[i], m_device.HostCallbacks());
+        vkDestroyFence(m_device.LogicalDevice(), m_inFlightFences[i], m_device.HostCallbacks());
     }
 }
 
@@ -51,6 +49,8 @@ void Swapchain::CreateSwapchain() {
     if (swapchainSupport.Capabilities.maxImageCount > 0 && imageCount > swapchainSupport.Capabilities.maxImageCount) {
         imageCount = swapchainSupport.Capabilities.maxImageCount;
     }
+    // Frame capture copies straight out of the presented images.
+    m_readback = swapchainSupport.Capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 
     VkSwapchainCreateInfoKHR swapchainCreateInfoKhr{
             .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -60,7 +60,7 @@ void Swapchain::CreateSwapchain() {
             .imageColorSpace = surfaceFormat.colorSpace,
             .imageExtent = m_swapchainExtent,
             .imageArrayLayers = 1,
-            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+            .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (m_readback ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0u),
             .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
             .preTransform = swapchainSupport.Capabilities.currentTransform,
             .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
@@ -69,8 +69,17 @@ void Swapchain::CreateSwapchain() {
             .oldSwapchain = VK_NULL_HANDLE,
     };
 
+    // Presenting from another family, concurrent images spare an ownership transfer per frame.
+    auto const &families = m_device.QueueFamilies();
+    u32 sharingFamilies[] = {*families.GraphicsFamily, *families.PresentFamily};
+    if (sharingFamilies[0] != sharingFamilies[1]) {
+        swapchainCreateInfoKhr.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        swapchainCreateInfoKhr.queueFamilyIndexCount = 2;
+        swapchainCreateInfoKhr.pQueueFamilyIndices = sharingFamilies;
+    }
+
     INFO("Creating swapchain");
-    auto result = vkCreateSwapchainKHR(m_device.LogicalDevice(), &swapchainCreateInfoKhr, nullptr, &m_swapchain);
+    auto result = vkCreateSwapchainKHR(m_device.LogicalDevice(), &swapchainCreateInfoKhr, m_device.HostCallbacks(), &m_swapchain);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to create swapchain: {}", string_VkResult(result));
     }
@@ -100,13 +109,14 @@ void Swapchain::CreateImageViews() {
                 .subresourceRange = VkImageSubresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = 0, .levelCount = 1, .baseArrayLayer = 0, .layerCount = 1}};
 
         VkImageView view;
-        vkCreateImageView(m_device.LogicalDevice(), &info, nullptr, &view);
+        vkCreateImageView(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &view);
         m_swapchainImageViews.push_back(view);
     }
 }
 
 void Swapchain::CreateRenderPass() {
-    VkAttachmentDescription attachmentDescription{
+    std::vector<VkAttachmentDescription> attachments;
+    attachments.push_back(VkAttachmentDescription{
             .format = m_swapchainImageFormat,
             .samples = VK_SAMPLE_COUNT_1_BIT,
             .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
@@ -115,13 +125,18 @@ void Swapchain::CreateRenderPass() {
             .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
             .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
             .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
+    });
 
     VkAttachmentReference attachmentRef{
             .attachment = 0,
             .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
     };
 
+    VkAttachmentReference depthRef{
+            .attachment = 1,
+            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+
     VkSubpassDescription subpass{
             .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
             .colorAttachmentCount = 1,
@@ -137,36 +152,69 @@ void Swapchain::CreateRenderPass() {
             .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
     };
 
+    if (HasDepth()) {
+        // Depth never outlives the pass, it is cleared on load and its contents are dropped.
+        attachments.push_back(VkAttachmentDescription{
+                .format = m_depthFormat,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        });
+        subpass.pDepthStencilAttachment = &depthRef;
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+
     VkRenderPassCreateInfo renderPassCreateInfo{
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .attachmentCount = 1,
-            .pAttachments = &attachmentDescription,
+            .attachmentCount = static_cast<u32>(attachments.size()),
+            .pAttachments = attachments.data(),
             .subpassCount = 1,
             .pSubpasses = &subpass,
             .dependencyCount = 1,
             .pDependencies = &dependency};
 
     INFO("Creating render pass");
-    auto result = vkCreateRenderPass(m_device.LogicalDevice(), &renderPassCreateInfo, nullptr, &m_renderPass);
+    auto result = vkCreateRenderPass(m_device.LogicalDevice(), &renderPassCreateInfo, m_device.HostCallbacks(), &m_renderPass);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to create render pass: {}", string_VkResult(result));
     }
     INFO("Successfully created render pass");
 }
 
+void Swapchain::RequireDepth() {
+    if (HasDepth()) {
+        return;
+    }
+    CreateDepthResources();
+
+    // Nothing has been recorded against the old pass yet, it can go right away.
+    DestroyFramebuffers();
+    vkDestroyRenderPass(m_device.LogicalDevice(), m_renderPass, m_device.HostCallbacks());
+    CreateRenderPass();
+    CreateFramebuffers();
+}
+
 void Swapchain::CreateDepthResources() {
     INFO("Creating depth resources");
-    VkFormat depthFormat = m_device.FindSupportedFormat(
+    m_depthFormat = m_device.FindSupportedFormat(
             {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
             VK_IMAGE_TILING_OPTIMAL,
             VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 
-    auto imageCount = m_swapchainImages.size();
-    m_depthImages.resize(imageCount);
-    m_depthImageMemories.resize(imageCount);
-    m_depthImageViews.resize(imageCount);
+    // Frames in flight are the only ones that can render at the same time, swapchain images
+    // waiting for presentation don't need depth anymore.
+    m_depthImages.resize(MaxFramesInFlight);
+    m_depthImageMemories.resize(MaxFramesInFlight);
+    m_depthImageViews.resize(MaxFramesInFlight);
 
-    for (int i = 0; i < m_depthImages.size(); i++) {
+    for (u32 i = 0; i < MaxFramesInFlight; i++) {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -175,61 +223,101 @@ void Swapchain::CreateDepthResources() {
         imageInfo.extent.depth = 1;
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 1;
-        imageInfo.format = depthFormat;
+        imageInfo.format = m_depthFormat;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        // Never stored, tile based GPUs can keep it on chip and back it with lazily allocated memory.
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
         imageInfo.flags = 0;
 
         auto image = m_device.CreateImage(
                 imageInfo,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
         m_depthImages[i] = image.Image;
         m_depthImageMemories[i] = image.Memory;
+        m_depthImageSize = image.Size;
+        m_depthLazilyAllocated = (image.MemoryProperties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         viewInfo.image = m_depthImages[i];
         viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = depthFormat;
+        viewInfo.format = m_depthFormat;
         viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
         viewInfo.subresourceRange.baseMipLevel = 0;
         viewInfo.subresourceRange.levelCount = 1;
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
-        auto result = vkCreateImageView(m_device.LogicalDevice(), &viewInfo, nullptr, &m_depthImageViews[i]);
+        auto result = vkCreateImageView(m_device.LogicalDevice(), &viewInfo, m_device.HostCallbacks(), &m_depthImageViews[i]);
         if (result != VK_SUCCESS) {
             ERRORF("Failed to create texture image view: {}", string_VkResult(result));
         }
     }
 }
 
+void Swapchain::ReportDepthMemory() const {
+    // Compared against a device local depth image per swapchain image, 4 bytes per texel when
+    // there is no depth to measure.
+    auto imageSize = HasDepth() ? m_depthImageSize : static_cast<VkDeviceSize>(m_swapchainExtent.width) * m_swapchainExtent.height * 4;
+    auto perSwapchainImage = imageSize * ImageCount();
+    if (!HasDepth()) {
+        INFOF("Depth: no pipeline uses depth, saved about {} bytes", perSwapchainImage);
+        return;
+    }
+
+    VkDeviceSize resident = 0;
+    for (auto memory: m_depthImageMemories) {
+        if (m_depthLazilyAllocated) {
+            VkDeviceSize committed = 0;
+            vkGetDeviceMemoryCommitment(m_device.LogicalDevice(), memory, &committed);
+            resident += committed;
+        } else {
+            resident += m_depthImageSize;
+        }
+    }
+    INFOF("Depth: {} images of {} bytes{}, {} bytes resident, saved {} bytes",
+          m_depthImages.size(), m_depthImageSize, m_depthLazilyAllocated ? " in lazily allocated memory" : "",
+          resident, perSwapchainImage - resident);
+}
+
 void Swapchain::CreateFramebuffers() {
     INFO("Creating framebuffers");
-    m_swapchainFrameBuffers.resize(m_swapchainImages.size());
+    auto depthCount = HasDepth() ? MaxFramesInFlight : 1;
+    m_swapchainFrameBuffers.resize(m_swapchainImages.size() * depthCount);
 
     u32 i = 0;
     for (auto view: m_swapchainImageViews) {
-        VkFramebufferCreateInfo info{
-                .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-                .renderPass = m_renderPass,
-                .attachmentCount = 1,
-                .pAttachments = &view,
-                .width = m_swapchainExtent.width,
-                .height = m_swapchainExtent.height,
-                .layers = 1,
-        };
-
-        auto result = vkCreateFramebuffer(m_device.LogicalDevice(), &info, nullptr, &m_swapchainFrameBuffers[i++]);
-        if (result != VK_SUCCESS) {
-            ERRORF("Failed to create framebuffer: {}", string_VkResult(result));
+        for (u32 frame = 0; frame < depthCount; frame++) {
+            VkImageView attachments[] = {view, HasDepth() ? m_depthImageViews[frame] : VK_NULL_HANDLE};
+            VkFramebufferCreateInfo info{
+                    .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+                    .renderPass = m_renderPass,
+                    .attachmentCount = HasDepth() ? 2u : 1u,
+                    .pAttachments = attachments,
+                    .width = m_swapchainExtent.width,
+                    .height = m_swapchainExtent.height,
+                    .layers = 1,
+            };
+
+            auto result = vkCreateFramebuffer(m_device.LogicalDevice(), &info, m_device.HostCallbacks(), &m_swapchainFrameBuffers[i++]);
+            if (result != VK_SUCCESS) {
+                ERRORF("Failed to create framebuffer: {}", string_VkResult(result));
+            }
         }
     }
 }
 
+void Swapchain::DestroyFramebuffers() {
+    for (auto framebuffer: m_swapchainFrameBuffers) {
+        vkDestroyFramebuffer(m_device.LogicalDevice(), framebuffer, m_device.HostCallbacks());
+    }
+    m_swapchainFrameBuffers.clear();
+}
+
 void Swapchain::CreateSyncObjects() {
     m_imageAvailableSemaphores.resize(MaxFramesInFlight);
     m_renderFinishedSemaphores.resize(MaxFramesInFlight);
@@ -244,15 +332,15 @@ void Swapchain::CreateSyncObjects() {
             .flags = VK_FENCE_CREATE_SIGNALED_BIT};
 
     for (u32 i = 0; i < MaxFramesInFlight; i++) {
-        auto result = vkCreateSemaphore(m_device.LogicalDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]);
+        auto result = vkCreateSemaphore(m_device.LogicalDevice(), &semaphoreInfo, m_device.HostCallbacks(), &m_imageAvailableSemaphores[i]);
         if (result != VK_SUCCESS) {
             ERRORF("Failed to create ImageAvailable semaphore for frame '{}'", i);
         }
-        result = vkCreateSemaphore(m_device.LogicalDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]);
+        result = vkCreateSemaphore(m_device.LogicalDevice(), &semaphoreInfo, m_device.HostCallbacks(), &m_renderFinishedSemaphores[i]);
         if (result != VK_SUCCESS) {
             ERRORF("Failed to create RenderFinished semaphore for frame '{}'", i);
         }
-        result = vkCreateFence(m_device.LogicalDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]);
+        result = vkCreateFence(m_device.LogicalDevice(), &fenceInfo, m_device.HostCallbacks(), &m_inFlightFences[i]);
         if (result != VK_SUCCESS) {
             ERRORF("Failed to create fence for frame '{}'", i);
         }
@@ -281,6 +369,12 @@ VkExtent2D Swapchain::ChooseSwapExtent(VkSurfaceCapabilitiesKHR capabilities) {
 u32 Swapchain::AcquireNextImage() {
     vkWaitForFences(m_device.LogicalDevice(), 1, &m_inFlightFences[m_currentFrame], VK_TRUE, std::numeric_limits<u64>::max());
 
+    // This slot was last used MaxFramesInFlight frames ago, the fence covers that frame and
+    // everything submitted before it.
+    u64 completedFrames = m_frameNumber >= MaxFramesInFlight ? m_frameNumber - MaxFramesInFlight + 1 : 0;
+    m_device.Deletion().BeginFrame(m_frameNumber, completedFrames);
+    m_device.ReclaimUploads();
+
     u32 index;
     auto result = vkAcquireNextImageKHR(m_device.LogicalDevice(), m_swapchain, std::numeric_limits<u64>::max(), m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &index);
     if (result != VK_SUCCESS) {
@@ -289,7 +383,7 @@ u32 Swapchain::AcquireNextImage() {
     return index;
 }
 
-void Swapchain::SubmitCommandBuffers(VkCommandBuffer const* buffers, u32 imageIndex) {
+void Swapchain::SubmitCommandBuffers(VkCommandBuffer const* buffers, u32 imageIndex, std::span<QueueWait const> waits) {
     if (m_imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
         vkWaitForFences(m_device.LogicalDevice(), 1, &m_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
     }
@@ -299,22 +393,16 @@ void Swapchain::SubmitCommandBuffers(VkCommandBuffer const* buffers, u32 imageIn
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
 
-    VkSubmitInfo submitInfo {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = waitSemaphores,
-            .pWaitDstStageMask = waitStages,
-            .commandBufferCount = 1,
-            .pCommandBuffers = buffers,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = signalSemaphores,
-    };
-
+    // The frame also signals the graphics timeline, so other queues can wait on it.
     vkResetFences(m_device.LogicalDevice(), 1, &m_inFlightFences[m_currentFrame]);
-    auto result = vkQueueSubmit(m_device.GraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]);
-    if (result != VK_SUCCESS) {
-        ERRORF("Failed to submit draw command buffer: {}", string_VkResult(result));
-    }
+    m_lastSubmit = m_device.Submit(QueueType::Graphics, QueueSubmission{
+            .CommandBuffers = {buffers, 1},
+            .Waits = waits,
+            .BinaryWaits = waitSemaphores,
+            .BinaryWaitStages = waitStages,
+            .BinarySignals = signalSemaphores,
+            .Fence = m_inFlightFences[m_currentFrame],
+    });
 
     VkSwapchainKHR swapChains[] = {m_swapchain};
     VkPresentInfoKHR presentInfo {
@@ -326,10 +414,12 @@ void Swapchain::SubmitCommandBuffers(VkCommandBuffer const* buffers, u32 imageIn
             .pImageIndices = &imageIndex,
     };
 
-    result = vkQueuePresentKHR(m_device.PresentQueue(), &presentInfo);
+    std::scoped_lock queueLock(m_device.QueueMutex());
+    auto result = vkQueuePresentKHR(m_device.PresentQueue(), &presentInfo);
     if (result != VK_SUCCESS) {
         ERRORF("Failed to present queue: {}", string_VkResult(result));
     }
 
     m_currentFrame = (m_currentFrame + 1) % MaxFramesInFlight;
+    m_frameNumber++;
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "Definitions.h"
 #include "Device.h"
+#include <span>
 #include <vector>
 #include <vulkan/vulkan.h>
 
@@ -11,9 +12,13 @@ class Swapchain {
     std::vector<VkFramebuffer> m_swapchainFrameBuffers;
     VkRenderPass m_renderPass{};
 
+    // One per frame in flight, only created once something renders with depth.
+    VkFormat m_depthFormat{VK_FORMAT_UNDEFINED};
     std::vector<VkImage> m_depthImages;
     std::vector<VkDeviceMemory> m_depthImageMemories;
     std::vector<VkImageView> m_depthImageViews;
+    VkDeviceSize m_depthImageSize{0};
+    bool m_depthLazilyAllocated{false};
     std::vector<VkImage> m_swapchainImages;
     std::vector<VkImageView> m_swapchainImageViews;
 
@@ -25,6 +30,9 @@ class Swapchain {
     std::vector<VkFence> m_inFlightFences;
     std::vector<VkFence> m_imagesInFlight;
     u32 m_currentFrame = 0;
+    u64 m_frameNumber = 0;
+    QueuePoint m_lastSubmit{};
+    bool m_readback{false};
 
 public:
     static constexpr u32 MaxFramesInFlight = 2;
@@ -35,11 +43,31 @@ public:
     MUST_USE u32 ImageCount() const { return m_swapchainImages.size(); }
     MUST_USE VkRenderPass RenderPass() const { return m_renderPass; }
     MUST_USE VkExtent2D Extent() const { return m_swapchainExtent; }
+    MUST_USE VkFormat ImageFormat() const { return m_swapchainImageFormat; }
+    MUST_USE VkImage GetImage(u32 index) const { return m_swapchainImages[index]; }
+    MUST_USE VkImageView GetImageView(u32 index) const { return m_swapchainImageViews[index]; }
+    MUST_USE u32 CurrentFrame() const { return m_currentFrame; }
+    MUST_USE u64 FrameNumber() const { return m_frameNumber; }
+    // The images can be a transfer source, which frame capture needs.
+    MUST_USE bool SupportsReadback() const { return m_readback; }
 
-    MUST_USE VkFramebuffer GetFramebuffer(u32 index) const { return m_swapchainFrameBuffers[index]; }
+    // Adds depth attachments to the render pass and framebuffers. Has to be called before any
+    // pipeline is created against RenderPass(), later calls do nothing.
+    void RequireDepth();
+    MUST_USE bool HasDepth() const { return !m_depthImages.empty(); }
+    MUST_USE VkFormat DepthFormat() const { return m_depthFormat; }
+    MUST_USE VkImage DepthImage() const { return m_depthImages[m_currentFrame]; }
+    MUST_USE VkImageView DepthImageView() const { return m_depthImageViews[m_currentFrame]; }
+    void ReportDepthMemory() const;
+
+    // With depth there is a framebuffer per swapchain image and frame in flight.
+    MUST_USE VkFramebuffer GetFramebuffer(u32 index) const { return m_swapchainFrameBuffers[HasDepth() ? index * MaxFramesInFlight + m_currentFrame : index]; }
     MUST_USE u32 AcquireNextImage();
 
-    void SubmitCommandBuffers(VkCommandBuffer const* buffers, u32 imageIndex);
+    // `waits` are work on other queues the frame consumes, e.g. async compute results.
+    void SubmitCommandBuffers(VkCommandBuffer const* buffers, u32 imageIndex, std::span<QueueWait const> waits = {});
+    // Graphics timeline point of the last submitted frame.
+    MUST_USE QueuePoint LastSubmit() const { return m_lastSubmit; }
 
 private:
     void CreateSwapchain();
@@ -47,6 +75,7 @@ private:
     void CreateRenderPass();
     void CreateDepthResources();
     void CreateFramebuffers();
+    void DestroyFramebuffers();
     void CreateSyncObjects();
 
     MUST_USE VkExtent2D ChooseSwapExtent(VkSurfaceCapabilitiesKHR capabilities);
@@ -0,0 +1,66 @@
+#pragma once
+#include "Definitions.h"
+#include "Types.h"
+#include <atomic>
+
+// Single-producer / single-consumer handoff. The producer always owns one slot, the consumer
+// owns another and the third is exchanged between them through a single atomic word, so neither
+// side ever takes a lock. If the producer publishes twice before the consumer reads, the older
+// packet is dropped and the consumer only ever sees the latest one.
+template<typename T>
+class TripleBuffer {
+    static constexpr u32 IndexMask = 0b011;
+    static constexpr u32 FreshBit = 0b100;
+
+    T m_slots[3]{};
+    std::atomic<u32> m_shared{1};
+    u32 m_write{0};
+    u32 m_read{2};
+
+public:
+    MUST_USE T &WriteSlot() { return m_slots[m_write]; }
+    MUST_USE T const &ReadSlot() const { return m_slots[m_read]; }
+
+    void Publish()
+    {
+        auto previous = m_shared.exchange(m_write | FreshBit, std::memory_order_acq_rel);
+        m_write = previous & IndexMask;
+        m_shared.notify_all();
+    }
+
+    MUST_USE bool Consume()
+    {
+        if ((m_shared.load(std::memory_order_acquire) & FreshBit) == 0) {
+            return false;
+        }
+        auto previous = m_shared.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & IndexMask;
+        m_shared.notify_all();
+        return true;
+    }
+
+    MUST_USE bool HasPending() const
+    {
+        return (m_shared.load(std::memory_order_acquire) & FreshBit) != 0;
+    }
+
+    // Blocks the producer until the last published packet has been picked up.
+    void WaitUntilConsumed() const
+    {
+        auto value = m_shared.load(std::memory_order_acquire);
+        while (value & FreshBit) {
+            m_shared.wait(value, std::memory_order_acquire);
+            value = m_shared.load(std::memory_order_acquire);
+        }
+    }
+
+    // Blocks the consumer until a new packet has been published.
+    void WaitForPacket() const
+    {
+        auto value = m_shared.load(std::memory_order_acquire);
+        while ((value & FreshBit) == 0) {
+            m_shared.wait(value, std::memory_order_acquire);
+            value = m_shared.load(std::memory_order_acquire);
+        }
+    }
+};
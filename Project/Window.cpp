@@ -1,7 +1,9 @@
 #include "Window.h"
+#include "StartupTimer.h"
 #include <exception>
 
 Window::Window(u32 width, u32 height, std::string title) : m_Width(width), m_Height(height), m_Title(std::move(title)) {
+    auto phase = StartupTimer::Get().Measure("Window");
     if (glfwInit() != GLFW_TRUE) {
         throw std::exception("Failed to initialize GLFW");
     }
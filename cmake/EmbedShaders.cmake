@@ -0,0 +1,24 @@
+# Turns compiled SPIR-V into constexpr word arrays the shader loader finds by path. Run as
+#   cmake -DSHADER_FILES="a.spv|b.spv" -DOUTPUT=EmbeddedShaders.h -P EmbedShaders.cmake
+string(REPLACE "|" ";" SHADER_FILES "${SHADER_FILES}")
+
+set(CONTENT "// Generated by cmake/EmbedShaders.cmake, do not edit.\n#pragma once\n#include \"ShaderCode.h\"\n\n")
+set(TABLE "")
+foreach(SHADER_FILE ${SHADER_FILES})
+    get_filename_component(SHADER_NAME ${SHADER_FILE} NAME)
+    string(MAKE_C_IDENTIFIER ${SHADER_NAME} SHADER_SYMBOL)
+    file(READ ${SHADER_FILE} SHADER_HEX HEX)
+    string(LENGTH "${SHADER_HEX}" HEX_LENGTH)
+    math(EXPR SHADER_SIZE "${HEX_LENGTH} / 2")
+
+    # SPIR-V is a stream of little endian words, eight to a line.
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1u, " SHADER_WORDS "${SHADER_HEX}")
+    string(REPEAT "0x[0-9a-f]+u, " 8 LINE_PATTERN)
+    string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n        " SHADER_WORDS "${SHADER_WORDS}")
+
+    string(APPEND CONTENT "alignas(16) inline constexpr u32 g_${SHADER_SYMBOL}[] = {\n        ${SHADER_WORDS}\n};\n\n")
+    string(APPEND TABLE "        EmbeddedShader{\"Assets/Shaders/${SHADER_NAME}\", g_${SHADER_SYMBOL}, ${SHADER_SIZE}},\n")
+endforeach()
+
+string(APPEND CONTENT "inline constexpr EmbeddedShader g_EmbeddedShaders[] = {\n${TABLE}};\n")
+file(WRITE ${OUTPUT} "${CONTENT}")